@@ -0,0 +1,1224 @@
+#include "x86_64.h"
+#include "../codegen/ir.h"
+#include "../common/arena.h"
+#include "../common/file_utils.h"
+#include "../semantic/semantic.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define BUFFER_SIZE 1024
+
+// Note: values live in registers or stack slots for their whole interval,
+// so an instruction never needs more than the scratch registers rax, rcx
+// and rdx, or xmm0 and xmm1, to reach them.
+
+//> Platform
+#ifdef __APPLE__
+#define SYMBOL_PREFIX "_"
+#define LOCAL_PREFIX "L"
+#define CALL_SUFFIX ""
+#define RODATA_SECTION ".section __TEXT,__const"
+#define STDERR_SYMBOL "___stderrp"
+#else
+#define SYMBOL_PREFIX ""
+#define LOCAL_PREFIX ".L"
+#define CALL_SUFFIX "@PLT"
+#define RODATA_SECTION ".section .rodata"
+#define STDERR_SYMBOL "stderr"
+#endif
+//< Platform
+
+//> Registers
+// Allocatable registers never overlap the scratch or argument registers,
+// so argument moves cannot clobber a live value
+static const char *intRegisters[] = {"%rbx", "%r12", "%r13", "%r14",
+                                     "%r15", "%r10", "%r11"};
+#define INT_REGISTER_COUNT 7
+#define CALLEE_SAVED_COUNT 5 // The first ones survive calls
+
+static const char *doubleRegisters[] = {"%xmm8",  "%xmm9",  "%xmm10",
+                                        "%xmm11", "%xmm12", "%xmm13",
+                                        "%xmm14", "%xmm15"};
+#define DOUBLE_REGISTER_COUNT 8
+#define MAX_REGISTER_COUNT 8
+
+static const char *intArguments[] = {"%rdi", "%rsi", "%rdx",
+                                     "%rcx", "%r8",  "%r9"};
+#define INT_ARGUMENT_COUNT 6
+
+static const char *doubleArguments[] = {"%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                                        "%xmm4", "%xmm5", "%xmm6", "%xmm7"};
+#define DOUBLE_ARGUMENT_COUNT 8
+//< Registers
+
+//> Output
+static OutputBuffer output;
+
+static void emit(const char *format, ...) {
+  char line[BUFFER_SIZE];
+  va_list args;
+
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  if (length > 0) {
+    size_t size = (size_t)length;
+    appendBytes(&output, line, size < sizeof(line) ? size : sizeof(line) - 1);
+  }
+}
+//< Output
+
+//> Live Intervals
+typedef struct {
+  int32_t start; // Position of the first occurrence, -1 if never used
+  int32_t end;   // Position of the last occurrence
+  bool isDouble;
+  bool firstIsDefinition;
+  bool crossesCall;
+  int8_t reg;   // Index in its register class, -1 when spilled
+  int32_t slot; // Frame offset of a spilled value
+} Interval;
+
+// Where an operand lives while the function runs
+typedef enum {
+  LOCATION_NONE,
+  LOCATION_REGISTER,
+  LOCATION_STACK,
+  LOCATION_INT,         // Integer constant
+  LOCATION_DOUBLE,      // Double constant in read-only data
+  LOCATION_STACK_ARRAY, // Array in the frame
+  LOCATION_GLOBAL_ARRAY,
+} LocationKind;
+
+typedef struct {
+  LocationKind kind;
+  bool isDouble;
+  int32_t reg;    // Register index, or constant index for doubles
+  int32_t offset; // Frame offset of a slot or array
+  int64_t value;  // Integer constant, or array size
+  const char *name;
+} Location;
+
+// State of the function being compiled
+static IrFunction *function;
+static int functionIndex;
+static Interval *intervals;
+static int valueCount;
+static int32_t *valueOfVariable; // Value of a scalar, -1 for other variables
+static int32_t *arrayOffset;     // Frame offset of a local array
+static int32_t *labelPosition;
+
+// Variables grouped by the function that owns them, globals under the
+// entry function: those of f are owned[ownedStart[f] .. ownedStart[f + 1]]
+static int32_t *owned;
+static int32_t *ownedStart;
+static int32_t frameBytes;       // Spill slots and local arrays
+static int savedCount;           // Callee-saved registers pushed
+static bool usesDivision;
+static bool usesBounds;
+
+// Temporaries and scalar variables are values, numbered per function
+static int32_t valueOf(Operand operand) {
+  switch (operandKind(operand)) {
+  case OPERAND_TEMP:
+    return (int32_t)operandIndex(operand) - function->firstTemp;
+  case OPERAND_VARIABLE:
+    return valueOfVariable[operandIndex(operand)];
+  default:
+    return -1;
+  }
+}
+
+static void occur(Operand operand, int32_t position, bool isDefinition) {
+  int32_t value = valueOf(operand);
+  if (value < 0) {
+    return;
+  }
+
+  Interval *interval = &intervals[value];
+  if (interval->start < 0) {
+    interval->start = position;
+    interval->firstIsDefinition = isDefinition;
+  }
+  interval->end = position;
+}
+
+static bool definesResult(uint8_t opcode) {
+  return opcode == IR_COPY || (opcode >= IR_ADD && opcode <= IR_LOAD) ||
+         opcode == IR_CALL || opcode == IR_SHL || opcode == IR_MOD_POW2;
+}
+
+// Instructions that call into C or another function clobber every
+// caller-saved register
+static bool isCall(const Instruction *instruction) {
+  return instruction->opcode == IR_CALL || instruction->opcode == IR_PRINT ||
+         (instruction->opcode == IR_MOD && instruction->type == DOUBLE);
+}
+
+static const Instruction *instructionAt(int32_t position) {
+  return &ir->instructions[function->firstInstruction + position - 1];
+}
+
+// Positions count from 1; position 0 is the function entry, where
+// parameters arrive and variables start at zero
+static void buildIntervals() {
+  for (int i = 0; i < valueCount; i++) {
+    intervals[i].start = -1;
+    intervals[i].end = -1;
+    intervals[i].crossesCall = false;
+    intervals[i].reg = -1;
+    intervals[i].slot = 0;
+  }
+
+  for (int t = 0; t < function->tempCount; t++) {
+    intervals[t].isDouble = ir->tempTypes[function->firstTemp + t] == DOUBLE;
+  }
+  for (int k = ownedStart[functionIndex]; k < ownedStart[functionIndex + 1];
+       k++) {
+    int32_t v = owned[k];
+    if (valueOfVariable[v] >= 0) {
+      Interval *interval = &intervals[valueOfVariable[v]];
+      interval->isDouble = ir->variables[v].type == DOUBLE;
+      interval->start = 0;
+      interval->end = 0;
+      interval->firstIsDefinition = true;
+    }
+  }
+
+  for (int32_t position = 1; position <= function->instructionCount;
+       position++) {
+    const Instruction *instruction = instructionAt(position);
+
+    if (instruction->opcode == IR_LABEL) {
+      labelPosition[operandIndex(instruction->result)] = position;
+      continue;
+    }
+
+    occur(instruction->arg1, position, false);
+    occur(instruction->arg2, position, false);
+    if (definesResult(instruction->opcode)) {
+      occur(instruction->result, position, true);
+    }
+  }
+
+  // A temporary read before its definition, which only a loop can reach,
+  // lives from the entry like a variable
+  for (int i = 0; i < function->tempCount; i++) {
+    if (intervals[i].start >= 0 && !intervals[i].firstIsDefinition) {
+      intervals[i].start = 0;
+    }
+  }
+
+  // Loops nest, so a value live across a loop boundary must hold for the
+  // whole loop: stretch its end to the furthest back edge of a loop it
+  // ends in, and its start to the top of a loop it starts in
+  int32_t positions = function->instructionCount + 2;
+  size_t tableSize = positions * sizeof(int32_t);
+  int32_t *furthestBottom = arenaAlloc(backendArena, tableSize);
+  int32_t *earliestTop = arenaAlloc(backendArena, tableSize);
+  int32_t *callsBefore = arenaAlloc(backendArena, tableSize);
+
+  for (int32_t position = 0; position < positions; position++) {
+    furthestBottom[position] = -1;
+    earliestTop[position] = positions;
+  }
+
+  for (int32_t position = 1; position <= function->instructionCount;
+       position++) {
+    const Instruction *instruction = instructionAt(position);
+    if (instruction->opcode < IR_JUMP || instruction->opcode > IR_JUMP_NE) {
+      continue;
+    }
+
+    int32_t top = labelPosition[operandIndex(instruction->result)];
+    if (top <= position) {
+      if (position > furthestBottom[top]) {
+        furthestBottom[top] = position;
+      }
+      if (top < earliestTop[position]) {
+        earliestTop[position] = top;
+      }
+    }
+  }
+
+  // Loops with their top at or before a position, and their back edge at
+  // or after it
+  for (int32_t position = 1; position < positions; position++) {
+    if (furthestBottom[position - 1] > furthestBottom[position]) {
+      furthestBottom[position] = furthestBottom[position - 1];
+    }
+  }
+  for (int32_t position = positions - 2; position >= 0; position--) {
+    if (earliestTop[position + 1] < earliestTop[position]) {
+      earliestTop[position] = earliestTop[position + 1];
+    }
+  }
+
+  callsBefore[0] = 0;
+  for (int32_t position = 1; position < positions; position++) {
+    callsBefore[position] = callsBefore[position - 1] +
+                            (position <= function->instructionCount &&
+                             isCall(instructionAt(position)));
+  }
+
+  for (int i = 0; i < valueCount; i++) {
+    Interval *interval = &intervals[i];
+    if (interval->start < 0) {
+      continue;
+    }
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      if (furthestBottom[interval->end] > interval->end) {
+        interval->end = furthestBottom[interval->end];
+        changed = true;
+      }
+      if (earliestTop[interval->start] < interval->start) {
+        interval->start = earliestTop[interval->start];
+        changed = true;
+      }
+    }
+
+    // A call strictly inside the interval clobbers caller-saved registers
+    interval->crossesCall =
+        interval->end > interval->start + 1 &&
+        callsBefore[interval->end - 1] > callsBefore[interval->start];
+  }
+}
+//< Live Intervals
+
+//> Linear Scan
+static int compareStarts(const void *left, const void *right) {
+  const Interval *a = &intervals[*(const int32_t *)left];
+  const Interval *b = &intervals[*(const int32_t *)right];
+
+  if (a->start != b->start) {
+    return a->start < b->start ? -1 : 1;
+  }
+  return *(const int32_t *)left - *(const int32_t *)right;
+}
+
+static void spill(Interval *interval) {
+  interval->reg = -1;
+  frameBytes += 8;
+  interval->slot = -frameBytes;
+}
+
+// Intervals crossing a call only fit callee-saved registers, and SSE has
+// none of those in the System V convention
+static bool fits(const Interval *interval, int reg) {
+  if (!interval->crossesCall) {
+    return true;
+  }
+  return !interval->isDouble && reg < CALLEE_SAVED_COUNT;
+}
+
+static void allocateRegisters() {
+  int32_t *order = arenaAlloc(backendArena, (valueCount + 1) * sizeof(int32_t));
+  int32_t active[INT_REGISTER_COUNT + DOUBLE_REGISTER_COUNT];
+  int activeCount = 0;
+  int count = 0;
+
+  for (int i = 0; i < valueCount; i++) {
+    if (intervals[i].start >= 0) {
+      order[count++] = i;
+    }
+  }
+  qsort(order, count, sizeof(int32_t), compareStarts);
+
+  for (int n = 0; n < count; n++) {
+    Interval *current = &intervals[order[n]];
+    bool isUsed[MAX_REGISTER_COUNT] = {false};
+
+    // Expire intervals that ended before this one starts
+    int kept = 0;
+    for (int i = 0; i < activeCount; i++) {
+      if (intervals[active[i]].end >= current->start) {
+        active[kept++] = active[i];
+      }
+    }
+    activeCount = kept;
+
+    for (int i = 0; i < activeCount; i++) {
+      if (intervals[active[i]].isDouble == current->isDouble) {
+        isUsed[intervals[active[i]].reg] = true;
+      }
+    }
+
+    int registerCount =
+        current->isDouble ? DOUBLE_REGISTER_COUNT : INT_REGISTER_COUNT;
+    for (int reg = 0; reg < registerCount; reg++) {
+      if (!isUsed[reg] && fits(current, reg)) {
+        current->reg = (int8_t)reg;
+        break;
+      }
+    }
+
+    if (current->reg >= 0) {
+      active[activeCount++] = order[n];
+      continue;
+    }
+
+    // Spill whichever ends last: the current interval, or an active one
+    // whose register it can take
+    int victim = -1;
+    for (int i = 0; i < activeCount; i++) {
+      Interval *candidate = &intervals[active[i]];
+      if (candidate->isDouble == current->isDouble &&
+          fits(current, candidate->reg) && candidate->end > current->end &&
+          (victim < 0 || candidate->end > intervals[active[victim]].end)) {
+        victim = i;
+      }
+    }
+
+    if (victim < 0) {
+      spill(current);
+      continue;
+    }
+
+    current->reg = intervals[active[victim]].reg;
+    spill(&intervals[active[victim]]);
+    active[victim] = order[n];
+  }
+}
+//< Linear Scan
+
+//> Operands
+static Location locate(Operand operand) {
+  Location location = {.kind = LOCATION_NONE};
+  uint32_t index = operandIndex(operand);
+
+  switch (operandKind(operand)) {
+  case OPERAND_CONSTANT:
+    location.isDouble = ir->constants[index].type == DOUBLE;
+    location.kind = location.isDouble ? LOCATION_DOUBLE : LOCATION_INT;
+    location.reg = (int32_t)index;
+    location.value = ir->constants[index].intValue;
+    return location;
+  case OPERAND_VARIABLE:
+    if (ir->variables[index].arraySize > 0) {
+      location.kind = ir->variables[index].function == -1
+                          ? LOCATION_GLOBAL_ARRAY
+                          : LOCATION_STACK_ARRAY;
+      location.isDouble = ir->variables[index].type == DOUBLE;
+      location.offset = arrayOffset[index];
+      location.value = ir->variables[index].arraySize;
+      location.name = ir->variables[index].name;
+      return location;
+    }
+    break;
+  case OPERAND_TEMP:
+    break;
+  default:
+    return location;
+  }
+
+  // Scalar variables are values, like temporaries
+  Interval *interval = &intervals[valueOf(operand)];
+  location.isDouble = interval->isDouble;
+  location.kind = interval->reg >= 0 ? LOCATION_REGISTER : LOCATION_STACK;
+  location.reg = interval->reg;
+  location.offset = interval->slot;
+  return location;
+}
+
+static bool fitsImmediate(int64_t value) {
+  return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static bool sameLocation(Location a, Location b) {
+  if (a.kind != b.kind) {
+    return false;
+  }
+  if (a.kind == LOCATION_REGISTER) {
+    return a.isDouble == b.isDouble && a.reg == b.reg;
+  }
+  return a.kind == LOCATION_STACK && a.offset == b.offset;
+}
+
+// Assembly text of a location; rotating buffers keep a few alive at once
+static const char *text(Location location) {
+  static char texts[4][64];
+  static int next = 0;
+  char *result = texts[next];
+  next = (next + 1) % 4;
+
+  switch (location.kind) {
+  case LOCATION_REGISTER:
+    return location.isDouble ? doubleRegisters[location.reg]
+                             : intRegisters[location.reg];
+  case LOCATION_STACK:
+    snprintf(result, 64, "%d(%%rbp)", location.offset);
+    return result;
+  case LOCATION_INT:
+    snprintf(result, 64, "$%lld", (long long)location.value);
+    return result;
+  case LOCATION_DOUBLE:
+    snprintf(result, 64, LOCAL_PREFIX "D%d(%%rip)", location.reg);
+    return result;
+  default:
+    return "?";
+  }
+}
+
+// Source text for an integer operand; constants too wide for an immediate
+// go through the scratch register
+static const char *intSource(Location location, const char *scratch) {
+  if (location.kind == LOCATION_INT && !fitsImmediate(location.value)) {
+    emit("  movabsq $%lld, %s\n", (long long)location.value, scratch);
+    return scratch;
+  }
+  return text(location);
+}
+
+static void loadInt(const char *reg, Location source) {
+  if (source.kind == LOCATION_INT && source.value == 0) {
+    emit("  xorq %s, %s\n", reg, reg);
+    return;
+  }
+  if (source.kind == LOCATION_INT && !fitsImmediate(source.value)) {
+    emit("  movabsq $%lld, %s\n", (long long)source.value, reg);
+    return;
+  }
+  emit("  movq %s, %s\n", text(source), reg);
+}
+
+static void storeInt(Location target, const char *reg) {
+  emit("  movq %s, %s\n", reg, text(target));
+}
+
+static void moveInt(Location target, Location source) {
+  if (sameLocation(target, source)) {
+    return;
+  }
+
+  if (target.kind == LOCATION_REGISTER) {
+    loadInt(text(target), source);
+  } else if (source.kind == LOCATION_REGISTER ||
+             (source.kind == LOCATION_INT && fitsImmediate(source.value))) {
+    emit("  movq %s, %s\n", text(source), text(target));
+  } else {
+    loadInt("%rax", source);
+    storeInt(target, "%rax");
+  }
+}
+
+static void loadDouble(const char *reg, Location source) {
+  if (source.kind == LOCATION_REGISTER) {
+    emit("  movapd %s, %s\n", text(source), reg);
+  } else {
+    emit("  movsd %s, %s\n", text(source), reg);
+  }
+}
+
+static void storeDouble(Location target, const char *reg) {
+  if (target.kind == LOCATION_REGISTER) {
+    emit("  movapd %s, %s\n", reg, text(target));
+  } else {
+    emit("  movsd %s, %s\n", reg, text(target));
+  }
+}
+
+static void moveDouble(Location target, Location source) {
+  if (sameLocation(target, source)) {
+    return;
+  }
+
+  if (target.kind == LOCATION_REGISTER) {
+    loadDouble(text(target), source);
+  } else if (source.kind == LOCATION_REGISTER) {
+    storeDouble(target, text(source));
+  } else {
+    loadDouble("%xmm0", source);
+    storeDouble(target, "%xmm0");
+  }
+}
+
+// A double operand as an SSE source: registers and memory as they are
+static const char *doubleSource(Location location) { return text(location); }
+
+// Register holding a double operand, loading it into the scratch if needed
+static const char *doubleRegister(Location location, const char *scratch) {
+  if (location.kind == LOCATION_REGISTER) {
+    return text(location);
+  }
+  loadDouble(scratch, location);
+  return scratch;
+}
+//< Operands
+
+//> Instruction Selection
+static void label(Operand operand) {
+  emit(LOCAL_PREFIX "L%u:\n", operandIndex(operand));
+}
+
+static void genIntArithmetic(const Instruction *instruction) {
+  static const char *mnemonics[] = {"addq", "subq", "imulq"};
+  Location result = locate(instruction->result);
+  Location left = locate(instruction->arg1);
+  Location right = locate(instruction->arg2);
+
+  // Work in the result register unless the right operand lives there
+  bool isInPlace =
+      result.kind == LOCATION_REGISTER && !sameLocation(result, right);
+  const char *reg = isInPlace ? text(result) : "%rax";
+
+  if (!sameLocation(result, left) || !isInPlace) {
+    loadInt(reg, left);
+  }
+  emit("  %s %s, %s\n", mnemonics[instruction->opcode - IR_ADD],
+       intSource(right, "%rcx"), reg);
+
+  if (!isInPlace) {
+    storeInt(result, "%rax");
+  }
+}
+
+static void genIntDivision(const Instruction *instruction) {
+  Location result = locate(instruction->result);
+  bool isModulo = instruction->opcode == IR_MOD;
+
+  // Dividing by -1 negates, and the modulo is 0, without the overflow
+  // idiv traps on for the smallest integer
+  usesDivision = true;
+  loadInt("%rcx", locate(instruction->arg2));
+  emit("  testq %%rcx, %%rcx\n");
+  emit("  je " LOCAL_PREFIX "divide_by_zero_%d\n", functionIndex);
+  loadInt("%rax", locate(instruction->arg1));
+  emit("  cmpq $-1, %%rcx\n");
+  emit("  jne 1f\n");
+  emit(isModulo ? "  xorq %%rax, %%rax\n" : "  negq %%rax\n");
+  emit("  jmp 2f\n");
+  emit("1:\n");
+  emit("  cqto\n");
+  emit("  idivq %%rcx\n");
+  if (isModulo) {
+    emit("  movq %%rdx, %%rax\n");
+  }
+  emit("2:\n");
+  storeInt(result, "%rax");
+}
+
+static void genShift(const Instruction *instruction) {
+  Location result = locate(instruction->result);
+  Location value = locate(instruction->arg1);
+  const char *reg = result.kind == LOCATION_REGISTER ? text(result) : "%rax";
+
+  if (!sameLocation(result, value)) {
+    loadInt(reg, value);
+  }
+  emit("  shlq $%lld, %s\n", (long long)locate(instruction->arg2).value, reg);
+  if (result.kind != LOCATION_REGISTER) {
+    storeInt(result, "%rax");
+  }
+}
+
+// x % 2^k without idiv: bias a negative x by 2^k - 1 so that clearing the
+// low bits rounds toward zero, and subtract the multiple that leaves
+static void genModPowerOfTwo(const Instruction *instruction) {
+  int64_t divisor = locate(instruction->arg2).value;
+  int shift = 0;
+  while (((int64_t)1 << shift) != divisor) {
+    shift++;
+  }
+
+  loadInt("%rax", locate(instruction->arg1));
+  emit("  movq %%rax, %%rcx\n");
+  emit("  sarq $63, %%rcx\n");
+  emit("  shrq $%d, %%rcx\n", 64 - shift);
+  emit("  addq %%rax, %%rcx\n");
+  if (fitsImmediate(-divisor)) {
+    emit("  andq $%lld, %%rcx\n", (long long)-divisor);
+  } else {
+    emit("  movabsq $%lld, %%rdx\n", (long long)-divisor);
+    emit("  andq %%rdx, %%rcx\n");
+  }
+  emit("  subq %%rcx, %%rax\n");
+  storeInt(locate(instruction->result), "%rax");
+}
+
+static void genDoubleArithmetic(const Instruction *instruction) {
+  static const char *mnemonics[] = {"addsd", "subsd", "mulsd", "divsd"};
+  Location result = locate(instruction->result);
+  Location left = locate(instruction->arg1);
+  Location right = locate(instruction->arg2);
+
+  if (instruction->opcode == IR_MOD) {
+    loadDouble("%xmm0", left);
+    loadDouble("%xmm1", right);
+    emit("  call " SYMBOL_PREFIX "fmod" CALL_SUFFIX "\n");
+    storeDouble(result, "%xmm0");
+    return;
+  }
+
+  bool isInPlace =
+      result.kind == LOCATION_REGISTER && !sameLocation(result, right);
+  const char *reg = isInPlace ? text(result) : "%xmm0";
+
+  if (!sameLocation(result, left) || !isInPlace) {
+    loadDouble(reg, left);
+  }
+  emit("  %s %s, %s\n", mnemonics[instruction->opcode - IR_ADD],
+       doubleSource(right), reg);
+
+  if (!isInPlace) {
+    storeDouble(result, "%xmm0");
+  }
+}
+
+// Leave the checked element index in rcx, and return the element's address
+static const char *genElement(Location array, Operand index) {
+  static char address[64];
+
+  usesBounds = true;
+  loadInt("%rcx", locate(index));
+  emit("  cmpq $%lld, %%rcx\n", (long long)array.value);
+  emit("  jae " LOCAL_PREFIX "out_of_bounds_%d\n", functionIndex);
+
+  if (array.kind == LOCATION_GLOBAL_ARRAY) {
+    emit("  leaq ez_global_%s(%%rip), %%rdx\n", array.name);
+    snprintf(address, sizeof(address), "(%%rdx,%%rcx,8)");
+  } else {
+    snprintf(address, sizeof(address), "%d(%%rbp,%%rcx,8)", array.offset);
+  }
+
+  return address;
+}
+
+static void genLoad(const Instruction *instruction) {
+  Location result = locate(instruction->result);
+  const char *address =
+      genElement(locate(instruction->arg1), instruction->arg2);
+
+  if (result.isDouble) {
+    if (result.kind == LOCATION_REGISTER) {
+      emit("  movsd %s, %s\n", address, text(result));
+    } else {
+      emit("  movsd %s, %%xmm0\n", address);
+      storeDouble(result, "%xmm0");
+    }
+  } else if (result.kind == LOCATION_REGISTER) {
+    emit("  movq %s, %s\n", address, text(result));
+  } else {
+    emit("  movq %s, %%rax\n", address);
+    storeInt(result, "%rax");
+  }
+}
+
+static void genStore(const Instruction *instruction) {
+  Location value = locate(instruction->arg2);
+  const char *address =
+      genElement(locate(instruction->result), instruction->arg1);
+
+  if (value.isDouble) {
+    emit("  movsd %s, %s\n", doubleRegister(value, "%xmm0"), address);
+  } else if (value.kind == LOCATION_REGISTER ||
+             (value.kind == LOCATION_INT && fitsImmediate(value.value))) {
+    emit("  movq %s, %s\n", text(value), address);
+  } else {
+    loadInt("%rax", value);
+    emit("  movq %%rax, %s\n", address);
+  }
+}
+
+static void genJump(const Instruction *instruction) {
+  static const char *intJumps[] = {"jl", "jle", "jg", "jge", "je", "jne"};
+  Location left = locate(instruction->arg1);
+  Location right = locate(instruction->arg2);
+  unsigned int target = operandIndex(instruction->result);
+  int condition = instruction->opcode - IR_JUMP_LT;
+
+  if (instruction->type != DOUBLE) {
+    const char *reg = text(left);
+    if (left.kind != LOCATION_REGISTER) {
+      loadInt("%rax", left);
+      reg = "%rax";
+    }
+    emit("  cmpq %s, %s\n", intSource(right, "%rcx"), reg);
+    emit("  %s " LOCAL_PREFIX "L%u\n", intJumps[condition], target);
+    return;
+  }
+
+  // ucomisd reports unordered as below and equal: compare the operands so
+  // that "above" answers the question, and no comparison holds for NaN
+  switch (instruction->opcode) {
+  case IR_JUMP_LT:
+  case IR_JUMP_LE:
+    emit("  ucomisd %s, %s\n", doubleSource(left),
+         doubleRegister(right, "%xmm0"));
+    emit("  %s " LOCAL_PREFIX "L%u\n",
+         instruction->opcode == IR_JUMP_LT ? "ja" : "jae", target);
+    return;
+  case IR_JUMP_GT:
+  case IR_JUMP_GE:
+    emit("  ucomisd %s, %s\n", doubleSource(right),
+         doubleRegister(left, "%xmm0"));
+    emit("  %s " LOCAL_PREFIX "L%u\n",
+         instruction->opcode == IR_JUMP_GT ? "ja" : "jae", target);
+    return;
+  case IR_JUMP_EQ:
+    emit("  ucomisd %s, %s\n", doubleSource(right),
+         doubleRegister(left, "%xmm0"));
+    emit("  jp 1f\n");
+    emit("  je " LOCAL_PREFIX "L%u\n", target);
+    emit("1:\n");
+    return;
+  default:
+    emit("  ucomisd %s, %s\n", doubleSource(right),
+         doubleRegister(left, "%xmm0"));
+    emit("  jne " LOCAL_PREFIX "L%u\n", target);
+    emit("  jp " LOCAL_PREFIX "L%u\n", target);
+    return;
+  }
+}
+
+// Arguments beyond the registers go on the stack, the last one pushed
+// first, and the stack stays 16-byte aligned at the call
+static void genCall(const Instruction *instruction, const Operand *arguments,
+                    int argumentCount) {
+  Location *locations =
+      arenaAlloc(backendArena, (argumentCount + 1) * sizeof(Location));
+  bool *isOnStack =
+      arenaAlloc(backendArena, (argumentCount + 1) * sizeof(bool));
+  int intCount = 0, doubleCount = 0, stackCount = 0;
+
+  for (int i = 0; i < argumentCount; i++) {
+    locations[i] = locate(arguments[i]);
+    isOnStack[i] = locations[i].isDouble
+                       ? doubleCount++ >= DOUBLE_ARGUMENT_COUNT
+                       : intCount++ >= INT_ARGUMENT_COUNT;
+    stackCount += isOnStack[i];
+  }
+
+  if (stackCount % 2 == 1) {
+    emit("  subq $8, %%rsp\n");
+  }
+  for (int i = argumentCount - 1; i >= 0; i--) {
+    if (!isOnStack[i]) {
+      continue;
+    }
+
+    if (locations[i].isDouble) {
+      emit("  subq $8, %%rsp\n");
+      emit("  movsd %s, (%%rsp)\n", doubleRegister(locations[i], "%xmm0"));
+    } else {
+      emit("  pushq %s\n", intSource(locations[i], "%rax"));
+    }
+  }
+
+  intCount = doubleCount = 0;
+  for (int i = 0; i < argumentCount; i++) {
+    if (isOnStack[i]) {
+      continue;
+    }
+
+    if (locations[i].isDouble) {
+      loadDouble(doubleArguments[doubleCount++], locations[i]);
+    } else {
+      loadInt(intArguments[intCount++], locations[i]);
+    }
+  }
+
+  emit("  call ez_%s\n",
+       ir->functions[operandIndex(instruction->arg1)].name);
+  if (stackCount > 0) {
+    emit("  addq $%d, %%rsp\n", (stackCount + stackCount % 2) * 8);
+  }
+
+  Location result = locate(instruction->result);
+  if (result.isDouble) {
+    storeDouble(result, "%xmm0");
+  } else {
+    storeInt(result, "%rax");
+  }
+}
+
+static void genPrint(const Instruction *instruction) {
+  Location value = locate(instruction->arg1);
+
+  if (value.isDouble) {
+    loadDouble("%xmm0", value);
+    emit("  leaq " LOCAL_PREFIX "print_double(%%rip), %%rdi\n");
+    emit("  movl $1, %%eax\n");
+  } else {
+    loadInt("%rsi", value);
+    emit("  leaq " LOCAL_PREFIX "print_int(%%rip), %%rdi\n");
+    emit("  xorl %%eax, %%eax\n");
+  }
+  emit("  call " SYMBOL_PREFIX "printf" CALL_SUFFIX "\n");
+}
+
+static void genInstructions() {
+  Operand *arguments = NULL;
+  int argumentCount = 0;
+  int argumentCapacity = 0;
+
+  for (int32_t position = 1; position <= function->instructionCount;
+       position++) {
+    const Instruction *instruction = instructionAt(position);
+    bool isDouble = instruction->type == DOUBLE;
+
+    switch (instruction->opcode) {
+    case IR_COPY:
+      if (isDouble) {
+        moveDouble(locate(instruction->result), locate(instruction->arg1));
+      } else {
+        moveInt(locate(instruction->result), locate(instruction->arg1));
+      }
+      break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+      if (isDouble) {
+        genDoubleArithmetic(instruction);
+      } else {
+        genIntArithmetic(instruction);
+      }
+      break;
+    case IR_DIV:
+    case IR_MOD:
+      if (isDouble) {
+        genDoubleArithmetic(instruction);
+      } else {
+        genIntDivision(instruction);
+      }
+      break;
+    case IR_SHL:
+      genShift(instruction);
+      break;
+    case IR_MOD_POW2:
+      genModPowerOfTwo(instruction);
+      break;
+    case IR_LOAD:
+      genLoad(instruction);
+      break;
+    case IR_STORE:
+      genStore(instruction);
+      break;
+    case IR_LABEL:
+      label(instruction->result);
+      break;
+    case IR_JUMP:
+      emit("  jmp " LOCAL_PREFIX "L%u\n", operandIndex(instruction->result));
+      break;
+    case IR_JUMP_LT:
+    case IR_JUMP_LE:
+    case IR_JUMP_GT:
+    case IR_JUMP_GE:
+    case IR_JUMP_EQ:
+    case IR_JUMP_NE:
+      genJump(instruction);
+      break;
+    case IR_PARAM:
+      if (argumentCount == argumentCapacity) {
+        int capacity = argumentCapacity == 0 ? 8 : argumentCapacity * 2;
+        arguments = arenaGrow(backendArena, arguments,
+                              argumentCapacity * sizeof(Operand),
+                              capacity * sizeof(Operand));
+        argumentCapacity = capacity;
+      }
+      arguments[argumentCount++] = instruction->arg1;
+      break;
+    case IR_CALL:
+      genCall(instruction, arguments, argumentCount);
+      argumentCount = 0;
+      break;
+    case IR_RETURN:
+      if (instruction->arg1 == NO_OPERAND) {
+        emit("  xorl %%eax, %%eax\n");
+      } else if (isDouble) {
+        loadDouble("%xmm0", locate(instruction->arg1));
+      } else {
+        loadInt("%rax", locate(instruction->arg1));
+      }
+      emit("  jmp " LOCAL_PREFIX "return_%d\n", functionIndex);
+      break;
+    case IR_PRINT:
+      genPrint(instruction);
+      break;
+    default:
+      break;
+    }
+  }
+}
+//< Instruction Selection
+
+//> Functions
+static int ownerOf(const IrVariable *variable) {
+  return variable->function == -1 ? ir->entry : variable->function;
+}
+
+// Bucket the variables by owner, keeping their order so parameters come
+// first
+static void groupVariables() {
+  ownedStart =
+      arenaAlloc(backendArena, (ir->functionCount + 2) * sizeof(int32_t));
+  owned = arenaAlloc(backendArena, (ir->variableCount + 1) * sizeof(int32_t));
+
+  for (int f = 0; f <= ir->functionCount + 1; f++) {
+    ownedStart[f] = 0;
+  }
+  for (int v = 0; v < ir->variableCount; v++) {
+    valueOfVariable[v] = -1;
+    ownedStart[ownerOf(&ir->variables[v]) + 2]++;
+  }
+  for (int f = 2; f <= ir->functionCount + 1; f++) {
+    ownedStart[f] += ownedStart[f - 1];
+  }
+  for (int v = 0; v < ir->variableCount; v++) {
+    owned[ownedStart[ownerOf(&ir->variables[v]) + 1]++] = v;
+  }
+}
+
+// Registers, spill slots and frame layout of one function
+static void layoutFunction(int f) {
+  function = &ir->functions[f];
+  functionIndex = f;
+  frameBytes = 0;
+  usesDivision = false;
+  usesBounds = false;
+
+  // Temporaries first, then the scalar variables the function owns
+  valueCount = function->tempCount;
+  for (int k = ownedStart[f]; k < ownedStart[f + 1]; k++) {
+    if (ir->variables[owned[k]].arraySize == 0) {
+      valueOfVariable[owned[k]] = valueCount++;
+    }
+  }
+
+  intervals = arenaAlloc(backendArena, (valueCount + 1) * sizeof(Interval));
+  buildIntervals();
+  allocateRegisters();
+
+  // Local arrays sit below the spill slots; globals live in bss
+  for (int k = ownedStart[f]; k < ownedStart[f + 1]; k++) {
+    IrVariable *variable = &ir->variables[owned[k]];
+    if (variable->function == f && variable->arraySize > 0) {
+      frameBytes += variable->arraySize * 8;
+      arrayOffset[owned[k]] = -frameBytes;
+    }
+  }
+
+  savedCount = 0;
+  for (int i = 0; i < valueCount; i++) {
+    if (!intervals[i].isDouble && intervals[i].reg >= savedCount &&
+        intervals[i].reg < CALLEE_SAVED_COUNT) {
+      savedCount = intervals[i].reg + 1;
+    }
+  }
+
+  // Slots sit below the saved registers, and rsp stays 16-byte aligned
+  for (int i = 0; i < valueCount; i++) {
+    if (intervals[i].reg < 0) {
+      intervals[i].slot -= savedCount * 8;
+    }
+  }
+  for (int k = ownedStart[f]; k < ownedStart[f + 1]; k++) {
+    if (ir->variables[owned[k]].function == f &&
+        ir->variables[owned[k]].arraySize > 0) {
+      arrayOffset[owned[k]] -= savedCount * 8;
+    }
+  }
+  if ((savedCount * 8 + frameBytes) % 16 != 0) {
+    frameBytes += 8;
+  }
+}
+
+// Parameters arrive in argument registers or above the return address,
+// every other variable starts at zero
+static void genPrologue(int f) {
+  if (function->name) {
+    emit("\nez_%s:\n", function->name);
+  } else {
+    emit("\n.globl " SYMBOL_PREFIX "main\n" SYMBOL_PREFIX "main:\n");
+  }
+
+  emit("  pushq %%rbp\n");
+  emit("  movq %%rsp, %%rbp\n");
+  for (int i = 0; i < savedCount; i++) {
+    emit("  pushq %s\n", intRegisters[i]);
+  }
+  if (frameBytes > 0) {
+    emit("  subq $%d, %%rsp\n", frameBytes);
+  }
+
+  int intCount = 0, doubleCount = 0, stackCount = 0;
+  for (int k = ownedStart[f]; k < ownedStart[f + 1]; k++) {
+    int32_t v = owned[k];
+    if (valueOfVariable[v] < 0) {
+      continue;
+    }
+
+    Location home = locate(makeOperand(OPERAND_VARIABLE, (uint32_t)v));
+    bool isParam = v >= function->firstParam &&
+                   v < function->firstParam + function->paramCount;
+
+    if (!isParam) {
+      if (home.kind == LOCATION_REGISTER && home.isDouble) {
+        emit("  xorpd %s, %s\n", text(home), text(home));
+      } else if (home.kind == LOCATION_REGISTER) {
+        emit("  xorq %s, %s\n", text(home), text(home));
+      } else {
+        emit("  movq $0, %s\n", text(home));
+      }
+      continue;
+    }
+
+    Location incoming = {.kind = LOCATION_STACK, .isDouble = home.isDouble};
+    if (home.isDouble && doubleCount < DOUBLE_ARGUMENT_COUNT) {
+      storeDouble(home, doubleArguments[doubleCount++]);
+      continue;
+    }
+    if (!home.isDouble && intCount < INT_ARGUMENT_COUNT) {
+      storeInt(home, intArguments[intCount++]);
+      continue;
+    }
+
+    incoming.offset = 16 + 8 * stackCount++;
+    if (home.isDouble) {
+      moveDouble(home, incoming);
+    } else {
+      moveInt(home, incoming);
+    }
+  }
+
+  for (int k = ownedStart[f]; k < ownedStart[f + 1]; k++) {
+    int32_t v = owned[k];
+    if (ir->variables[v].function == f && ir->variables[v].arraySize > 0) {
+      emit("  leaq %d(%%rbp), %%rdi\n", arrayOffset[v]);
+      emit("  movq $%d, %%rcx\n", ir->variables[v].arraySize);
+      emit("  xorl %%eax, %%eax\n");
+      emit("  rep stosq\n");
+    }
+  }
+}
+
+// Runtime errors flush the program's output, report and exit with 1
+static void genFailure(const char *name, const char *message) {
+  emit(LOCAL_PREFIX "%s_%d:\n", name, functionIndex);
+  emit("  leaq " LOCAL_PREFIX "%s_message_%d(%%rip), %%rdi\n", name,
+       functionIndex);
+  emit("  jmp " LOCAL_PREFIX "fail\n");
+
+  // The message goes with the code that uses it
+  emit("  " RODATA_SECTION "\n");
+  if (function->name) {
+    emit(LOCAL_PREFIX "%s_message_%d:\n  .asciz \"Runtime Error: %s in "
+                      "function %s\\n\"\n",
+         name, functionIndex, message, function->name);
+  } else {
+    emit(LOCAL_PREFIX "%s_message_%d:\n  .asciz \"Runtime Error: %s in the "
+                      "program\\n\"\n",
+         name, functionIndex, message);
+  }
+  emit("  .text\n");
+}
+
+static void genEpilogue() {
+  emit(LOCAL_PREFIX "return_%d:\n", functionIndex);
+  if (savedCount > 0) {
+    emit("  leaq %d(%%rbp), %%rsp\n", -savedCount * 8);
+  } else if (frameBytes > 0) {
+    emit("  movq %%rbp, %%rsp\n");
+  }
+  for (int i = savedCount - 1; i >= 0; i--) {
+    emit("  popq %s\n", intRegisters[i]);
+  }
+  emit("  popq %%rbp\n");
+  emit("  ret\n");
+
+  if (usesDivision) {
+    genFailure("divide_by_zero", "Division by zero");
+  }
+  if (usesBounds) {
+    genFailure("out_of_bounds", "Array index out of bounds");
+  }
+}
+
+// Shared tail of every runtime error: the message is in rdi
+static void genRuntime() {
+  emit("\n" LOCAL_PREFIX "fail:\n");
+  emit("  movq %%rdi, %%rbx\n");
+  emit("  andq $-16, %%rsp\n");
+  emit("  xorl %%edi, %%edi\n");
+  emit("  call " SYMBOL_PREFIX "fflush" CALL_SUFFIX "\n");
+  emit("  movq %%rbx, %%rdi\n");
+  emit("  movq " STDERR_SYMBOL "@GOTPCREL(%%rip), %%rsi\n");
+  emit("  movq (%%rsi), %%rsi\n");
+  emit("  call " SYMBOL_PREFIX "fputs" CALL_SUFFIX "\n");
+  emit("  movl $1, %%edi\n");
+  emit("  call " SYMBOL_PREFIX "exit" CALL_SUFFIX "\n");
+}
+
+static void genData() {
+  emit("\n" RODATA_SECTION "\n");
+  emit(LOCAL_PREFIX "print_int:\n  .asciz \"%%lld\\n\"\n");
+  emit(LOCAL_PREFIX "print_double:\n  .asciz \"%%g\\n\"\n");
+
+  emit("  .p2align 3\n");
+  for (int i = 0; i < ir->constantCount; i++) {
+    if (ir->constants[i].type == DOUBLE) {
+      union {
+        double value;
+        uint64_t bits;
+      } constant = {.value = ir->constants[i].doubleValue};
+      emit(LOCAL_PREFIX "D%d:\n  .quad 0x%llx\n", i,
+           (unsigned long long)constant.bits);
+    }
+  }
+
+  // Global arrays start zeroed, like the interpreter's
+  for (int v = 0; v < ir->variableCount; v++) {
+    IrVariable *variable = &ir->variables[v];
+    if (variable->function == -1 && variable->arraySize > 0) {
+#ifdef __APPLE__
+      emit(".zerofill __DATA,__bss,ez_global_%s,%d,3\n",
+           variable->name, variable->arraySize * 8);
+#else
+      emit("  .local ez_global_%s\n", variable->name);
+      emit("  .comm ez_global_%s,%d,8\n", variable->name,
+           variable->arraySize * 8);
+#endif
+    }
+  }
+
+#ifndef __APPLE__
+  emit("\n  .section .note.GNU-stack,\"\",@progbits\n");
+#endif
+}
+
+void emitAssembly(const char *fileName) {
+  removeOutputFile(fileName);
+  openOutput(&output, fileName);
+
+  valueOfVariable =
+      arenaAlloc(backendArena, (ir->variableCount + 1) * sizeof(int32_t));
+  arrayOffset =
+      arenaAlloc(backendArena, (ir->variableCount + 1) * sizeof(int32_t));
+  labelPosition =
+      arenaAlloc(backendArena, (ir->labelCount + 1) * sizeof(int32_t));
+  groupVariables();
+
+  emit("# Generated by ezsharp\n  .text\n");
+
+  for (int f = 0; f < ir->functionCount; f++) {
+    layoutFunction(f);
+    genPrologue(f);
+    genInstructions();
+    genEpilogue();
+
+    for (int k = ownedStart[f]; k < ownedStart[f + 1]; k++) {
+      valueOfVariable[owned[k]] = -1;
+    }
+  }
+
+  genRuntime();
+  genData();
+
+  closeOutput(&output);
+  releaseArena(backendArena);
+}
+//< Functions
@@ -0,0 +1,17 @@
+// Native backend: x86-64 assembly from the IR, for the system assembler
+
+#ifndef X86_64_H
+#define X86_64_H
+
+/**
+ * Write the IR program as x86-64 assembly in AT&T syntax. Temporaries and
+ * scalar variables get registers by linear scan, doubles use SSE2, and
+ * functions follow the System V calling convention. The top-level
+ * statements become main, so the file links into an executable with
+ * `cc file.s -lm`.
+ *
+ * @param fileName The assembly file to write.
+ */
+void emitAssembly(const char *fileName);
+
+#endif
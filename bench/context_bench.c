@@ -0,0 +1,143 @@
+// To compile: gcc -O2 bench/context_bench.c lexer/*.c parser/*.c
+// semantic/*.c codegen/*.c common/*.c driver/*.c -lm -pthread -o
+// context_bench
+// To run: ./context_bench [compiles]
+
+//> Benchmark: many small programs compiled with compile_buffer, as a build
+// service would, first with a process forked per compile, then in one
+// process on 1 to 8 threads with a compiler context each, reused from one
+// compile to the next
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../common/thread_pool.h"
+#include "../driver/compiler.h"
+#include "generated_program.h"
+
+#define RUNS 3
+#define MAX_THREADS 8
+#define FUNCTIONS 8
+
+typedef struct {
+  const char *source;
+  int length;
+  CompilerContext *contexts; // By thread
+  int *instructions;         // Generated by every compile
+} Batch;
+
+// Quiet: a service wants the code, not the trace of every phase
+static void initQuietContext(CompilerContext *context) {
+  initContext(context);
+  context->errors.isQuiet = true;
+}
+
+// One process per compile, which a compiler with global state needs
+static double forkPerCompile(const char *source, int length, int compiles) {
+  double start = now();
+
+  for (int c = 0; c < compiles; c++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("Failed to fork");
+      exit(1);
+    }
+
+    if (pid == 0) {
+      CompilerContext context;
+      initQuietContext(&context);
+      _exit(compile_buffer(&context, source, length) ? 0 : 1);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Benchmark program does not compile\n");
+      exit(1);
+    }
+  }
+
+  return now() - start;
+}
+
+static void compileOne(void *context, int task, int thread) {
+  Batch *batch = context;
+  CompilerContext *compiler = &batch->contexts[thread];
+
+  bool isCompiled = compile_buffer(compiler, batch->source, batch->length);
+  batch->instructions[task] = isCompiled ? compiler->ir.instructionCount : -1;
+}
+
+// Every compile in this process, a context per thread
+static double inProcess(Batch *batch, int compiles, int threads) {
+  for (int t = 0; t < threads; t++) {
+    initQuietContext(&batch->contexts[t]);
+  }
+
+  double start = now();
+  runTasks(threads, compiles, compileOne, batch);
+  double elapsed = now() - start;
+
+  for (int t = 0; t < threads; t++) {
+    resetContext(&batch->contexts[t]);
+  }
+
+  // Contexts share nothing, so every compile gives the same code
+  for (int c = 1; c < compiles; c++) {
+    if (batch->instructions[c] != batch->instructions[0] ||
+        batch->instructions[c] < 0) {
+      fprintf(stderr, "Compile %d differs from the first\n", c);
+      exit(1);
+    }
+  }
+
+  return elapsed;
+}
+
+int main(int argc, const char *argv[]) {
+  int compiles = argc > 1 ? atoi(argv[1]) : 2000;
+  compiles = compiles > 0 ? compiles : 1;
+
+  Batch batch;
+  batch.source = generate(FUNCTIONS, &batch.length);
+  batch.contexts = malloc(MAX_THREADS * sizeof(CompilerContext));
+  batch.instructions = malloc(compiles * sizeof(int));
+  if (!batch.contexts || !batch.instructions) {
+    perror("Failed to allocate benchmark");
+    return 1;
+  }
+
+  printf("%d compiles of %d bytes, best of %d runs\n", compiles,
+         batch.length, RUNS);
+  fflush(stdout);
+
+  double best = 1e9;
+  for (int r = 0; r < RUNS; r++) {
+    double elapsed = forkPerCompile(batch.source, batch.length, compiles);
+    best = elapsed < best ? elapsed : best;
+  }
+  double forked = best;
+  printf("%-20s %8.1f ms %9.0f compiles/s\n", "fork per compile",
+         forked * 1e3, compiles / forked);
+  fflush(stdout);
+
+  for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+    best = 1e9;
+    for (int r = 0; r < RUNS; r++) {
+      double elapsed = inProcess(&batch, compiles, threads);
+      best = elapsed < best ? elapsed : best;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%d threads", threads);
+    printf("%-20s %8.1f ms %9.0f compiles/s %5.2fx fork\n", name, best * 1e3,
+           compiles / best, forked / best);
+  }
+
+  free(batch.instructions);
+  free(batch.contexts);
+  free((char *)batch.source);
+  return 0;
+}
@@ -0,0 +1,63 @@
+// The program the compiler benchmarks compile, generated to any number of
+// functions, and the clock they time it with. Included by the benchmarks
+// alone, which build without a library of their own.
+
+#ifndef GENERATED_PROGRAM_H
+#define GENERATED_PROGRAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Each function loops, branches and calls the one before it
+static const char *functionFormat =
+    "def int f%d(int a, int b)\n"
+    "  int x, y, z;\n"
+    "  x = a; y = 0; z = b * 2;\n"
+    "  while (y < b) do\n"
+    "    x = x + (a * 3 + y) %% 7; y = y + 1;\n"
+    "    if (x > z) then x = x - z else z = z + 1 fi\n"
+    "  od;\n"
+    "  if (x > 100) then x = x - %s fi;\n"
+    "  return (x + y * z)\n"
+    "fed;\n";
+
+/**
+ * Generate the functions, then a program printing what the last returns.
+ *
+ * @param functions Number of functions, 1 or more.
+ * @param length Set to the length of the program.
+ * @return The program, to be freed.
+ */
+static char *generate(int functions, int *length) {
+  size_t capacity = (size_t)functions * 512 + 256;
+  char *source = malloc(capacity);
+  if (!source) {
+    perror("Failed to allocate benchmark program");
+    exit(1);
+  }
+
+  size_t used = 0;
+  for (int f = 0; f < functions; f++) {
+    char call[32];
+    if (f == 0) {
+      snprintf(call, sizeof(call), "1");
+    } else {
+      snprintf(call, sizeof(call), "f%d(a, 2)", f - 1);
+    }
+    used += snprintf(source + used, capacity - used, functionFormat, f, call);
+  }
+  used += snprintf(source + used, capacity - used,
+                   "int s;\ns = f%d(5, 9);\nprint(s).", functions - 1);
+
+  *length = (int)used;
+  return source;
+}
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+#endif
\ No newline at end of file
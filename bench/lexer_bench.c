@@ -0,0 +1,160 @@
+// To compile: gcc -O2 bench/lexer_bench.c lexer/transition_table.c -o
+// lexer_bench
+// To run (from the repository root): ./lexer_bench [megabytes]
+
+//> Benchmark: DFA throughput of the full 29x128 transition table against the
+// compact byte-class table the lexer uses
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../lexer/transition_table.h"
+
+#define RUNS 5
+
+// A loop-heavy snippet, repeated until the input reaches the requested size
+static const char *sample = "def int gcd(int a, int b)\n"
+                            "  if (a==b) then return (a) fi;\n"
+                            "  if (a>b) then return(gcd(a-b,b))\n"
+                            "  else return(gcd(a,b-a)) fi;\n"
+                            "fed;\n"
+                            "int x,i; double y;\n"
+                            "x=0;i=1;y=12.5E3;\n"
+                            "while(i<10000) do\n"
+                            "\tx = x+i*i; i=i+1; y = y*2.0\n"
+                            "od;\n";
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static char *makeInput(size_t targetLength, size_t *length) {
+  size_t sampleLength = 0;
+  while (sample[sampleLength] != '\0') {
+    sampleLength++;
+  }
+
+  size_t copies = targetLength / sampleLength + 1;
+  char *input = malloc(copies * sampleLength);
+  if (!input) {
+    perror("Failed to allocate benchmark input");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < copies * sampleLength; i++) {
+    input[i] = sample[i % sampleLength];
+  }
+
+  *length = copies * sampleLength;
+  return input;
+}
+
+// Both loops mirror lexicalAnalysis: a return to the start state ends a
+// token and the character is scanned again, an error skips the character.
+static long lexFullTable(TransitionState table[TT_ROWS][TT_COLS],
+                         const char *input, size_t length) {
+  TransitionState state = STATE_START;
+  long tokenCount = 0;
+  size_t i = 0;
+
+  while (i < length) {
+    TransitionState next = table[state][input[i] & 0x7F];
+
+    if (next == STATE_START) {
+      tokenCount++;
+      state = STATE_START;
+      continue;
+    }
+
+    state = next == STATE_ERROR ? STATE_START : next;
+    i++;
+  }
+
+  return tokenCount;
+}
+
+static long lexCompactTable(const CompactDfa *dfa, const char *input,
+                            size_t length) {
+  TransitionState state = STATE_START;
+  long tokenCount = 0;
+  size_t i = 0;
+
+  while (i < length) {
+    TransitionState next = dfaNext(dfa, state, input[i]);
+
+    if (next == STATE_START) {
+      tokenCount++;
+      state = STATE_START;
+      continue;
+    }
+
+    state = next == STATE_ERROR ? STATE_START : next;
+    i++;
+  }
+
+  return tokenCount;
+}
+
+static void report(const char *name, size_t tableSize, long tokenCount,
+                   double seconds, size_t length) {
+  printf("%-14s %6zu bytes  %10ld tokens  %8.1f Mtokens/s  %8.1f MB/s\n",
+         name, tableSize, tokenCount, tokenCount / seconds / 1e6,
+         length / seconds / 1e6);
+}
+
+int main(int argc, const char *argv[]) {
+  size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 64;
+
+  int fd = open("lexer_transition.txt", O_RDONLY);
+  if (fd == -1) {
+    perror("Failed to open lexer_transition.txt");
+    return 1;
+  }
+
+  static TransitionState table[TT_ROWS][TT_COLS];
+  static CompactDfa dfa;
+  int isRead = initTransitionTable(table, &fd) == 0;
+  close(fd);
+
+  if (!isRead || compressTransitionTable(table, &dfa) != 0) {
+    return 1;
+  }
+
+  size_t length;
+  char *input = makeInput(megabytes * 1024 * 1024, &length);
+
+  double bestFull = 1e9, bestCompact = 1e9;
+  long fullTokens = 0, compactTokens = 0;
+
+  // Alternate the layouts so both see the same cache and frequency state
+  for (int run = 0; run < RUNS; run++) {
+    double start = now();
+    fullTokens = lexFullTable(table, input, length);
+    double elapsed = now() - start;
+    bestFull = elapsed < bestFull ? elapsed : bestFull;
+
+    start = now();
+    compactTokens = lexCompactTable(&dfa, input, length);
+    elapsed = now() - start;
+    bestCompact = elapsed < bestCompact ? elapsed : bestCompact;
+  }
+
+  if (fullTokens != compactTokens) {
+    fprintf(stderr, "Token counts differ: %ld vs %ld\n", fullTokens,
+            compactTokens);
+    return 1;
+  }
+
+  printf("Input: %zu bytes, %d byte classes, best of %d runs\n", length,
+         dfa.classCount, RUNS);
+  report("full table", sizeof(table), fullTokens, bestFull, length);
+  report("compact table", sizeof(dfa), compactTokens, bestCompact, length);
+
+  free(input);
+  return 0;
+}
@@ -0,0 +1,222 @@
+// To compile: gcc -O2 bench/loop_bench.c lexer/*.c parser/*.c semantic/*.c
+// codegen/*.c vm/*.c opt/*.c common/*.c driver/*.c -lm -pthread -o
+// loop_bench
+// To run: ./loop_bench [iterations]
+
+//> Benchmark: loop- and call-heavy EZ-Sharp programs run on the bytecode
+// interpreter without optimization, with the local passes only, with every
+// pass and with unrolling on top, reported in executed instructions. Every
+// configuration has to print what the unoptimized program prints.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../driver/compiler.h"
+#include "../opt/opt.h"
+#include "../vm/vm.h"
+
+#define UNROLL_FACTOR 4
+// Room for what a program prints
+#define MAX_PRINTED 256
+
+typedef enum {
+  CONFIG_NONE,
+  CONFIG_LOCAL,
+  CONFIG_ALL,
+  CONFIG_UNROLL,
+  CONFIG_COUNT,
+} Config;
+
+static const char *configNames[CONFIG_COUNT] = {"none", "local", "-O",
+                                                "-O --unroll 4"};
+
+// Every program loops %d times; tests/Test1.cp is the first one, scaled up
+static const char *programs[][2] = {
+    {"Test1 squares", "int x,i;\n"
+                      "x=0;i=1;\n"
+                      "while(i<%d) do\n"
+                      "\tx = x+i*i; i=i+1\n"
+                      "od;\n"
+                      "print(x)."},
+    {"invariant", "int i, s, x, y;\n"
+                  "i=0; s=0; x=3; y=7;\n"
+                  "while(i<%d) do\n"
+                  "\ts = s + (x * y + x / y) * 2; i = i + 1\n"
+                  "od;\n"
+                  "print(s)."},
+    {"strided array", "int a[64], i, s;\n"
+                      "i=0; s=0;\n"
+                      "while(i<%d) do\n"
+                      "\ta[(2 * i + 1) %% 64] = i; s = s + a[(i * 4) %% 64];\n"
+                      "\ti = i + 1\n"
+                      "od;\n"
+                      "print(s)."},
+    {"nested matrix", "int m[64], i, j, k, s;\n"
+                      "k=0; s=0;\n"
+                      "while(k<%d / 64) do\n"
+                      "\ti = 0;\n"
+                      "\twhile(i<8) do\n"
+                      "\t\tj = 0;\n"
+                      "\t\twhile(j<8) do\n"
+                      "\t\t\tm[i * 8 + j] = m[i * 8 + j] + k; j = j + 1\n"
+                      "\t\tod;\n"
+                      "\t\ti = i + 1\n"
+                      "\tod;\n"
+                      "\ts = s + m[k %% 64]; k = k + 1\n"
+                      "od;\n"
+                      "print(s)."},
+    {"small calls", "def int mulmod(int a, int b)\n"
+                    "  return ((a * b) %% 1000003)\n"
+                    "fed;\n"
+                    "def int dot3(int x, int y, int z)\n"
+                    "  return (x * 3 + y * 5 + z * 7)\n"
+                    "fed;\n"
+                    "int i, s;\n"
+                    "i=0; s=1;\n"
+                    "while(i<%d) do\n"
+                    "\ts = mulmod(s, 31) + dot3(i, i + 1, s %% 9); i = i + 1\n"
+                    "od;\n"
+                    "print(s)."},
+    {"loops in two", "def int f(int q)\n"
+                     "  int u, s;\n"
+                     "  u=0; s=0;\n"
+                     "  while(u<q) do s = s + u * 3; u = u + 1 od;\n"
+                     "  return (s)\n"
+                     "fed;\n"
+                     "int a[20], i, s;\n"
+                     "i=0; s=0;\n"
+                     "while(i<%d) do\n"
+                     "\ta[i %% 20] = i * 7 %% 13; s = s + a[(i * 3) %% 20];\n"
+                     "\ti = i + 1\n"
+                     "od;\n"
+                     "print(f(10)); print(s)."},
+};
+
+// What a program did in one configuration
+typedef struct {
+  long long executed;
+  char printed[MAX_PRINTED];
+} Outcome;
+
+// Compile a program through every phase, as ezsharp does, into a context
+// that stays bound for the rest of the process
+static void compile(const char *source, int length) {
+  if (!compile_buffer(createContext(), source, length)) {
+    fprintf(stderr, "Benchmark program does not compile\n");
+    exit(1);
+  }
+}
+
+// Runs in its own process, since the optimizer and interpreter keep global
+// state. The program prints to a file that goes back with the count.
+static void measure(int report, const char *format, int iterations,
+                    Config config) {
+  char source[1024];
+  int length = snprintf(source, sizeof(source), format, iterations);
+  bool enabled[PASS_COUNT];
+
+  compile(source, length);
+
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    bool isLocal = pass >= PASS_FOLD && pass < PASS_LICM;
+    enabled[pass] = config == CONFIG_ALL || config == CONFIG_UNROLL ||
+                    (config == CONFIG_LOCAL && isLocal);
+  }
+  setUnrollFactor(config == CONFIG_UNROLL ? UNROLL_FACTOR : 1);
+  if (config != CONFIG_NONE) {
+    optimizeIr(enabled);
+  }
+
+  VmProgram program;
+  lowerIr(&program);
+
+  Outcome outcome = {0};
+  FILE *printed = tmpfile();
+  if (!printed || dup2(fileno(printed), STDOUT_FILENO) == -1) {
+    perror("Failed to redirect stdout");
+    exit(1);
+  }
+
+  if (runVm(&program, &outcome.executed) != 0 || fflush(stdout) != 0) {
+    exit(1);
+  }
+  rewind(printed);
+  size_t count = fread(outcome.printed, 1, MAX_PRINTED - 1, printed);
+  outcome.printed[count] = '\0';
+
+  if (write(report, &outcome, sizeof(outcome)) != sizeof(outcome)) {
+    exit(1);
+  }
+}
+
+// Instructions a program executes in one configuration, and what it prints
+static Outcome run(const char *format, int iterations, Config config) {
+  int fds[2];
+  if (pipe(fds) == -1) {
+    perror("Failed to create pipe");
+    exit(1);
+  }
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("Failed to fork");
+    exit(1);
+  }
+
+  if (pid == 0) {
+    close(fds[0]);
+    measure(fds[1], format, iterations, config);
+    _exit(0);
+  }
+
+  Outcome outcome = {.executed = -1};
+  close(fds[1]);
+  if (read(fds[0], &outcome, sizeof(outcome)) != sizeof(outcome)) {
+    outcome.executed = -1;
+  }
+  close(fds[0]);
+
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+      outcome.executed == -1) {
+    fprintf(stderr, "Benchmark program failed\n");
+    exit(1);
+  }
+  return outcome;
+}
+
+int main(int argc, const char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  printf("%d iterations\n", iterations);
+  fflush(stdout);
+
+  for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+    Outcome baseline = {0};
+
+    for (int config = 0; config < CONFIG_COUNT; config++) {
+      Outcome outcome = run(programs[i][1], iterations, config);
+      if (config == CONFIG_NONE) {
+        baseline = outcome;
+      }
+      printf("%-14s %-14s %12lld executed %6.1f%% fewer\n",
+             config == CONFIG_NONE ? programs[i][0] : "",
+             configNames[config], outcome.executed,
+             100.0 * (baseline.executed - outcome.executed) /
+                 baseline.executed);
+      fflush(stdout);
+
+      if (strcmp(outcome.printed, baseline.printed) != 0) {
+        fprintf(stderr, "%s prints differently with %s\n", programs[i][0],
+                configNames[config]);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,127 @@
+// To compile: gcc -O2 bench/parallel_bench.c lexer/*.c parser/*.c
+// semantic/*.c codegen/*.c common/*.c driver/*.c -lm -pthread -o
+// parallel_bench
+// To run: ./parallel_bench [functions]
+
+//> Benchmark: a generated program with hundreds of functions parsed,
+// checked and lowered sequentially, then with the function bodies compiled
+// on 1 to 8 threads. The 1 thread run tells the cost of the pre-scan and
+// merge apart from the speedup of the threads themselves.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../codegen/parallel.h"
+#include "../driver/compiler.h"
+#include "generated_program.h"
+
+#define RUNS 5
+#define MAX_THREADS 8
+
+// Runs in its own process, so every compile starts from a fresh heap;
+// threads is 0 for the sequential compile
+static void measure(int report, const char *source, int length,
+                    int threads) {
+  CompilerContext *context = createContext();
+  TokenStream *tokens = lexicalAnalysisOfBuffer(context, source, length);
+
+  double start = now();
+  if (threads == 0) {
+    initTokenCursor(tokens);
+    AstIndex program = Parse(context);
+    if (!context->errors.hasError) {
+      CodeGen(context, program);
+    }
+  } else if (!compileInParallel(context, tokens, threads)) {
+    context->errors.hasError = true;
+  }
+  double elapsed = now() - start;
+
+  if (context->errors.hasError) {
+    fprintf(stderr, "Benchmark program does not compile\n");
+    exit(1);
+  }
+
+  double results[2] = {elapsed, context->ir.instructionCount};
+  if (write(report, results, sizeof(results)) != sizeof(results)) {
+    exit(1);
+  }
+  destroyContext(context);
+}
+
+// Best time of RUNS compiles, and the instructions generated
+static double run(const char *source, int length, int threads,
+                  int *instructions) {
+  double best = 1e9;
+
+  for (int r = 0; r < RUNS; r++) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+      perror("Failed to create pipe");
+      exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("Failed to fork");
+      exit(1);
+    }
+
+    if (pid == 0) {
+      close(fds[0]);
+      measure(fds[1], source, length, threads);
+      _exit(0);
+    }
+
+    double results[2] = {-1, 0};
+    close(fds[1]);
+    if (read(fds[0], results, sizeof(results)) != sizeof(results)) {
+      results[0] = -1;
+    }
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || results[0] < 0) {
+      fprintf(stderr, "Benchmark compile failed\n");
+      exit(1);
+    }
+
+    best = results[0] < best ? results[0] : best;
+    *instructions = (int)results[1];
+  }
+
+  return best;
+}
+
+int main(int argc, const char *argv[]) {
+  int functions = argc > 1 ? atoi(argv[1]) : 400;
+  int length;
+  char *source = generate(functions > 0 ? functions : 1, &length);
+
+  printf("%d functions, %d bytes, best of %d runs\n", functions, length,
+         RUNS);
+  fflush(stdout);
+
+  int instructions;
+  double sequential = run(source, length, 0, &instructions);
+  printf("%-10s %8.2f ms %8d instructions\n", "sequential", sequential * 1e3,
+         instructions);
+  fflush(stdout);
+
+  double single = 0;
+  for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+    double elapsed = run(source, length, threads, &instructions);
+    single = threads == 1 ? elapsed : single;
+    printf("%2d threads %8.2f ms %8d instructions %5.2fx sequential "
+           "%5.2fx 1 thread\n",
+           threads, elapsed * 1e3, instructions, sequential / elapsed,
+           single / elapsed);
+    fflush(stdout);
+  }
+
+  free(source);
+  return 0;
+}
@@ -0,0 +1,134 @@
+// To compile: gcc -O2 bench/span_bench.c lexer/*.c parser/*.c
+// semantic/*.c codegen/*.c common/*.c driver/*.c -lm -pthread -o
+// span_bench
+// To run: ./span_bench [megabytes]
+
+//> Benchmark: lexical analysis of large generated sources with every byte
+// taken through the DFA, then with spans of whitespace, identifiers and
+// numbers skipped a byte, 16 bytes and 32 bytes at a time
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../driver/compiler.h"
+#include "../lexer/span.h"
+
+#define RUNS 5
+
+// Short tokens packed tight, then long names and numbers deeply indented
+static const char *dense = "def int gcd(int a, int b)\n"
+                           "  if (a==b) then return (a) fi;\n"
+                           "  if (a>b) then return(gcd(a-b,b))\n"
+                           "  else return(gcd(a,b-a)) fi;\n"
+                           "fed;\n"
+                           "int x,i; double y;\n"
+                           "x=0;i=1;y=12.5E3;\n"
+                           "while(i<10000) do\n"
+                           "\tx = x+i*i; i=i+1; y = y*2.0\n"
+                           "od;\n";
+
+static const char *wide =
+    "def int accumulate_running_total(int current_total_value, int step)\n"
+    "        int intermediate_result_of_step;\n"
+    "        intermediate_result_of_step = current_total_value * 1000003;\n"
+    "        while (intermediate_result_of_step > 123456789012) do\n"
+    "                intermediate_result_of_step =\n"
+    "                    intermediate_result_of_step - 987654321098\n"
+    "        od;\n"
+    "        return (intermediate_result_of_step + step)\n"
+    "fed;\n\n";
+
+static const char *sampleNames[] = {"dense", "wide"};
+
+static char *makeInput(const char *sample, size_t targetLength,
+                       size_t *length) {
+  size_t sampleLength = 0;
+  while (sample[sampleLength] != '\0') {
+    sampleLength++;
+  }
+
+  size_t copies = targetLength / sampleLength + 1;
+  char *input = malloc(copies * sampleLength);
+  if (!input) {
+    perror("Failed to allocate benchmark input");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < copies * sampleLength; i++) {
+    input[i] = sample[i % sampleLength];
+  }
+
+  *length = copies * sampleLength;
+  return input;
+}
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Best time of RUNS lexical analyses, and what the tokens add up to
+static double measure(CompilerContext *context, const char *input,
+                      size_t length, long *checksum) {
+  double best = 1e9;
+
+  for (int r = 0; r < RUNS; r++) {
+    resetContext(context);
+
+    double start = now();
+    TokenStream *tokens = lexicalAnalysisOfBuffer(context, input, length);
+    double elapsed = now() - start;
+    best = elapsed < best ? elapsed : best;
+
+    *checksum = tokens->count;
+    for (int t = 0; t < tokens->count; t++) {
+      *checksum = *checksum * 31 + tokens->types[t] + tokens->offsets[t];
+    }
+    freeLexerInput();
+  }
+
+  return best;
+}
+
+int main(int argc, const char *argv[]) {
+  size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 32;
+  const char *samples[] = {dense, wide};
+
+  static const char *levelNames[] = {"off", "scalar", "sse2", "avx2"};
+  CompilerContext *context = createContext();
+
+  for (int s = 0; s < 2; s++) {
+    size_t length;
+    char *input = makeInput(samples[s], megabytes * 1024 * 1024, &length);
+    printf("%s: %zu bytes, best of %d runs\n", sampleNames[s], length, RUNS);
+
+    double off = 0;
+    long expected = 0;
+    for (SpanLevel level = SPAN_OFF; level <= SPAN_AVX2; level++) {
+      if (setSpanLevel(level) != level) {
+        printf("  %-7s not supported\n", levelNames[level]);
+        continue;
+      }
+
+      long checksum;
+      double elapsed = measure(context, input, length, &checksum);
+      if (level == SPAN_OFF) {
+        off = elapsed;
+        expected = checksum;
+      } else if (checksum != expected) {
+        fprintf(stderr, "Tokens differ with %s spans\n", levelNames[level]);
+        return 1;
+      }
+
+      printf("  %-7s %8.1f MB/s %6.2fx off\n", levelNames[level],
+             length / elapsed / 1e6, off / elapsed);
+    }
+
+    free(input);
+  }
+
+  destroyContext(context);
+  return 0;
+}
@@ -0,0 +1,256 @@
+// To compile: gcc -O2 bench/symbol_table_bench.c semantic/semantic.c
+// common/arena.c common/intern.c common/error_state.c common/file_utils.c
+// common/string.c common/trace.c common/diagnostics.c common/line_index.c
+// -o symbol_table_bench
+// To run: ./symbol_table_bench [globals] [depth]
+
+//> Benchmark: hashed scopes of the semantic analyser against the linear scan
+// they replaced, with many globals and with deeply nested scopes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../common/arena.h"
+#include "../common/diagnostics.h"
+#include "../common/error_state.h"
+#include "../common/intern.h"
+#include "../common/trace.h"
+#include "../semantic/semantic.h"
+
+#define RUNS 3
+#define LOCALS_PER_SCOPE 8
+#define LOOKUP_ROUNDS 1
+
+static FILE *out;
+
+// The semantic analyser alone needs only these parts of a compiler context
+static PhaseArenas arenas;
+static ErrorState errors;
+static TraceState traceState;
+static DiagnosticLog diagnosticLog;
+static InternTable internTable;
+static SemanticState semanticState;
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Interned names "v0", "v1", ... as the parser would hand them over
+static const char **makeNames(int count) {
+  const char **names = malloc(count * sizeof(char *));
+  if (!names) {
+    perror("Failed to allocate benchmark names");
+    exit(1);
+  }
+
+  for (int i = 0; i < count; i++) {
+    char name[32];
+    int length = snprintf(name, sizeof(name), "v%d", i);
+    names[i] = internString(name, length);
+  }
+
+  return names;
+}
+
+// Shuffled order, so lookups do not follow insertion order
+static int *makeOrder(int count) {
+  int *order = malloc(count * sizeof(int));
+  if (!order) {
+    perror("Failed to allocate benchmark order");
+    exit(1);
+  }
+
+  for (int i = 0; i < count; i++) {
+    order[i] = i;
+  }
+
+  srand(42);
+  for (int i = count - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    int swap = order[i];
+    order[i] = order[j];
+    order[j] = swap;
+  }
+
+  return order;
+}
+
+//> Linear reference
+// The previous layout: every scope is an array scanned front to back
+typedef struct {
+  const char **names;
+  int count;
+} LinearScope;
+
+static LinearScope *linearScopes;
+static int linearScopeCount;
+
+static const char *linearLookup(const char *lexeme) {
+  for (int i = linearScopeCount - 1; i >= 0; i--) {
+    LinearScope *scope = &linearScopes[i];
+
+    for (int j = 0; j < scope->count; j++) {
+      if (scope->names[j] == lexeme) {
+        return scope->names[j];
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void linearBuild(const char **names, int globals, int depth) {
+  linearScopes = malloc((depth + 1) * sizeof(LinearScope));
+  if (!linearScopes) {
+    perror("Failed to allocate benchmark scopes");
+    exit(1);
+  }
+
+  linearScopes[0].names = names;
+  linearScopes[0].count = globals;
+  for (int i = 1; i <= depth; i++) {
+    linearScopes[i].names = names + globals + (i - 1) * LOCALS_PER_SCOPE;
+    linearScopes[i].count = LOCALS_PER_SCOPE;
+  }
+  linearScopeCount = depth + 1;
+}
+//< Linear reference
+
+static void insertNames(const char **names, int count) {
+  for (int i = 0; i < count; i++) {
+    SymbolTableEntry entry;
+    entry.offset = (uint32_t)i;
+    entry.lexeme = names[i];
+    entry.returnType = INT;
+    entry.symbolType = VARIABLE;
+    entry.parameterCount = 0;
+
+    insertSymbol(entry);
+  }
+}
+
+static void hashedBuild(const char **names, int globals, int depth) {
+  pushScope("global");
+  insertNames(names, globals);
+
+  for (int i = 1; i <= depth; i++) {
+    pushScope("block");
+    insertNames(names + globals + (i - 1) * LOCALS_PER_SCOPE,
+                LOCALS_PER_SCOPE);
+  }
+}
+
+static void report(const char *name, long lookups, double hashed,
+                   double linear) {
+  fprintf(out,
+          "%-22s %9ld lookups  hashed %8.1f ns  linear %10.1f ns  %7.1fx\n",
+          name, lookups, hashed / lookups * 1e9, linear / lookups * 1e9,
+          linear / hashed);
+}
+
+// Time every name in order against both layouts, best of RUNS
+static void measure(const char *name, const char **names, const int *order,
+                    int count) {
+  double bestHashed = 1e9, bestLinear = 1e9;
+  long found = 0, linearFound = 0;
+
+  for (int run = 0; run < RUNS; run++) {
+    found = 0;
+    double start = now();
+    for (int round = 0; round < LOOKUP_ROUNDS; round++) {
+      for (int i = 0; i < count; i++) {
+        found += lookupSymbol(names[order[i]]) != NULL;
+      }
+    }
+    double elapsed = now() - start;
+    bestHashed = elapsed < bestHashed ? elapsed : bestHashed;
+
+    linearFound = 0;
+    start = now();
+    for (int round = 0; round < LOOKUP_ROUNDS; round++) {
+      for (int i = 0; i < count; i++) {
+        linearFound += linearLookup(names[order[i]]) != NULL;
+      }
+    }
+    elapsed = now() - start;
+    bestLinear = elapsed < bestLinear ? elapsed : bestLinear;
+  }
+
+  if (found != linearFound || found != (long)count * LOOKUP_ROUNDS) {
+    fprintf(stderr, "%s: lookups disagree: %ld vs %ld\n", name, found,
+            linearFound);
+    exit(1);
+  }
+
+  report(name, (long)count * LOOKUP_ROUNDS, bestHashed, bestLinear);
+}
+
+int main(int argc, const char *argv[]) {
+  int globals = argc > 1 ? atoi(argv[1]) : 20000;
+  int depth = argc > 2 ? atoi(argv[2]) : 1000;
+  int locals = depth * LOCALS_PER_SCOPE;
+
+  out = stdout;
+
+  initPhaseArenas(&arenas);
+  usePhaseArenas(&arenas);
+  errorState = &errors;
+  diagnostics = &diagnosticLog;
+  initTrace(&traceState);
+  tracing = &traceState;
+  interned = &internTable;
+  initSemanticState(&semanticState);
+  semantic = &semanticState;
+
+  const char **names = makeNames(globals + locals);
+
+  double start = now();
+  hashedBuild(names, globals, depth);
+  double buildTime = now() - start;
+  linearBuild(names, globals, depth);
+
+  fprintf(out, "%d globals, %d nested scopes of %d names, best of %d runs\n",
+          globals, depth, LOCALS_PER_SCOPE, RUNS);
+  fprintf(out, "insert %d names: %.1f ns each\n", globals + locals,
+          buildTime / (globals + locals) * 1e9);
+
+  // Globals seen from the innermost scope walk the whole chain
+  int *globalOrder = makeOrder(globals);
+  measure("globals, innermost", names, globalOrder, globals);
+
+  // Locals of the innermost scope are found in the first table
+  int *innerOrder = makeOrder(LOCALS_PER_SCOPE);
+  for (int i = 0; i < LOCALS_PER_SCOPE; i++) {
+    innerOrder[i] += globals + locals - LOCALS_PER_SCOPE;
+  }
+  measure("innermost locals", names, innerOrder, LOCALS_PER_SCOPE);
+
+  // Locals spread over every depth
+  int *localOrder = makeOrder(locals);
+  for (int i = 0; i < locals; i++) {
+    localOrder[i] += globals;
+  }
+  measure("locals at any depth", names, localOrder, locals);
+
+  // Leave only the global scope, as while analysing top-level statements
+  while (semantic->scopeCount > 1) {
+    popScope();
+  }
+  linearScopeCount = 1;
+  measure("globals, global scope", names, globalOrder, globals);
+
+  freeSymbolTables();
+  freeInternTable();
+  free(names);
+  free(globalOrder);
+  free(innerOrder);
+  free(localOrder);
+  free(linearScopes);
+  fclose(out);
+
+  return 0;
+}
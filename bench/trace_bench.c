@@ -0,0 +1,74 @@
+// To compile: gcc -O2 bench/trace_bench.c lexer/*.c parser/*.c
+// semantic/*.c codegen/*.c common/*.c driver/*.c -lm -pthread -o
+// trace_bench
+// To run: ./trace_bench [functions]
+// Built with -DTRACE_MAX_LEVEL=0 as well, the untraced compile shows what
+// the checks left in cost
+
+//> Benchmark: a generated program compiled in-process with tracing off,
+// then with every category traced down to phases, grammar rules and
+// tokens, the trace written to /dev/null
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../driver/compiler.h"
+#include "generated_program.h"
+
+#define RUNS 5
+
+// Best time of RUNS compiles at a trace level, 0 for none
+static double measure(CompilerContext *context, const char *source,
+                      int length, int level) {
+  double best = 1e9;
+
+  for (int r = 0; r < RUNS; r++) {
+    context->trace.categories = level > 0 ? TRACE_ALL : 0;
+    context->trace.level = level;
+
+    double start = now();
+    if (!compile_buffer(context, source, length)) {
+      fprintf(stderr, "Benchmark program does not compile\n");
+      exit(1);
+    }
+    fflush(stdout);
+    double elapsed = now() - start;
+
+    best = elapsed < best ? elapsed : best;
+  }
+
+  return best;
+}
+
+int main(int argc, const char *argv[]) {
+  int functions = argc > 1 ? atoi(argv[1]) : 400;
+  int length;
+  char *source = generate(functions > 0 ? functions : 1, &length);
+
+  // The trace goes to stdout, keep the report apart
+  FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+  if (!out || !freopen("/dev/null", "w", stdout)) {
+    perror("Failed to redirect stdout");
+    return 1;
+  }
+
+  CompilerContext *context = createContext();
+  fprintf(out, "%d functions, %d bytes, best of %d runs\n", functions,
+          length, RUNS);
+
+  static const char *names[] = {"off", "phases", "rules", "tokens"};
+  double untraced = measure(context, source, length, 0);
+  fprintf(out, "%-7s %8.2f ms\n", names[0], untraced * 1e3);
+
+  for (int level = TRACE_PHASE; level <= TRACE_MAX_LEVEL; level++) {
+    double elapsed = measure(context, source, length, level);
+    fprintf(out, "%-7s %8.2f ms %6.2fx off\n", names[level], elapsed * 1e3,
+            elapsed / untraced);
+  }
+
+  destroyContext(context);
+  fclose(out);
+  free(source);
+  return 0;
+}
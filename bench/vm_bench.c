@@ -0,0 +1,131 @@
+// To compile: gcc -O2 bench/vm_bench.c lexer/*.c parser/*.c semantic/*.c
+// codegen/*.c vm/*.c common/*.c driver/*.c -lm -pthread -o vm_bench
+// To run: ./vm_bench [iterations]
+
+//> Benchmark: loop-heavy EZ-Sharp programs compiled in-process and run on
+// the bytecode interpreter, reported in executed instructions per second
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../driver/compiler.h"
+#include "../vm/vm.h"
+
+#define RUNS 5
+
+// Every program loops %d times; tests/Test1.cp is the first one, scaled up
+static const char *programs[][2] = {
+    {"Test1 squares", "int x,i;\n"
+                      "x=0;i=1;\n"
+                      "while(i<%d) do\n"
+                      "\tx = x+i*i; i=i+1\n"
+                      "od;\n"
+                      "print(x)."},
+    {"double series", "int i; double s, t;\n"
+                      "i=0; s=0.0; t=1.0;\n"
+                      "while(i<%d) do\n"
+                      "\ts = s + t / (t + 1.0); t = t + 0.5; i = i + 1\n"
+                      "od;\n"
+                      "print(s)."},
+    {"array sweep", "int a[64], i, j, s;\n"
+                    "i=0; s=0;\n"
+                    "while(i<%d) do\n"
+                    "\tj = i %% 64; a[j] = a[j] + i; s = s + a[j]; i = i + 1\n"
+                    "od;\n"
+                    "print(s)."},
+    {"gcd calls", "def int gcd(int a, int b)\n"
+                  "  if (a==b) then return (a) fi;\n"
+                  "  if (a>b) then return(gcd(a-b,b))\n"
+                  "  else return(gcd(a,b-a)) fi;\n"
+                  "fed;\n"
+                  "int i, s;\n"
+                  "i=1; s=0;\n"
+                  "while(i<%d / 20) do\n"
+                  "\ts = s + gcd(i %% 60 + 1, 24); i = i + 1\n"
+                  "od;\n"
+                  "print(s)."},
+};
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Compile a program through every phase, as ezsharp does, into a context
+// that stays bound for the rest of the process
+static void compile(const char *source, int length) {
+  if (!compile_buffer(createContext(), source, length)) {
+    fprintf(stderr, "Benchmark program does not compile\n");
+    exit(1);
+  }
+}
+
+// Runs in its own process, since the optimizer and interpreter keep global
+// state
+static void measure(FILE *out, const char *name, const char *format,
+                    int iterations) {
+  char source[1024];
+  int length = snprintf(source, sizeof(source), format, iterations);
+
+  compile(source, length);
+
+  VmProgram program;
+  lowerIr(&program);
+
+  double best = 1e9;
+  long long executed = 0;
+  for (int run = 0; run < RUNS; run++) {
+    double start = now();
+    if (runVm(&program, &executed) != 0) {
+      exit(1);
+    }
+    double elapsed = now() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+
+  fprintf(out,
+          "%-14s %4d bytecodes %11lld executed %8.1f ms %8.1f Minstr/s\n",
+          name, program.codeCount, executed, best * 1e3,
+          executed / best / 1e6);
+}
+
+int main(int argc, const char *argv[]) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 10000000;
+
+  // The programs print on stdout, keep the report apart
+  FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+  if (!out || !freopen("/dev/null", "w", stdout)) {
+    perror("Failed to redirect stdout");
+    return 1;
+  }
+
+  fprintf(out, "%d iterations, best of %d runs\n", iterations, RUNS);
+  fflush(out);
+
+  for (size_t i = 0; i < sizeof(programs) / sizeof(programs[0]); i++) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      perror("Failed to fork");
+      return 1;
+    }
+
+    if (pid == 0) {
+      measure(out, programs[i][0], programs[i][1], iterations);
+      fclose(out);
+      _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      return 1;
+    }
+  }
+
+  fclose(out);
+  return 0;
+}
@@ -1,592 +1,538 @@
 #include "codegen.h"
-#include "../common/token_utils.h"
+#include "../common/arena.h"
+#include "../common/diagnostics.h"
+#include "../common/line_index.h"
+#include "../common/trace.h"
+#include "../semantic/semantic.h"
+#include <stdlib.h>
 
-Instruction instructions[MAX_INSTRUCTIONS];
-int instructionCount;
-
-// Create a new temp variable function
-// Create a new label function
+#define INITIAL_NAME_SLOTS 64
 
 // Aim: generate 3TAC version of source code that is already correct
 
-// Note: symbol table has been created, now might need to refer for quick
-// reference when creating temporary variable.
+// Note: the symbol table has been popped by now, so names are resolved
+// again here: locals of the current function first, then globals.
 
-// Note: Go through the tokens again
+// Note: Walk the syntax tree built by the parser instead of the tokens
 // Should generate 3TAC for any code that is error free
 // Output Intermediate Code File
 
-// Token methods
-//> Parse Functions
-void preGen(const char *message) {
-  printf("Currently generate: %s\n", message);
-}
-
-void CodeGen(Token *tokens) {
-  // Reset look_ahead to the beginning of tokens again
-  look_ahead = tokens;
-
-  puts("Generating code now");
+// A jump target that is not taken: control falls through instead
+#define FALL_THROUGH NO_OPERAND
 
-  prog();
+//> Name Maps
+_Thread_local CodegenState *codegen = NULL;
 
-  if (look_ahead->type == TOKEN_DOLLAR) {
-    puts("=====================");
-    puts("Parsing Reach To End!");
-    puts("=====================");
-  } else {
-    puts("=========================");
-    puts("Parsing Not Reach To End!");
-    puts("=========================");
-  }
+static unsigned int hashName(const char *name) {
+  uintptr_t key = (uintptr_t)name;
+  return (unsigned int)((key >> 4) ^ (key >> 20)) * 2654435761u;
 }
 
-void prog() {
-  // PROG → A FNS DECLS STMTS B .
-  // A(); // Starting point of IR
-  preGen("prog");
-
-  fns();
+static NameSlot *findNameSlot(NameMap *map, const char *name) {
+  unsigned int mask = map->slotCount - 1;
+  unsigned int index = hashName(name) & mask;
 
-  decls();
+  while (map->slots[index].name && map->slots[index].name != name) {
+    index = (index + 1) & mask;
+  }
 
-  stmts();
-  // B(); // Final point of IR
-  matchType(TOKEN_DOT);
+  return &map->slots[index];
 }
 
-void fns() {
-  // FNS → FN ; FNSC
-  // FNS → ε
-
-  preGen("fns");
-
-  if (isKeyword("def", 3)) {
-    fn();
+static void clearNameMap(NameMap *map) {
+  map->slots = NULL;
+  map->slotCount = 0;
+  map->count = 0;
+}
 
-    matchType(TOKEN_SEMICOLON);
+static void bindName(NameMap *map, const char *name, int32_t index) {
+  // Keep the load factor under one half
+  if ((map->count + 1) * 2 > map->slotCount) {
+    NameSlot *oldSlots = map->slots;
+    int oldCount = map->slotCount;
 
-    fnsc();
+    map->slotCount = oldCount == 0 ? INITIAL_NAME_SLOTS : oldCount * 2;
+    map->slots = arenaAlloc(irArena, map->slotCount * sizeof(NameSlot));
+    for (int i = 0; i < map->slotCount; i++) {
+      map->slots[i].name = NULL;
+    }
 
-    return;
+    for (int i = 0; i < oldCount; i++) {
+      if (oldSlots[i].name) {
+        *findNameSlot(map, oldSlots[i].name) = oldSlots[i];
+      }
+    }
   }
 
-  return;
+  NameSlot *slot = findNameSlot(map, name);
+  if (!slot->name) {
+    slot->name = name;
+    map->count++;
+  }
+  slot->index = index;
 }
 
-void fnsc() {
-  // FNSC → FN; FNSC
-  // FNSC → ε
-  preGen("fnsc");
+static int32_t findName(NameMap *map, const char *name) {
+  if (map->slotCount == 0) {
+    return -1;
+  }
 
-  fns();
+  NameSlot *slot = findNameSlot(map, name);
+  return slot->name ? slot->index : -1;
 }
 
-void fn() {
-  // FN → def TYPE FNAME ( PARAMS ) C A C DECLS STMTS fed B
-  // Todo: create label for function
-  preGen("fn");
-
-  matchKeyword("def");
-
-  type();
-
-  fname();
-
-  matchType(TOKEN_LEFT_PAREN);
-
-  params();
-
-  matchType(TOKEN_RIGHT_PAREN);
-
-  decls();
-
-  stmts();
+static Operand resolveVariable(const char *name) {
+  int32_t index = findName(&codegen->locals, name);
+  if (index == -1) {
+    index = findName(&codegen->globals, name);
+  }
 
-  matchKeyword("fed");
+  return makeOperand(OPERAND_VARIABLE, (uint32_t)index);
 }
+//< Name Maps
 
-void params() {
-  // PARAMS → TYPE VAR PARAMSC
-  // PARAMS → ε
-  preGen("params");
+static Operand genExpr(AstIndex index);
+static void genStmts(AstIndex index);
 
-  if (isKeyword("int", 3) || isKeyword("double", 6)) {
-    type();
-
-    var();
+//> Tree Walk Functions
+void preGen(const char *message) {
+  trace(TRACE_CODEGEN, TRACE_RULE, "Currently generate: %s\n", message);
+}
 
-    paramsc();
+static void codeGenError(const char *message, const char *name, int line) {
+  reportError(PHASE_CODEGEN, DIAG_ARRAY_SIZE, line, 0,
+              "Code Generation Error: %s '%s' at line %d", message, name, line);
+}
 
-    return;
+static Operand genNumber(AstNode *node) {
+  if (node->dataType == INT) {
+    return intConstant(strtoll(node->name, NULL, 10));
   }
 
-  return;
+  return doubleConstant(strtod(node->name, NULL));
 }
 
-void paramsc() {
-  // PARAMSC → , TYPE VAR PARAMSC
-  // PARAMSC → ε
-  preGen("paramsc");
-
-  if (look_ahead->type == TOKEN_COMMA) {
-    matchType(TOKEN_COMMA);
-
-    type();
-
-    var();
-
-    paramsc();
+static Operand genCall(AstNode *node) {
+  preGen("factorc");
+  preGen("exprs");
 
-    return;
+  // Evaluate every argument before passing any, so nested calls do not
+  // interleave their params with ours
+  int argumentCount = 0;
+  for (AstIndex argument = node->a; argument != AST_NONE;
+       argument = astNode(argument)->next) {
+    argumentCount++;
   }
 
-  return;
-}
+  Operand *arguments =
+      arenaAlloc(irArena, (argumentCount + 1) * sizeof(Operand));
+  argumentCount = 0;
+  for (AstIndex argument = node->a; argument != AST_NONE;
+       argument = astNode(argument)->next) {
+    arguments[argumentCount++] = genExpr(argument);
+  }
 
-void fname() {
-  // FNAME → ID
-  preGen("fname");
+  for (int i = 0; i < argumentCount; i++) {
+    emitInstruction(IR_PARAM, operandType(arguments[i]), NO_OPERAND,
+                    arguments[i], NO_OPERAND);
+  }
 
-  if (look_ahead->type == TOKEN_ID) {
-    matchType(TOKEN_ID);
+  int32_t function = findName(&codegen->functions, node->name);
+  Operand result = newTemp(node->dataType);
+  emitInstruction(IR_CALL, node->dataType, result,
+                  makeOperand(OPERAND_FUNCTION, (uint32_t)function),
+                  NO_OPERAND);
+
+  return result;
+}
+
+static IrOpcode arithmeticFor(TokenType op) {
+  switch (op) {
+  case TOKEN_ADD:
+    return IR_ADD;
+  case TOKEN_SUB:
+    return IR_SUB;
+  case TOKEN_MUL:
+    return IR_MUL;
+  case TOKEN_DIV:
+    return IR_DIV;
+  default:
+    return IR_MOD;
   }
 }
 
-void decls() {
-  // DECLS → DECL; DECLSC
-  // DECLS → ε
-  preGen("decls");
-
-  if (isKeyword("int", 3) || isKeyword("double", 6)) {
-    decl();
+static Operand genExpr(AstIndex index) {
+  AstNode *node = astNode(index);
 
-    matchType(TOKEN_SEMICOLON);
+  switch (node->kind) {
+  case AST_BINARY: {
+    preGen("expr");
 
-    declsc();
+    Operand left = genExpr(node->a);
+    Operand right = genExpr(node->b);
+    Operand result = newTemp(node->dataType);
 
-    return;
+    emitInstruction(arithmeticFor((TokenType)node->op), node->dataType,
+                    result, left, right);
+    return result;
   }
+  case AST_NUMBER:
+    preGen("factor");
+    return genNumber(node);
+  case AST_VARIABLE: {
+    preGen("factor");
 
-  return;
-}
-
-void declsc() {
-  // DECLS → DECL; DECLSC
-  // DECLS → ε
-  preGen("declsc");
+    Operand variable = resolveVariable(node->name);
+    if (node->a == AST_NONE) {
+      return variable;
+    }
 
-  decls();
-}
+    preGen("varc");
 
-void decl() {
-  // DECL → TYPE VARS
-  preGen("decl");
+    Operand element = genExpr(node->a);
+    Operand result = newTemp(node->dataType);
+    emitInstruction(IR_LOAD, node->dataType, result, variable, element);
 
-  type();
-  vars();
-}
-
-void type() {
-  // TYPE → int
-  // TYPE → double
-  // if lookAhead is int, match keyword int
-  // if lookAhead is double, match keyword double
-  preGen("type");
-
-  if (isKeyword("int", 3)) {
-    matchKeyword("int");
-    return;
+    return result;
   }
-
-  if (isKeyword("double", 3)) {
-    matchKeyword("double");
-    return;
+  case AST_CALL:
+    return genCall(node);
+  default:
+    return NO_OPERAND;
   }
 }
 
-void vars() {
-  // VARS → VAR C VARSC
-  preGen("vars");
-
-  var();
-  varsc();
+static IrOpcode jumpFor(TokenType op) {
+  switch (op) {
+  case TOKEN_LT:
+    return IR_JUMP_LT;
+  case TOKEN_LE:
+    return IR_JUMP_LE;
+  case TOKEN_GT:
+    return IR_JUMP_GT;
+  case TOKEN_GE:
+    return IR_JUMP_GE;
+  case TOKEN_EQ:
+    return IR_JUMP_EQ;
+  default:
+    return IR_JUMP_NE;
+  }
 }
 
-void varsc() {
-  // VARSC → , VARS
-  // VARSC → ε
-  preGen("varsc");
-
-  if (look_ahead->type == TOKEN_COMMA) {
-    matchType(TOKEN_COMMA);
-
-    vars();
-
-    return;
+static IrOpcode invertJump(IrOpcode opcode) {
+  switch (opcode) {
+  case IR_JUMP_LT:
+    return IR_JUMP_GE;
+  case IR_JUMP_LE:
+    return IR_JUMP_GT;
+  case IR_JUMP_GT:
+    return IR_JUMP_LE;
+  case IR_JUMP_GE:
+    return IR_JUMP_LT;
+  case IR_JUMP_EQ:
+    return IR_JUMP_NE;
+  default:
+    return IR_JUMP_EQ;
   }
-
-  return;
 }
 
-void stmts() {
-  // STMTS → STMT STMTSC
-  preGen("stmts");
-
-  stmt();
-
-  stmtsc();
+static void placeLabel(Operand label) {
+  emitInstruction(IR_LABEL, INT, label, NO_OPERAND, NO_OPERAND);
 }
 
-void stmtsc() {
-  // STMTSC → ; STMTS
-  // STMTSC → ε
-  preGen("stmtsc");
-
-  if (look_ahead->type == TOKEN_SEMICOLON) {
-    matchType(TOKEN_SEMICOLON);
-
-    stmts();
-
-    return;
-  }
-
-  return;
+static void jumpTo(Operand label) {
+  emitInstruction(IR_JUMP, INT, label, NO_OPERAND, NO_OPERAND);
 }
 
-void stmt() {
-  // STMT → VAR D = EXPR
-  // STMT → if BEXPR then STMTS STMTC
-  // STMT → while BEXPR do STMTS od
-  // STMT → print EXPR
-  // STMT -> return EXPR
-  // STMT →  ε
-
-  preGen("stmt");
-
-  if (look_ahead->type == TOKEN_ID) {
-    var();
-
-    matchType(TOKEN_ASSIGN_OP);
-
-    expr();
+// Jump to onTrue or onFalse depending on the condition. At most one of them
+// may be FALL_THROUGH, in which case control continues after the code.
+static void genCondition(AstIndex index, Operand onTrue, Operand onFalse) {
+  AstNode *node = astNode(index);
 
-  } else if (isKeyword("if", 2)) {
-    matchKeyword("if");
+  switch (node->kind) {
+  case AST_OR: {
+    preGen("bexpr");
 
-    bexpr();
+    // Short circuit: a true left operand decides
+    Operand isTrue = onTrue == FALL_THROUGH ? newLabel() : onTrue;
 
-    matchKeyword("then");
+    genCondition(node->a, isTrue, FALL_THROUGH);
+    genCondition(node->b, onTrue, onFalse);
 
-    stmts();
-
-    stmtc();
-
-  } else if (isKeyword("while", 5)) {
-    matchKeyword("while");
-
-    bexpr();
-
-    matchKeyword("do");
-
-    stmts();
-
-    matchKeyword("od");
-
-  } else if (isKeyword("print", 5)) {
-    matchKeyword("print");
-
-    expr();
+    if (onTrue == FALL_THROUGH) {
+      placeLabel(isTrue);
+    }
+    return;
+  }
+  case AST_AND: {
+    preGen("bterm");
 
-  } else if (isKeyword("return", 6)) {
-    matchKeyword("return");
+    // Short circuit: a false left operand decides
+    Operand isFalse = onFalse == FALL_THROUGH ? newLabel() : onFalse;
 
-    expr();
+    genCondition(node->a, FALL_THROUGH, isFalse);
+    genCondition(node->b, onTrue, onFalse);
 
-  } else {
+    if (onFalse == FALL_THROUGH) {
+      placeLabel(isFalse);
+    }
     return;
   }
-}
-void stmtc() {
-  // STMTC → fi
-  // STMTC → else STMTS fi
-
-   preGen("stmtc");
-
-  if (isKeyword("fi", 2)) {
-    matchKeyword("fi");
+  case AST_NOT:
+    preGen("bfactor");
+    genCondition(node->a, onFalse, onTrue);
+    return;
+  case AST_COMPARE: {
+    preGen("bfactor");
+
+    IrOpcode jump = jumpFor((TokenType)node->op);
+    Operand left = genExpr(node->a);
+    preGen("comp");
+    Operand right = genExpr(node->b);
+
+    // The inverse of a double comparison is not its negation once NaN
+    // is involved, so only integer comparisons are inverted
+    if (onTrue == FALL_THROUGH && node->dataType != DOUBLE) {
+      emitInstruction(invertJump(jump), node->dataType, onFalse, left, right);
+      return;
+    }
+
+    if (onTrue == FALL_THROUGH) {
+      Operand isTrue = newLabel();
+
+      emitInstruction(jump, node->dataType, isTrue, left, right);
+      jumpTo(onFalse);
+      placeLabel(isTrue);
+      return;
+    }
+
+    emitInstruction(jump, node->dataType, onTrue, left, right);
+    if (onFalse != FALL_THROUGH) {
+      jumpTo(onFalse);
+    }
     return;
   }
-
-  if (isKeyword("else", 4)) {
-    matchKeyword("else");
-
-    stmts();
-
-    matchKeyword("fi");
-
+  default:
     return;
   }
 }
 
-void expr() {
-  // EXPR → TERM EXPRC
-  preGen("expr");
-
-  term();
-  exprc();
-}
-
-void exprc() {
-  // EXPRC → + TERM EXPRC
-  // EXPRC → - TERM EXPRC
-  // EXPRC → ε
+static void genAssign(AstNode *node) {
+  AstNode *target = astNode(node->a);
+  Operand variable = resolveVariable(target->name);
 
-  preGen("exprc");
-
-  if (look_ahead->type == TOKEN_ADD || look_ahead->type == TOKEN_SUB) {
-    matchType(look_ahead->type);
-
-    term();
-
-    exprc();
+  if (target->a != AST_NONE) {
+    Operand element = genExpr(target->a);
+    Operand value = genExpr(node->b);
 
+    emitInstruction(IR_STORE, operandType(value), variable, element, value);
     return;
   }
 
-  return;
-}
-void term() {
-  // TERM → FACTOR TERMC
-  preGen("term");
-
-  factor();
-
-  termc();
-}
-
-void termc() {
-  // TERMC → * FACTOR TERMC
-  // TERMC → / FACTOR TERMC
-  // TERMC → % FACTOR TERMC
-  // TERMC → ε
-
-  preGen("termc");
-
-  if (look_ahead->type == TOKEN_MUL || look_ahead->type == TOKEN_DIV ||
-      look_ahead->type == TOKEN_MOD) {
-    matchType(look_ahead->type);
-
-    factor();
-
-    termc();
+  Operand value = genExpr(node->b);
 
+  // Write straight into the variable when the value was just computed into
+  // a fresh temporary, instead of copying it
+  if (operandKind(value) == OPERAND_TEMP && ir->instructionCount > 0 &&
+      ir->instructions[ir->instructionCount - 1].result == value) {
+    ir->instructions[ir->instructionCount - 1].result = variable;
     return;
   }
 
-  return;
+  emitInstruction(IR_COPY, operandType(variable), variable, value,
+                  NO_OPERAND);
 }
 
-void factor() {
-  // FACTOR → ID D FACTORC
-  // FACTOR → NUMBER
-  // FACTOR → (EXPR)
-
-  preGen("factor");
-
-  if (look_ahead->type == TOKEN_ID) {
-    matchType(TOKEN_ID);
+static void genStmt(AstIndex index) {
+  AstNode *node = astNode(index);
 
-    factorc();
+  preGen("stmt");
 
+  switch (node->kind) {
+  case AST_ASSIGN:
+    genAssign(node);
+    return;
+  case AST_IF: {
+    Operand otherwise = newLabel();
+
+    genCondition(node->a, FALL_THROUGH, otherwise);
+    genStmts(node->b);
+    preGen("stmtc");
+
+    if (node->c == AST_NONE) {
+      placeLabel(otherwise);
+      return;
+    }
+
+    Operand end = newLabel();
+    jumpTo(end);
+    placeLabel(otherwise);
+    genStmts(node->c);
+    placeLabel(end);
     return;
   }
-
-  if (isNumber(look_ahead->type)) {
-    matchType(look_ahead->type);
-
+  case AST_WHILE: {
+    Operand top = newLabel();
+    Operand end = newLabel();
+
+    placeLabel(top);
+    genCondition(node->a, FALL_THROUGH, end);
+    genStmts(node->b);
+    jumpTo(top);
+    placeLabel(end);
     return;
   }
+  case AST_PRINT:
+  case AST_RETURN: {
+    IrOpcode opcode = node->kind == AST_PRINT ? IR_PRINT : IR_RETURN;
+    Operand value = genExpr(node->a);
 
-  if (look_ahead->type == TOKEN_LEFT_PAREN) {
-    matchType(TOKEN_LEFT_PAREN);
-
-    expr();
-
-    matchType(TOKEN_RIGHT_PAREN);
-
+    emitInstruction(opcode, operandType(value), NO_OPERAND, value,
+                    NO_OPERAND);
     return;
   }
-}
-
-void factorc() {
-  // FACTORC → VARC
-  // FACTORC → ( EXPRS )
-
-  preGen("factorc");
-
-  if (look_ahead->type == TOKEN_LEFT_PAREN) {
-    matchType(TOKEN_LEFT_PAREN);
-
-    exprs();
-
-    matchType(TOKEN_RIGHT_PAREN);
-
+  default:
     return;
   }
-
-  varc();
 }
 
-void exprs() {
-  // EXPRS → EXPR EXPRSC
-  // EXPRS → ε
-
-  preGen("exprs");
-
-  if (look_ahead->type == TOKEN_ID || look_ahead->type == TOKEN_INT ||
-      look_ahead->type == TOKEN_DOUBLE ||
-      look_ahead->type == TOKEN_LEFT_PAREN) {
-    expr();
-
-    exprsc();
+static void genStmts(AstIndex index) {
+  preGen("stmts");
 
-    return;
+  for (; index != AST_NONE; index = astNode(index)->next) {
+    genStmt(index);
   }
-
-  return;
 }
 
-void exprsc() {
-  // EXPRSC → , EXPRS
-  // EXPRSC → ε
-
-  preGen("exprsc");
+static void genDecls(AstIndex index, NameMap *scope) {
+  preGen("decls");
 
-  if (look_ahead->type == TOKEN_COMMA) {
-    matchType(TOKEN_COMMA);
+  for (; index != AST_NONE; index = astNode(index)->next) {
+    AstNode *node = astNode(index);
+    int arraySize = 0;
 
-    exprs();
+    preGen("decl");
 
-    return;
-  }
-
-  return;
-}
+    // Array storage is laid out before the program runs
+    if (node->a != AST_NONE) {
+      AstNode *size = astNode(node->a);
 
-void var() {
-  // VAR → ID VARC
-  preGen("var");
+      if (size->kind == AST_NUMBER && size->dataType == INT) {
+        arraySize = (int)strtol(size->name, NULL, 10);
+      }
 
-  matchType(TOKEN_ID);
+      if (arraySize <= 0) {
+        codeGenError("Array size must be a positive integer constant for",
+                     node->name, lineOf(node->offset));
+        arraySize = 1;
+      }
+    }
 
-  varc();
+    Operand variable = newVariable(node->name, node->dataType, arraySize,
+                                   codegen->currentFunction);
+    bindName(scope, node->name, (int32_t)operandIndex(variable));
+  }
 }
 
-void varc() {
-  // VARC → [ EXPR ]
-  // VARC → ε
-
-  preGen("varc");
-
-  if (look_ahead->type == TOKEN_LEFT_SQUARE_PAREN) {
-    matchType(TOKEN_LEFT_SQUARE_PAREN);
+// Calls refer to the function by its index in the whole program, which
+// differs from the one in ir on the workers of a parallel compile
+static void genFunction(AstIndex index, int32_t programIndex) {
+  AstNode *node = astNode(index);
 
-    expr();
+  preGen("fn");
 
-    matchType(TOKEN_LEFT_SQUARE_PAREN);
+  codegen->currentFunction = beginFunction(node->name, node->dataType);
+  bindName(&codegen->functions, node->name, programIndex);
+  clearNameMap(&codegen->locals);
 
-    return;
+  preGen("params");
+  for (AstIndex param = node->a; param != AST_NONE;
+       param = astNode(param)->next) {
+    AstNode *paramNode = astNode(param);
+    preGen("var");
+
+    Operand variable = newVariable(paramNode->name, paramNode->dataType, 0,
+                                   codegen->currentFunction);
+    bindName(&codegen->locals, paramNode->name,
+             (int32_t)operandIndex(variable));
+    ir->functions[codegen->currentFunction].paramCount++;
   }
 
-  return;
-}
-
-void bexpr() {
-  // BEXPR → BTERM BEXPRC
-  preGen("bexpr");
+  genDecls(node->b, &codegen->locals);
+  genStmts(node->c);
 
-  bterm();
-  bexprc();
+  // Falling off the end returns zero
+  Operand zero = node->dataType == INT ? intConstant(0) : doubleConstant(0);
+  emitInstruction(IR_RETURN, node->dataType, NO_OPERAND, zero, NO_OPERAND);
 }
 
-void bexprc() {
-  // BEXPRC → or BTERM BEXPRC
-  // BEXPRC → ε
-  preGen("bexprc");
-
-  if (isKeyword("or", 2)) {
-    matchKeyword("or");
-
-    bterm();
+// Globals come after the functions, which cannot refer to them, then the
+// top-level statements form the entry function of the program
+static void genProgram(AstNode *node) {
+  codegen->currentFunction = -1;
+  clearNameMap(&codegen->locals);
+  genDecls(node->b, &codegen->globals);
 
-    bexprc();
+  codegen->currentFunction = beginFunction(NULL, INT);
+  ir->entry = codegen->currentFunction;
+  genStmts(node->c);
+  emitInstruction(IR_RETURN, INT, NO_OPERAND, NO_OPERAND, NO_OPERAND);
 
-    return;
-  }
-
-  return;
+  printIr("intermediate_code.txt");
 }
 
-void bterm() {
-  // BTERM → BFACTOR BTERMC
-  preGen("bterm");
+void CodeGen(CompilerContext *context, AstIndex program) {
+  useContext(context);
 
-  bfactor();
-  btermc();
-}
-
-void btermc() {
-  // BTERMC → and BFACTOR BTERMC
-  // BTERMC → ε
-  preGen("btermc");
+  trace(TRACE_CODEGEN, TRACE_PHASE, "Generating code now\n");
 
-  if (isKeyword("and", 3)) {
-    matchKeyword("and");
+  initIr();
+  clearNameMap(&codegen->globals);
+  clearNameMap(&codegen->locals);
+  clearNameMap(&codegen->functions);
 
-    bfactor();
+  // PROG → A FNS DECLS STMTS B .
+  AstNode *node = astNode(program);
 
-    btermc();
+  preGen("prog");
 
-    return;
+  preGen("fns");
+  for (AstIndex function = node->a; function != AST_NONE;
+       function = astNode(function)->next) {
+    genFunction(function, ir->functionCount);
   }
 
-  return;
+  genProgram(node);
 }
 
-void bfactor() {
-  // BFACTOR → not bfactor
-  // BFACTOR → (expr comp expr)
-  preGen("bfactor");
-
-  if (isKeyword("not", 3)) {
-    matchKeyword("not");
-
-    bfactor();
+void CodeGenFunction(AstIndex function, int32_t index,
+                     const char *const *names, const int32_t *callees,
+                     int calleeCount) {
+  resetIr();
+  clearNameMap(&codegen->globals);
+  clearNameMap(&codegen->locals);
+  clearNameMap(&codegen->functions);
 
-    return;
+  for (int i = 0; i < calleeCount; i++) {
+    bindName(&codegen->functions, names[callees[i]], callees[i]);
   }
 
-  if (look_ahead->type == TOKEN_LEFT_PAREN) {
-    matchType(TOKEN_LEFT_PAREN);
-
-    expr();
-
-    comp();
+  genFunction(function, index);
+}
 
-    expr();
+void CodeGenAfterFunctions(AstIndex program, const char *const *names,
+                           int count) {
+  trace(TRACE_CODEGEN, TRACE_PHASE, "Generating code now\n");
 
-    matchType(TOKEN_RIGHT_PAREN);
+  clearNameMap(&codegen->globals);
+  clearNameMap(&codegen->locals);
+  clearNameMap(&codegen->functions);
 
-    return;
+  for (int32_t f = 0; f < count; f++) {
+    bindName(&codegen->functions, names[f], f);
   }
-}
-
-void comp() {
-  preGen("comp");
 
-  if (isComparison(look_ahead->type)) {
-    matchType(look_ahead->type);
-    return;
-  }
+  preGen("prog");
+  genProgram(astNode(program));
 }
+//< Tree Walk Functions
@@ -1,71 +1,64 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
-#define MAX_OPERANDS 3
-#define MAX_INSTRUCTIONS 1024
-
+#include "../common/context.h"
 #include "../common/string.h"
 #include "../common/token_utils.h"
+#include "../parser/ast.h"
+#include "ir.h"
 #include "stdbool.h"
 
-// Todo: complete operand type
-
-// Define types
+// Interned name to index, open addressing over the pointer
 typedef struct {
-  char name[32];
-  int type;
-} Operand;
+  const char *name;
+  int32_t index;
+} NameSlot;
 
 typedef struct {
-  int operation;
-  Operand result;
-  Operand arg1;
-  Operand arg2;
-} Instruction;
+  NameSlot *slots;
+  int slotCount;
+  int count;
+} NameMap;
 
-Instruction instructions[MAX_INSTRUCTIONS];
-int instructionCount;
+// Names resolved while lowering, one set per compiler context
+typedef struct {
+  NameMap globals;
+  NameMap locals;
+  NameMap functions;
+  int currentFunction;
+} CodegenState;
 
-// Create a new temp variable function
-// Create a new label function
+// Code generation of the context bound to this thread
+extern _Thread_local CodegenState *codegen;
 
-void CodeGen(Token *tokens);
+// Lower the syntax tree the parser built to three-address code in the
+// context's ir, and write it to intermediate_code.txt
+void CodeGen(CompilerContext *context, AstIndex program);
 
-// Non-terminal
-void prog();
-void fns();
-void fnsc();
-void fn();
-void params();
-void paramsc();
-void fname();
-void decls();
-void declsc();
-void decl();
-void type();
-void vars();
-void varsc();
-void stmts();
-void stmtsc();
-void stmt();
-void stmtc();
-void expr();
-void exprc();
-void term();
-void termc();
-void factor();
-void factorc();
-void exprs();
-void exprsc();
-void var();
-void varc();
+/**
+ * Lower one function to a program of its own in ir, as a worker of a
+ * parallel compile does; appendIr merges it into the whole program. The
+ * programs of earlier calls stay in the IR arena.
+ *
+ * @param function The function's node.
+ * @param index Index of the function in the whole program.
+ * @param names Interned names of the program's functions, by index.
+ * @param callees Indices of the functions before it that it names.
+ * @param calleeCount Number of callees.
+ */
+void CodeGenFunction(AstIndex function, int32_t index,
+                     const char *const *names, const int32_t *callees,
+                     int calleeCount);
 
-// Boolean expression 
-void bexpr();
-void bexprc();
-void bterm();
-void btermc();
-void bfactor();
-void comp();
+/**
+ * Lower the globals and top-level statements after the functions merged
+ * into ir already, and write the whole program to intermediate_code.txt.
+ *
+ * @param program The program's node, whose function list is not walked.
+ * @param names Interned names of every function, by index.
+ * @param count Number of functions.
+ */
+void CodeGenAfterFunctions(AstIndex program, const char *const *names,
+                           int count);
 
-#endif
\ No newline at end of file
+#endif
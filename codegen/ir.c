@@ -0,0 +1,593 @@
+#include "ir.h"
+#include "../common/arena.h"
+#include "../common/file_utils.h"
+#include "../common/string.h"
+#include "../semantic/semantic.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+
+_Thread_local IrProgram *ir = NULL;
+
+// Grow a table of the IR arena so it holds one more element
+static void *reserve(void *table, int count, int *capacity,
+                     size_t elementSize) {
+  if (count < *capacity) {
+    return table;
+  }
+
+  int newCapacity = *capacity == 0 ? INITIAL_CAPACITY : *capacity * 2;
+  table = arenaGrow(irArena, table, *capacity * elementSize,
+                    newCapacity * elementSize);
+  *capacity = newCapacity;
+
+  return table;
+}
+
+void initIr() {
+  freeIr();
+  ir->entry = -1;
+}
+
+void freeIr() {
+  releaseArena(irArena);
+  resetIr();
+}
+
+void resetIr() {
+  *ir = (IrProgram){0};
+  ir->entry = -1;
+  ir->currentFunction = -1;
+}
+
+int emitInstruction(IrOpcode opcode, int type, Operand result, Operand arg1,
+                    Operand arg2) {
+  ir->instructions = reserve(ir->instructions, ir->instructionCount,
+                             &ir->instructionCapacity, sizeof(Instruction));
+
+  Instruction *instruction = &ir->instructions[ir->instructionCount];
+  instruction->opcode = (uint8_t)opcode;
+  instruction->type = (uint8_t)type;
+  instruction->unused = 0;
+  instruction->result = result;
+  instruction->arg1 = arg1;
+  instruction->arg2 = arg2;
+
+  if (ir->currentFunction >= 0) {
+    ir->functions[ir->currentFunction].instructionCount++;
+  }
+
+  return ir->instructionCount++;
+}
+
+Operand newVariable(const char *name, int type, int arraySize, int function) {
+  ir->variables = reserve(ir->variables, ir->variableCount,
+                          &ir->variableCapacity, sizeof(IrVariable));
+
+  IrVariable *variable = &ir->variables[ir->variableCount];
+  variable->name = name;
+  variable->type = (uint8_t)type;
+  variable->arraySize = arraySize;
+  variable->function = function;
+
+  return makeOperand(OPERAND_VARIABLE, ir->variableCount++);
+}
+
+Operand newTemp(int type) {
+  ir->tempTypes = reserve(ir->tempTypes, ir->tempCount, &ir->tempCapacity,
+                          sizeof(uint8_t));
+  ir->tempTypes[ir->tempCount] = (uint8_t)type;
+
+  if (ir->currentFunction >= 0) {
+    ir->functions[ir->currentFunction].tempCount++;
+  }
+
+  return makeOperand(OPERAND_TEMP, ir->tempCount++);
+}
+
+Operand newLabel() { return makeOperand(OPERAND_LABEL, ir->labelCount++); }
+
+static Operand addConstant(IrConstant constant) {
+  ir->constants = reserve(ir->constants, ir->constantCount,
+                          &ir->constantCapacity, sizeof(IrConstant));
+  ir->constants[ir->constantCount] = constant;
+
+  return makeOperand(OPERAND_CONSTANT, ir->constantCount++);
+}
+
+Operand intConstant(int64_t value) {
+  IrConstant constant = {.type = INT, .intValue = value};
+  return addConstant(constant);
+}
+
+Operand doubleConstant(double value) {
+  IrConstant constant = {.type = DOUBLE, .doubleValue = value};
+  return addConstant(constant);
+}
+
+int beginFunction(const char *name, int returnType) {
+  ir->functions = reserve(ir->functions, ir->functionCount,
+                          &ir->functionCapacity, sizeof(IrFunction));
+
+  IrFunction *function = &ir->functions[ir->functionCount];
+  function->name = name;
+  function->returnType = (uint8_t)returnType;
+  function->paramCount = 0;
+  function->firstParam = ir->variableCount;
+  function->firstInstruction = ir->instructionCount;
+  function->instructionCount = 0;
+  function->firstTemp = ir->tempCount;
+  function->tempCount = 0;
+
+  ir->currentFunction = ir->functionCount;
+  return ir->functionCount++;
+}
+
+// Make room for count more elements in a table of the IR arena
+static void *reserveMore(void *table, int count, int more, int *capacity,
+                         size_t elementSize) {
+  while (count + more > *capacity) {
+    table = reserve(table, *capacity, capacity, elementSize);
+  }
+
+  return table;
+}
+
+static Operand shiftOperand(Operand operand, const IrProgram *bases) {
+  uint32_t index = operandIndex(operand);
+
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    return makeOperand(OPERAND_VARIABLE, index + bases->variableCount);
+  case OPERAND_TEMP:
+    return makeOperand(OPERAND_TEMP, index + bases->tempCount);
+  case OPERAND_CONSTANT:
+    return makeOperand(OPERAND_CONSTANT, index + bases->constantCount);
+  case OPERAND_LABEL:
+    return makeOperand(OPERAND_LABEL, index + bases->labelCount);
+  default:
+    return operand;
+  }
+}
+
+void appendIr(const IrProgram *part) {
+  IrProgram bases = *ir;
+
+  ir->instructions = reserveMore(ir->instructions, ir->instructionCount,
+                                 part->instructionCount,
+                                 &ir->instructionCapacity, sizeof(Instruction));
+  ir->variables = reserveMore(ir->variables, ir->variableCount,
+                              part->variableCount, &ir->variableCapacity,
+                              sizeof(IrVariable));
+  ir->constants = reserveMore(ir->constants, ir->constantCount,
+                              part->constantCount, &ir->constantCapacity,
+                              sizeof(IrConstant));
+  ir->tempTypes = reserveMore(ir->tempTypes, ir->tempCount, part->tempCount,
+                              &ir->tempCapacity, sizeof(uint8_t));
+  ir->functions = reserveMore(ir->functions, ir->functionCount,
+                              part->functionCount, &ir->functionCapacity,
+                              sizeof(IrFunction));
+
+  for (int i = 0; i < part->instructionCount; i++) {
+    Instruction instruction = part->instructions[i];
+    instruction.result = shiftOperand(instruction.result, &bases);
+    instruction.arg1 = shiftOperand(instruction.arg1, &bases);
+    instruction.arg2 = shiftOperand(instruction.arg2, &bases);
+    ir->instructions[ir->instructionCount++] = instruction;
+  }
+
+  for (int v = 0; v < part->variableCount; v++) {
+    IrVariable variable = part->variables[v];
+    variable.function += bases.functionCount;
+    ir->variables[ir->variableCount++] = variable;
+  }
+
+  for (int c = 0; c < part->constantCount; c++) {
+    ir->constants[ir->constantCount++] = part->constants[c];
+  }
+
+  for (int t = 0; t < part->tempCount; t++) {
+    ir->tempTypes[ir->tempCount++] = part->tempTypes[t];
+  }
+
+  for (int f = 0; f < part->functionCount; f++) {
+    IrFunction function = part->functions[f];
+    function.firstParam += bases.variableCount;
+    function.firstInstruction += bases.instructionCount;
+    function.firstTemp += bases.tempCount;
+    ir->functions[ir->functionCount++] = function;
+  }
+
+  ir->labelCount += part->labelCount;
+  ir->currentFunction = -1;
+}
+
+int operandType(Operand operand) {
+  uint32_t index = operandIndex(operand);
+
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    return ir->variables[index].type;
+  case OPERAND_TEMP:
+    return ir->tempTypes[index];
+  case OPERAND_CONSTANT:
+    return ir->constants[index].type;
+  case OPERAND_FUNCTION:
+    return ir->functions[index].returnType;
+  default:
+    return ERROR;
+  }
+}
+
+void compactIr() {
+  Instruction *instructions = ir->instructions;
+  int kept = 0;
+
+  // A function whose code was replaced sits after the ones that follow
+  // it, and compacting in place would overwrite them: copy to a new table
+  for (int f = 1; f < ir->functionCount; f++) {
+    if (ir->functions[f].firstInstruction <
+        ir->functions[f - 1].firstInstruction) {
+      instructions = arenaAlloc(irArena, (ir->instructionCapacity + 1) *
+                                              sizeof(Instruction));
+      break;
+    }
+  }
+
+  for (int f = 0; f < ir->functionCount; f++) {
+    IrFunction *function = &ir->functions[f];
+    int first = kept;
+
+    for (int i = 0; i < function->instructionCount; i++) {
+      Instruction *instruction =
+          &ir->instructions[function->firstInstruction + i];
+      if (instruction->opcode != IR_NOP) {
+        instructions[kept++] = *instruction;
+      }
+    }
+
+    function->firstInstruction = first;
+    function->instructionCount = kept - first;
+  }
+
+  ir->instructions = instructions;
+  ir->instructionCount = kept;
+}
+
+void replaceCode(int function, const Instruction *code, int count) {
+  IrFunction *owner = &ir->functions[function];
+
+  // The last function's code can be overwritten where it is
+  if (owner->firstInstruction + owner->instructionCount ==
+      ir->instructionCount) {
+    ir->instructionCount = owner->firstInstruction;
+  }
+  while (ir->instructionCount + count > ir->instructionCapacity) {
+    ir->instructions =
+        reserve(ir->instructions, ir->instructionCapacity,
+                &ir->instructionCapacity, sizeof(Instruction));
+  }
+
+  memcpy(&ir->instructions[ir->instructionCount], code,
+         count * sizeof(Instruction));
+  owner->firstInstruction = ir->instructionCount;
+  owner->instructionCount = count;
+  ir->instructionCount += count;
+}
+
+static void renumberTemp(Operand *operand, int32_t from, int32_t to) {
+  if (operandKind(*operand) == OPERAND_TEMP) {
+    *operand = makeOperand(OPERAND_TEMP, operandIndex(*operand) - from + to);
+  }
+}
+
+Operand addTemp(int function, int type) {
+  IrFunction *owner = &ir->functions[function];
+
+  // Temporaries of a function are consecutive: when another function's
+  // follow them, they move to the end of the table first
+  if (owner->firstTemp + owner->tempCount != ir->tempCount) {
+    int32_t first = ir->tempCount;
+
+    for (int t = 0; t < owner->tempCount; t++) {
+      ir->tempTypes = reserve(ir->tempTypes, ir->tempCount, &ir->tempCapacity,
+                              sizeof(uint8_t));
+      ir->tempTypes[ir->tempCount++] = ir->tempTypes[owner->firstTemp + t];
+    }
+    for (int i = 0; i < owner->instructionCount; i++) {
+      Instruction *instruction =
+          &ir->instructions[owner->firstInstruction + i];
+      renumberTemp(&instruction->result, owner->firstTemp, first);
+      renumberTemp(&instruction->arg1, owner->firstTemp, first);
+      renumberTemp(&instruction->arg2, owner->firstTemp, first);
+    }
+    owner->firstTemp = first;
+  }
+
+  ir->tempTypes = reserve(ir->tempTypes, ir->tempCount, &ir->tempCapacity,
+                          sizeof(uint8_t));
+  ir->tempTypes[ir->tempCount] = (uint8_t)type;
+  owner->tempCount++;
+
+  return makeOperand(OPERAND_TEMP, ir->tempCount++);
+}
+
+//> Printing
+static const char *operatorSymbol(IrOpcode opcode) {
+  switch (opcode) {
+  case IR_ADD:
+    return "+";
+  case IR_SUB:
+    return "-";
+  case IR_MUL:
+    return "*";
+  case IR_DIV:
+    return "/";
+  case IR_MOD:
+  case IR_MOD_POW2:
+    return "%";
+  case IR_SHL:
+    return "<<";
+  case IR_JUMP_LT:
+    return "<";
+  case IR_JUMP_LE:
+    return "<=";
+  case IR_JUMP_GT:
+    return ">";
+  case IR_JUMP_GE:
+    return ">=";
+  case IR_JUMP_EQ:
+    return "==";
+  case IR_JUMP_NE:
+    return "<>";
+  default:
+    return "?";
+  }
+}
+
+// Shortest text that reads back as the same double, and never as an int
+static void formatDouble(char *text, size_t size, double value) {
+  for (int precision = 1; precision <= 17; precision++) {
+    snprintf(text, size, "%.*g", precision, value);
+    if (strtod(text, NULL) == value) {
+      break;
+    }
+  }
+
+  for (const char *c = text; *c; c++) {
+    if (*c == '.' || *c == 'e' || *c == 'n' || *c == 'i') {
+      return;
+    }
+  }
+
+  size_t length = _strlen(text);
+  if (length + 2 < size) {
+    text[length] = '.';
+    text[length + 1] = '0';
+    text[length + 2] = '\0';
+  }
+}
+
+void appendOperand(OutputBuffer *output, Operand operand) {
+  uint32_t index = operandIndex(operand);
+  char text[64];
+
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    appendString(output, ir->variables[index].name);
+    return;
+  case OPERAND_TEMP:
+    appendChar(output, 't');
+    appendInt(output, index);
+    return;
+  case OPERAND_CONSTANT:
+    if (ir->constants[index].type == INT) {
+      appendInt(output, ir->constants[index].intValue);
+    } else {
+      formatDouble(text, sizeof(text), ir->constants[index].doubleValue);
+      appendString(output, text);
+    }
+    return;
+  case OPERAND_LABEL:
+    appendChar(output, 'L');
+    appendInt(output, index);
+    return;
+  case OPERAND_FUNCTION:
+    appendString(output, ir->functions[index].name);
+    return;
+  default:
+    appendChar(output, '_');
+    return;
+  }
+}
+
+// Two operands with an operator between them
+static void appendBinary(OutputBuffer *output, Operand left, IrOpcode opcode,
+                         Operand right) {
+  appendOperand(output, left);
+  appendChar(output, ' ');
+  appendString(output, operatorSymbol(opcode));
+  appendChar(output, ' ');
+  appendOperand(output, right);
+}
+
+void appendExpression(OutputBuffer *output, const Instruction *instruction) {
+  switch (instruction->opcode) {
+  case IR_LOAD:
+    appendOperand(output, instruction->arg1);
+    appendChar(output, '[');
+    appendOperand(output, instruction->arg2);
+    appendChar(output, ']');
+    return;
+  case IR_CALL:
+    appendString(output, "call ");
+    appendOperand(output, instruction->arg1);
+    appendString(output, ", ");
+    appendInt(output,
+              ir->functions[operandIndex(instruction->arg1)].paramCount);
+    return;
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_MOD:
+  case IR_SHL:
+  case IR_MOD_POW2:
+    appendBinary(output, instruction->arg1, instruction->opcode,
+                 instruction->arg2);
+    return;
+  default:
+    appendOperand(output, instruction->arg1);
+    return;
+  }
+}
+
+void appendInstruction(OutputBuffer *output, const Instruction *instruction) {
+  switch (instruction->opcode) {
+  case IR_COPY:
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_MOD:
+  case IR_SHL:
+  case IR_MOD_POW2:
+  case IR_LOAD:
+  case IR_CALL:
+    appendString(output, "  ");
+    appendOperand(output, instruction->result);
+    appendString(output, " = ");
+    appendExpression(output, instruction);
+    return;
+  case IR_STORE:
+    appendString(output, "  ");
+    appendOperand(output, instruction->result);
+    appendChar(output, '[');
+    appendOperand(output, instruction->arg1);
+    appendString(output, "] = ");
+    appendOperand(output, instruction->arg2);
+    return;
+  case IR_LABEL:
+    appendOperand(output, instruction->result);
+    appendChar(output, ':');
+    return;
+  case IR_JUMP:
+    appendString(output, "  goto ");
+    appendOperand(output, instruction->result);
+    return;
+  case IR_JUMP_LT:
+  case IR_JUMP_LE:
+  case IR_JUMP_GT:
+  case IR_JUMP_GE:
+  case IR_JUMP_EQ:
+  case IR_JUMP_NE:
+    appendString(output, "  if ");
+    appendBinary(output, instruction->arg1, instruction->opcode,
+                 instruction->arg2);
+    appendString(output, " goto ");
+    appendOperand(output, instruction->result);
+    return;
+  case IR_PARAM:
+    appendString(output, "  param ");
+    appendOperand(output, instruction->arg1);
+    return;
+  case IR_RETURN:
+    appendString(output, "  return");
+    if (instruction->arg1 != NO_OPERAND) {
+      appendChar(output, ' ');
+      appendOperand(output, instruction->arg1);
+    }
+    return;
+  case IR_PRINT:
+    appendString(output, "  print ");
+    appendOperand(output, instruction->arg1);
+    return;
+  default:
+    appendString(output, "  nop");
+    return;
+  }
+}
+
+static const char *typeName(int type) { return type == INT ? "int" : "double"; }
+
+// A declaration: type, name, then the size of an array
+static void appendVariable(OutputBuffer *output, const IrVariable *variable) {
+  appendString(output, typeName(variable->type));
+  appendChar(output, ' ');
+  appendString(output, variable->name);
+
+  if (variable->arraySize > 0) {
+    appendChar(output, '[');
+    appendInt(output, variable->arraySize);
+    appendChar(output, ']');
+  }
+}
+
+void printIr(const char *fileName) {
+  OutputBuffer output;
+
+  removeOutputFile(fileName);
+  openOutput(&output, fileName);
+
+  // Globals first, then every function with its locals
+  bool isEmpty = true;
+  for (int i = 0; i < ir->variableCount; i++) {
+    IrVariable *variable = &ir->variables[i];
+
+    if (variable->function != -1) {
+      continue;
+    }
+
+    appendString(&output, "global ");
+    appendVariable(&output, variable);
+    appendChar(&output, '\n');
+    isEmpty = false;
+  }
+
+  for (int f = 0; f < ir->functionCount; f++) {
+    IrFunction *function = &ir->functions[f];
+
+    if (!(f == 0 && isEmpty)) {
+      appendChar(&output, '\n');
+    }
+
+    if (function->name) {
+      appendString(&output, "function ");
+      appendString(&output, typeName(function->returnType));
+      appendChar(&output, ' ');
+      appendString(&output, function->name);
+      appendChar(&output, '(');
+
+      for (int p = 0; p < function->paramCount; p++) {
+        IrVariable *param = &ir->variables[function->firstParam + p];
+        if (p > 0) {
+          appendString(&output, ", ");
+        }
+        appendString(&output, typeName(param->type));
+        appendChar(&output, ' ');
+        appendString(&output, param->name);
+      }
+      appendString(&output, ")\n");
+    } else {
+      appendString(&output, "program\n");
+    }
+
+    // Locals follow the parameters
+    for (int i = function->firstParam + function->paramCount;
+         i < ir->variableCount && ir->variables[i].function == f; i++) {
+      appendString(&output, "  local ");
+      appendVariable(&output, &ir->variables[i]);
+      appendChar(&output, '\n');
+    }
+
+    for (int i = 0; i < function->instructionCount; i++) {
+      appendInstruction(&output,
+                        &ir->instructions[function->firstInstruction + i]);
+      appendChar(&output, '\n');
+    }
+  }
+
+  closeOutput(&output);
+}
+//< Printing
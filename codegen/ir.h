@@ -0,0 +1,229 @@
+// Three-address code: the intermediate representation CodeGen produces
+
+#ifndef IR_H
+#define IR_H
+
+#include "../common/file_utils.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// An operand is a 32-bit index tagged with what it indexes: the top four
+// bits hold the OperandKind, the rest the index into that kind's table
+typedef uint32_t Operand;
+
+typedef enum {
+  OPERAND_NONE,
+  OPERAND_VARIABLE, // ir->variables
+  OPERAND_TEMP,     // ir->tempTypes
+  OPERAND_CONSTANT, // ir->constants
+  OPERAND_LABEL,    // Label number, placed by an IR_LABEL
+  OPERAND_FUNCTION, // ir->functions
+} OperandKind;
+
+#define OPERAND_INDEX_BITS 28
+#define OPERAND_INDEX_MASK ((1u << OPERAND_INDEX_BITS) - 1)
+#define NO_OPERAND ((Operand)0)
+
+static inline Operand makeOperand(OperandKind kind, uint32_t index) {
+  return ((uint32_t)kind << OPERAND_INDEX_BITS) | index;
+}
+
+static inline OperandKind operandKind(Operand operand) {
+  return (OperandKind)(operand >> OPERAND_INDEX_BITS);
+}
+
+static inline uint32_t operandIndex(Operand operand) {
+  return operand & OPERAND_INDEX_MASK;
+}
+
+typedef enum {
+  IR_NOP,
+  IR_COPY,    // result = arg1
+  IR_ADD,     // result = arg1 + arg2
+  IR_SUB,     // result = arg1 - arg2
+  IR_MUL,     // result = arg1 * arg2
+  IR_DIV,     // result = arg1 / arg2
+  IR_MOD,     // result = arg1 % arg2
+  IR_LOAD,    // result = arg1[arg2]
+  IR_STORE,   // result[arg1] = arg2
+  IR_LABEL,   // result:
+  IR_JUMP,    // goto result
+  IR_JUMP_LT, // if arg1 < arg2 goto result
+  IR_JUMP_LE, // if arg1 <= arg2 goto result
+  IR_JUMP_GT, // if arg1 > arg2 goto result
+  IR_JUMP_GE, // if arg1 >= arg2 goto result
+  IR_JUMP_EQ, // if arg1 == arg2 goto result
+  IR_JUMP_NE, // if arg1 <> arg2 goto result
+  IR_PARAM,   // pass arg1 to the next call
+  IR_CALL,    // result = call arg1, with the preceding params
+  IR_RETURN,  // return arg1, none for the program itself
+  IR_PRINT,   // print arg1
+
+  // Strength-reduced forms the optimizer produces, arg2 is a constant
+  IR_SHL,      // result = arg1 << arg2, for arg1 * 2^arg2
+  IR_MOD_POW2, // result = arg1 % arg2, arg2 a power of two
+} IrOpcode;
+
+// 16 bytes, so long instruction lists stay cache-friendly
+typedef struct {
+  uint8_t opcode; // IrOpcode
+  uint8_t type;   // DataType of the operation: INT or DOUBLE
+  uint16_t unused;
+  Operand result;
+  Operand arg1;
+  Operand arg2;
+} Instruction;
+
+typedef struct {
+  const char *name; // Interned
+  uint8_t type;     // DataType
+  int32_t arraySize; // 0 for scalars
+  int32_t function;  // Owning function, -1 for globals
+} IrVariable;
+
+typedef struct {
+  uint8_t type; // DataType
+  union {
+    int64_t intValue;
+    double doubleValue;
+  };
+} IrConstant;
+
+typedef struct {
+  const char *name; // Interned, NULL for the program's top-level statements
+  uint8_t returnType;
+  int32_t paramCount;
+  int32_t firstParam; // Parameters are consecutive variables
+  int32_t firstInstruction;
+  int32_t instructionCount;
+  int32_t firstTemp; // Temporaries of a function are consecutive
+  int32_t tempCount;
+} IrFunction;
+
+// Every table grows in the IR arena
+typedef struct {
+  Instruction *instructions;
+  int instructionCount;
+  int instructionCapacity;
+
+  IrVariable *variables;
+  int variableCount;
+  int variableCapacity;
+
+  IrConstant *constants;
+  int constantCount;
+  int constantCapacity;
+
+  uint8_t *tempTypes; // DataType of every temporary
+  int tempCount;
+  int tempCapacity;
+
+  IrFunction *functions;
+  int functionCount;
+  int functionCapacity;
+
+  int labelCount;
+  int32_t entry; // Function holding the top-level statements
+
+  int32_t currentFunction; // Being generated, -1 between functions
+} IrProgram;
+
+// Program of the context bound to this thread
+extern _Thread_local IrProgram *ir;
+
+void initIr();
+// Release the whole program at once
+void freeIr();
+// Start an empty program, leaving the last one's tables in the IR arena
+void resetIr();
+
+/**
+ * Append an instruction to the program.
+ *
+ * @param opcode The operation.
+ * @param type DataType of the operation.
+ * @param result Destination, or label for jumps.
+ * @param arg1 First source operand, or NO_OPERAND.
+ * @param arg2 Second source operand, or NO_OPERAND.
+ * @return Index of the instruction.
+ */
+int emitInstruction(IrOpcode opcode, int type, Operand result, Operand arg1,
+                    Operand arg2);
+
+/**
+ * Add a variable to the program.
+ *
+ * @param name Interned name.
+ * @param type DataType of the variable or its elements.
+ * @param arraySize Number of elements, 0 for a scalar.
+ * @param function Owning function, -1 for a global.
+ * @return Operand referring to the variable.
+ */
+Operand newVariable(const char *name, int type, int arraySize, int function);
+
+// New temporary of the given DataType
+Operand newTemp(int type);
+// New label, placed later with an IR_LABEL
+Operand newLabel();
+Operand intConstant(int64_t value);
+Operand doubleConstant(double value);
+
+/**
+ * Start a function. Instructions and temporaries created until the next
+ * call belong to it.
+ *
+ * @param name Interned name, NULL for the top-level statements.
+ * @param returnType DataType of the returned value.
+ * @return Index of the function.
+ */
+int beginFunction(const char *name, int returnType);
+
+/**
+ * Append the functions of a program generated on its own, like a worker
+ * of a parallel compile does, after those of ir. Its variables, temporaries,
+ * constants and labels are renumbered to follow those of ir; calls keep the
+ * function they refer to, which must be the index it has in ir.
+ *
+ * @param part The program to append, which holds no globals.
+ */
+void appendIr(const IrProgram *part);
+
+// DataType of any value operand
+int operandType(Operand operand);
+
+// Drop the IR_NOPs passes left behind, keeping every function contiguous
+// and the functions in order
+void compactIr();
+
+/**
+ * Replace the code of a function. The new code goes after every other
+ * function's until the next compactIr.
+ *
+ * @param function Index of the function.
+ * @param code The instructions, copied.
+ * @param count Number of instructions.
+ */
+void replaceCode(int function, const Instruction *code, int count);
+
+/**
+ * Add a temporary to a function whose code is already generated. If the
+ * function's temporaries have to move to stay consecutive, its code is
+ * renumbered, so earlier operands of its temporaries are stale.
+ *
+ * @param function Index of the function.
+ * @param type DataType of the temporary.
+ * @return The new temporary.
+ */
+Operand addTemp(int function, int type);
+
+// Readable text of an operand: a name, a constant or a label
+void appendOperand(OutputBuffer *output, Operand operand);
+// Right-hand side of an instruction with a result, such as a + b
+void appendExpression(OutputBuffer *output, const Instruction *instruction);
+// An instruction as printIr writes it, indented, without the newline
+void appendInstruction(OutputBuffer *output, const Instruction *instruction);
+
+// Write the program as readable three-address code
+void printIr(const char *fileName);
+
+#endif
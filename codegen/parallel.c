@@ -0,0 +1,353 @@
+#include "parallel.h"
+#include "../common/thread_pool.h"
+#include "../driver/compiler.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// A function found by the pre-scan, FN → def TYPE FNAME ( PARAMS ) ... fed
+typedef struct {
+  int first;        // Token of its def
+  int end;          // Token after its ';'
+  const char *name; // Interned
+  DataType returnType;
+  uint32_t offset; // Of the token after ')', where the parser declares it
+  int parameterCount;
+  int parameters; // Token of the first one's type, the next ones every 3
+} FunctionRange;
+
+// What a worker leaves behind for one function
+typedef struct {
+  bool hasError;
+  IrProgram part; // In the IR arena of the thread that generated it
+} FunctionResult;
+
+typedef struct {
+  const TokenStream *tokens;
+  FunctionRange *functions;
+  const char **names; // Of every function, by index
+  FunctionResult *results;
+  // The context of every worker thread, kept here between its tasks since
+  // they outlive the thread: its functions' code stays in the IR arena until
+  // merged, the syntax tree and symbol tables go with every function
+  CompilerContext *workers;
+  int32_t *slots; // Function indices hashed by name, -1 if empty
+  int slotCount;  // Power of two, at most half full
+} ParallelCompile;
+
+static void *allocate(size_t size) {
+  void *memory = malloc(size > 0 ? size : 1);
+  if (!memory) {
+    perror("Failed to allocate parallel compile");
+    exit(1);
+  }
+
+  return memory;
+}
+
+//> Pre-scan
+static bool isKeywordAt(const TokenStream *tokens, int index,
+                        KeywordType keyword) {
+  return index < tokens->count && tokens->types[index] == TOKEN_KEYWORD &&
+         tokens->keywords[index] == keyword;
+}
+
+static bool isTypeAt(const TokenStream *tokens, int index) {
+  return isKeywordAt(tokens, index, KEYWORD_INT) ||
+         isKeywordAt(tokens, index, KEYWORD_DOUBLE);
+}
+
+static bool isTokenAt(const TokenStream *tokens, int index, TokenType type) {
+  return index < tokens->count && tokens->types[index] == type;
+}
+
+static DataType typeAt(const TokenStream *tokens, int index) {
+  return isKeywordAt(tokens, index, KEYWORD_INT) ? INT : DOUBLE;
+}
+
+/**
+ * Read the signature of the function at a def, and find its end.
+ *
+ * @param tokens The token stream.
+ * @param first Index of the def.
+ * @param function The signature read.
+ * @return Index of the token after the function's ';', or -1 if the
+ * function is not well formed.
+ */
+static int scanFunction(const TokenStream *tokens, int first,
+                        FunctionRange *function) {
+  int index = first + 1;
+
+  if (!isTypeAt(tokens, index) || !isTokenAt(tokens, index + 1, TOKEN_ID) ||
+      !isTokenAt(tokens, index + 2, TOKEN_LEFT_PAREN)) {
+    return -1;
+  }
+
+  function->first = first;
+  function->returnType = typeAt(tokens, index);
+  function->name = tokens->lexemes[index + 1];
+  function->parameterCount = 0;
+  index += 3;
+  function->parameters = index;
+
+  // Scalar parameters only, separated by commas
+  while (!isTokenAt(tokens, index, TOKEN_RIGHT_PAREN)) {
+    if (!isTypeAt(tokens, index) || !isTokenAt(tokens, index + 1, TOKEN_ID)) {
+      return -1;
+    }
+
+    function->parameterCount++;
+    index += 2;
+
+    if (isTokenAt(tokens, index, TOKEN_COMMA)) {
+      index++;
+    } else if (!isTokenAt(tokens, index, TOKEN_RIGHT_PAREN)) {
+      return -1;
+    }
+  }
+
+  index++;
+  if (index >= tokens->count) {
+    return -1;
+  }
+  function->offset = tokens->offsets[index];
+
+  // Functions do not nest, so the body ends at the first fed
+  while (!isKeywordAt(tokens, index, KEYWORD_FED)) {
+    if (index >= tokens->count || isKeywordAt(tokens, index, KEYWORD_DEF)) {
+      return -1;
+    }
+    index++;
+  }
+
+  function->end = index + 2;
+  return isTokenAt(tokens, index + 1, TOKEN_SEMICOLON) ? function->end : -1;
+}
+
+/**
+ * Find the functions at the start of the program.
+ *
+ * @param tokens The token stream.
+ * @param functions Gets the functions, in program order.
+ * @param count Gets the number of functions.
+ * @return Index of the first token after the functions, or -1 if they
+ * cannot be compiled apart.
+ */
+static int scanFunctions(const TokenStream *tokens, FunctionRange **functions,
+                         int *count) {
+  int capacity = 16;
+  int index = 0;
+
+  *functions = allocate(capacity * sizeof(FunctionRange));
+  *count = 0;
+
+  while (isKeywordAt(tokens, index, KEYWORD_DEF)) {
+    if (*count == capacity) {
+      capacity *= 2;
+      *functions = realloc(*functions, capacity * sizeof(FunctionRange));
+      if (!*functions) {
+        perror("Failed to allocate parallel compile");
+        exit(1);
+      }
+    }
+
+    index = scanFunction(tokens, index, &(*functions)[*count]);
+    if (index == -1) {
+      return -1;
+    }
+
+    // A name declared twice is reported where the second one is parsed
+    for (int f = 0; f < *count; f++) {
+      if ((*functions)[f].name == (*functions)[*count].name) {
+        return -1;
+      }
+    }
+    (*count)++;
+  }
+
+  return index;
+}
+//< Pre-scan
+
+//> Function Names
+// Names are interned, so the pointer itself is the key
+static unsigned int hashName(const char *name) {
+  uintptr_t key = (uintptr_t)name;
+  return (unsigned int)((key >> 4) ^ (key >> 20)) * 2654435761u;
+}
+
+static int32_t *findSlot(const ParallelCompile *compile, const char *name) {
+  unsigned int mask = compile->slotCount - 1;
+  unsigned int index = hashName(name) & mask;
+
+  while (compile->slots[index] != -1 &&
+         compile->names[compile->slots[index]] != name) {
+    index = (index + 1) & mask;
+  }
+
+  return &compile->slots[index];
+}
+
+static void indexNames(ParallelCompile *compile, int count) {
+  compile->slotCount = 16;
+  while (compile->slotCount < 2 * count) {
+    compile->slotCount *= 2;
+  }
+
+  compile->slots = allocate(compile->slotCount * sizeof(int32_t));
+  for (int i = 0; i < compile->slotCount; i++) {
+    compile->slots[i] = -1;
+  }
+
+  for (int f = 0; f < count; f++) {
+    *findSlot(compile, compile->names[f]) = f;
+  }
+}
+//< Function Names
+
+// Declare a function in the global scope, as parseFn does on the way
+static void declareFunction(const TokenStream *tokens,
+                            const FunctionRange *function) {
+  SymbolTableEntry entry;
+  entry.symbolType = FUNCTION;
+  entry.returnType = function->returnType;
+  entry.offset = function->offset;
+  entry.parameterCount = function->parameterCount;
+  entry.parameters = newParameters(entry.parameterCount);
+  entry.lexeme = function->name;
+
+  for (int i = 0; i < entry.parameterCount; i++) {
+    entry.parameters[i] = typeAt(tokens, function->parameters + 3 * i);
+  }
+
+  insertSymbol(entry);
+}
+
+// Of the functions before f, declare the ones its body names: declaring
+// every one of them for every function would take quadratic time
+static int declareCallees(const ParallelCompile *compile, int f,
+                          int32_t *callees) {
+  const TokenStream *tokens = compile->tokens;
+  const FunctionRange *function = &compile->functions[f];
+  int count = 0;
+
+  for (int index = function->first; index < function->end; index++) {
+    if (tokens->types[index] != TOKEN_ID) {
+      continue;
+    }
+
+    int32_t callee = *findSlot(compile, tokens->lexemes[index]);
+    if (callee != -1 && callee < f &&
+        !lookupSymbol(compile->names[callee])) {
+      declareFunction(tokens, &compile->functions[callee]);
+      callees[count++] = callee;
+    }
+  }
+
+  return count;
+}
+
+// One task of the pool: parse, check and lower function f on its own
+static void compileFunction(void *context, int f, int thread) {
+  ParallelCompile *compile = context;
+  FunctionResult *result = &compile->results[f];
+  useContext(&compile->workers[thread]);
+
+  // The syntax tree and symbol tables of the thread's last function go,
+  // their memory is kept for this one
+  errorState->hasError = false;
+  clearSymbolTables();
+  clearAst();
+
+  initTokenCursorAt(compile->tokens, compile->functions[f].first);
+  const FunctionRange *range = &compile->functions[f];
+  int32_t *callees =
+      arenaAlloc(parserArena, (range->end - range->first) * sizeof(int32_t));
+
+  A("global");
+  int calleeCount = declareCallees(compile, f, callees);
+  AstIndex function = parseFn();
+
+  if (!errorState->hasError) {
+    CodeGenFunction(function, f, compile->names, callees, calleeCount);
+  }
+
+  result->hasError = errorState->hasError;
+  result->part = *ir;
+}
+
+bool compileInParallel(CompilerContext *context, const TokenStream *tokens,
+                       int threadCount) {
+  useContext(context);
+
+  FunctionRange *functions;
+  int count;
+  int end = scanFunctions(tokens, &functions, &count);
+
+  if (end == -1 || count == 0) {
+    free(functions);
+    return false;
+  }
+
+  ParallelCompile compile = {tokens, functions, NULL, NULL, NULL, NULL, 0};
+  compile.names = allocate(count * sizeof(const char *));
+  compile.results = allocate(count * sizeof(FunctionResult));
+  compile.workers = allocate(threadCount * sizeof(CompilerContext));
+  for (int f = 0; f < count; f++) {
+    compile.names[f] = functions[f].name;
+  }
+  // Workers share the calling thread's line index, so it is built once
+  prepareLineIndex(lineIndex);
+  for (int t = 0; t < threadCount; t++) {
+    initContext(&compile.workers[t]);
+    compile.workers[t].errors.isQuiet = true;
+    compile.workers[t].lines = *lineIndex;
+  }
+
+  indexNames(&compile, count);
+  runTasks(threadCount, count, compileFunction, &compile);
+
+  bool isCompiled = true;
+  for (int f = 0; f < count; f++) {
+    isCompiled &= !compile.results[f].hasError;
+  }
+
+  if (isCompiled) {
+    // PROG → A FNS DECLS STMTS B . with FNS compiled by the workers
+    beginParse();
+    initTokenCursorAt(tokens, end);
+    preParse("prog");
+
+    A("global");
+    for (int f = 0; f < count; f++) {
+      declareFunction(tokens, &functions[f]);
+    }
+    AstIndex program = parseProgc(tokens->offsets[0], AST_NONE);
+    endParse();
+
+    // Functions first, in program order, as CodeGen lays them out
+    if (!errorState->hasError) {
+      initIr();
+      for (int f = 0; f < count; f++) {
+        appendIr(&compile.results[f].part);
+      }
+      CodeGenAfterFunctions(program, compile.names, count);
+    }
+  }
+
+  // What the workers leave goes with the context's arenas
+  for (int t = 0; t < threadCount; t++) {
+    PhaseArenas *arenas = &compile.workers[t].arenas;
+    absorbArena(parserArena, &arenas->parser);
+    absorbArena(semanticArena, &arenas->semantic);
+    absorbArena(irArena, &arenas->ir);
+    freeTrace(&compile.workers[t].trace);
+  }
+
+  free(compile.slots);
+  free(compile.workers);
+  free(compile.results);
+  free(compile.names);
+  free(functions);
+  return isCompiled;
+}
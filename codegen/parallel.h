@@ -0,0 +1,33 @@
+// Parallel front end: the function bodies of a program are parsed, checked
+// and lowered to three-address code on a thread pool, while the program's
+// own declarations and statements are compiled on the calling thread
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "../common/context.h"
+#include "../common/token_stream.h"
+#include <stdbool.h>
+
+/**
+ * Compile a whole token stream as Parse followed by CodeGen do, with every
+ * function compiled on a worker thread. A pre-scan finds the functions and
+ * their signatures first, so each worker declares the functions before its
+ * own, as the sequential parse would have. The functions are merged into ir
+ * in program order, so the code is the same as a sequential compile's.
+ *
+ * Workers compile in contexts of their own and do not trace. If any function
+ * has an error, or the pre-scan does not recognize the program's shape,
+ * nothing is written and the program has to be compiled sequentially, which
+ * reports the errors in order.
+ *
+ * @param context The context to compile in, whose ir gets the code.
+ * @param tokens The token stream of the whole program.
+ * @param threadCount Number of worker threads.
+ * @return Whether the program was compiled; hasError then tells whether its
+ * declarations or statements have errors, and code was generated if not.
+ */
+bool compileInParallel(CompilerContext *context, const TokenStream *tokens,
+                       int threadCount);
+
+#endif
@@ -0,0 +1,275 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t used;
+  size_t capacity;
+  _Alignas(ARENA_ALIGNMENT) char data[];
+};
+
+_Thread_local Arena *lexerArena = NULL;
+_Thread_local Arena *internArena = NULL;
+_Thread_local Arena *parserArena = NULL;
+_Thread_local Arena *semanticArena = NULL;
+_Thread_local Arena *irArena = NULL;
+_Thread_local Arena *optArena = NULL;
+_Thread_local Arena *vmArena = NULL;
+_Thread_local Arena *backendArena = NULL;
+_Thread_local Arena *errorArena = NULL;
+
+static size_t alignSize(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock *newBlock(Arena *arena, size_t capacity) {
+  ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+  if (!block) {
+    perror("Failed to allocate arena block");
+    exit(1);
+  }
+
+  block->used = 0;
+  block->capacity = capacity;
+
+  arena->blockCount++;
+  arena->bytesReserved += capacity;
+  if (arena->bytesReserved > arena->peakReserved) {
+    arena->peakReserved = arena->bytesReserved;
+  }
+
+  return block;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+  size_t alignedSize = alignSize(size);
+  ArenaBlock *head = arena->blocks;
+
+  arena->allocationCount++;
+  arena->bytesAllocated += size;
+
+  if (head && head->used + alignedSize <= head->capacity) {
+    void *memory = head->data + head->used;
+    head->used += alignedSize;
+    return memory;
+  }
+
+  // Large requests get a block of their own behind the current one, so the
+  // space left in the current block is not abandoned
+  if (alignedSize > ARENA_BLOCK_SIZE / 4) {
+    ArenaBlock *block = newBlock(arena, alignedSize);
+    block->used = alignedSize;
+
+    if (head) {
+      block->next = head->next;
+      head->next = block;
+    } else {
+      block->next = NULL;
+      arena->blocks = block;
+    }
+
+    return block->data;
+  }
+
+  ArenaBlock *block = newBlock(arena, ARENA_BLOCK_SIZE);
+  block->next = head;
+  block->used = alignedSize;
+  arena->blocks = block;
+
+  return block->data;
+}
+
+void *arenaGrow(Arena *arena, void *memory, size_t oldSize, size_t newSize) {
+  ArenaBlock *head = arena->blocks;
+
+  // The last allocation of the current block can grow where it is
+  if (memory && head &&
+      (char *)memory + alignSize(oldSize) == head->data + head->used) {
+    size_t start = (char *)memory - head->data;
+
+    if (start + alignSize(newSize) <= head->capacity) {
+      head->used = start + alignSize(newSize);
+      arena->allocationCount++;
+      arena->bytesAllocated += newSize - oldSize;
+      return memory;
+    }
+  }
+
+  // A large allocation owns its block, so the block itself can be resized
+  if (memory && alignSize(oldSize) > ARENA_BLOCK_SIZE / 4 &&
+      alignSize(newSize) > ARENA_BLOCK_SIZE / 4) {
+    ArenaBlock **link = &arena->blocks;
+    while (*link && (*link)->data != memory) {
+      link = &(*link)->next;
+    }
+
+    if (*link) {
+      ArenaBlock *block = *link;
+      size_t capacity = alignSize(newSize);
+      ArenaBlock *resized = realloc(block, sizeof(ArenaBlock) + capacity);
+      if (!resized) {
+        perror("Failed to grow arena block");
+        exit(1);
+      }
+
+      arena->allocationCount++;
+      arena->bytesAllocated += newSize - oldSize;
+      arena->bytesReserved += capacity - resized->capacity;
+      if (arena->bytesReserved > arena->peakReserved) {
+        arena->peakReserved = arena->bytesReserved;
+      }
+
+      resized->used = capacity;
+      resized->capacity = capacity;
+      *link = resized;
+
+      return resized->data;
+    }
+  }
+
+  char *grown = arenaAlloc(arena, newSize);
+  char *old = memory;
+  for (size_t i = 0; i < oldSize; i++) {
+    grown[i] = old[i];
+  }
+
+  return grown;
+}
+
+void releaseArena(Arena *arena) {
+  if (!arena->blocks) {
+    return;
+  }
+
+  ArenaBlock *block = arena->blocks;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  arena->blocks = NULL;
+  arena->bytesReserved = 0;
+  arena->releaseCount++;
+}
+
+void rewindArena(Arena *arena) {
+  ArenaBlock *kept = NULL;
+  ArenaBlock *block = arena->blocks;
+
+  if (!block) {
+    return;
+  }
+
+  // A block of the usual size, not one a large allocation had to itself
+  while (block) {
+    ArenaBlock *next = block->next;
+    if (!kept && block->capacity == ARENA_BLOCK_SIZE) {
+      kept = block;
+    } else {
+      free(block);
+    }
+    block = next;
+  }
+
+  arena->blocks = kept;
+  arena->bytesReserved = 0;
+  if (kept) {
+    kept->next = NULL;
+    kept->used = 0;
+    arena->bytesReserved = kept->capacity;
+  }
+  arena->releaseCount++;
+}
+
+void absorbArena(Arena *arena, Arena *from) {
+  // Behind the current block, which keeps taking allocations
+  if (from->blocks) {
+    ArenaBlock *last = from->blocks;
+    while (last->next) {
+      last = last->next;
+    }
+
+    if (arena->blocks) {
+      last->next = arena->blocks->next;
+      arena->blocks->next = from->blocks;
+    } else {
+      last->next = NULL;
+      arena->blocks = from->blocks;
+    }
+  }
+
+  arena->allocationCount += from->allocationCount;
+  arena->bytesAllocated += from->bytesAllocated;
+  arena->blockCount += from->blockCount;
+  arena->bytesReserved += from->bytesReserved;
+  arena->peakReserved += from->peakReserved;
+  arena->releaseCount += from->releaseCount;
+  if (arena->bytesReserved > arena->peakReserved) {
+    arena->peakReserved = arena->bytesReserved;
+  }
+
+  *from = (Arena){.name = from->name};
+}
+
+static void reportArena(const Arena *arena) {
+  fprintf(stderr,
+          "%-9s %9zu allocations %12zu bytes %6zu blocks %12zu peak bytes "
+          "%12zu live bytes\n",
+          arena->name, arena->allocationCount, arena->bytesAllocated,
+          arena->blockCount, arena->peakReserved, arena->bytesReserved);
+}
+
+void initPhaseArenas(PhaseArenas *arenas) {
+  *arenas = (PhaseArenas){
+      .lexer = {.name = "lexer"},
+      .intern = {.name = "intern"},
+      .parser = {.name = "parser"},
+      .semantic = {.name = "semantic"},
+      .ir = {.name = "ir"},
+      .opt = {.name = "opt"},
+      .vm = {.name = "vm"},
+      .backend = {.name = "backend"},
+      .error = {.name = "error"},
+  };
+}
+
+void usePhaseArenas(PhaseArenas *arenas) {
+  lexerArena = &arenas->lexer;
+  internArena = &arenas->intern;
+  parserArena = &arenas->parser;
+  semanticArena = &arenas->semantic;
+  irArena = &arenas->ir;
+  optArena = &arenas->opt;
+  vmArena = &arenas->vm;
+  backendArena = &arenas->backend;
+  errorArena = &arenas->error;
+}
+
+void releasePhaseArenas(PhaseArenas *arenas) {
+  releaseArena(&arenas->lexer);
+  releaseArena(&arenas->intern);
+  releaseArena(&arenas->parser);
+  releaseArena(&arenas->semantic);
+  releaseArena(&arenas->ir);
+  releaseArena(&arenas->opt);
+  releaseArena(&arenas->vm);
+  releaseArena(&arenas->backend);
+  releaseArena(&arenas->error);
+}
+
+void reportArenas() {
+  reportArena(lexerArena);
+  reportArena(internArena);
+  reportArena(parserArena);
+  reportArena(semanticArena);
+  reportArena(irArena);
+  reportArena(optArena);
+  reportArena(vmArena);
+  reportArena(backendArena);
+  reportArena(errorArena);
+}
@@ -0,0 +1,119 @@
+// Region allocator: every allocation of a compiler phase comes from that
+// phase's arena and is released with it in one go
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+  const char *name;
+  ArenaBlock *blocks; // Most recent block first
+
+  // Counters, kept across releases so a long-lived process can report them
+  size_t allocationCount; // Calls to arenaAlloc and arenaGrow
+  size_t bytesAllocated;  // Bytes handed out, before alignment
+  size_t blockCount;      // Blocks requested from malloc
+  size_t bytesReserved;   // Bytes held in blocks right now
+  size_t peakReserved;    // Largest bytesReserved seen
+  size_t releaseCount;    // Calls to releaseArena that freed blocks
+} Arena;
+
+// One arena per phase, in every compiler context
+typedef struct {
+  Arena lexer;    // Spooled input, token stream
+  Arena intern;   // Interned lexemes, their index
+  Arena parser;   // Syntax tree
+  Arena semantic; // Symbol tables and call frames
+  Arena ir;       // Generated instructions
+  Arena opt;      // Scratch tables of the passes
+  Arena vm;       // Bytecode for the interpreter
+  Arena backend;  // Live intervals of the backend
+  Arena error;    // Diagnostics, until written at the end
+} PhaseArenas;
+
+// The arenas of the context bound to this thread, see usePhaseArenas
+extern _Thread_local Arena *lexerArena;
+extern _Thread_local Arena *internArena;
+extern _Thread_local Arena *parserArena;
+extern _Thread_local Arena *semanticArena;
+extern _Thread_local Arena *irArena;
+extern _Thread_local Arena *optArena;
+extern _Thread_local Arena *vmArena;
+extern _Thread_local Arena *backendArena;
+extern _Thread_local Arena *errorArena;
+
+/**
+ * Name every arena of a set, all of them empty.
+ *
+ * @param arenas The arenas to set up.
+ */
+void initPhaseArenas(PhaseArenas *arenas);
+
+/**
+ * Make a set the phase arenas of the calling thread.
+ *
+ * @param arenas The arenas every phase allocates from from now on.
+ */
+void usePhaseArenas(PhaseArenas *arenas);
+
+/**
+ * Release every arena of a set.
+ *
+ * @param arenas The arenas to release.
+ */
+void releasePhaseArenas(PhaseArenas *arenas);
+
+/**
+ * Allocate memory from an arena. The memory is not zeroed and lives until
+ * the arena is released.
+ *
+ * @param arena The arena to allocate from.
+ * @param size Number of bytes, aligned to 16.
+ * @return Pointer to the memory. Exits the process if out of memory.
+ */
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * Grow an allocation, in place when it is the last one in its block,
+ * otherwise by copying it. The old memory is reclaimed on release only.
+ *
+ * @param arena The arena the allocation came from.
+ * @param memory The allocation, or NULL to allocate a new one.
+ * @param oldSize Its current size in bytes.
+ * @param newSize The size it needs, larger than oldSize.
+ * @return Pointer to the grown allocation.
+ */
+void *arenaGrow(Arena *arena, void *memory, size_t oldSize, size_t newSize);
+
+/**
+ * Free every block of the arena. Pointers into it are invalid afterwards,
+ * the counters are kept.
+ *
+ * @param arena The arena to release.
+ */
+void releaseArena(Arena *arena);
+
+/**
+ * Empty an arena to fill it again, as releaseArena does, but keep one of
+ * its blocks, so the next allocations do not go back to malloc.
+ *
+ * @param arena The arena to rewind.
+ */
+void rewindArena(Arena *arena);
+
+/**
+ * Move every block of an arena into another, counters included, so the
+ * memory lives as long as the other arena. Leaves the first one empty.
+ *
+ * @param arena The arena taking the blocks.
+ * @param from The arena giving them up, of another thread usually.
+ */
+void absorbArena(Arena *arena, Arena *from);
+
+// Print the counters of the thread's phase arenas to stderr
+void reportArenas();
+
+#endif
@@ -0,0 +1,19 @@
+// The compiler context, as the phases see it: their entry points take the
+// context to work on, defined in driver/compiler.h along with its lifecycle
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+typedef struct CompilerContext CompilerContext;
+
+/**
+ * Bind a context to the calling thread. Every phase keeps its state in the
+ * bound context, so a thread works on one compile at a time while other
+ * threads work on their own. Entry points taking a context bind it, the
+ * functions called after them keep working on it.
+ *
+ * @param context The context to compile in.
+ */
+void useContext(CompilerContext *context);
+
+#endif
@@ -0,0 +1,217 @@
+#include "diagnostics.h"
+#include "arena.h"
+#include "error_state.h"
+#include "file_utils.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define INITIAL_RECORDS 16
+#define INITIAL_LOG 1024
+
+_Thread_local DiagnosticLog *diagnostics = NULL;
+
+// Where each phase's diagnostics go, NULL for stderr
+static const char *phaseFiles[PHASE_COUNT] = {
+    [PHASE_LEXICAL] = "lexical_analysis_errors.txt",
+    [PHASE_SYNTAX] = "syntax_analysis_errors.txt",
+    [PHASE_SEMANTIC] = "semantic_errors.txt",
+    [PHASE_CODEGEN] = NULL,
+};
+
+//> Deduplication
+static uint32_t hashRecord(const Diagnostic *record) {
+  const char *text = diagnostics->log + record->offset;
+  uint32_t hash = 2166136261u;
+
+  for (uint32_t i = 0; i < record->length; i++) {
+    hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+  }
+
+  hash = (hash ^ record->phase) * 16777619u;
+  hash = (hash ^ record->id) * 16777619u;
+  hash = (hash ^ (uint32_t)record->line) * 16777619u;
+  return (hash ^ (uint32_t)record->column) * 16777619u;
+}
+
+static bool isSameRecord(const Diagnostic *a, const Diagnostic *b) {
+  if (a->phase != b->phase || a->id != b->id || a->line != b->line ||
+      a->column != b->column || a->length != b->length) {
+    return false;
+  }
+
+  const char *first = diagnostics->log + a->offset;
+  const char *second = diagnostics->log + b->offset;
+  for (uint32_t i = 0; i < a->length; i++) {
+    if (first[i] != second[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int32_t *findSlot(const Diagnostic *record) {
+  unsigned int mask = diagnostics->slotCount - 1;
+  unsigned int index = hashRecord(record) & mask;
+
+  while (diagnostics->slots[index] != -1 &&
+         !isSameRecord(&diagnostics->records[diagnostics->slots[index]],
+                       record)) {
+    index = (index + 1) & mask;
+  }
+
+  return &diagnostics->slots[index];
+}
+
+static void growSlots() {
+  int slotCount = diagnostics->slotCount ? diagnostics->slotCount * 2
+                                         : INITIAL_RECORDS * 2;
+  diagnostics->slots = arenaAlloc(errorArena, slotCount * sizeof(int32_t));
+  diagnostics->slotCount = slotCount;
+
+  for (int i = 0; i < slotCount; i++) {
+    diagnostics->slots[i] = -1;
+  }
+  for (int r = 0; r < diagnostics->count; r++) {
+    *findSlot(&diagnostics->records[r]) = r;
+  }
+}
+//< Deduplication
+
+// Format a record's text onto the end of the log, with its newline
+static uint32_t appendText(const char *format, va_list arguments) {
+  va_list retry;
+  va_copy(retry, arguments);
+
+  size_t left = diagnostics->logCapacity - diagnostics->logLength;
+  char *end = left > 0 ? diagnostics->log + diagnostics->logLength : NULL;
+  int length = vsnprintf(end, left, format, arguments);
+  length = length < 0 ? 0 : length;
+
+  // The newline takes the place of vsnprintf's terminator
+  if ((size_t)length >= left) {
+    size_t capacity = diagnostics->logCapacity ? diagnostics->logCapacity
+                                               : INITIAL_LOG;
+    while (capacity < diagnostics->logLength + length + 1) {
+      capacity *= 2;
+    }
+
+    diagnostics->log = arenaGrow(errorArena, diagnostics->log,
+                                 diagnostics->logCapacity, capacity);
+    diagnostics->logCapacity = capacity;
+    vsnprintf(diagnostics->log + diagnostics->logLength, length + 1, format,
+              retry);
+  }
+  va_end(retry);
+
+  diagnostics->log[diagnostics->logLength + length] = '\n';
+  return (uint32_t)length + 1;
+}
+
+static void report(Severity severity, DiagnosticPhase phase, DiagnosticId id,
+                   int line, int column, const char *format,
+                   va_list arguments) {
+
+  if (diagnostics->count == diagnostics->capacity) {
+    int capacity = diagnostics->capacity ? diagnostics->capacity * 2
+                                         : INITIAL_RECORDS;
+    diagnostics->records = arenaGrow(
+        errorArena, diagnostics->records,
+        diagnostics->capacity * sizeof(Diagnostic),
+        capacity * sizeof(Diagnostic));
+    diagnostics->capacity = capacity;
+  }
+
+  Diagnostic *record = &diagnostics->records[diagnostics->count];
+  record->severity = severity;
+  record->phase = phase;
+  record->id = id;
+  record->line = line;
+  record->column = column;
+  record->offset = (uint32_t)diagnostics->logLength;
+
+  record->length = appendText(format, arguments);
+
+  // Keep the table at most half full, counting this record
+  if ((diagnostics->count + 1) * 2 > diagnostics->slotCount) {
+    growSlots();
+  }
+
+  int32_t *slot = findSlot(record);
+  if (*slot != -1) {
+    diagnostics->droppedCount++;
+    return;
+  }
+
+  *slot = diagnostics->count++;
+  diagnostics->logLength += record->length;
+}
+
+void reportError(DiagnosticPhase phase, DiagnosticId id, int line, int column,
+                 const char *format, ...) {
+  setErrorOccurred();
+  if (errorState->isQuiet) {
+    return;
+  }
+
+  va_list arguments;
+  va_start(arguments, format);
+  report(SEVERITY_ERROR, phase, id, line, column, format, arguments);
+  va_end(arguments);
+}
+
+void reportWarning(DiagnosticPhase phase, DiagnosticId id, int line,
+                   int column, const char *format, ...) {
+  if (errorState->isQuiet) {
+    return;
+  }
+
+  va_list arguments;
+  va_start(arguments, format);
+  report(SEVERITY_WARNING, phase, id, line, column, format, arguments);
+  va_end(arguments);
+}
+
+void writeDiagnostics() {
+  int first = diagnostics->writtenCount;
+  int count = diagnostics->count - first;
+  if (count == 0) {
+    return;
+  }
+
+  struct iovec *parts = arenaAlloc(errorArena, count * sizeof(struct iovec));
+
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    int partCount = 0;
+
+    // Records of a phase reported one after the other are one part
+    for (int r = first; r < diagnostics->count; r++) {
+      const Diagnostic *record = &diagnostics->records[r];
+      if (record->phase != phase) {
+        continue;
+      }
+
+      char *text = diagnostics->log + record->offset;
+      struct iovec *last = partCount > 0 ? &parts[partCount - 1] : NULL;
+      if (last && (char *)last->iov_base + last->iov_len == text) {
+        last->iov_len += record->length;
+      } else {
+        parts[partCount++] = (struct iovec){text, record->length};
+      }
+    }
+
+    if (partCount == 0) {
+      continue;
+    }
+
+    if (phaseFiles[phase]) {
+      generateFileFromParts(phaseFiles[phase], parts, partCount);
+    } else {
+      writeParts(STDERR_FILENO, parts, partCount);
+    }
+  }
+
+  diagnostics->writtenCount = diagnostics->count;
+}
@@ -0,0 +1,92 @@
+// Diagnostics: every error a compile finds, as a record of where and what,
+// kept in memory and written once the compile is done, each phase's to its
+// own file with one writev. A record repeating an earlier one, as panic mode
+// recovery tends to produce, is dropped.
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum { SEVERITY_ERROR, SEVERITY_WARNING } Severity;
+
+// Where a diagnostic is written follows from its phase
+typedef enum {
+  PHASE_LEXICAL,  // lexical_analysis_errors.txt
+  PHASE_SYNTAX,   // syntax_analysis_errors.txt
+  PHASE_SEMANTIC, // semantic_errors.txt
+  PHASE_CODEGEN,  // stderr
+  PHASE_COUNT,
+} DiagnosticPhase;
+
+typedef enum {
+  DIAG_UNEXPECTED_CHARACTER,
+  DIAG_UNREADABLE_INPUT,
+  DIAG_UNUSABLE_TRANSITION_TABLE,
+  DIAG_EXPECTED,
+  DIAG_UNDECLARED,
+  DIAG_ARGUMENT_COUNT,
+  DIAG_ARGUMENT_TYPE,
+  DIAG_ASSIGNMENT_TYPE,
+  DIAG_RETURN_OUTSIDE_FUNCTION,
+  DIAG_RETURN_TYPE,
+  DIAG_ARITHMETIC_TYPE,
+  DIAG_COMPARISON_TYPE,
+  DIAG_NOT_A_FUNCTION,
+  DIAG_REDECLARATION,
+  DIAG_NO_SCOPE,
+  DIAG_ARRAY_SIZE,
+} DiagnosticId;
+
+typedef struct {
+  uint8_t severity; // Severity
+  uint8_t phase;    // DiagnosticPhase
+  uint16_t id;      // DiagnosticId
+  int line;         // 0 if not known
+  int column;       // 0 if not known
+  uint32_t offset;  // Of its text in the log, one line ending in '\n'
+  uint32_t length;
+} Diagnostic;
+
+// The diagnostics of one compile, growing in the error arena
+typedef struct {
+  Diagnostic *records; // In the order reported
+  int count;
+  int capacity;
+  int writtenCount; // Records already written out
+
+  char *log; // Text of every record, back to back
+  size_t logLength;
+  size_t logCapacity;
+
+  int32_t *slots; // Records hashed by content, -1 if empty
+  int slotCount;  // Power of two, at most half full
+  int droppedCount; // Repeats left out
+} DiagnosticLog;
+
+// Diagnostics of the context bound to this thread
+extern _Thread_local DiagnosticLog *diagnostics;
+
+/**
+ * Report an error, formatted as printf does. It always sets hasError; the
+ * record is kept unless the compile is quiet or it repeats an earlier one.
+ *
+ * @param phase The phase finding it, which decides where it is written.
+ * @param id What kind of error it is.
+ * @param line Line of the source it is about, 0 if none.
+ * @param column Column on that line, 0 if not known.
+ * @param format Its text, without the trailing newline.
+ */
+void reportError(DiagnosticPhase phase, DiagnosticId id, int line, int column,
+                 const char *format, ...);
+
+// Report what does not stop the compile, written as an error is
+void reportWarning(DiagnosticPhase phase, DiagnosticId id, int line,
+                   int column, const char *format, ...);
+
+// Write the records reported since the last call, each phase's at once
+void writeDiagnostics();
+
+#endif
@@ -1,5 +1,6 @@
 #include "error_state.h"
+#include <stddef.h>
 
-bool hasError = false;
+_Thread_local ErrorState *errorState = NULL;
 
-void setErrorOccurred() { hasError = true; }
\ No newline at end of file
+void setErrorOccurred() { errorState->hasError = true; }
@@ -5,9 +5,19 @@
 
 #include "stdbool.h"
 
-// Global error flag
-extern bool hasError;
+typedef struct {
+  bool hasError;
+
+  // A quiet compile writes no diagnostics, an error only sets hasError:
+  // the workers of a parallel compile are quiet, as the program is compiled
+  // again sequentially to report it, and so are library compiles that only
+  // want the code
+  bool isQuiet;
+} ErrorState;
+
+// Error state of the compile bound to this thread
+extern _Thread_local ErrorState *errorState;
 
 void setErrorOccurred();
 
-#endif
\ No newline at end of file
+#endif
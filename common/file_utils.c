@@ -1,74 +1,347 @@
+#include <errno.h>  // For EEXIST
 #include <fcntl.h>  // For open() flags
+#include <limits.h> // For IOV_MAX
+#include <stdlib.h> // For realloc() and free()
+#include <string.h> // For memcpy()
+#include <sys/stat.h> // For mkdir()
 #include <unistd.h> // For write() and close()
 #include "../common/string.h"
 #include "../common/file_utils.h"
+#include "../common/error_state.h"
+#include "../common/trace.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+_Thread_local const char *outputDirectory = NULL;
 
-// Todo: 1024 to BUFFER_SIZE
 //> buffer-file-functions
 
-void appendToBuffer(char *buffer, size_t *bufferIndex, const char *message, const char *fileName)
+bool makeOutputDirectory(const char *path)
 {
-  size_t messageLength = _strlen(message);
+  if (mkdir(path, 0777) == -1 && errno != EEXIST)
+  {
+    perror(path);
+    return false;
+  }
 
-  // If exceed the buffer max length
-  if (*bufferIndex + messageLength >= 1024 - 1)
+  return true;
+}
+
+// Where a file goes in the output directory, false if nothing is written
+static bool outputPath(const char *fileName, char *path, size_t size)
+{
+  if (!outputDirectory)
   {
-    // Need to get filename
-    flushBufferToFile(fileName, buffer, bufferIndex);
+    return false;
   }
 
-  // Copy message and ensure null termination
-  _strncpy(buffer + *bufferIndex, message, messageLength);
-  *bufferIndex += messageLength;
-  buffer[*bufferIndex] = '\0'; // Explicitly null-termination
+  if (fileName[0] == '/')
+  {
+    return snprintf(path, size, "%s", fileName) < (int)size;
+  }
+
+  return snprintf(path, size, "%s/%s", outputDirectory, fileName) < (int)size;
+}
+
+void removeOutputFile(const char *fileName)
+{
+  char path[4096];
+  if (outputPath(fileName, path, sizeof(path)))
+  {
+    remove(path);
+  }
 }
 
 int generateFile(const char *fileName, const char *content)
 {
+  char path[4096];
+  if (!outputPath(fileName, path, sizeof(path)))
+  {
+    return 0;
+  }
+
   // O_WRONLY -> Writing only
   // O_CREAT  -> Create file if it does not exist
   // O_APPEND -> Append content at the end of the file
   // S_IRUSR  -> Set the read permission for user
   // S_IWUSR  -> Set the write permission for user
-  int file = open(fileName, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+  int file = open(path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
   if (file == -1)
   {
     perror("Failed to open file for writing");
+    setErrorOccurred();
     return -1;
   }
 
-  printf("%s\n", content);
-
   size_t contentLength = _strlen(content);
+  if (isTraced(TRACE_FILES, TRACE_PHASE))
+  {
+    traceText(content, contentLength);
+    traceText("\n", 1);
+  }
+
   if (contentLength == 0)
   {
     close(file);
     return 0;
   }
 
-  size_t bytesWrite = write(file, content, contentLength);
+  ssize_t bytesWrite = write(file, content, contentLength);
   if (bytesWrite == -1)
   {
     perror("Failed to write to file");
+    setErrorOccurred();
     close(file);
     return -1;
   }
 
-  printf("Writing to file: %s\n", fileName);
+  trace(TRACE_FILES, TRACE_PHASE, "Writing to file: %s\n", fileName);
   close(file);
 
   return 0;
 }
 
-void flushBufferToFile(const char *fileName, char *buffer, size_t *bufferIndex)
+int writeParts(int fd, struct iovec *parts, int count)
+{
+  while (count > 0)
+  {
+    int batch = count < IOV_MAX ? count : IOV_MAX;
+    ssize_t written = writev(fd, parts, batch);
+    if (written == -1)
+    {
+      perror("Failed to write to file");
+      return -1;
+    }
+
+    // Skip what was written, resuming within a part cut short
+    while (count > 0 && (size_t)written >= parts->iov_len)
+    {
+      written -= parts->iov_len;
+      parts++;
+      count--;
+    }
+    if (count > 0)
+    {
+      parts->iov_base = (char *)parts->iov_base + written;
+      parts->iov_len -= written;
+    }
+  }
+
+  return 0;
+}
+
+int generateFileFromParts(const char *fileName, struct iovec *parts, int count)
 {
-  if (*bufferIndex > 0)
+  char path[4096];
+  if (!outputPath(fileName, path, sizeof(path)))
+  {
+    return 0;
+  }
+
+  int file = open(path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+  if (file == -1)
+  {
+    perror("Failed to open file for writing");
+    setErrorOccurred();
+    return -1;
+  }
+
+  if (isTraced(TRACE_FILES, TRACE_PHASE))
+  {
+    for (int i = 0; i < count; i++)
+    {
+      traceText(parts[i].iov_base, parts[i].iov_len);
+    }
+    traceText("\n", 1);
+  }
+
+  int result = writeParts(file, parts, count);
+  if (result != 0)
   {
-    buffer[*bufferIndex] = '\0'; // Final null-termination
-    generateFile(fileName, buffer);
+    setErrorOccurred();
   }
-  *bufferIndex = 0; // Reset buffer
-  buffer[0] = '\0'; // Clear buffer content
+  else
+  {
+    trace(TRACE_FILES, TRACE_PHASE, "Writing to file: %s\n", fileName);
+  }
+  close(file);
+
+  return result;
+}
+
+//< buffer-file-functions
+
+//> Output buffer
+void openOutput(OutputBuffer *output, const char *fileName)
+{
+  output->fileName = fileName;
+  output->fd = -1;
+  output->isDiscarded = !outputDirectory;
+  output->data = NULL;
+  output->length = 0;
+  output->capacity = 0;
 }
 
-//< buffer-file-functions
\ No newline at end of file
+// Open the file the first time it is needed, discarding the output and
+// failing the compile if it cannot be
+static bool openOutputFile(OutputBuffer *output)
+{
+  if (output->fd == -1)
+  {
+    char path[4096];
+    if (outputPath(output->fileName, path, sizeof(path)))
+    {
+      output->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+    }
+
+    if (output->fd == -1)
+    {
+      perror("Failed to open file for writing");
+      setErrorOccurred();
+      output->isDiscarded = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Write a chunk to the file, opening it on the first one
+static void writeChunk(OutputBuffer *output, const char *data, size_t length)
+{
+  if (!openOutputFile(output))
+  {
+    return;
+  }
+
+  if (isTraced(TRACE_FILES, TRACE_PHASE))
+  {
+    traceText(data, length);
+  }
+
+  struct iovec part = {(void *)data, length};
+  if (writeParts(output->fd, &part, 1) != 0)
+  {
+    setErrorOccurred();
+    output->isDiscarded = true;
+  }
+}
+
+// Make room for length more bytes: grow to a chunk, then write chunks out
+static void reserveOutput(OutputBuffer *output, size_t length)
+{
+  if (output->capacity < OUTPUT_CHUNK_SIZE)
+  {
+    size_t capacity = output->capacity ? output->capacity : 4096;
+    while (capacity < output->length + length && capacity < OUTPUT_CHUNK_SIZE)
+    {
+      capacity *= 2;
+    }
+
+    char *data = realloc(output->data, capacity);
+    if (!data)
+    {
+      perror("Failed to allocate output buffer");
+      exit(1);
+    }
+    output->data = data;
+    output->capacity = capacity;
+  }
+
+  if (output->length + length > output->capacity)
+  {
+    writeChunk(output, output->data, output->length);
+    output->length = 0;
+  }
+}
+
+void appendBytes(OutputBuffer *output, const char *text, size_t length)
+{
+  // Nothing to copy, and no buffer to copy it to before the first bytes
+  if (output->isDiscarded || length == 0)
+  {
+    return;
+  }
+
+  if (output->length + length > output->capacity)
+  {
+    reserveOutput(output, length);
+
+    // Longer than a chunk, it goes straight out
+    if (length > output->capacity)
+    {
+      writeChunk(output, text, length);
+      return;
+    }
+  }
+
+  memcpy(output->data + output->length, text, length);
+  output->length += length;
+}
+
+void appendString(OutputBuffer *output, const char *text)
+{
+  appendBytes(output, text, _strlen(text));
+}
+
+void appendChar(OutputBuffer *output, char character)
+{
+  if (output->length < output->capacity)
+  {
+    output->data[output->length++] = character;
+    return;
+  }
+
+  appendBytes(output, &character, 1);
+}
+
+void appendInt(OutputBuffer *output, long long value)
+{
+  // Digits from the last, of the magnitude so the minimum works too
+  char digits[24];
+  int start = sizeof(digits);
+  unsigned long long magnitude =
+      value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+  do
+  {
+    digits[--start] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+
+  if (value < 0)
+  {
+    digits[--start] = '-';
+  }
+
+  appendBytes(output, digits + start, sizeof(digits) - start);
+}
+
+void closeOutput(OutputBuffer *output)
+{
+  // An empty output still gets its file, as generateFile gives it
+  if (!output->isDiscarded && openOutputFile(output) && output->length > 0)
+  {
+    writeChunk(output, output->data, output->length);
+  }
+
+  // Traced as generateFile does, once for the whole file
+  if (output->fd != -1)
+  {
+    if (isTraced(TRACE_FILES, TRACE_PHASE))
+    {
+      traceText("\n", 1);
+    }
+    trace(TRACE_FILES, TRACE_PHASE, "Writing to file: %s\n", output->fileName);
+    close(output->fd);
+  }
+
+  free(output->data);
+  output->fd = -1;
+  output->data = NULL;
+  output->length = 0;
+  output->capacity = 0;
+}
+//< Output buffer
\ No newline at end of file
@@ -3,10 +3,52 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <sys/uio.h>
 
-void appendToBuffer(char *buffer, size_t *bufferIndex, const char *message, const char *fileName);
+// Directory the compile bound to this thread writes its files to, NULL to
+// write none. Absolute file names are used as they are.
+extern _Thread_local const char *outputDirectory;
+
+// Create a directory unless it exists, reporting why it cannot be
+bool makeOutputDirectory(const char *path);
+
+// A file that cannot be written fails the compile, as every one below does
 int generateFile(const char *fileName, const char *content);
-void flushBufferToFile(const char *fileName, char *buffer, size_t *bufferIndex);
+// Remove a file written by an earlier compile to the output directory
+void removeOutputFile(const char *fileName);
+
+// Write every part to a descriptor, however many writev calls it takes
+int writeParts(int fd, struct iovec *parts, int count);
+// Append every part to a file in the output directory, as generateFile does
+int generateFileFromParts(const char *fileName, struct iovec *parts, int count);
+
+//> Output buffer
+// Size of the chunks an output buffer writes, which it grows to first
+#define OUTPUT_CHUNK_SIZE 65536
+
+// Text appended piece by piece to a file in the output directory, and
+// written out a chunk at a time with the file kept open in between
+typedef struct {
+  const char *fileName;
+  int fd;            // Opened by the first chunk, -1 before
+  bool isDiscarded;  // Nothing to write to, appends are dropped
+  char *data;
+  size_t length;
+  size_t capacity;   // Up to OUTPUT_CHUNK_SIZE
+} OutputBuffer;
+
+// Start an empty output to a file, appended to as generateFile does
+void openOutput(OutputBuffer *output, const char *fileName);
+// Write what is left, close the file and release the buffer
+void closeOutput(OutputBuffer *output);
+
+void appendBytes(OutputBuffer *output, const char *text, size_t length);
+void appendString(OutputBuffer *output, const char *text);
+void appendChar(OutputBuffer *output, char character);
+// In decimal, without going through printf
+void appendInt(OutputBuffer *output, long long value);
+//< Output buffer
 
 #endif
\ No newline at end of file
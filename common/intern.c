@@ -0,0 +1,121 @@
+#include "intern.h"
+#include "arena.h"
+
+#define INTERN_CHUNK_SIZE (16 * 1024)
+#define INTERN_INITIAL_SLOTS 1024
+
+_Thread_local InternTable *interned = NULL;
+
+//> hash
+// FNV-1a: cheap and good enough for short identifiers
+static unsigned int hashString(const char *start, int length) {
+  unsigned int hash = 2166136261u;
+
+  for (int i = 0; i < length; i++) {
+    hash ^= (unsigned char)start[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+//< hash
+
+static char *storeString(const char *start, int length) {
+  if (length + 1 > interned->chunkLeft) {
+    // Long strings get their own allocation, the chunk stays usable
+    if (length + 1 > INTERN_CHUNK_SIZE / 4) {
+      char *string = arenaAlloc(internArena, length + 1);
+      for (int i = 0; i < length; i++) {
+        string[i] = start[i];
+      }
+      string[length] = '\0';
+
+      return string;
+    }
+
+    interned->chunk = arenaAlloc(internArena, INTERN_CHUNK_SIZE);
+    interned->chunkLeft = INTERN_CHUNK_SIZE;
+  }
+
+  char *string = interned->chunk;
+  for (int i = 0; i < length; i++) {
+    string[i] = start[i];
+  }
+  string[length] = '\0';
+  interned->chunk += length + 1;
+  interned->chunkLeft -= length + 1;
+
+  return string;
+}
+
+static void growSlots() {
+  int newCount =
+      interned->slotCount == 0 ? INTERN_INITIAL_SLOTS : interned->slotCount * 2;
+  InternSlot *newSlots = arenaAlloc(internArena, newCount * sizeof(InternSlot));
+  for (int i = 0; i < newCount; i++) {
+    newSlots[i].string = NULL;
+  }
+
+  // Rehash every stored string into the bigger index
+  for (int i = 0; i < interned->slotCount; i++) {
+    if (!interned->slots[i].string) {
+      continue;
+    }
+
+    int index = interned->slots[i].hash & (newCount - 1);
+    while (newSlots[index].string) {
+      index = (index + 1) & (newCount - 1);
+    }
+    newSlots[index] = interned->slots[i];
+  }
+
+  // The old index stays in the arena until the table is freed
+  interned->slots = newSlots;
+  interned->slotCount = newCount;
+}
+
+//> intern-string
+const char *internString(const char *start, int length) {
+  // Keep the load factor under one half
+  if ((interned->stringCount + 1) * 2 > interned->slotCount) {
+    growSlots();
+  }
+
+  unsigned int hash = hashString(start, length);
+  int index = hash & (interned->slotCount - 1);
+
+  while (interned->slots[index].string) {
+    InternSlot *slot = &interned->slots[index];
+
+    if (slot->hash == hash && slot->length == length) {
+      int i = 0;
+      while (i < length && slot->string[i] == start[i]) {
+        i++;
+      }
+
+      if (i == length) {
+        return slot->string;
+      }
+    }
+
+    index = (index + 1) & (interned->slotCount - 1);
+  }
+
+  interned->slots[index].string = storeString(start, length);
+  interned->slots[index].length = length;
+  interned->slots[index].hash = hash;
+  interned->stringCount++;
+
+  return interned->slots[index].string;
+}
+//< intern-string
+
+void freeInternTable() {
+  releaseArena(internArena);
+
+  interned->chunk = NULL;
+  interned->chunkLeft = 0;
+  interned->slots = NULL;
+  interned->slotCount = 0;
+  interned->stringCount = 0;
+}
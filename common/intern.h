@@ -0,0 +1,41 @@
+// Interned string table: every distinct lexeme is stored exactly once
+
+#ifndef INTERN_H
+#define INTERN_H
+
+// Open-addressing hash index over the stored strings
+typedef struct {
+  const char *string;
+  int length;
+  unsigned int hash;
+} InternSlot;
+
+// Strings are packed back to back in chunks carved from the intern arena
+typedef struct {
+  char *chunk;
+  int chunkLeft;
+  InternSlot *slots;
+  int slotCount;
+  int stringCount;
+} InternTable;
+
+// Table of the compile bound to this thread
+extern _Thread_local InternTable *interned;
+
+/**
+ * Intern a string, copying it into the table the first time it is seen.
+ *
+ * @param start Pointer to the first character (need not be null-terminated).
+ * @param length Number of characters to intern.
+ * @return A stable, null-terminated pointer. Interning the same characters
+ * again returns the same pointer, so interned strings can be compared with ==.
+ */
+const char *internString(const char *start, int length);
+
+/**
+ * Release every interned string at once. Pointers returned by internString
+ * are invalid afterwards.
+ */
+void freeInternTable();
+
+#endif
@@ -0,0 +1,89 @@
+#include "keyword.h"
+
+/**
+ * keywordNames
+ * Spelling of every keyword, indexed by KeywordType
+ */
+static const char *keywordNames[] = {
+    [KEYWORD_NONE] = "",        [KEYWORD_OR] = "or",
+    [KEYWORD_AND] = "and",      [KEYWORD_NOT] = "not",
+    [KEYWORD_IF] = "if",        [KEYWORD_THEN] = "then",
+    [KEYWORD_ELSE] = "else",    [KEYWORD_FI] = "fi",
+    [KEYWORD_WHILE] = "while",  [KEYWORD_DO] = "do",
+    [KEYWORD_OD] = "od",        [KEYWORD_DEF] = "def",
+    [KEYWORD_FED] = "fed",      [KEYWORD_RETURN] = "return",
+    [KEYWORD_PRINT] = "print",  [KEYWORD_INT] = "int",
+    [KEYWORD_DOUBLE] = "double"};
+
+//> check-keyword
+// Compare the rest of the lexeme once the first character picked a candidate
+static KeywordType checkKeyword(const char *start, int length,
+                                KeywordType keyword) {
+  const char *name = keywordNames[keyword];
+
+  for (int i = 1; i < length; i++) {
+    if (name[i] != start[i]) {
+      return KEYWORD_NONE;
+    }
+  }
+
+  // The lexeme matched so far, so it must not be a longer name either
+  return name[length] == '\0' ? keyword : KEYWORD_NONE;
+}
+//< check-keyword
+
+//> classify-keyword
+// Keywords are 2 to 6 characters long, so the length rules out most
+// identifiers before the first-character switch narrows the candidates
+// down to one or two.
+KeywordType classifyKeyword(const char *start, int length) {
+  if (length < 2 || length > 6) {
+    return KEYWORD_NONE;
+  }
+
+  switch (start[0]) {
+  case 'a':
+    return checkKeyword(start, length, KEYWORD_AND);
+  case 'd':
+    switch (length) {
+    case 2:
+      return checkKeyword(start, length, KEYWORD_DO);
+    case 3:
+      return checkKeyword(start, length, KEYWORD_DEF);
+    case 6:
+      return checkKeyword(start, length, KEYWORD_DOUBLE);
+    }
+    break;
+  case 'e':
+    return checkKeyword(start, length, KEYWORD_ELSE);
+  case 'f':
+    return length == 2 ? checkKeyword(start, length, KEYWORD_FI)
+                       : checkKeyword(start, length, KEYWORD_FED);
+  case 'i':
+    return length == 2 ? checkKeyword(start, length, KEYWORD_IF)
+                       : checkKeyword(start, length, KEYWORD_INT);
+  case 'n':
+    return checkKeyword(start, length, KEYWORD_NOT);
+  case 'o':
+    if (length == 2) {
+      return start[1] == 'r' ? KEYWORD_OR
+                             : checkKeyword(start, length, KEYWORD_OD);
+    }
+    break;
+  case 'p':
+    return checkKeyword(start, length, KEYWORD_PRINT);
+  case 'r':
+    return checkKeyword(start, length, KEYWORD_RETURN);
+  case 't':
+    return checkKeyword(start, length, KEYWORD_THEN);
+  case 'w':
+    return checkKeyword(start, length, KEYWORD_WHILE);
+  }
+
+  return KEYWORD_NONE;
+}
+//< classify-keyword
+
+const char *keywordToString(KeywordType keyword) {
+  return keywordNames[keyword];
+}
@@ -0,0 +1,25 @@
+// Keyword classification for identifiers found by the lexer
+
+#ifndef KEYWORD_H
+#define KEYWORD_H
+
+#include "token.h"
+
+/**
+ * Classify a lexeme as one of the reserved keywords.
+ *
+ * @param start Pointer to the first character (need not be null-terminated).
+ * @param length Number of characters in the lexeme.
+ * @return The matching keyword, or KEYWORD_NONE for a plain identifier.
+ */
+KeywordType classifyKeyword(const char *start, int length);
+
+/**
+ * Get the spelling of a keyword, used for diagnostics.
+ *
+ * @param keyword The keyword to look up.
+ * @return The keyword as written in source, e.g. "while".
+ */
+const char *keywordToString(KeywordType keyword);
+
+#endif
@@ -0,0 +1,141 @@
+#include "line_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAS_X86_LINES 1
+#endif
+
+// Lines of a typical source run well under this many bytes, so the first
+// guess rarely has to grow
+#define BYTES_PER_LINE 32
+#define MIN_LINE_CAPACITY 64
+
+_Thread_local LineIndex *lineIndex = NULL;
+
+void initLineIndex(LineIndex *index, const char *input, size_t inputLength) {
+  index->input = input;
+  index->inputLength = inputLength;
+  index->lineStarts = NULL;
+  index->lineCount = 0;
+  index->capacity = 0;
+}
+
+void freeLineIndex(LineIndex *index) {
+  free(index->lineStarts);
+  initLineIndex(index, NULL, 0);
+}
+
+//> Build
+static void addLine(LineIndex *index, size_t start) {
+  if (index->lineCount == index->capacity) {
+    index->capacity *= 2;
+    index->lineStarts =
+        realloc(index->lineStarts, index->capacity * sizeof(uint32_t));
+    if (!index->lineStarts) {
+      perror("Failed to allocate line index");
+      exit(1);
+    }
+  }
+
+  index->lineStarts[index->lineCount++] = (uint32_t)start;
+}
+
+// A line starts after every newline bit of the block at offset
+static inline void addLines(LineIndex *index, unsigned int newlines,
+                            size_t offset) {
+  while (newlines != 0) {
+    addLine(index, offset + __builtin_ctz(newlines) + 1);
+    newlines &= newlines - 1;
+  }
+}
+
+// Each finder returns how far it got, whole blocks only
+#ifdef HAS_X86_LINES
+static size_t findLinesSse2(LineIndex *index) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  size_t offset = 0;
+
+  for (; index->inputLength - offset >= 16; offset += 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(index->input + offset));
+    addLines(index,
+             (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)),
+             offset);
+  }
+
+  return offset;
+}
+
+__attribute__((target("avx2"))) static size_t
+findLinesAvx2(LineIndex *index) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  size_t offset = 0;
+
+  for (; index->inputLength - offset >= 32; offset += 32) {
+    __m256i bytes =
+        _mm256_loadu_si256((const __m256i *)(index->input + offset));
+    addLines(index,
+             (unsigned int)_mm256_movemask_epi8(
+                 _mm256_cmpeq_epi8(bytes, newline)),
+             offset);
+  }
+
+  return offset;
+}
+#endif
+
+static void buildLineIndex(LineIndex *index) {
+  index->capacity = index->inputLength / BYTES_PER_LINE + MIN_LINE_CAPACITY;
+  index->lineStarts = malloc(index->capacity * sizeof(uint32_t));
+  if (!index->lineStarts) {
+    perror("Failed to allocate line index");
+    exit(1);
+  }
+  addLine(index, 0);
+
+  size_t offset = 0;
+#ifdef HAS_X86_LINES
+  __builtin_cpu_init();
+  offset = __builtin_cpu_supports("avx2") ? findLinesAvx2(index)
+                                          : findLinesSse2(index);
+#endif
+
+  for (; offset < index->inputLength; offset++) {
+    if (index->input[offset] == '\n') {
+      addLine(index, offset + 1);
+    }
+  }
+}
+
+void prepareLineIndex(LineIndex *index) {
+  if (!index->lineStarts) {
+    buildLineIndex(index);
+  }
+}
+//< Build
+
+//> Lookup
+SourcePosition positionOf(uint32_t offset) {
+  prepareLineIndex(lineIndex);
+
+  // The last line starting at or before offset, the first line always does
+  int low = 0;
+  int high = lineIndex->lineCount - 1;
+  while (low < high) {
+    int middle = low + (high - low + 1) / 2;
+    if (lineIndex->lineStarts[middle] <= offset) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  SourcePosition position;
+  position.line = low + 1;
+  position.column = (int)(offset - lineIndex->lineStarts[low]) + 1;
+  return position;
+}
+
+int lineOf(uint32_t offset) { return positionOf(offset).line; }
+//< Lookup
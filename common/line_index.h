@@ -0,0 +1,57 @@
+// Line index: where each line of the input starts. Tokens and syntax tree
+// nodes keep only a byte offset into the input; a line and column are worked
+// out from it when a diagnostic or a trace prints one, by binary search in
+// the index. The index is built the first time a position is asked for, with
+// one vectorized pass over the input for its newlines.
+
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  const char *input; // Must stay alive for as long as positions are asked for
+  size_t inputLength;
+  uint32_t *lineStarts; // Offset of each line's first byte, NULL until built
+  int lineCount;
+  int capacity;
+} LineIndex;
+
+typedef struct {
+  int line;   // From 1
+  int column; // From 1, in bytes
+} SourcePosition;
+
+// Line index of the context bound to this thread
+extern _Thread_local LineIndex *lineIndex;
+
+/**
+ * Point an index at an input, without building it yet. An index that was
+ * built before must be freed first.
+ *
+ * @param index The index to set up.
+ * @param input The input positions are offsets into.
+ * @param inputLength Number of bytes in the input.
+ */
+void initLineIndex(LineIndex *index, const char *input, size_t inputLength);
+
+// Release the index, which then has no input
+void freeLineIndex(LineIndex *index);
+
+// Build the index now if it is not yet, so threads can share it read-only
+void prepareLineIndex(LineIndex *index);
+
+/**
+ * Find the line and column of a byte of the input of the bound index,
+ * building the index first if no position was asked for yet.
+ *
+ * @param offset Offset of the byte, up to the input length for its end.
+ * @return Its line and column.
+ */
+SourcePosition positionOf(uint32_t offset);
+
+// The line alone
+int lineOf(uint32_t offset);
+
+#endif
@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Tasks not taken yet from a share: the owner takes from the head, in
+// order, and thieves from the tail, far from where the owner works
+typedef struct {
+  pthread_mutex_t lock;
+  int head;
+  int tail;
+} TaskQueue;
+
+typedef struct {
+  TaskQueue *queues;
+  int threadCount;
+  TaskFunction run;
+  void *context;
+} Pool;
+
+typedef struct {
+  Pool *pool;
+  int index;
+} Worker;
+
+static int takeTask(TaskQueue *queue, bool isOwner) {
+  int task = -1;
+
+  pthread_mutex_lock(&queue->lock);
+  if (queue->head < queue->tail) {
+    task = isOwner ? queue->head++ : --queue->tail;
+  }
+  pthread_mutex_unlock(&queue->lock);
+
+  return task;
+}
+
+static void *work(void *argument) {
+  Worker *worker = argument;
+  Pool *pool = worker->pool;
+
+  for (;;) {
+    int task = takeTask(&pool->queues[worker->index], true);
+
+    // Tasks are never added, so once every queue is empty the work is done
+    for (int k = 1; task == -1 && k < pool->threadCount; k++) {
+      int victim = (worker->index + k) % pool->threadCount;
+      task = takeTask(&pool->queues[victim], false);
+    }
+    if (task == -1) {
+      return NULL;
+    }
+
+    pool->run(pool->context, task, worker->index);
+  }
+}
+
+void runTasks(int threadCount, int taskCount, TaskFunction run,
+              void *context) {
+  if (threadCount > taskCount) {
+    threadCount = taskCount > 0 ? taskCount : 1;
+  }
+
+  Pool pool = {NULL, threadCount, run, context};
+  pool.queues = malloc(threadCount * sizeof(TaskQueue));
+  Worker *workers = malloc(threadCount * sizeof(Worker));
+  pthread_t *threads = malloc(threadCount * sizeof(pthread_t));
+  if (!pool.queues || !workers || !threads) {
+    perror("Failed to allocate thread pool");
+    exit(1);
+  }
+
+  for (int i = 0; i < threadCount; i++) {
+    pthread_mutex_init(&pool.queues[i].lock, NULL);
+    pool.queues[i].head = (int)((long long)taskCount * i / threadCount);
+    pool.queues[i].tail = (int)((long long)taskCount * (i + 1) / threadCount);
+    workers[i] = (Worker){&pool, i};
+  }
+
+  for (int i = 0; i < threadCount; i++) {
+    if (pthread_create(&threads[i], NULL, work, &workers[i]) != 0) {
+      perror("Failed to start worker thread");
+      exit(1);
+    }
+  }
+
+  // Others may still steal from a queue whose owner is done
+  for (int i = 0; i < threadCount; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  for (int i = 0; i < threadCount; i++) {
+    pthread_mutex_destroy(&pool.queues[i].lock);
+  }
+
+  free(threads);
+  free(workers);
+  free(pool.queues);
+}
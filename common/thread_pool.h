@@ -0,0 +1,26 @@
+// Work-stealing thread pool: a fixed set of tasks shared out between
+// threads, each taking its own in order and stealing from the others once
+// its queue runs dry
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Run one task; context is the pointer given to runTasks, and thread the
+// index of the thread running it, from 0 on, for state kept per thread
+typedef void (*TaskFunction)(void *context, int task, int thread);
+
+/**
+ * Run tasks 0 to taskCount - 1 on threads of their own and wait for all of
+ * them. Each thread starts with a contiguous share of the tasks, and the
+ * calling thread runs none, so its thread-local state stays untouched.
+ *
+ * @param threadCount Number of threads, at least 1; no more are started
+ * than there are tasks.
+ * @param taskCount Number of tasks.
+ * @param run Called once per task, from any of the threads.
+ * @param context Passed to every call of run.
+ */
+void runTasks(int threadCount, int taskCount, TaskFunction run,
+              void *context);
+
+#endif
@@ -1,18 +1,17 @@
 #include "token.h"
-#include "../common/string.h"
-#include <stdio.h>
-#include <stdlib.h>
+#include "../common/intern.h"
+#include "../common/line_index.h"
+#include "../common/trace.h"
 
 //> make-token
-Token makeToken(TokenType type, char *start, int length, int line) {
+Token makeToken(TokenType type, char *start, int length, uint32_t offset) {
   Token token;
   token.type = type;
   token.start = start;
   token.length = length;
-  token.line = line;
-  token.lexeme = malloc(length + 1);
-  _strncpy(token.lexeme, start, length);
-  token.lexeme[length] = '\0';
+  token.offset = offset;
+  token.lexeme = internString(start, length);
+  token.keyword = KEYWORD_NONE;
 
   return token;
 }
@@ -20,24 +19,12 @@ Token makeToken(TokenType type, char *start, int length, int line) {
 
 //> print-token
 void printToken(Token *token) {
-  printf("Token Line   : %d\n", token->line);
-  printf("Token Type   : %d\n", token->type);
-  printf("Lexeme Size  : %d\n", token->length);
-  printf("Token Lexeme : %s\n", token->lexeme);
+  traceFormat("Token Line   : %d\nToken Type   : %d\nLexeme Size  : %d\n"
+              "Token Lexeme : %s\n",
+              lineOf(token->offset), token->type, token->length,
+              token->lexeme);
 }
 //< print-token
 
-char *getTokenLexeme(Token *token) {
-  char *lexeme = (char *)malloc(token->length + 1);
-
-  if (!lexeme) {
-    printf("Memory allocation failed\n");
-    return NULL;
-  }
-
-  _strncpy(lexeme, token->lexeme, token->length);
-
-  lexeme[token->length] = '\0';
-
-  return lexeme;
-}
\ No newline at end of file
+// Interned lexemes are shared, so callers must not free the result
+const char *getTokenLexeme(Token *token) { return token->lexeme; }
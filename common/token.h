@@ -1,6 +1,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <stdint.h>
+
 typedef enum {
   TOKEN_ADD = 0,
   TOKEN_SUB = 1,
@@ -29,16 +31,39 @@ typedef enum {
   TOKEN_DOLLAR = 24
 } TokenType;
 
+// Which keyword a TOKEN_KEYWORD is, so the parser can dispatch on an enum
+typedef enum {
+  KEYWORD_NONE = 0,
+  KEYWORD_OR,
+  KEYWORD_AND,
+  KEYWORD_NOT,
+  KEYWORD_IF,
+  KEYWORD_THEN,
+  KEYWORD_ELSE,
+  KEYWORD_FI,
+  KEYWORD_WHILE,
+  KEYWORD_DO,
+  KEYWORD_OD,
+  KEYWORD_DEF,
+  KEYWORD_FED,
+  KEYWORD_RETURN,
+  KEYWORD_PRINT,
+  KEYWORD_INT,
+  KEYWORD_DOUBLE
+} KeywordType;
+
 typedef struct {
   TokenType type;
-  char *start; // Start of lexeme
+  char *start; // Start of lexeme, pointing straight into the input
   int length;  // Size of lexeme
-  int line;
-  char *lexeme;
+  uint32_t offset; // Of the lexeme in the input, for its line and column
+  const char *lexeme; // Interned, so equal lexemes share one pointer
+  KeywordType keyword; // KEYWORD_NONE unless type is TOKEN_KEYWORD
 } Token;
 
-Token makeToken(TokenType type, char *start, int length, int line);
+Token makeToken(TokenType type, char *start, int length, uint32_t offset);
+// Write a token to the trace, whatever is enabled
 void printToken(Token *token);
-char *getTokenLexeme(Token *token);
+const char *getTokenLexeme(Token *token);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "token_stream.h"
+#include "arena.h"
+
+// Most tokens span a few characters plus whitespace, so one token per four
+// input bytes rarely needs to grow
+#define BYTES_PER_TOKEN 4
+#define MIN_TOKEN_CAPACITY 64
+
+// The arrays live in the lexer arena and are released with it
+static void *growArray(void *array, int oldCapacity, int capacity,
+                       size_t elementSize) {
+  return arenaGrow(lexerArena, array, oldCapacity * elementSize,
+                   capacity * elementSize);
+}
+
+static void reserveTokens(TokenStream *stream, int capacity) {
+  int old = stream->capacity;
+
+  stream->types = growArray(stream->types, old, capacity, sizeof(uint8_t));
+  stream->keywords =
+      growArray(stream->keywords, old, capacity, sizeof(uint8_t));
+  stream->offsets =
+      growArray(stream->offsets, old, capacity, sizeof(uint32_t));
+  stream->lengths =
+      growArray(stream->lengths, old, capacity, sizeof(uint32_t));
+  stream->lexemes = growArray(stream->lexemes, old, capacity, sizeof(char *));
+  stream->capacity = capacity;
+}
+
+void initTokenStream(TokenStream *stream, char *input, size_t inputLength) {
+  stream->types = NULL;
+  stream->keywords = NULL;
+  stream->offsets = NULL;
+  stream->lengths = NULL;
+  stream->lexemes = NULL;
+  stream->count = 0;
+  stream->capacity = 0;
+  stream->input = input;
+
+  size_t capacity = inputLength / BYTES_PER_TOKEN + MIN_TOKEN_CAPACITY;
+  reserveTokens(stream, (int)capacity);
+}
+
+void pushToken(TokenStream *stream, Token token) {
+  if (stream->count == stream->capacity) {
+    reserveTokens(stream, stream->capacity * 2);
+  }
+
+  int index = stream->count++;
+  stream->types[index] = (uint8_t)token.type;
+  stream->keywords[index] = (uint8_t)token.keyword;
+  stream->offsets[index] = token.offset;
+  stream->lengths[index] = (uint32_t)token.length;
+  stream->lexemes[index] = token.lexeme;
+}
+
+Token tokenAt(const TokenStream *stream, int index) {
+  Token token;
+  token.type = (TokenType)stream->types[index];
+  token.keyword = (KeywordType)stream->keywords[index];
+  token.start = stream->input + stream->offsets[index];
+  token.offset = stream->offsets[index];
+  token.length = (int)stream->lengths[index];
+  token.lexeme = stream->lexemes[index];
+
+  return token;
+}
+
+void freeTokenStream(TokenStream *stream) {
+  // The arrays themselves go when the lexer arena is released
+  stream->types = NULL;
+  stream->keywords = NULL;
+  stream->offsets = NULL;
+  stream->lengths = NULL;
+  stream->lexemes = NULL;
+  stream->count = 0;
+  stream->capacity = 0;
+}
@@ -0,0 +1,51 @@
+// Growable token stream shared by the lexer, parser and code generator
+
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include "token.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Struct-of-arrays layout: the parser mostly scans types, so each field gets
+// its own array and a type check touches one byte per token
+typedef struct {
+  uint8_t *types;       // TokenType
+  uint8_t *keywords;    // KeywordType
+  uint32_t *offsets;    // Byte offset of the lexeme in the input
+  uint32_t *lengths;    // Size of lexeme
+  const char **lexemes; // Interned lexemes
+  int count;
+  int capacity;
+  char *input; // Base that offsets are relative to
+} TokenStream;
+
+/**
+ * Prepare an empty stream, sized from the input length up front.
+ *
+ * @param stream The stream to initialize.
+ * @param input The input that token lexemes point into.
+ * @param inputLength Number of bytes in the input.
+ */
+void initTokenStream(TokenStream *stream, char *input, size_t inputLength);
+
+/**
+ * Append a token, growing the stream when it is full.
+ *
+ * @param stream The stream to append to.
+ * @param token The token, whose start must point into the stream input.
+ */
+void pushToken(TokenStream *stream, Token token);
+
+/**
+ * Gather the fields of one token back into a Token.
+ *
+ * @param stream The stream to read from.
+ * @param index Index of the token, from 0 to count - 1.
+ * @return The token at that index.
+ */
+Token tokenAt(const TokenStream *stream, int index);
+
+void freeTokenStream(TokenStream *stream);
+
+#endif
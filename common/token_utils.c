@@ -1,14 +1,37 @@
 #include "token_utils.h"
-#include "../common/string.h"
-#include <stdio.h>
+#include "../common/error_state.h"
+#include "../common/keyword.h"
+#include "../common/trace.h"
 
-Token *look_ahead = NULL;
+_Thread_local Token *look_ahead = NULL;
+_Thread_local TokenCursor *tokenCursor = NULL;
+
+// Get the token at an index no older than the window
+static Token fetchToken(int index) {
+  TokenCursor *cursor = tokenCursor;
+
+  if (cursor->stream) {
+    return tokenAt(cursor->stream, index);
+  }
+
+  while (cursor->pulledCount <= index) {
+    cursor->window[cursor->pulledCount & (TOKEN_WINDOW - 1)] =
+        cursor->source.pull();
+    cursor->pulledCount++;
+  }
+
+  return cursor->window[index & (TOKEN_WINDOW - 1)];
+}
+
+void useTokenCursor(TokenCursor *cursor) {
+  tokenCursor = cursor;
+  look_ahead = &cursor->current;
+}
 
 bool isAtEnd() { return look_ahead->type == TOKEN_DOLLAR; }
 
-bool isKeyword(const char *keyword, int length) {
-  return look_ahead->type == TOKEN_KEYWORD &&
-         _strncmp(look_ahead->lexeme, keyword, length) == 0;
+bool isKeyword(KeywordType keyword) {
+  return look_ahead->type == TOKEN_KEYWORD && look_ahead->keyword == keyword;
 }
 
 bool isComparison(TokenType type) {
@@ -20,46 +43,88 @@ bool isNumber(TokenType type) {
   return type == TOKEN_INT || type == TOKEN_DOUBLE;
 }
 
+void initTokenCursor(const TokenStream *stream) {
+  initTokenCursorAt(stream, 0);
+}
+
+void initTokenCursorAt(const TokenStream *stream, int index) {
+  tokenCursor->stream = stream;
+  tokenCursor->position = index;
+  tokenCursor->current = fetchToken(tokenCursor->position);
+  look_ahead = &tokenCursor->current;
+}
+
+void initTokenCursorFromSource(TokenSource source) {
+  tokenCursor->stream = NULL;
+  tokenCursor->source = source;
+  tokenCursor->pulledCount = 0;
+  tokenCursor->position = 0;
+  tokenCursor->current = fetchToken(tokenCursor->position);
+  look_ahead = &tokenCursor->current;
+}
+
 void advanceToken() {
   if (look_ahead->type != TOKEN_DOLLAR) {
-    look_ahead++;
+    tokenCursor->position++;
+    tokenCursor->current = fetchToken(tokenCursor->position);
   }
 }
 
-Token *previousToken() { return look_ahead - 1; }
+Token *previousToken() {
+  if (tokenCursor->position == 0) {
+    return NULL;
+  }
 
-Token *nextToken() { return look_ahead + 1; }
+  tokenCursor->adjacent = fetchToken(tokenCursor->position - 1);
+  return &tokenCursor->adjacent;
+}
 
-bool matchType(TokenType expectedType) {
-  puts("================");
-  puts("Look-ahead Token");
-  puts("================");
+Token *nextToken() {
+  if (look_ahead->type == TOKEN_DOLLAR) {
+    return NULL;
+  }
+
+  tokenCursor->adjacent = fetchToken(tokenCursor->position + 1);
+  return &tokenCursor->adjacent;
+}
+
+static void traceLookAhead() {
+  traceFormat("================\nLook-ahead Token\n================\n");
   printToken(look_ahead);
+}
 
+bool matchType(TokenType expectedType) {
   if (look_ahead->type != expectedType) {
-    puts("==> Incorrect Type");
-    printf("==> Expected Type is %d\n\n", expectedType);
+    if (isTraced(TRACE_PARSER, TRACE_TOKEN)) {
+      traceLookAhead();
+      traceFormat("==> Incorrect Type\n==> Expected Type is %d\n\n",
+                  expectedType);
+    }
     return false;
   }
 
-  puts("==> Correct Type\n");
+  if (isTraced(TRACE_PARSER, TRACE_TOKEN)) {
+    traceLookAhead();
+    traceFormat("==> Correct Type\n\n");
+  }
   advanceToken();
   return true;
 }
 
-bool matchKeyword(const char *expectedKeyword) {
-  puts("================");
-  puts("Look-ahead Token");
-  puts("================");
-  printToken(look_ahead);
-
-  if (_strcmp(look_ahead->lexeme, expectedKeyword) != 0) {
-    puts("==>  Incorrect Keyword");
-    printf("==> Expected Keyword is %s\n\n", expectedKeyword);
+bool matchKeyword(KeywordType expectedKeyword) {
+  if (!isKeyword(expectedKeyword)) {
+    if (isTraced(TRACE_PARSER, TRACE_TOKEN)) {
+      traceLookAhead();
+      traceFormat("==>  Incorrect Keyword\n==> Expected Keyword is %s\n\n",
+                  keywordToString(expectedKeyword));
+    }
     return false;
   }
 
-  puts("==>  Correct Keyword\n");
+  if (isTraced(TRACE_PARSER, TRACE_TOKEN)) {
+    traceLookAhead();
+    traceFormat("==>  Correct Keyword\n\n");
+  }
   advanceToken();
   return true;
 }
\ No newline at end of file
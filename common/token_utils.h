@@ -4,26 +4,58 @@
 #define TOKEN_UTILS_H
 
 #include "token.h"
+#include "token_stream.h"
 #include <stdbool.h>
 
-// Global variables
-extern Token *look_ahead;
+// Pulls tokens on demand, for parsing without materializing a token stream
+typedef struct {
+  Token (*pull)(); // Next token, then TOKEN_DOLLAR once input is over
+} TokenSource;
+
+// The parser never looks further than one token back or ahead, so a source
+// only has to keep a window of the most recent tokens. Power of two.
+#define TOKEN_WINDOW 4
+
+// Tokens come from either a whole stream or a source; the look-ahead is
+// gathered from position. One cursor per compiler context.
+typedef struct {
+  const TokenStream *stream;
+  TokenSource source;
+  Token window[TOKEN_WINDOW];
+  int pulledCount; // Tokens pulled so far
+  int position;
+  Token current; // What look_ahead points at
+  Token adjacent;
+} TokenCursor;
+
+// Cursor of the context bound to this thread, and its look-ahead token
+extern _Thread_local TokenCursor *tokenCursor;
+extern _Thread_local Token *look_ahead;
+
+// Bind a cursor to this thread, look_ahead included
+void useTokenCursor(TokenCursor *cursor);
 
 // Helper functions
 bool isAtEnd();
 
 // Classification
-bool isKeyword(const char *keyword, int length);
+bool isKeyword(KeywordType keyword);
 bool isComparison(TokenType type);
 bool isNumber(TokenType type);
 
 // Navigation
+// Point look_ahead at the first token of the stream
+void initTokenCursor(const TokenStream *stream);
+// Or at any token of it, to parse one part of the program
+void initTokenCursorAt(const TokenStream *stream, int index);
+// Pull tokens from the source through a small ring buffer instead
+void initTokenCursorFromSource(TokenSource source);
 void advanceToken();
 Token *previousToken();
 Token *nextToken();
 
 // Matching
 bool matchType(TokenType expectedType);
-bool matchKeyword(const char *expectedKeyword);
+bool matchKeyword(KeywordType expectedKeyword);
 
 #endif // TOKEN_UTILS
\ No newline at end of file
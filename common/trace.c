@@ -0,0 +1,141 @@
+#include "trace.h"
+#include "string.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+_Thread_local TraceState *tracing = NULL;
+
+static const struct {
+  const char *name;
+  TraceCategory category;
+} categoryNames[] = {
+    {"parser", TRACE_PARSER}, {"semantic", TRACE_SEMANTIC},
+    {"codegen", TRACE_CODEGEN}, {"files", TRACE_FILES},
+    {"opt", TRACE_OPT},         {"all", TRACE_ALL},
+};
+
+void initTrace(TraceState *state) {
+  state->categories = 0;
+  state->level = TRACE_MAX_LEVEL;
+  state->buffer = NULL;
+  state->bufferIndex = 0;
+}
+
+void flushTrace(TraceState *state) {
+  if (state->bufferIndex > 0) {
+    fwrite(state->buffer, 1, state->bufferIndex, stdout);
+    state->bufferIndex = 0;
+  }
+}
+
+void freeTrace(TraceState *state) {
+  flushTrace(state);
+  free(state->buffer);
+  state->buffer = NULL;
+}
+
+// Most contexts never trace, so their buffer comes with the first trace
+static void reserveBuffer() {
+  if (!tracing->buffer) {
+    tracing->buffer = malloc(TRACE_BUFFER_SIZE);
+    if (!tracing->buffer) {
+      perror("Failed to allocate trace");
+      exit(1);
+    }
+  }
+}
+
+void traceText(const char *text, size_t length) {
+  reserveBuffer();
+  if (tracing->bufferIndex + length > TRACE_BUFFER_SIZE) {
+    flushTrace(tracing);
+  }
+
+  // Too long for the buffer, it goes straight out
+  if (length > TRACE_BUFFER_SIZE) {
+    fwrite(text, 1, length, stdout);
+    return;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    tracing->buffer[tracing->bufferIndex + i] = text[i];
+  }
+  tracing->bufferIndex += length;
+}
+
+void traceFormat(const char *format, ...) {
+  reserveBuffer();
+  size_t left = TRACE_BUFFER_SIZE - tracing->bufferIndex;
+  va_list arguments;
+
+  va_start(arguments, format);
+  int length = vsnprintf(tracing->buffer + tracing->bufferIndex, left,
+                         format, arguments);
+  va_end(arguments);
+
+  if (length < 0) {
+    return;
+  }
+
+  // Did not fit: flush and format again, or on the heap if it never would
+  if ((size_t)length >= left) {
+    flushTrace(tracing);
+
+    char *text = tracing->buffer;
+    if ((size_t)length >= TRACE_BUFFER_SIZE) {
+      text = malloc(length + 1);
+      if (!text) {
+        perror("Failed to allocate trace");
+        exit(1);
+      }
+    }
+
+    va_start(arguments, format);
+    vsnprintf(text, length + 1, format, arguments);
+    va_end(arguments);
+
+    if (text != tracing->buffer) {
+      fwrite(text, 1, length, stdout);
+      free(text);
+      return;
+    }
+  }
+
+  tracing->bufferIndex += length;
+}
+
+bool parseTraceSpec(const char *spec, unsigned int *categories, int *level) {
+  *categories = 0;
+  *level = TRACE_MAX_LEVEL;
+
+  while (*spec && *spec != ':') {
+    int length = 0;
+    while (spec[length] && spec[length] != ',' && spec[length] != ':') {
+      length++;
+    }
+
+    int c = 0;
+    int count = sizeof(categoryNames) / sizeof(categoryNames[0]);
+    while (c < count &&
+           (_strlen(categoryNames[c].name) != length ||
+            _strncmp((char *)spec, categoryNames[c].name, length) != 0)) {
+      c++;
+    }
+    if (c == count) {
+      return false;
+    }
+
+    *categories |= categoryNames[c].category;
+    spec += spec[length] == ',' ? length + 1 : length;
+  }
+
+  if (*spec == ':') {
+    *level = atoi(spec + 1);
+    if (*level < TRACE_PHASE || *level > TRACE_TOKEN) {
+      return false;
+    }
+  }
+
+  return *categories != 0;
+}
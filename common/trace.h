@@ -0,0 +1,82 @@
+// Tracing: what the compiler does, rule by rule and token by token, written
+// to stdout through a buffer when asked for. Every trace has a category, the
+// part of the compiler it comes from, and a level, how fine grained it is;
+// none is enabled by default, and levels above TRACE_MAX_LEVEL are compiled
+// out altogether.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Levels, from the coarsest
+#define TRACE_PHASE 1 // Phases starting and ending, files written
+#define TRACE_RULE 2  // Grammar rules parsed and lowered, scopes
+#define TRACE_TOKEN 3 // Every token matched
+
+// Build with -DTRACE_MAX_LEVEL=0 to leave every trace out
+#ifndef TRACE_MAX_LEVEL
+#define TRACE_MAX_LEVEL TRACE_TOKEN
+#endif
+
+#define TRACE_BUFFER_SIZE 65536
+
+typedef enum {
+  TRACE_PARSER = 1 << 0,   // Parsing, token matching
+  TRACE_SEMANTIC = 1 << 1, // Scopes and their symbols
+  TRACE_CODEGEN = 1 << 2,  // Lowering to three-address code
+  TRACE_FILES = 1 << 3,    // Every file written, with its content
+  TRACE_OPT = 1 << 4,      // Optimization passes, round by round
+  TRACE_ALL = (1 << 5) - 1,
+} TraceCategory;
+
+// Tracing of one compiler context
+typedef struct {
+  unsigned int categories; // Enabled, none by default
+  int level;               // Finest level written
+  char *buffer; // TRACE_BUFFER_SIZE bytes, allocated on the first trace
+  size_t bufferIndex;
+} TraceState;
+
+// Tracing of the context bound to this thread
+extern _Thread_local TraceState *tracing;
+
+// Whether traces of a category and level are written
+#define isTraced(category, lvl)                                              \
+  ((lvl) <= TRACE_MAX_LEVEL && tracing->level >= (lvl) &&                    \
+   (tracing->categories & (category)))
+
+// Write a trace, formatted as printf does, if its category and level are
+// enabled; the arguments are not evaluated otherwise
+#define trace(category, lvl, ...)                                            \
+  do {                                                                       \
+    if (isTraced(category, lvl)) {                                           \
+      traceFormat(__VA_ARGS__);                                              \
+    }                                                                        \
+  } while (0)
+
+// Set a state up with tracing off
+void initTrace(TraceState *state);
+
+// Append to the bound context's trace, without checking what is enabled
+void traceFormat(const char *format, ...);
+void traceText(const char *text, size_t length);
+
+// Write what a trace holds to stdout, so it comes before what follows there
+void flushTrace(TraceState *state);
+// Flush, then free the buffer until the next trace
+void freeTrace(TraceState *state);
+
+/**
+ * Read what to trace from the command line: categories separated by commas,
+ * or all, then optionally a colon and the finest level, 1 to 3.
+ *
+ * @param spec Such as "parser,semantic:2".
+ * @param categories Gets the categories.
+ * @param level Gets the level, the finest compiled in if not given.
+ * @return Whether spec is well formed.
+ */
+bool parseTraceSpec(const char *spec, unsigned int *categories, int *level);
+
+#endif
@@ -0,0 +1,251 @@
+#include "batch.h"
+#include "../common/file_utils.h"
+#include "../common/string.h"
+#include "../common/thread_pool.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+typedef struct {
+  const SourceList *sources;
+  BatchSummary *summary;
+  CompilerContext *contexts; // By thread
+  FileCompiler compile;
+  const void *options;
+} Batch;
+
+static void *allocate(size_t size) {
+  void *memory = malloc(size > 0 ? size : 1);
+  if (!memory) {
+    perror("Failed to allocate batch");
+    exit(1);
+  }
+
+  return memory;
+}
+
+static char *joinPath(const char *directory, const char *name) {
+  size_t length = _strlen(directory) + _strlen(name) + 2;
+  char *path = allocate(length);
+  snprintf(path, length, "%s/%s", directory, name);
+  return path;
+}
+
+//> Sources
+static void addPath(SourceList *sources, char *path) {
+  if (sources->count == sources->capacity) {
+    sources->capacity = sources->capacity ? sources->capacity * 2 : 16;
+    sources->paths =
+        realloc(sources->paths, sources->capacity * sizeof(char *));
+    if (!sources->paths) {
+      perror("Failed to allocate batch");
+      exit(1);
+    }
+  }
+
+  sources->paths[sources->count++] = path;
+}
+
+static bool isSourceName(const char *name) {
+  size_t length = _strlen(name);
+  return length > 3 && _strcmp(name + length - 3, ".cp") == 0;
+}
+
+static int comparePaths(const void *a, const void *b) {
+  return _strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void addDirectory(SourceList *sources, const char *directory) {
+  DIR *stream = opendir(directory);
+  if (!stream) {
+    perror(directory);
+    return;
+  }
+
+  int first = sources->count;
+  struct dirent *entry;
+  while ((entry = readdir(stream))) {
+    // Hidden entries, and . and .. with them
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    char *path = joinPath(directory, entry->d_name);
+    struct stat status;
+    if (stat(path, &status) == 0 && S_ISDIR(status.st_mode)) {
+      addDirectory(sources, path);
+      free(path);
+    } else if (isSourceName(entry->d_name)) {
+      addPath(sources, path);
+    } else {
+      free(path);
+    }
+  }
+  closedir(stream);
+
+  // Directory order depends on the file system
+  qsort(sources->paths + first, sources->count - first, sizeof(char *),
+        comparePaths);
+}
+
+bool addSources(SourceList *sources, const char *input) {
+  struct stat status;
+  if (stat(input, &status) == 0 && S_ISDIR(status.st_mode)) {
+    addDirectory(sources, input);
+    return true;
+  }
+
+  size_t length = _strlen(input) + 1;
+  char *path = allocate(length);
+  _strncpy(path, input, length);
+  addPath(sources, path);
+  return false;
+}
+
+void freeSources(SourceList *sources) {
+  for (int i = 0; i < sources->count; i++) {
+    free(sources->paths[i]);
+  }
+  free(sources->paths);
+  *sources = (SourceList){0};
+}
+//< Sources
+
+//> Output Directories
+typedef struct {
+  const char *name; // File name without directory and extension
+  int length;
+  int file;
+} OutputName;
+
+static OutputName outputName(const char *path, int file) {
+  const char *name = path;
+  for (const char *c = path; *c; c++) {
+    if (*c == '/' && c[1]) {
+      name = c + 1;
+    }
+  }
+
+  int length = 0;
+  while (name[length] && name[length] != '/') {
+    length++;
+  }
+  if (length > 3 && _strncmp((char *)name + length - 3, ".cp", 3) == 0) {
+    length -= 3;
+  }
+
+  return (OutputName){name, length, file};
+}
+
+static int compareNames(const void *a, const void *b) {
+  const OutputName *first = a;
+  const OutputName *second = b;
+  int shorter = first->length < second->length ? first->length
+                                                : second->length;
+  int order = _strncmp((char *)first->name, (char *)second->name, shorter);
+
+  if (order == 0) {
+    order = first->length - second->length;
+  }
+  return order != 0 ? order : first->file - second->file;
+}
+
+// Sorted by name then by file, so the files of one name are numbered in
+// the order given
+static void nameOutputDirs(const SourceList *sources, const char *directory,
+                           char **outputDirs) {
+  OutputName *names = allocate(sources->count * sizeof(OutputName));
+  for (int f = 0; f < sources->count; f++) {
+    names[f] = outputName(sources->paths[f], f);
+  }
+  qsort(names, sources->count, sizeof(OutputName), compareNames);
+
+  int same = 0;
+  for (int i = 0; i < sources->count; i++) {
+    const OutputName *name = &names[i];
+    bool isRepeated =
+        i > 0 && name->length == names[i - 1].length &&
+        _strncmp((char *)name->name, (char *)names[i - 1].name,
+                 name->length) == 0;
+    same = isRepeated ? same + 1 : 0;
+
+    char suffix[16] = "";
+    if (same > 0) {
+      snprintf(suffix, sizeof(suffix), "-%d", same + 1);
+    }
+
+    size_t length = _strlen(directory) + name->length + sizeof(suffix) + 2;
+    outputDirs[name->file] = allocate(length);
+    snprintf(outputDirs[name->file], length, "%s/%.*s%s", directory,
+             name->length, name->name, suffix);
+  }
+
+  free(names);
+}
+//< Output Directories
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// One task of the pool: compile file f in the thread's context
+static void compileOne(void *context, int f, int thread) {
+  Batch *batch = context;
+  BatchSummary *summary = batch->summary;
+  CompilerContext *compiler = &batch->contexts[thread];
+
+  compiler->outputDirectory = summary->outputDirs[f];
+  summary->isCompiled[f] =
+      makeOutputDirectory(summary->outputDirs[f]) &&
+      batch->compile(compiler, batch->sources->paths[f], batch->options);
+}
+
+BatchSummary compileBatch(const SourceList *sources,
+                          const char *outputDirectory, int threadCount,
+                          FileCompiler compile, const void *options) {
+  BatchSummary summary = {sources->count, 0, 0, NULL, NULL};
+  summary.isCompiled = allocate(sources->count * sizeof(bool));
+  summary.outputDirs = allocate(sources->count * sizeof(char *));
+  nameOutputDirs(sources, outputDirectory, summary.outputDirs);
+
+  threadCount = threadCount > 0 ? threadCount : 1;
+  Batch batch = {sources, &summary, NULL, compile, options};
+  batch.contexts = allocate(threadCount * sizeof(CompilerContext));
+  for (int t = 0; t < threadCount; t++) {
+    initContext(&batch.contexts[t]);
+  }
+
+  double start = now();
+  if (makeOutputDirectory(outputDirectory) && sources->count > 0) {
+    runTasks(threadCount, sources->count, compileOne, &batch);
+  } else {
+    for (int f = 0; f < sources->count; f++) {
+      summary.isCompiled[f] = false;
+    }
+  }
+  summary.seconds = now() - start;
+
+  for (int t = 0; t < threadCount; t++) {
+    resetContext(&batch.contexts[t]);
+  }
+  free(batch.contexts);
+
+  for (int f = 0; f < sources->count; f++) {
+    summary.failedCount += !summary.isCompiled[f];
+  }
+
+  return summary;
+}
+
+void freeBatchSummary(BatchSummary *summary) {
+  for (int f = 0; f < summary->fileCount; f++) {
+    free(summary->outputDirs[f]);
+  }
+  free(summary->outputDirs);
+  free(summary->isCompiled);
+  *summary = (BatchSummary){0};
+}
@@ -0,0 +1,60 @@
+// Batch compile: many source files compiled at once on a thread pool, with
+// one compiler context per thread, reused from one file to the next, and a
+// directory of its own for the files each source writes
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "compiler.h"
+#include <stdbool.h>
+
+// The source files of a batch, in the order they are compiled
+typedef struct {
+  char **paths;
+  int count;
+  int capacity;
+} SourceList;
+
+// Compile one file in a context whose output directory is already set,
+// as the command line does; options is the pointer given to compileBatch
+typedef bool (*FileCompiler)(CompilerContext *context, const char *path,
+                             const void *options);
+
+typedef struct {
+  int fileCount;
+  int failedCount;
+  double seconds;    // Wall time of the whole batch
+  bool *isCompiled;  // By file
+  char **outputDirs; // By file, where its files went
+} BatchSummary;
+
+/**
+ * Add an input to the batch: a file as it is, or every .cp file under a
+ * directory, in name order, leaving out hidden entries.
+ *
+ * @param sources The list to add to.
+ * @param input Path of a file or directory.
+ * @return Whether the input was a directory.
+ */
+bool addSources(SourceList *sources, const char *input);
+void freeSources(SourceList *sources);
+
+/**
+ * Compile every file of a batch on a thread pool. Each file writes to a
+ * directory named after it, without its extension, under the output
+ * directory; files of the same name get -2, -3 and on in the order given.
+ * Traces come out a buffer at a time, whole but interleaved.
+ *
+ * @param sources The files to compile.
+ * @param outputDirectory Created if missing.
+ * @param threadCount Number of files compiled at once.
+ * @param compile Called for every file, from any of the threads.
+ * @param options Passed to every call of compile.
+ * @return What was compiled; release it with freeBatchSummary.
+ */
+BatchSummary compileBatch(const SourceList *sources,
+                          const char *outputDirectory, int threadCount,
+                          FileCompiler compile, const void *options);
+void freeBatchSummary(BatchSummary *summary);
+
+#endif
@@ -0,0 +1,92 @@
+#include "compiler.h"
+#include "../common/file_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void useContext(CompilerContext *context) {
+  usePhaseArenas(&context->arenas);
+  useTokenCursor(&context->cursor);
+  errorState = &context->errors;
+  diagnostics = &context->diagnostics;
+  tracing = &context->trace;
+  interned = &context->intern;
+  lexing = &context->lexer;
+  lineIndex = &context->lines;
+  parsing = &context->parser;
+  semantic = &context->semantic;
+  ast = &context->ast;
+  codegen = &context->codegen;
+  ir = &context->ir;
+  outputDirectory = context->outputDirectory;
+}
+
+// Every phase starts out empty, with nothing allocated
+static void clearPhases(CompilerContext *context) {
+  context->errors.hasError = false;
+  context->diagnostics = (DiagnosticLog){0};
+  context->intern = (InternTable){0};
+  context->lexer.lexer = (Lexer){0};
+  context->lexer.tokenStream = (TokenStream){0};
+  initLineIndex(&context->lines, NULL, 0);
+  context->cursor = (TokenCursor){0};
+  context->parser.symbolTableBufferIndex = 0;
+  initSemanticState(&context->semantic);
+  context->ast = (AstPool){0};
+  context->codegen = (CodegenState){0};
+  context->ir = (IrProgram){0};
+  context->ir.entry = -1;
+  context->ir.currentFunction = -1;
+}
+
+void initContext(CompilerContext *context) {
+  initPhaseArenas(&context->arenas);
+  context->errors.isQuiet = false;
+  initTrace(&context->trace);
+  context->outputDirectory = NULL;
+  clearPhases(context);
+}
+
+void resetContext(CompilerContext *context) {
+  freeTrace(&context->trace);
+
+  // A mapped input is not in an arena, nor is the line index
+  releaseInput(&context->lexer.lexer.db);
+  freeLineIndex(&context->lines);
+  releasePhaseArenas(&context->arenas);
+  clearPhases(context);
+}
+
+CompilerContext *createContext() {
+  CompilerContext *context = malloc(sizeof(CompilerContext));
+  if (!context) {
+    perror("Failed to allocate compiler context");
+    exit(1);
+  }
+
+  initContext(context);
+  return context;
+}
+
+void destroyContext(CompilerContext *context) {
+  resetContext(context);
+  free(context);
+}
+
+bool compile_buffer(CompilerContext *context, const char *source,
+                    size_t length) {
+  resetContext(context);
+
+  initTokenCursor(lexicalAnalysisOfBuffer(context, source, length));
+  AstIndex program = Parse(context);
+
+  if (!context->errors.hasError) {
+    CodeGen(context, program);
+  }
+
+  // Code generation errors are reported at offsets in the input
+  freeLexerInput();
+
+  writeDiagnostics();
+  flushTrace(&context->trace);
+  return !context->errors.hasError;
+}
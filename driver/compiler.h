@@ -0,0 +1,80 @@
+// Compiler context: everything one compile works on, from the input to the
+// generated code. A process can run any number of compiles one after the
+// other in a context, and compile on several threads at once with one
+// context per thread, as nothing is shared between contexts.
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "../codegen/codegen.h"
+#include "../codegen/ir.h"
+#include "../common/arena.h"
+#include "../common/context.h"
+#include "../common/diagnostics.h"
+#include "../common/error_state.h"
+#include "../common/intern.h"
+#include "../common/line_index.h"
+#include "../common/token_utils.h"
+#include "../common/trace.h"
+#include "../lexer/lexer.h"
+#include "../parser/ast.h"
+#include "../parser/parser.h"
+#include "../semantic/semantic.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+struct CompilerContext {
+  PhaseArenas arenas;
+  ErrorState errors;
+  DiagnosticLog diagnostics; // Written when a compile ends
+  TraceState trace; // Flushed when a compile ends
+  InternTable intern;
+  LexerState lexer;
+  LineIndex lines; // Of the lexer's input, built when a position is asked
+  TokenCursor cursor;
+  ParserState parser;
+  SemanticState semantic;
+  AstPool ast;
+  CodegenState codegen;
+  IrProgram ir; // The generated code, until the next compile
+
+  // Directory the compiler's files are written to, NULL to write none;
+  // read when the context is bound
+  const char *outputDirectory;
+};
+
+/**
+ * Set up an empty context, which writes no files and traces nothing.
+ *
+ * @param context The context to set up.
+ */
+void initContext(CompilerContext *context);
+
+/**
+ * Release the memory of the last compile, so the context can compile again,
+ * and write out its trace. Its settings and arena counters are kept.
+ *
+ * @param context The context to reset.
+ */
+void resetContext(CompilerContext *context);
+
+// The same on the heap
+CompilerContext *createContext();
+void destroyContext(CompilerContext *context);
+
+/**
+ * Compile source held in memory to three-address code, as the compiler does
+ * a file: lexical analysis, parsing with semantic analysis, then code
+ * generation. Binds the context to the calling thread and releases the
+ * memory of its last compile first.
+ *
+ * @param context The context to compile in.
+ * @param source The program's text, which is copied.
+ * @param length Number of bytes in source.
+ * @return Whether the program compiled without errors; its code is then in
+ * context->ir.
+ */
+bool compile_buffer(CompilerContext *context, const char *source,
+                    size_t length);
+
+#endif
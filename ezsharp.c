@@ -1,56 +1,319 @@
 // To compile: gcc ezsharp.c lexer/*.c parser/*.c semantic/*.c codegen/*.c
-// common/*.c -o ezsharp
+// opt/*.c vm/*.c backend/*.c common/*.c driver/*.c -lm -pthread -o ezsharp
+// Usage: ./ezsharp [--stream] [--jobs N] [--arena-stats] [--run] [--asm file.s]
+// [-O] [--passes fold,simplify,...] [--no-fold] [--no-cse] ... [--unroll N]
+// [--analysis] [--transition-table lexer_transition.txt] [--out-dir DIR]
+// [--trace parser,semantic,codegen,files,opt | all[:level]]
+// [file.cp | directory | -] ...
+// -O runs every optimization pass, --passes only the listed ones, and
+// --no-<pass> leaves one out; the optimized code goes to optimized_code.txt.
+// The unroll pass runs N copies of a loop's body per test, none by default.
+// --analysis writes the control-flow graphs, dataflow and SSA form of the
+// final code to analysis.txt
+// --jobs compiles the function bodies on N threads, without tracing them;
+// a program with errors in its functions is compiled again sequentially.
+// Several files, or a directory, whose .cp files are all taken, make a
+// batch: --jobs then compiles N files at once, each writing its files to
+// DIR/<file name>, and a summary closes the batch.
+// The files go to --out-dir, created if missing, the current directory by
+// default; a file that cannot be written fails the compile.
+// --trace writes what the compiler does to stdout, for the categories
+// listed, down to level 1 (phases), 2 (grammar rules) or 3 (every token,
+// the default); nothing is traced without it.
+// The assembly links with: cc file.s -lm -o program
 
 //> Entry point for our compiler
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
-#include "codegen/codegen.h"
-#include "common/error_state.h"
-#include "lexer/lexer.h"
-#include "parser/parser.h"
+#include "backend/x86_64.h"
+#include "codegen/parallel.h"
+#include "common/file_utils.h"
+#include "common/string.h"
+#include "driver/batch.h"
+#include "driver/compiler.h"
+#include "opt/opt.h"
+#include "vm/vm.h"
 
-int main(int argc, const char *argv[]) {
-  // Open the file with extension ".cp"
+// What every file is compiled with, from the command line
+typedef struct {
+  const char *transitionTablePath;
+  const char *assemblyPath;
+  bool isStreaming;
+  bool showArenaStats;
+  bool isRunning;
+  bool isOptimizing;
+  bool isAnalyzing;
+  bool isBatch;
+  int jobs; // Threads for the function bodies of one file
+  unsigned int traceCategories;
+  int traceLevel;
+  bool enabledPasses[PASS_COUNT];
+} Options;
+
+// The optimizer, analysis, backend and interpreter keep global state, so
+// the files of a batch go through them one at a time
+static pthread_mutex_t backEndLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Compile one file in a context, writing to its output directory
+static bool compileFile(CompilerContext *context, const char *sourcePath,
+                        const void *settings) {
+  const Options *options = settings;
+  bool isCompiled = false; // Already lowered by the parallel front end
+  AstIndex program;
+
+  // Open the file with extension ".cp", or read from stdin with "-"
   // CorrectSyntaxTest
   // IncorrectSyntaxTest
-  int fd = open("tests/CorrectSyntax.cp", O_RDONLY);
+  int fd = _strcmp(sourcePath, "-") == 0 ? STDIN_FILENO
+                                         : open(sourcePath, O_RDONLY);
   if (fd == -1) {
     printf("Error Number % d\n", errno);
-    _exit(1);
+    return false;
   }
 
-  // Open the transition file for lexer
-  int transitionTableFd = open("lexer_transition.txt", O_RDONLY);
-  if (open("lexer_transition.txt", O_RDONLY) == -1) {
-    printf("Error Number % d\n", errno);
-    _exit(1);
+  // The transition table is compiled in, a file only overrides it
+  int transitionTableFd = -1;
+  if (options->transitionTablePath) {
+    transitionTableFd = open(options->transitionTablePath, O_RDONLY);
+    if (transitionTableFd == -1) {
+      printf("Error Number % d\n", errno);
+      close(fd);
+      return false;
+    }
   }
 
-  // Start compiling with lexical analysis
-  Token *tokens = lexicalAnalysis(&fd, &transitionTableFd);
+  int *tableFd = transitionTableFd == -1 ? NULL : &transitionTableFd;
+
+  // The context may hold the last file's compile
+  resetContext(context);
+  context->trace.categories = options->traceCategories;
+  context->trace.level = options->traceLevel;
+
+  if (options->isStreaming) {
+    // The parser pulls tokens from the lexer as it goes, so no token array
+    // is kept; the input is still mapped whole, and the syntax tree, code
+    // and interned names grow with it
+    beginLexicalAnalysis(context, &fd, tableFd);
+    initTokenCursorFromSource((TokenSource){scanToken});
+    program = Parse(context);
+    endLexicalAnalysis();
+  } else {
+    // Start compiling with lexical analysis
+    TokenStream *tokens = lexicalAnalysis(context, &fd, tableFd);
 
-  // Add end token at the end of the list
-  tokens[tokenCount++] = makeToken(TOKEN_DOLLAR, "$", 1, -1);
+    // The tokens generated by lexer is now used by parser and semantic
+    // analyser, on several threads when asked to
+    isCompiled =
+        options->jobs > 1 && compileInParallel(context, tokens, options->jobs);
+    if (!isCompiled) {
+      initTokenCursor(tokens);
+      program = Parse(context);
+    }
+  }
 
-  // The tokens generated by lexer is now used by parser and semantic analyser
-  Parse(&tokens); 
-  
   // Check if any frontend error
-  if (hasError) {
-    fprintf(stderr, "\nErrors encountered. Skipping code generation.\n");
-    _exit(1);
+  if (errorState->hasError) {
+    // A batch names the files with errors once it is done
+    if (!options->isBatch) {
+      fprintf(stderr, "\nErrors encountered. Skipping code generation.\n");
+    }
+  } else if (!isCompiled) {
+    // If got no frontend error, we generate code from the syntax tree
+    CodeGen(context, program);
+  }
+
+  // Syntax tree nodes keep their offset in the input, which code generation
+  // errors are reported at, so the input goes once code is generated
+  freeLexerInput();
+
+  writeDiagnostics();
+
+  // The front end's trace comes before anything the back end prints
+  flushTrace(tracing);
+  pthread_mutex_lock(&backEndLock);
+
+  if (options->isOptimizing && !errorState->hasError) {
+    optimizeIr(options->enabledPasses);
+    printIr("optimized_code.txt");
+  }
+
+  if (options->isAnalyzing && !errorState->hasError) {
+    writeAnalysis("analysis.txt");
+  }
+
+  if (options->assemblyPath && !errorState->hasError) {
+    emitAssembly(options->assemblyPath);
+  }
+
+  // Execute the generated code on the bytecode interpreter
+  if (options->isRunning && !errorState->hasError) {
+    VmProgram bytecode;
+    lowerIr(&bytecode);
+    flushTrace(tracing);
+
+    if (runVm(&bytecode, NULL) != 0) {
+      setErrorOccurred();
+    }
   }
 
-  // If got no frontend error, we generate code
-  CodeGen(tokens);
+  flushTrace(tracing);
+  pthread_mutex_unlock(&backEndLock);
+
+  // Every phase releases its arena in one go
+  freeVm();
+  freeIr();
+  freeAst();
+  freeSymbolTables();
+  freeInternTable();
+
+  if (options->showArenaStats && !options->isBatch) {
+    reportArenas();
+  }
+
+  if (close(fd) < 0 ||
+      (transitionTableFd != -1 && close(transitionTableFd) < 0)) {
+    setErrorOccurred();
+  }
+
+  return !errorState->hasError;
+}
+
+// Compile every file on the threads, then sum the batch up
+static bool compileFiles(const SourceList *sources, const char *outputDir,
+                         const Options *options) {
+  // A file per thread already keeps them busy
+  Options fileOptions = *options;
+  fileOptions.isBatch = true;
+  fileOptions.jobs = 1;
+
+  BatchSummary summary = compileBatch(sources, outputDir, options->jobs,
+                                      compileFile, &fileOptions);
+
+  for (int f = 0; f < summary.fileCount; f++) {
+    if (!summary.isCompiled[f]) {
+      fprintf(stderr, "Failed: %s, see %s\n", sources->paths[f],
+              summary.outputDirs[f]);
+    }
+  }
+
+  double seconds = summary.seconds > 0 ? summary.seconds : 1e-9;
+  printf("Compiled %d files, %d failed, in %.1f ms: %.0f files/s on %d "
+         "threads\n",
+         summary.fileCount, summary.failedCount, summary.seconds * 1e3,
+         summary.fileCount / seconds, options->jobs);
+
+  fflush(stdout);
+
+  bool hasError = summary.failedCount > 0 || summary.fileCount == 0;
+  freeBatchSummary(&summary);
+  return !hasError;
+}
+
+int main(int argc, const char *argv[]) {
+  const char *outputDir = ".";
+  Options options = {0};
+  options.jobs = 1;
+  SourceList sources = {0};
+  bool isBatch = false;
+
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    options.enabledPasses[pass] = true;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    if (_strcmp(argv[i], "--stream") == 0) {
+      options.isStreaming = true;
+    } else if (_strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      char *end;
+      long jobs = strtol(argv[++i], &end, 10);
+      if (end == argv[i] || *end != '\0' || jobs < 1 || jobs > INT_MAX) {
+        fprintf(stderr, "--jobs takes a number of threads of 1 or more: %s\n",
+                argv[i]);
+        _exit(1);
+      }
+      options.jobs = (int)jobs;
+    } else if (_strcmp(argv[i], "--arena-stats") == 0) {
+      options.showArenaStats = true;
+    } else if (_strcmp(argv[i], "--run") == 0) {
+      options.isRunning = true;
+    } else if (_strcmp(argv[i], "--asm") == 0 && i + 1 < argc) {
+      options.assemblyPath = argv[++i];
+    } else if (_strcmp(argv[i], "--analysis") == 0) {
+      options.isAnalyzing = true;
+    } else if (_strcmp(argv[i], "-O") == 0) {
+      options.isOptimizing = true;
+    } else if (_strcmp(argv[i], "--unroll") == 0 && i + 1 < argc) {
+      setUnrollFactor(atoi(argv[++i]));
+    } else if (_strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+      // Comma separated, every pass not listed is off
+      const char *list = argv[++i];
+      options.isOptimizing = true;
+      for (int pass = 0; pass < PASS_COUNT; pass++) {
+        options.enabledPasses[pass] = false;
+      }
+      while (*list) {
+        int length = 0;
+        while (list[length] && list[length] != ',') {
+          length++;
+        }
+        PassKind pass = findPass(list, length);
+        if (pass == PASS_COUNT) {
+          fprintf(stderr, "Unknown pass: %.*s\n", length, list);
+          _exit(1);
+        }
+        options.enabledPasses[pass] = true;
+        list += list[length] == ',' ? length + 1 : length;
+      }
+    } else if (_strncmp((char *)argv[i], "--no-", 5) == 0 &&
+               findPass(argv[i] + 5, _strlen(argv[i] + 5)) != PASS_COUNT) {
+      options.enabledPasses[findPass(argv[i] + 5, _strlen(argv[i] + 5))] =
+          false;
+    } else if (_strcmp(argv[i], "--transition-table") == 0 && i + 1 < argc) {
+      options.transitionTablePath = argv[++i];
+    } else if (_strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      if (!parseTraceSpec(argv[++i], &options.traceCategories,
+                          &options.traceLevel)) {
+        fprintf(stderr, "Unknown trace: %s\n", argv[i]);
+        _exit(1);
+      }
+    } else if (_strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
+      outputDir = argv[++i];
+    } else {
+      isBatch |= addSources(&sources, argv[i]);
+    }
+  }
+
+  if (sources.count == 0 && !isBatch) {
+    addSources(&sources, "tests/CorrectSyntax.cp");
+  }
+  isBatch |= sources.count > 1;
+
+  bool isCompiled;
+  if (isBatch) {
+    isCompiled = compileFiles(&sources, outputDir, &options);
+  } else {
+    // One compile, tracing every phase
+    CompilerContext *context = createContext();
+    context->outputDirectory = outputDir;
+    isCompiled = makeOutputDirectory(outputDir) &&
+                 compileFile(context, sources.paths[0], &options);
+    destroyContext(context);
+  }
 
-  if (close(fd) < 0 || close(transitionTableFd) < 0) {
+  freeSources(&sources);
+  if (!isCompiled) {
+    // _exit does not flush what the trace left in stdout's buffer
+    fflush(stdout);
     _exit(1);
   }
 
   return 0;
-}
\ No newline at end of file
+}
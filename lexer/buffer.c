@@ -1,6 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "../common/arena.h"
 #include "buffer.h"
 
 //> init-double-buffer
@@ -10,6 +14,10 @@ void initDoubleBuffer(DoubleBuffer *db, int *fd) {
   db->fd = *fd;
   db->activeBuffer = 0;
   db->fileEnd = 0;
+  db->input = NULL;
+  db->inputLength = 0;
+  db->inputCapacity = 0;
+  db->isMapped = false;
 }
 //< init-double-buffer
 
@@ -22,11 +30,136 @@ ssize_t fillBuffer(DoubleBuffer *db) {
   char *activeBuffer = db->activeBuffer == 0 ? db->buffer1 : db->buffer2;
   ssize_t bytesRead = read(db->fd, activeBuffer, BUFFER_SIZE - 1);
 
-  if (bytesRead < BUFFER_SIZE - 1) {
+  // Pipes can return short reads, so only an empty read marks the end
+  if (bytesRead <= 0) {
+    if (bytesRead < 0) {
+      perror("Error reading input file");
+    }
+
     db->fileEnd = 1;
-    activeBuffer[bytesRead] = EOF;
   }
 
+  activeBuffer[bytesRead > 0 ? bytesRead : 0] = EOF;
+
   return bytesRead;
 }
-//< fill-buffer
\ No newline at end of file
+//< fill-buffer
+
+//> map-input
+// Map a regular file in place. An anonymous region one byte larger than the
+// file is reserved first so the EOF sentinel always has somewhere to live,
+// even when the file size is an exact multiple of the page size.
+static int mapInput(DoubleBuffer *db, size_t fileSize) {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t regionSize = (fileSize + 1 + pageSize - 1) & ~(pageSize - 1);
+
+  char *region = mmap(NULL, regionSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    return -1;
+  }
+
+  // Private mapping: writing the sentinel never touches the file on disk
+  if (mmap(region, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+           db->fd, 0) == MAP_FAILED) {
+    munmap(region, regionSize);
+    return -1;
+  }
+
+  region[fileSize] = EOF;
+
+  db->input = region;
+  db->inputLength = fileSize;
+  db->inputCapacity = regionSize;
+  db->isMapped = true;
+
+  return 0;
+}
+//< map-input
+
+//> spool-input
+// Fallback for pipes and stdin: read through the double buffer and append
+// each chunk to a growable block, so lexemes never straddle two buffers.
+static int spoolInput(DoubleBuffer *db) {
+  ssize_t bytesRead;
+
+  while ((bytesRead = fillBuffer(db)) > 0) {
+    char *activeBuffer = db->activeBuffer == 0 ? db->buffer1 : db->buffer2;
+
+    // Keep one spare byte for the sentinel
+    if (db->inputLength + bytesRead + 1 > db->inputCapacity) {
+      size_t capacity = db->inputCapacity == 0 ? BUFFER_SIZE * 4
+                                               : db->inputCapacity * 2;
+      while (capacity < db->inputLength + bytesRead + 1) {
+        capacity *= 2;
+      }
+
+      // Spooled input belongs to the lexer arena
+      db->input = arenaGrow(lexerArena, db->input, db->inputLength, capacity);
+      db->inputCapacity = capacity;
+    }
+
+    for (ssize_t i = 0; i < bytesRead; i++) {
+      db->input[db->inputLength + i] = activeBuffer[i];
+    }
+    db->inputLength += bytesRead;
+
+    // Alternate buffers for the next reload
+    db->activeBuffer = !db->activeBuffer;
+  }
+
+  // Empty input still needs a sentinel
+  if (!db->input) {
+    db->input = arenaAlloc(lexerArena, 1);
+    db->inputCapacity = 1;
+  }
+
+  db->input[db->inputLength] = EOF;
+
+  return bytesRead < 0 ? -1 : 0;
+}
+//< spool-input
+
+//> load-input
+int loadInput(DoubleBuffer *db) {
+  struct stat fileStat;
+
+  if (fstat(db->fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode) &&
+      fileStat.st_size > 0 && mapInput(db, (size_t)fileStat.st_size) == 0) {
+    return 0;
+  }
+
+  return spoolInput(db);
+}
+
+void copyInput(DoubleBuffer *db, const char *source, size_t length) {
+  int noFd = -1;
+  initDoubleBuffer(db, &noFd);
+
+  db->input = arenaAlloc(lexerArena, length + 1);
+  for (size_t i = 0; i < length; i++) {
+    db->input[i] = source[i];
+  }
+  db->input[length] = EOF;
+
+  db->inputLength = length;
+  db->inputCapacity = length + 1;
+  db->fileEnd = 1;
+}
+
+void releaseInput(DoubleBuffer *db) {
+  if (!db->input) {
+    return;
+  }
+
+  // Spooled input is released with the lexer arena
+  if (db->isMapped) {
+    munmap(db->input, db->inputCapacity);
+  }
+
+  db->input = NULL;
+  db->inputLength = 0;
+  db->inputCapacity = 0;
+  db->isMapped = false;
+}
+//< load-input
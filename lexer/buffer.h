@@ -3,6 +3,8 @@
 
 #define BUFFER_SIZE 1024
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <sys/types.h>
 
 typedef struct {
@@ -11,9 +13,26 @@ typedef struct {
   int fd;
   int activeBuffer;
   int fileEnd;
+
+  // Contiguous view of the whole input, terminated by an EOF sentinel.
+  // Regular files are memory-mapped; pipes and stdin are read through the
+  // double buffer and spooled into a heap block.
+  char *input;
+  size_t inputLength;
+  size_t inputCapacity;
+  bool isMapped;
 } DoubleBuffer;
 
 void initDoubleBuffer(DoubleBuffer *db, int *fd);
+// Bytes read into the active buffer, 0 at the end of input, -1 on error
 ssize_t fillBuffer(DoubleBuffer *db);
 
-#endif
\ No newline at end of file
+// Load the whole input into db->input, preferring a zero-copy mapping.
+// Returns 0, or -1 if reading failed part way; db->input then holds what
+// was read, still ended by its sentinel
+int loadInput(DoubleBuffer *db);
+// Or copy input already in memory into the lexer arena, sentinel included
+void copyInput(DoubleBuffer *db, const char *source, size_t length);
+void releaseInput(DoubleBuffer *db);
+
+#endif
@@ -1,9 +1,15 @@
 // lexer.c: the main component to handle lexical analysis
 
 #include "lexer.h"
+#include "../common/arena.h"
+#include "../common/context.h"
+#include "../common/diagnostics.h"
 #include "../common/error_state.h"
 #include "../common/file_utils.h"
+#include "../common/keyword.h"
+#include "../common/line_index.h"
 #include "../common/string.h"
+#include "transition_table_data.h"
 #include <fcntl.h>  // For open() flags
 #include <unistd.h> // For write() and close()
 
@@ -40,46 +46,45 @@ static const TokenType stateToToken[] = {
     [STATE_RIGHT_SQUARE_PAREN] = TOKEN_RIGHT_SQUARE_PAREN,
 };
 
-/**
- * keywords
- * A list of keywords that exists in our grammar
- * e.g. "or", "and", "not"...
- */
-static const char *keywords[] = {
-    "or", "and", "not", "if",  "then",   "else",  "fi",  "while",
-    "do", "od",  "def", "fed", "return", "print", "int", "double"};
+_Thread_local LexerState *lexing = NULL;
 
-static const int keywordsCount = sizeof(keywords) / sizeof(keywords[0]);
-int tokenCount = 0;
-
-void initializeLexer(Lexer *lexer, int *inputFd, int *transitionTableFd) {
+// The input is already in lexer->db
+void initializeLexer(Lexer *lexer, int *transitionTableFd) {
   // Initialize lexer state and buffer-related variables
   lexer->currentState = STATE_START;
-  lexer->newLineCount = 0;
-  lexer->characterCount = 0;
-  lexer->hasNewLine = false;
+  lexer->reachedEnd = false;
+
+  // Initialize the scanner to walk the input in place
+  initScanner(&lexer->scanner, lexer->db.input, lexer->db.inputLength);
 
-  // Initialize double buffering for input reading
-  initDoubleBuffer(&lexer->db, inputFd);
-  fillBuffer(&lexer->db); // Fill the buffer with the first data chunk
+  // Use the table generated at build time unless a file overrides it
+  lexer->dfa = &builtinDfa;
 
-  // Initialize the scanner
-  initScanner(&lexer->scanner, lexer->db.buffer1);
+  if (transitionTableFd) {
+    TransitionState transitionTable[TT_ROWS][TT_COLS];
+    if (initTransitionTable(transitionTable, transitionTableFd) == 0 &&
+        compressTransitionTable(transitionTable, &lexing->loadedDfa) == 0) {
+      lexer->dfa = &lexing->loadedDfa;
+    } else {
+      // Lex with the built-in table so the outputs stay complete, but the
+      // compile fails rather than run on a table nobody asked for
+      reportError(PHASE_LEXICAL, DIAG_UNUSABLE_TRANSITION_TABLE, 0, 0,
+                  "Lexical Error: Failed to use the transition table file!");
+    }
+  }
 
-  // Initialize the transition table with file data
-  initTransitionTable(lexer->transitionTable, transitionTableFd);
+  buildSpanSets(lexer->dfa, lexer->spans);
+  lexer->scanSpan = spanScanner();
 }
 
 void handleError(Lexer *lexer, char character) {
 
   // Reset the state to start lexing from the invalid character
   lexer->currentState = STATE_START;
-  TransitionState state =
-      lexer->transitionTable[lexer->currentState][character];
+  TransitionState state = dfaNext(lexer->dfa, lexer->currentState, character);
 
-  // If initial character is valid, then undo the col and forward pointer
+  // If initial character is valid, then undo the forward pointer
   if (state != STATE_ERROR) {
-    lexer->scanner.col--;     // Undo the column increment
     lexer->scanner.forward--; // Undo the last forward movement
   }
 
@@ -87,167 +92,230 @@ void handleError(Lexer *lexer, char character) {
   lexer->scanner.lexemeBegin = lexer->scanner.forward;
 }
 
+// Take the bytes after the current one that keep the state all at once, as
+// the loop would have one by one
+static void skipSpan(Lexer *lexer) {
+  const SpanSet *set = &lexer->spans[lexer->currentState];
+  lexer->scanner.forward += lexer->scanSpan(
+      set, lexer->scanner.forward, lexer->db.input + lexer->db.inputLength);
+}
+
 Token getNextToken(TransitionState state, Scanner *scanner) {
   // Map the state to the corresponding token type
   TokenType tokenType = stateToToken[state];
   char *startCharacter = scanner->lexemeBegin;
   int tokenLength = scanner->forward - scanner->lexemeBegin;
-  int tokenLine = scanner->line;
-
-  // Get the token's lexeme
-  char value[tokenLength + 1];
-  for (int i = 0; i < tokenLength; i++) {
-    value[i] = startCharacter[i];
-  }
-  value[tokenLength] = '\0';
+  uint32_t tokenOffset = (uint32_t)(startCharacter - scanner->input);
+  KeywordType keyword = KEYWORD_NONE;
 
-  // If the token is a keyword, check if the lexeme matches any predefined
-  // keywords
+  // If the token may be a keyword, classify the lexeme in place
   if (tokenType == TOKEN_KEYWORD) {
-    bool isKeyword = false;
-
-    // Check if the lexeme matches any keyword
-    for (int i = 0; i < keywordsCount; i++) {
-      if (_strcmp(value, keywords[i]) == 0) {
-        isKeyword = true;
-      }
-    }
+    keyword = classifyKeyword(startCharacter, tokenLength);
 
     // If it is not a keyword, treat it as an identifier (ID)
-    tokenType = isKeyword ? TOKEN_KEYWORD : TOKEN_ID;
+    tokenType = keyword != KEYWORD_NONE ? TOKEN_KEYWORD : TOKEN_ID;
   }
 
-  return makeToken(tokenType, startCharacter, tokenLength, tokenLine);
+  Token token = makeToken(tokenType, startCharacter, tokenLength, tokenOffset);
+  token.keyword = keyword;
+
+  return token;
 }
 
-void processToken(Lexer *lexer, TransitionState state) {
-  // Undo column and forward before processing the token
-  lexer->scanner.col--;
+Token processToken(Lexer *lexer, TransitionState state) {
+  // Undo forward before processing the token
   lexer->scanner.forward--;
 
-  // Get the next token and add it to the token list
-  Token token = getNextToken(state, &lexer->scanner);
+  // Get the next token, the caller drops it if it is whitespace
+  return getNextToken(state, &lexer->scanner);
+}
+
+// Write the token to the token file
+void recordToken(Token token) {
+  OutputBuffer *output = &lexing->tokenFile;
+  appendInt(output, token.type);
 
-  // Ignore whitespace
-  if (token.type == TOKEN_WHITESPACE) {
-    return;
+  // If token required attribute value
+  if (token.type == TOKEN_KEYWORD || token.type == TOKEN_ID) {
+    appendChar(output, ' ');
+    appendString(output, token.lexeme);
   }
 
-  tokens[tokenCount] = token;
-  tokenCount++;
+  appendChar(output, '\n');
 }
 
-Token *lexicalAnalysis(int *inputFd, int *transitionTableFd) {
+Token endOfInputToken(Lexer *lexer) {
+  // Positioned at the end of input, so offsets stay inside the input
+  Token token = makeToken(TOKEN_DOLLAR, "$", 1, lexer->db.inputLength);
+  token.start = lexer->db.input + lexer->db.inputLength;
+
+  return token;
+}
+
+// Start on the input loaded into the bound context's lexer
+static void beginLexing(int *transitionTableFd) {
   // Remove the created files first
-  remove("lexical_analysis_errors.txt");
-  remove("token_lexeme_pairs.txt");
+  removeOutputFile("lexical_analysis_errors.txt");
+  removeOutputFile("token_lexeme_pairs.txt");
 
-  //> Output: tokens and errors log
-  char errorBuffer[BUFFER_SIZE +
-                   1]; // Holds error messages before writing to error file
-  errorBuffer[BUFFER_SIZE] = '\0'; // Null character
-  size_t errorBufferIndex = 0;     // Track the size of error buffer
+  openOutput(&lexing->tokenFile, "token_lexeme_pairs.txt");
 
-  char tokenFileBuffer[BUFFER_SIZE +
-                       1]; // Holds token info before writing to token file
-  tokenFileBuffer[BUFFER_SIZE] = '\0'; // Null character
-  size_t tokenFileBufferIndex = 0;
-  //< Output
+  // Positions of tokens are found in the input once something prints one
+  freeLineIndex(lineIndex);
+  initLineIndex(lineIndex, lexing->lexer.db.input,
+                lexing->lexer.db.inputLength);
 
-  Lexer lexer;
-  initializeLexer(&lexer, inputFd, transitionTableFd);
+  initializeLexer(&lexing->lexer, transitionTableFd);
+}
+
+void beginLexicalAnalysis(CompilerContext *context, int *inputFd,
+                          int *transitionTableFd) {
+  useContext(context);
+
+  // Map the input, or read it through the double buffer for pipes
+  initDoubleBuffer(&lexing->lexer.db, inputFd);
+  bool isLoaded = loadInput(&lexing->lexer.db) == 0;
+
+  // What was read of an input that failed is not lexed, the compile fails
+  if (!isLoaded) {
+    lexing->lexer.db.inputLength = 0;
+  }
+
+  beginLexing(transitionTableFd);
+
+  if (!isLoaded) {
+    reportError(PHASE_LEXICAL, DIAG_UNREADABLE_INPUT, 0, 0,
+                "Lexical Error: Failed to read the input!");
+  }
+}
+
+Token scanToken() {
+  Lexer *lexer = &lexing->lexer;
 
   while (1) {
-    char character = getNextChar(&lexer.db, &lexer.scanner);
+    int character = getNextChar(&lexer->scanner);
 
     // Handle end of file (EOF)
     if (character == EOF) {
+      if (lexer->reachedEnd) {
+        return endOfInputToken(lexer);
+      }
+      lexer->reachedEnd = true;
+
       // Process the last token before finishing
-      Token token = getNextToken(lexer.currentState, &lexer.scanner);
+      Token token = getNextToken(lexer->currentState, &lexer->scanner);
 
       // Token validation, possibly 0
       if (token.type <= 0 || token.type == TOKEN_WHITESPACE) {
-        break;
+        return endOfInputToken(lexer);
       }
 
-      tokens[tokenCount] = token;
-      tokenCount++;
-      break;
+      recordToken(token);
+      return token;
     }
 
     // Update lexer state based on the transition table
-    TransitionState prevState = lexer.currentState;
-    lexer.currentState = lexer.transitionTable[prevState][character];
+    TransitionState prevState = lexer->currentState;
+    lexer->currentState = dfaNext(lexer->dfa, prevState, character);
 
-    bool isTokenFound = lexer.currentState == STATE_START;
-    bool isErrorFound = lexer.currentState == STATE_ERROR;
+    bool isTokenFound = lexer->currentState == STATE_START;
+    bool isErrorFound = lexer->currentState == STATE_ERROR;
 
     // Handle error before processing token
     if (isErrorFound) {
-      // Write error message
-      char errorMessage[BUFFER_SIZE];
-      sprintf(
-          errorMessage,
-          "Lexical Error: Unexpected character '%c' at line %d, column %d!\n",
-          character, lexer.scanner.line, lexer.scanner.col);
-      appendToBuffer(errorBuffer, &errorBufferIndex, errorMessage,
-                     "lexical_analysis_errors.txt");
-
-      handleError(&lexer, character);
-      setErrorOccurred();
+      // Report the error where the character is, then recover in panic mode
+      SourcePosition position = positionOf(
+          (uint32_t)(lexer->scanner.forward - 1 - lexer->scanner.input));
+      reportError(PHASE_LEXICAL, DIAG_UNEXPECTED_CHARACTER, position.line,
+                  position.column,
+                  "Lexical Error: Unexpected character '%c' at line %d, "
+                  "column %d!",
+                  character, position.line, position.column);
+
+      handleError(lexer, character);
 
       continue;
     }
 
-    // Track character count only if we are still in a token
+    // Still in a token
     if (!isTokenFound) {
-      lexer.characterCount++;
-
-      // Handle new line detection
-      if (character == '\n') {
-        lexer.newLineCount++;
-        lexer.hasNewLine = true; // Remember that a newline appeared
+      // The rest of a run of whitespace, an identifier or a number, when
+      // the run goes on past the next byte
+      if (lexer->scanSpan && lexer->spans[lexer->currentState].rangeCount &&
+          dfaNext(lexer->dfa, lexer->currentState, *lexer->scanner.forward) ==
+              lexer->currentState) {
+        skipSpan(lexer);
       }
+
+      continue;
     }
 
-    // Process a token if a valid token is found
-    if (isTokenFound) {
-      processToken(&lexer, prevState);
+    // Process a token if a valid token is found; whitespace makes none, so
+    // its lexeme is not interned
+    bool isWhitespace = stateToToken[prevState] == TOKEN_WHITESPACE;
+    Token token;
+    if (isWhitespace) {
+      lexer->scanner.forward--;
+    } else {
+      token = processToken(lexer, prevState);
+    }
 
-      // Prepare for the next token by updating lexemeBegin
-      lexer.scanner.lexemeBegin = lexer.scanner.forward;
+    // Prepare for the next token by updating lexemeBegin
+    lexer->scanner.lexemeBegin = lexer->scanner.forward;
 
-      // Reset line and column if a newline was encountered
-      if (lexer.hasNewLine) {
-        lexer.scanner.line = lexer.newLineCount + 1; // 1-based index for lines
-        lexer.scanner.col = 0;    // Reset column to 0 after newline
-        lexer.hasNewLine = false; // Reset newline flag
-      }
+    // Ignore whitespace
+    if (!isWhitespace) {
+      recordToken(token);
+      return token;
     }
   }
+}
+
+void endLexicalAnalysis() {
+  // The parser may stop early, scan the rest so the outputs are complete
+  while (!lexing->lexer.reachedEnd) {
+    scanToken();
+  }
 
-  // Handle Token file
-  char tokenMessage[BUFFER_SIZE];
+  // Write what is left of the token log at the end of lexical analysis
+  closeOutput(&lexing->tokenFile);
+}
 
-  for (int i = 0; i < tokenCount; i++) {
-    Token token = tokens[i];
+// Pull every token up front, ending with the TOKEN_DOLLAR
+static TokenStream *scanAllTokens() {
+  TokenStream *stream = &lexing->tokenStream;
+  initTokenStream(stream, lexing->lexer.db.input,
+                  lexing->lexer.db.inputLength);
 
-    // If token required attribute value
-    if (token.type == TOKEN_KEYWORD || token.type == TOKEN_ID) {
-      sprintf(tokenMessage, "%d %s\n", token.type, token.lexeme);
-    } else {
-      sprintf(tokenMessage, "%d\n", token.type);
-    }
+  Token token;
+  do {
+    token = scanToken();
+    pushToken(stream, token);
+  } while (token.type != TOKEN_DOLLAR);
 
-    appendToBuffer(tokenFileBuffer, &tokenFileBufferIndex, tokenMessage,
-                   "token_lexeme_pairs.txt");
-  }
+  endLexicalAnalysis();
 
-  // Flush buffer contents to the file at the end of lexical analysis
-  flushBufferToFile("lexical_analysis_errors.txt", errorBuffer,
-                    &errorBufferIndex);
-  flushBufferToFile("token_lexeme_pairs.txt", tokenFileBuffer,
-                    &tokenFileBufferIndex);
+  return stream;
+}
 
-  return tokens;
-}
\ No newline at end of file
+TokenStream *lexicalAnalysis(CompilerContext *context, int *inputFd,
+                             int *transitionTableFd) {
+  beginLexicalAnalysis(context, inputFd, transitionTableFd);
+  return scanAllTokens();
+}
+
+TokenStream *lexicalAnalysisOfBuffer(CompilerContext *context,
+                                     const char *source, size_t length) {
+  useContext(context);
+  copyInput(&lexing->lexer.db, source, length);
+  beginLexing(NULL);
+
+  return scanAllTokens();
+}
+
+void freeLexerInput() {
+  freeLineIndex(lineIndex);
+  freeTokenStream(&lexing->tokenStream);
+  releaseInput(&lexing->lexer.db);
+  releaseArena(lexerArena);
+}
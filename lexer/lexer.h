@@ -1,24 +1,60 @@
 #ifndef LEXICAL_ANALYZER_H
 #define LEXICAL_ANALYZER_H
 
+#include "../common/context.h"
+#include "../common/file_utils.h"
 #include "../common/token.h"
+#include "../common/token_stream.h"
 #include "scanner.h"
+#include "span.h"
 #include "stdbool.h"
 #include "transition_table.h"
 
-Token tokens[1024];
-extern int tokenCount;
-
 typedef struct {
   TransitionState currentState;
-  TransitionState transitionTable[TT_ROWS][TT_COLS];
+  const CompactDfa *dfa;
   DoubleBuffer db;
   Scanner scanner;
-  int newLineCount;
-  int characterCount;
-  bool hasNewLine;
+  bool reachedEnd; // The last token before EOF was already produced
+
+  // Spans of every state of dfa, skipped by scanSpan unless it is NULL
+  SpanSet spans[TT_ROWS];
+  SpanScanner scanSpan;
 } Lexer;
 
-Token *lexicalAnalysis(int *inputFd, int *transitionTableFd);
+// Everything a lexical analysis works on, one per compiler context
+typedef struct {
+  // Kept alive after lexical analysis: token lexemes point into its input
+  Lexer lexer;
+  TokenStream tokenStream;
+
+  //> Output: tokens log, errors go to the diagnostics
+  OutputBuffer tokenFile;
+  //< Output
+
+  // Only filled when a transition table file overrides the built-in one
+  CompactDfa loadedDfa;
+} LexerState;
+
+// Lexer of the context bound to this thread
+extern _Thread_local LexerState *lexing;
+
+// Pass NULL as transitionTableFd to use the table compiled into the binary
+// The returned stream ends with a TOKEN_DOLLAR and lives until freeLexerInput
+TokenStream *lexicalAnalysis(CompilerContext *context, int *inputFd,
+                             int *transitionTableFd);
+// The same for source held in memory, which is copied
+TokenStream *lexicalAnalysisOfBuffer(CompilerContext *context,
+                                     const char *source, size_t length);
+
+// Streaming mode: produce tokens one at a time on demand, with no stream
+void beginLexicalAnalysis(CompilerContext *context, int *inputFd,
+                          int *transitionTableFd);
+// Next non-whitespace token, then TOKEN_DOLLAR for as long as it is called
+Token scanToken();
+void endLexicalAnalysis();
+// Release the input and token stream once no position in the input can be
+// reported any more, after code generation
+void freeLexerInput();
 
 #endif
\ No newline at end of file
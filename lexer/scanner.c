@@ -1,33 +1,20 @@
 #include "scanner.h"
 
-void initScanner(Scanner *scanner, char *buffer) {
+void initScanner(Scanner *scanner, char *buffer, size_t length) {
+  scanner->input = buffer;
+  scanner->end = buffer + length;
   scanner->lexemeBegin = buffer;
   scanner->forward = buffer;
-  scanner->line = 1;
-  scanner->col = 0;
 }
 
 char peek(Scanner *scanner) { return *scanner->forward; }
 
-char getNextChar(DoubleBuffer *db, Scanner *scanner) {
-  char character = peek(scanner);
-
-  if (character == EOF) {
-    if (&character == &db->buffer1[BUFFER_SIZE - 1]) {
-      db->activeBuffer = 1;
-      fillBuffer(db);
-      scanner->forward = db->buffer2;
-    } else if (&character == &db->buffer2[BUFFER_SIZE - 1]) {
-      db->activeBuffer = 0;
-      fillBuffer(db);
-      scanner->forward = db->buffer1;
-    } else {
-      return EOF;
-    }
+int getNextChar(Scanner *scanner) {
+  // The end is a position, not the sentinel's value: a 0xFF byte in the
+  // input is a character like any other
+  if (scanner->forward == scanner->end) {
+    return EOF;
   }
 
-  // Update column number
-  scanner->col++;
-
-  return *scanner->forward++;
-}
\ No newline at end of file
+  return (unsigned char)*scanner->forward++;
+}
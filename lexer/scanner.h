@@ -7,14 +7,15 @@
 #include <stdio.h>
 
 typedef struct {
+  char *input; // Where offsets of tokens count from
+  char *end;   // Past the last byte of input, at its sentinel
   char *lexemeBegin;
   char *forward;
-  int line;
-  int col;
 } Scanner;
 
-void initScanner(Scanner *scanner, char *buffer);
+void initScanner(Scanner *scanner, char *buffer, size_t length);
 char peek(Scanner *scanner);
-char getNextChar(DoubleBuffer *db, Scanner *scanner);
+// Next byte of input as an unsigned char, or EOF once the input is over
+int getNextChar(Scanner *scanner);
 
-#endif
\ No newline at end of file
+#endif
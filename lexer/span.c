@@ -0,0 +1,164 @@
+#include "span.h"
+#include <stdbool.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAS_X86_SPANS 1
+#endif
+
+static SpanLevel chosenLevel = SPAN_BEST;
+
+//> Span sets
+void buildSpanSets(const CompactDfa *dfa, SpanSet sets[TT_ROWS]) {
+  for (int state = 0; state < TT_ROWS; state++) {
+    SpanSet *set = &sets[state];
+    set->rangeCount = 0;
+
+    // The start state ends a token, it never stays
+    if (state == STATE_START) {
+      continue;
+    }
+
+    bool isInRange = false;
+    for (int byte = 0; byte < TT_BYTES; byte++) {
+      bool isKept = dfa->next[state][dfa->byteClass[byte]] == state;
+
+      if (isKept && !isInRange) {
+        if (set->rangeCount == SPAN_MAX_RANGES) {
+          set->rangeCount = 0;
+          break;
+        }
+        set->low[set->rangeCount] = (uint8_t)byte;
+        set->high[set->rangeCount++] = (uint8_t)byte;
+      } else if (isKept) {
+        set->high[set->rangeCount - 1] = (uint8_t)byte;
+      }
+      isInRange = isKept;
+    }
+  }
+}
+//< Span sets
+
+//> Scanners
+static inline bool isInSet(const SpanSet *set, uint8_t byte) {
+  for (int r = 0; r < set->rangeCount; r++) {
+    // Below low wraps around to a large difference
+    if ((uint8_t)(byte - set->low[r]) <= set->high[r] - set->low[r]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Stops at end: the sentinel past the input is a byte like any other, 0xFF
+// included, and may well be in the set
+static size_t scanScalar(const SpanSet *set, const char *text,
+                         const char *end) {
+  const char *p = text;
+
+  while (p < end && isInSet(set, (uint8_t)*p)) {
+    p++;
+  }
+
+  return p - text;
+}
+
+#ifdef HAS_X86_SPANS
+// Bytes are tested range by range: byte - low, saturated by high - low, is
+// zero exactly when the byte is in the range
+static size_t scanSse2(const SpanSet *set, const char *text,
+                       const char *end) {
+  __m128i lows[SPAN_MAX_RANGES], widths[SPAN_MAX_RANGES];
+  for (int r = 0; r < set->rangeCount; r++) {
+    lows[r] = _mm_set1_epi8((char)set->low[r]);
+    widths[r] = _mm_set1_epi8((char)(set->high[r] - set->low[r]));
+  }
+
+  const __m128i zero = _mm_setzero_si128();
+  const char *p = text;
+
+  // Whole blocks before the end only, so nothing past it is ever read
+  for (; end - p >= 16; p += 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+    __m128i in = zero;
+    for (int r = 0; r < set->rangeCount; r++) {
+      __m128i over = _mm_subs_epu8(_mm_sub_epi8(bytes, lows[r]), widths[r]);
+      in = _mm_or_si128(in, _mm_cmpeq_epi8(over, zero));
+    }
+
+    // The first byte out of the set ends the span
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(in);
+    if (mask != 0xFFFF) {
+      return p - text + __builtin_ctz(~mask);
+    }
+  }
+
+  return p - text + scanScalar(set, p, end);
+}
+
+__attribute__((target("avx2"))) static size_t
+scanAvx2(const SpanSet *set, const char *text, const char *end) {
+  __m256i lows[SPAN_MAX_RANGES], widths[SPAN_MAX_RANGES];
+  for (int r = 0; r < set->rangeCount; r++) {
+    lows[r] = _mm256_set1_epi8((char)set->low[r]);
+    widths[r] = _mm256_set1_epi8((char)(set->high[r] - set->low[r]));
+  }
+
+  const __m256i zero = _mm256_setzero_si256();
+  const char *p = text;
+
+  for (; end - p >= 32; p += 32) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)p);
+    __m256i in = zero;
+    for (int r = 0; r < set->rangeCount; r++) {
+      __m256i over =
+          _mm256_subs_epu8(_mm256_sub_epi8(bytes, lows[r]), widths[r]);
+      in = _mm256_or_si256(in, _mm256_cmpeq_epi8(over, zero));
+    }
+
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(in);
+    if (mask != 0xFFFFFFFFu) {
+      return p - text + __builtin_ctz(~mask);
+    }
+  }
+
+  // Less than a block is left, SSE2 takes what it can of it
+  return p - text + scanSse2(set, p, end);
+}
+#endif
+//< Scanners
+
+//> Dispatch
+// The widest level this CPU runs
+static SpanLevel bestLevel() {
+#ifdef HAS_X86_SPANS
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? SPAN_AVX2 : SPAN_SSE2;
+#else
+  return SPAN_SCALAR;
+#endif
+}
+
+SpanLevel setSpanLevel(SpanLevel level) {
+  SpanLevel best = bestLevel();
+  chosenLevel = level > best ? best : level;
+  return chosenLevel;
+}
+
+SpanScanner spanScanner() {
+  SpanLevel level = chosenLevel == SPAN_BEST ? bestLevel() : chosenLevel;
+
+  switch (level) {
+  case SPAN_OFF:
+    return NULL;
+#ifdef HAS_X86_SPANS
+  case SPAN_AVX2:
+    return scanAvx2;
+  case SPAN_SSE2:
+    return scanSse2;
+#endif
+  default:
+    return scanScalar;
+  }
+}
+//< Dispatch
@@ -0,0 +1,57 @@
+// Spans: runs of bytes that keep the DFA in the state it is in, such as the
+// rest of a run of whitespace, of an identifier or of a number. The lexer
+// skips a span many bytes at a time instead of taking every byte through the
+// transition table, then goes on with the byte that ends it.
+
+#ifndef SPAN_H
+#define SPAN_H
+
+#include "transition_table.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Most ranges of bytes a span set can be made of, enough for [0-9A-Z_a-z]
+#define SPAN_MAX_RANGES 4
+
+// Bytes that keep a state, as ranges from low to high inclusive
+typedef struct {
+  uint8_t low[SPAN_MAX_RANGES];
+  uint8_t high[SPAN_MAX_RANGES];
+  int rangeCount; // 0 if the state has no span worth skipping
+} SpanSet;
+
+// How spans are scanned, from none at all to 32 bytes at a time
+typedef enum {
+  SPAN_OFF,    // Every byte goes through the DFA
+  SPAN_SCALAR, // A byte at a time, without the DFA
+  SPAN_SSE2,   // 16 bytes at a time
+  SPAN_AVX2,   // 32 bytes at a time
+  SPAN_BEST,   // The widest this CPU has
+} SpanLevel;
+
+// Length of the span at text, which ends at end at the latest
+typedef size_t (*SpanScanner)(const SpanSet *set, const char *text,
+                              const char *end);
+
+/**
+ * Find the bytes that keep each state of a DFA where it is. A state whose
+ * bytes take more than SPAN_MAX_RANGES ranges gets none.
+ *
+ * @param dfa The DFA the lexer runs.
+ * @param sets Gets one set per state.
+ */
+void buildSpanSets(const CompactDfa *dfa, SpanSet sets[TT_ROWS]);
+
+/**
+ * Choose how lexers set up from now on scan spans. Call it before compiling,
+ * not while a compile runs.
+ *
+ * @param level The level wanted, lowered to what the CPU has.
+ * @return The level chosen.
+ */
+SpanLevel setSpanLevel(SpanLevel level);
+
+// The scanner for the level chosen, NULL for SPAN_OFF
+SpanScanner spanScanner();
+
+#endif
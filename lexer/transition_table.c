@@ -1,21 +1,48 @@
 #include "transition_table.h"
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #define BUFFER_SIZE 1024
 
-void initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd) {
+// Put the number just read at the end of the row, if the row has room
+static int storeEntry(TransitionState arr[TT_ROWS][TT_COLS], int row,
+                      int *col, int value) {
+  if (row >= TT_ROWS || *col >= TT_COLS) {
+    fprintf(stderr, "Transition table has more than %d rows of %d columns\n",
+            TT_ROWS, TT_COLS);
+    return -1;
+  }
+
+  arr[row][(*col)++] = value;
+  return 0;
+}
+
+// A row ends complete or not at all
+static int endRow(int row, int col) {
+  if (col != TT_COLS) {
+    fprintf(stderr, "Transition table row %d has %d columns, not %d\n",
+            row + 1, col, TT_COLS);
+    return -1;
+  }
+
+  return 0;
+}
+
+int initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd) {
   char buffer[BUFFER_SIZE];
   int row = 0, col = 0;
   int num = 0;
   int isNegative = 0, inNumber = 0;
   ssize_t bytesRead;
 
+  memset(arr, 0, TT_ROWS * sizeof(arr[0]));
+
   while (1) {
     // Didn't read transition table file
     if ((bytesRead = read(*fd, buffer, BUFFER_SIZE)) < 0) {
       perror("Error reading transition table file");
-      break;
+      return -1;
     }
 
     // Read the transition table content
@@ -27,12 +54,16 @@ void initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd) {
         isNegative = 1;
         inNumber = 1;
       } else if (character >= '0' && character <= '9') {
-        num = num * 10 + (character - '0');
+        // Past the states the number stays out of range without overflowing
+        if (num < TT_ROWS) {
+          num = num * 10 + (character - '0');
+        }
         inNumber = 1;
       } else if (character == ' ' || character == '\t') {
         if (inNumber) {
-          arr[row][col] = isNegative ? -num : num;
-          col++;
+          if (storeEntry(arr, row, &col, isNegative ? -num : num) != 0) {
+            return -1;
+          }
 
           num = 0;
           isNegative = 0;
@@ -40,8 +71,9 @@ void initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd) {
         }
       } else if (character == '\n') {
         if (inNumber) {
-          arr[row][col] = isNegative ? -num : num;
-          col++;
+          if (storeEntry(arr, row, &col, isNegative ? -num : num) != 0) {
+            return -1;
+          }
 
           num = 0;
           isNegative = 0;
@@ -49,20 +81,107 @@ void initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd) {
         }
 
         if (col > 0) {
+          if (endRow(row, col) != 0) {
+            return -1;
+          }
           row++;
           col = 0;
         }
       }
     }
 
-    if (bytesRead < BUFFER_SIZE) {
+    if (bytesRead == 0) {
       break;
     }
   }
 
   // If file does not end with new line, add the last number
-  if (inNumber) {
-    arr[row][col] = isNegative ? -num : num;
-    col++;
+  if (inNumber && storeEntry(arr, row, &col, isNegative ? -num : num) != 0) {
+    return -1;
+  }
+  if (col > 0) {
+    if (endRow(row, col) != 0) {
+      return -1;
+    }
+    row++;
+  }
+
+  if (row != TT_ROWS) {
+    fprintf(stderr, "Transition table has %d rows, not %d\n", row, TT_ROWS);
+    return -1;
+  }
+
+  return 0;
+}
+
+//> compress-transition-table
+static int sameColumn(TransitionState arr[TT_ROWS][TT_COLS], int col,
+                      const int8_t column[TT_ROWS]) {
+  for (int row = 0; row < TT_ROWS; row++) {
+    if (arr[row][col] != column[row]) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int compressTransitionTable(TransitionState arr[TT_ROWS][TT_COLS],
+                            CompactDfa *dfa) {
+  int8_t columns[TT_MAX_CLASSES][TT_ROWS];
+
+  // Every entry is a state, or the error state
+  for (int row = 0; row < TT_ROWS; row++) {
+    for (int col = 0; col < TT_COLS; col++) {
+      if (arr[row][col] < STATE_ERROR || arr[row][col] >= TT_ROWS) {
+        fprintf(stderr, "Transition table row %d, column %d is not a state\n",
+                row + 1, col + 1);
+        return -1;
+      }
+    }
+  }
+
+  // Class 0: every state rejects the byte
+  for (int row = 0; row < TT_ROWS; row++) {
+    columns[0][row] = STATE_ERROR;
+  }
+  dfa->classCount = 1;
+
+  for (int byte = 0; byte < TT_BYTES; byte++) {
+    dfa->byteClass[byte] = 0;
+  }
+
+  // Give each ASCII character the class of the first identical column
+  for (int col = 0; col < TT_COLS; col++) {
+    int class = 0;
+    while (class < dfa->classCount && !sameColumn(arr, col, columns[class])) {
+      class++;
+    }
+
+    if (class == dfa->classCount) {
+      if (dfa->classCount == TT_MAX_CLASSES) {
+        fprintf(stderr, "Transition table has more than %d byte classes\n",
+                TT_MAX_CLASSES);
+        return -1;
+      }
+
+      for (int row = 0; row < TT_ROWS; row++) {
+        columns[class][row] = (int8_t)arr[row][col];
+      }
+      dfa->classCount++;
+    }
+
+    dfa->byteClass[col] = (uint8_t)class;
   }
+
+  // Lay the class columns out row by row for the lexer
+  for (int row = 0; row < TT_ROWS; row++) {
+    for (int class = 0; class < TT_MAX_CLASSES; class++) {
+      dfa->next[row][class] =
+          class < dfa->classCount ? columns[class][row] : STATE_ERROR;
+    }
+  }
+
+  return 0;
 }
+//< compress-transition-table
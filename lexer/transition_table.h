@@ -1,8 +1,12 @@
 #ifndef TRANSITION_TABLE_H
 #define TRANSITION_TABLE_H
 
+#include <stdint.h>
+
 #define TT_ROWS 29
 #define TT_COLS 128
+#define TT_BYTES 256
+#define TT_MAX_CLASSES 32
 
 //> transition-state: 29 states, from index 0 to 28, following the transition
 // table
@@ -41,6 +45,35 @@ typedef enum {
 
 //< transition-state
 
-void initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd);
+//> compact-dfa
+// Bytes that behave the same in every state share one equivalence class, so
+// the table only needs one column per class. Class 0 is reserved for bytes
+// that are invalid everywhere, which covers everything above 0x7F.
+typedef struct {
+  uint8_t byteClass[TT_BYTES];
+  int8_t next[TT_ROWS][TT_MAX_CLASSES];
+  int classCount;
+} CompactDfa;
+//< compact-dfa
+
+/**
+ * Read the full table from its text file: TT_ROWS lines of TT_COLS numbers.
+ *
+ * @param arr The table to fill.
+ * @param fd The open file.
+ * @return 0 on success, -1 if it cannot be read or has another shape.
+ */
+int initTransitionTable(TransitionState arr[TT_ROWS][TT_COLS], int *fd);
+// Build the byte-class table from the full 128-column table, -1 when an
+// entry is not a state or the columns need too many classes
+int compressTransitionTable(TransitionState arr[TT_ROWS][TT_COLS],
+                            CompactDfa *dfa);
+
+// Next state for a character, safe for any byte value
+static inline TransitionState dfaNext(const CompactDfa *dfa,
+                                      TransitionState state, char character) {
+  return (TransitionState)
+      dfa->next[state][dfa->byteClass[(unsigned char)character]];
+}
 
 #endif
\ No newline at end of file
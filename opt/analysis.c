@@ -0,0 +1,183 @@
+// Readable dump of the control-flow graph, dataflow and SSA of every
+// function, in the style of printIr
+
+#include "../common/arena.h"
+#include "../common/file_utils.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "opt.h"
+#include "ssa.h"
+
+static OutputBuffer output;
+
+static void append(const char *text) { appendString(&output, text); }
+
+// Name text, like x.2 for the second definition of x
+static void appendName(const Cfg *cfg, const SsaForm *ssa, int32_t name) {
+  if (name == -1) {
+    appendChar(&output, '?');
+    return;
+  }
+
+  appendOperand(&output, valueOperand(cfg, ssa->names[name].value));
+  appendChar(&output, '.');
+  appendInt(&output, ssa->names[name].version);
+}
+
+static void appendBlockList(const char *label, const int32_t *blocks,
+                            int count) {
+  if (count == 0) {
+    return;
+  }
+
+  append(label);
+  for (int i = 0; i < count; i++) {
+    append(" B");
+    appendInt(&output, blocks[i]);
+  }
+}
+
+static void appendValues(const char *label, const Cfg *cfg,
+                         const BitWord *set, int words) {
+  append(label);
+  for (int v = nextBit(set, words, 0); v != -1;
+       v = nextBit(set, words, v + 1)) {
+    append(" ");
+    appendOperand(&output, valueOperand(cfg, v));
+  }
+  append("\n");
+}
+
+// The right-hand side of every expression available on entry
+static void appendExpressions(const Dataflow *expressions, int b) {
+  const BitWord *set = blockSet(expressions->in, expressions->words, b);
+
+  append("  available:");
+  for (int e = nextBit(set, expressions->words, 0); e != -1;
+       e = nextBit(set, expressions->words, e + 1)) {
+    append(" ");
+    appendExpression(&output, &ir->instructions[expressions->items[e]]);
+    append(",");
+  }
+  append("\n");
+}
+
+static void writeBlock(const Cfg *cfg, const Dataflow *liveness,
+                       const Dataflow *definitions,
+                       const Dataflow *expressions, const SsaForm *ssa,
+                       int b) {
+  const BasicBlock *block = &cfg->blocks[b];
+  int firstInstruction = ir->functions[cfg->function].firstInstruction;
+
+  append("B");
+  appendInt(&output, b);
+  appendBlockList(" <-", &cfg->predecessors[block->firstPredecessor],
+                  block->predecessorCount);
+  appendBlockList(" ->", block->successors, block->successorCount);
+  if (block->order == -1) {
+    append(" unreachable\n");
+    return;
+  }
+  if (block->idom != -1) {
+    append(" idom B");
+    appendInt(&output, block->idom);
+  }
+  appendBlockList(" frontier", &cfg->frontiers[block->firstFrontier],
+                  block->frontierCount);
+  append("\n");
+
+  appendValues("  live in:", cfg, blockSet(liveness->in, liveness->words, b),
+               liveness->words);
+
+  int reaching = 0;
+  const BitWord *set = blockSet(definitions->in, definitions->words, b);
+  for (int d = nextBit(set, definitions->words, 0); d != -1;
+       d = nextBit(set, definitions->words, d + 1)) {
+    reaching++;
+  }
+  append("  reaching definitions: ");
+  appendInt(&output, reaching);
+  append("\n");
+  appendExpressions(expressions, b);
+
+  for (int p = ssa->firstPhi[b]; p < ssa->firstPhi[b + 1]; p++) {
+    const Phi *phi = &ssa->phis[p];
+    append("  ");
+    appendName(cfg, ssa, phi->name);
+    append(" = phi(");
+
+    for (int a = 0; a < block->predecessorCount; a++) {
+      append(a == 0 ? "" : ", ");
+      appendName(cfg, ssa, ssa->arguments[phi->firstArgument + a]);
+    }
+    append(")\n");
+  }
+
+  // Every instruction, then the SSA names it defines and reads
+  for (int i = 0; i < block->count; i++) {
+    int offset = block->first - firstInstruction + i;
+
+    appendInstruction(&output, &ir->instructions[block->first + i]);
+
+    if (ssa->definitions[offset] != -1 || ssa->uses[2 * offset] != -1 ||
+        ssa->uses[2 * offset + 1] != -1) {
+      append("    ;");
+      if (ssa->definitions[offset] != -1) {
+        append(" ");
+        appendName(cfg, ssa, ssa->definitions[offset]);
+        append(" <-");
+      }
+      for (int u = 0; u < 2; u++) {
+        if (ssa->uses[2 * offset + u] != -1) {
+          append(" ");
+          appendName(cfg, ssa, ssa->uses[2 * offset + u]);
+        }
+      }
+    }
+    append("\n");
+  }
+
+  appendValues("  live out:", cfg,
+               blockSet(liveness->out, liveness->words, b), liveness->words);
+}
+
+void writeAnalysis(const char *fileName) {
+  removeOutputFile(fileName);
+  openOutput(&output, fileName);
+
+  for (int f = 0; f < ir->functionCount; f++) {
+    Cfg cfg;
+    Dataflow liveness, definitions, expressions;
+    SsaForm ssa;
+
+    // Each function's analyses are released before the next one's
+    initAnalysis();
+    buildCfg(&cfg, f);
+    computeLiveness(&liveness, &cfg);
+    computeReachingDefinitions(&definitions, &cfg);
+    computeAvailableExpressions(&expressions, &cfg);
+    buildSsa(&ssa, &cfg, &liveness);
+
+    append(f == 0 ? "" : "\n");
+    if (ir->functions[f].name) {
+      append("function ");
+      append(ir->functions[f].name);
+      append(":");
+    } else {
+      append("program:");
+    }
+    append(" ");
+    appendInt(&output, cfg.blockCount);
+    append(" blocks, ");
+    appendInt(&output, ssa.phiCount);
+    append(" phis\n");
+
+    for (int b = 0; b < cfg.blockCount; b++) {
+      writeBlock(&cfg, &liveness, &definitions, &expressions, &ssa, b);
+    }
+
+    releaseArena(optArena);
+  }
+
+  closeOutput(&output);
+}
@@ -0,0 +1,134 @@
+// Word-packed bit sets for the dataflow analyses: every operation works a
+// 64-bit word at a time
+
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint64_t BitWord;
+
+#define WORD_BITS 64
+
+// Index of the lowest bit set in a nonzero word
+#ifdef __GNUC__
+#define lowestBit(word) __builtin_ctzll(word)
+#else
+static inline int lowestBit(BitWord word) {
+  int bit = 0;
+  while ((word & 1) == 0) {
+    word >>= 1;
+    bit++;
+  }
+  return bit;
+}
+#endif
+
+static inline int bitWords(int bitCount) {
+  return (bitCount + WORD_BITS - 1) / WORD_BITS;
+}
+
+static inline void setBit(BitWord *set, int bit) {
+  set[bit / WORD_BITS] |= (BitWord)1 << (bit % WORD_BITS);
+}
+
+static inline void clearBit(BitWord *set, int bit) {
+  set[bit / WORD_BITS] &= ~((BitWord)1 << (bit % WORD_BITS));
+}
+
+static inline bool hasBit(const BitWord *set, int bit) {
+  return (set[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+static inline void clearBits(BitWord *set, int words) {
+  for (int i = 0; i < words; i++) {
+    set[i] = 0;
+  }
+}
+
+// Every bit below bitCount, and none past it
+static inline void fillBits(BitWord *set, int bitCount) {
+  int words = bitWords(bitCount);
+  for (int i = 0; i < words; i++) {
+    set[i] = ~(BitWord)0;
+  }
+  if (bitCount % WORD_BITS != 0) {
+    set[words - 1] = ((BitWord)1 << (bitCount % WORD_BITS)) - 1;
+  }
+}
+
+static inline void copyBits(BitWord *target, const BitWord *source,
+                            int words) {
+  for (int i = 0; i < words; i++) {
+    target[i] = source[i];
+  }
+}
+
+/**
+ * Merge a set into another.
+ *
+ * @param target The set to grow.
+ * @param source The set merged in.
+ * @param words Number of words in each set.
+ * @return Whether the target changed.
+ */
+static inline bool unionBits(BitWord *target, const BitWord *source,
+                             int words) {
+  BitWord changed = 0;
+  for (int i = 0; i < words; i++) {
+    BitWord merged = target[i] | source[i];
+    changed |= merged ^ target[i];
+    target[i] = merged;
+  }
+  return changed != 0;
+}
+
+// Like unionBits, keeping only the bits both sets have
+static inline bool intersectBits(BitWord *target, const BitWord *source,
+                                 int words) {
+  BitWord changed = 0;
+  for (int i = 0; i < words; i++) {
+    BitWord merged = target[i] & source[i];
+    changed |= merged ^ target[i];
+    target[i] = merged;
+  }
+  return changed != 0;
+}
+
+/**
+ * The transfer function of every gen/kill problem: target = gen | (source &
+ * ~kill).
+ *
+ * @return Whether the target changed.
+ */
+static inline bool transferBits(BitWord *target, const BitWord *gen,
+                                const BitWord *source, const BitWord *kill,
+                                int words) {
+  BitWord changed = 0;
+  for (int i = 0; i < words; i++) {
+    BitWord result = gen[i] | (source[i] & ~kill[i]);
+    changed |= result ^ target[i];
+    target[i] = result;
+  }
+  return changed != 0;
+}
+
+// First bit set at or after from, -1 if there is none
+static inline int nextBit(const BitWord *set, int words, int from) {
+  int i = from / WORD_BITS;
+  if (i >= words) {
+    return -1;
+  }
+
+  BitWord word = set[i] & (~(BitWord)0 << (from % WORD_BITS));
+  while (word == 0) {
+    if (++i == words) {
+      return -1;
+    }
+    word = set[i];
+  }
+  return i * WORD_BITS + lowestBit(word);
+}
+
+#endif
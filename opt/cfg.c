@@ -0,0 +1,418 @@
+#include "cfg.h"
+
+#include <string.h>
+
+#include "../common/arena.h"
+
+// Block each label starts, for the function being built; every label is
+// written before it is read, so the table is never cleared
+static int32_t *labelBlock;
+static int labelCapacity;
+
+void initAnalysis() {
+  labelBlock = NULL;
+  labelCapacity = 0;
+}
+
+static int32_t *newTable(int count) {
+  return arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(int32_t));
+}
+
+static bool isConditionalJump(uint8_t opcode) {
+  return opcode >= IR_JUMP_LT && opcode <= IR_JUMP_NE;
+}
+
+static bool endsBlock(uint8_t opcode) {
+  return opcode == IR_JUMP || isConditionalJump(opcode) ||
+         opcode == IR_RETURN;
+}
+
+//> Values
+// A function owns its parameters and locals, which follow each other; the
+// program's own variables are the globals, declared just before it
+static void numberValues(Cfg *cfg) {
+  IrFunction *function = &ir->functions[cfg->function];
+  int first = function->firstParam;
+  int end = first;
+
+  if (cfg->function == ir->entry) {
+    while (first > 0 && ir->variables[first - 1].function == -1) {
+      first--;
+    }
+  } else {
+    while (end < ir->variableCount &&
+           ir->variables[end].function == cfg->function) {
+      end++;
+    }
+  }
+
+  cfg->firstVariable = first;
+  cfg->variableCount = end - first;
+  cfg->valueCount = cfg->variableCount + function->tempCount;
+}
+
+int valueOf(const Cfg *cfg, Operand operand) {
+  int32_t index = (int32_t)operandIndex(operand);
+
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    index -= cfg->firstVariable;
+    return index >= 0 && index < cfg->variableCount ? index : -1;
+  case OPERAND_TEMP:
+    // Temporaries added after the graph was built are not values of it
+    index -= ir->functions[cfg->function].firstTemp;
+    return index >= 0 && index < cfg->valueCount - cfg->variableCount
+               ? cfg->variableCount + index
+               : -1;
+  default:
+    return -1;
+  }
+}
+
+Operand valueOperand(const Cfg *cfg, int value) {
+  if (value < cfg->variableCount) {
+    return makeOperand(OPERAND_VARIABLE, cfg->firstVariable + value);
+  }
+  return makeOperand(OPERAND_TEMP, ir->functions[cfg->function].firstTemp +
+                                       value - cfg->variableCount);
+}
+
+bool isScalarValue(const Cfg *cfg, int value) {
+  return value >= cfg->variableCount ||
+         ir->variables[cfg->firstVariable + value].arraySize == 0;
+}
+
+int instructionValues(const Cfg *cfg, const Instruction *instruction,
+                      int uses[2]) {
+  uses[0] = uses[1] = -1;
+
+  switch (instruction->opcode) {
+  case IR_NOP:
+  case IR_LABEL:
+  case IR_JUMP:
+    return -1;
+  case IR_CALL:
+    return valueOf(cfg, instruction->result);
+  case IR_LOAD:
+    uses[0] = valueOf(cfg, instruction->arg2);
+    return valueOf(cfg, instruction->result);
+  case IR_STORE:
+  case IR_PARAM:
+  case IR_RETURN:
+  case IR_PRINT:
+  case IR_JUMP_LT:
+  case IR_JUMP_LE:
+  case IR_JUMP_GT:
+  case IR_JUMP_GE:
+  case IR_JUMP_EQ:
+  case IR_JUMP_NE:
+    uses[0] = valueOf(cfg, instruction->arg1);
+    uses[1] = valueOf(cfg, instruction->arg2);
+    return -1;
+  default:
+    uses[0] = valueOf(cfg, instruction->arg1);
+    uses[1] = valueOf(cfg, instruction->arg2);
+    return valueOf(cfg, instruction->result);
+  }
+}
+//< Values
+
+//> Blocks
+static void splitBlocks(Cfg *cfg) {
+  IrFunction *function = &ir->functions[cfg->function];
+  Instruction *instructions = &ir->instructions[function->firstInstruction];
+  int count = function->instructionCount;
+
+  if (ir->labelCount > labelCapacity) {
+    labelCapacity = ir->labelCount * 2;
+    labelBlock = newTable(labelCapacity);
+  }
+
+  // A label starts a block, and so does whatever follows a jump or return.
+  // Block 0 is an empty entry, so no edge ever leads back into the entry.
+  cfg->blockOf = newTable(count);
+  cfg->blockCount = 1;
+  for (int i = 0; i < count; i++) {
+    if (i == 0 || instructions[i].opcode == IR_LABEL ||
+        endsBlock(instructions[i - 1].opcode)) {
+      cfg->blockCount++;
+    }
+    cfg->blockOf[i] = cfg->blockCount - 1;
+
+    if (instructions[i].opcode == IR_LABEL) {
+      labelBlock[operandIndex(instructions[i].result)] = cfg->blockOf[i];
+    }
+  }
+
+  cfg->blocks = arenaAlloc(optArena,
+                           (cfg->blockCount + 1) * sizeof(BasicBlock));
+  memset(cfg->blocks, 0, (cfg->blockCount + 1) * sizeof(BasicBlock));
+  cfg->blocks[0].first = function->firstInstruction;
+  for (int i = count - 1; i >= 0; i--) {
+    BasicBlock *block = &cfg->blocks[cfg->blockOf[i]];
+    block->first = function->firstInstruction + i;
+    block->count++;
+  }
+}
+
+static void addSuccessor(BasicBlock *block, int32_t successor) {
+  // Both edges of a jump to the next block are one edge
+  if (block->successorCount == 0 || block->successors[0] != successor) {
+    block->successors[block->successorCount++] = successor;
+  }
+}
+
+static void linkBlocks(Cfg *cfg) {
+  for (int b = 0; b < cfg->blockCount; b++) {
+    BasicBlock *block = &cfg->blocks[b];
+    bool hasNext = b + 1 < cfg->blockCount;
+
+    if (block->count == 0) {
+      addSuccessor(block, b + 1);
+      continue;
+    }
+
+    Instruction *last = &ir->instructions[block->first + block->count - 1];
+    if (last->opcode == IR_JUMP) {
+      addSuccessor(block, labelBlock[operandIndex(last->result)]);
+    } else if (isConditionalJump(last->opcode)) {
+      if (hasNext) {
+        addSuccessor(block, b + 1);
+      }
+      addSuccessor(block, labelBlock[operandIndex(last->result)]);
+    } else if (last->opcode != IR_RETURN && hasNext) {
+      addSuccessor(block, b + 1);
+    }
+  }
+
+  // Predecessor lists, counted first so they pack into one table
+  int edgeCount = 0;
+  for (int b = 0; b < cfg->blockCount; b++) {
+    BasicBlock *block = &cfg->blocks[b];
+    for (int s = 0; s < block->successorCount; s++) {
+      cfg->blocks[block->successors[s]].predecessorCount++;
+      edgeCount++;
+    }
+  }
+
+  int next = 0;
+  for (int b = 0; b < cfg->blockCount; b++) {
+    cfg->blocks[b].firstPredecessor = next;
+    next += cfg->blocks[b].predecessorCount;
+    cfg->blocks[b].predecessorCount = 0;
+  }
+
+  cfg->predecessors = newTable(edgeCount);
+  for (int b = 0; b < cfg->blockCount; b++) {
+    BasicBlock *block = &cfg->blocks[b];
+    for (int s = 0; s < block->successorCount; s++) {
+      BasicBlock *successor = &cfg->blocks[block->successors[s]];
+      cfg->predecessors[successor->firstPredecessor +
+                        successor->predecessorCount++] = b;
+    }
+  }
+}
+
+// Depth-first from the entry with an explicit stack, deep graphs included
+static void orderBlocks(Cfg *cfg) {
+  int32_t *stack = newTable(cfg->blockCount);
+  int32_t *nextSuccessor = newTable(cfg->blockCount);
+  int32_t *postorder = newTable(cfg->blockCount);
+  int depth = 0;
+  int visited = 0;
+
+  for (int b = 0; b < cfg->blockCount; b++) {
+    cfg->blocks[b].order = -1;
+    nextSuccessor[b] = 0;
+  }
+
+  stack[depth++] = 0;
+  cfg->blocks[0].order = 0;
+  while (depth > 0) {
+    int b = stack[depth - 1];
+    BasicBlock *block = &cfg->blocks[b];
+
+    // The jump target first, so the fall-through code that ends up
+    // before it in reverse postorder; a loop body then comes right after
+    // its header, ahead of the code following the loop
+    if (nextSuccessor[b] < block->successorCount) {
+      int successor =
+          block->successors[block->successorCount - 1 - nextSuccessor[b]++];
+      if (cfg->blocks[successor].order == -1) {
+        cfg->blocks[successor].order = 0;
+        stack[depth++] = successor;
+      }
+    } else {
+      postorder[visited++] = b;
+      depth--;
+    }
+  }
+
+  cfg->orderCount = visited;
+  cfg->order = newTable(visited);
+  for (int i = 0; i < visited; i++) {
+    cfg->order[i] = postorder[visited - 1 - i];
+    cfg->blocks[cfg->order[i]].order = i;
+  }
+}
+//< Blocks
+
+//> Dominators
+static int32_t intersect(const Cfg *cfg, int32_t a, int32_t b) {
+  while (a != b) {
+    while (cfg->blocks[a].order > cfg->blocks[b].order) {
+      a = cfg->blocks[a].idom;
+    }
+    while (cfg->blocks[b].order > cfg->blocks[a].order) {
+      b = cfg->blocks[b].idom;
+    }
+  }
+  return a;
+}
+
+static void computeDominators(Cfg *cfg) {
+  for (int b = 0; b < cfg->blockCount; b++) {
+    cfg->blocks[b].idom = -1;
+  }
+  cfg->blocks[0].idom = 0;
+
+  bool isChanged = true;
+  while (isChanged) {
+    isChanged = false;
+
+    for (int i = 1; i < cfg->orderCount; i++) {
+      int b = cfg->order[i];
+      BasicBlock *block = &cfg->blocks[b];
+      int32_t idom = -1;
+
+      for (int p = 0; p < block->predecessorCount; p++) {
+        int32_t predecessor = predecessorOf(cfg, b, p);
+        if (cfg->blocks[predecessor].idom == -1) {
+          continue;
+        }
+        idom = idom == -1 ? predecessor : intersect(cfg, predecessor, idom);
+      }
+
+      if (idom != block->idom) {
+        block->idom = idom;
+        isChanged = true;
+      }
+    }
+  }
+
+  cfg->blocks[0].idom = -1;
+}
+
+static void buildDominatorTree(Cfg *cfg) {
+  for (int b = 0; b < cfg->blockCount; b++) {
+    cfg->blocks[b].firstChild = cfg->blocks[b].nextSibling = -1;
+    cfg->blocks[b].treeEnter = cfg->blocks[b].treeExit = -1;
+  }
+
+  // Backwards, so children end up in block order
+  for (int b = cfg->blockCount - 1; b > 0; b--) {
+    BasicBlock *block = &cfg->blocks[b];
+    if (block->idom != -1) {
+      block->nextSibling = cfg->blocks[block->idom].firstChild;
+      cfg->blocks[block->idom].firstChild = b;
+    }
+  }
+
+  // Depth-first numbering; nextChild walks each list as children are entered
+  int32_t *stack = newTable(cfg->blockCount);
+  int32_t *nextChild = newTable(cfg->blockCount);
+  int depth = 0;
+  int clock = 0;
+
+  stack[depth++] = 0;
+  nextChild[0] = cfg->blocks[0].firstChild;
+  cfg->blocks[0].treeEnter = clock++;
+  while (depth > 0) {
+    int b = stack[depth - 1];
+    int child = nextChild[b];
+
+    if (child != -1) {
+      nextChild[b] = cfg->blocks[child].nextSibling;
+      nextChild[child] = cfg->blocks[child].firstChild;
+      cfg->blocks[child].treeEnter = clock++;
+      stack[depth++] = child;
+    } else {
+      cfg->blocks[b].treeExit = clock++;
+      depth--;
+    }
+  }
+}
+
+bool dominates(const Cfg *cfg, int a, int b) {
+  const BasicBlock *dominator = &cfg->blocks[a];
+  const BasicBlock *block = &cfg->blocks[b];
+  return block->order != -1 && dominator->order != -1 &&
+         dominator->treeEnter <= block->treeEnter &&
+         block->treeExit <= dominator->treeExit;
+}
+
+// Walk up from every predecessor of a join until its idom: each block on
+// the way has the join in its frontier. Run twice, to count then to fill.
+static void computeFrontiers(Cfg *cfg) {
+  int32_t *lastJoin = newTable(cfg->blockCount);
+  int total = 0;
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (int b = 0; b < cfg->blockCount; b++) {
+      lastJoin[b] = -1;
+      if (pass == 0) {
+        cfg->blocks[b].frontierCount = 0;
+      }
+    }
+
+    for (int b = 0; b < cfg->blockCount; b++) {
+      BasicBlock *block = &cfg->blocks[b];
+      if (block->order == -1 || block->predecessorCount < 2) {
+        continue;
+      }
+
+      for (int p = 0; p < block->predecessorCount; p++) {
+        int32_t runner = predecessorOf(cfg, b, p);
+        if (cfg->blocks[runner].order == -1) {
+          continue;
+        }
+
+        while (runner != block->idom && lastJoin[runner] != b) {
+          BasicBlock *frontier = &cfg->blocks[runner];
+          lastJoin[runner] = b;
+          if (pass == 0) {
+            frontier->frontierCount++;
+          } else {
+            cfg->frontiers[frontier->firstFrontier +
+                           frontier->frontierCount++] = b;
+          }
+          runner = frontier->idom;
+          if (runner == -1) {
+            break;
+          }
+        }
+      }
+    }
+
+    if (pass == 0) {
+      for (int b = 0; b < cfg->blockCount; b++) {
+        cfg->blocks[b].firstFrontier = total;
+        total += cfg->blocks[b].frontierCount;
+        cfg->blocks[b].frontierCount = 0;
+      }
+      cfg->frontiers = newTable(total);
+    }
+  }
+}
+//< Dominators
+
+void buildCfg(Cfg *cfg, int function) {
+  cfg->function = function;
+  numberValues(cfg);
+  splitBlocks(cfg);
+  linkBlocks(cfg);
+  orderBlocks(cfg);
+  computeDominators(cfg);
+  buildDominatorTree(cfg);
+  computeFrontiers(cfg);
+}
@@ -0,0 +1,96 @@
+// Control-flow graph of a function: basic blocks over its instructions, the
+// dominator tree, dominance frontiers and a dense numbering of its values
+
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../codegen/ir.h"
+
+typedef struct {
+  int32_t first; // Index of the first instruction in ir->instructions
+  int32_t count;
+  int32_t successors[2]; // The fall-through successor comes first
+  int32_t successorCount;
+  int32_t firstPredecessor; // Into Cfg.predecessors, in block order
+  int32_t predecessorCount;
+  int32_t order; // Position in reverse postorder, -1 if unreachable
+
+  // Dominator tree; the entry and unreachable blocks have no idom
+  int32_t idom;
+  int32_t firstChild;
+  int32_t nextSibling;
+  int32_t treeEnter; // Preorder and postorder numbers in the tree
+  int32_t treeExit;
+
+  int32_t firstFrontier; // Into Cfg.frontiers
+  int32_t frontierCount;
+} BasicBlock;
+
+typedef struct {
+  int function;
+  // Block 0 is an empty entry that falls into the first instruction, so no
+  // edge ever leads back to the entry
+  BasicBlock *blocks;
+  int blockCount;
+  int32_t *predecessors;
+  int32_t *frontiers;
+  int32_t *order; // Reachable blocks in reverse postorder
+  int orderCount;
+  int32_t *blockOf; // Block of every instruction, by offset in the function
+
+  // Values are the variables the function owns, arrays included, then its
+  // temporaries: dense numbers the analyses index their bit sets with
+  int valueCount;
+  int32_t firstVariable;
+  int32_t variableCount;
+} Cfg;
+
+// Reset the tables the graphs share; the optimizer calls it once per run,
+// before any buildCfg, and its memory lives in optArena
+void initAnalysis();
+
+/**
+ * Split a function into basic blocks, link them, and compute the reverse
+ * postorder, the dominator tree (Cooper, Harvey and Kennedy's iterative
+ * algorithm) and the dominance frontiers.
+ *
+ * @param cfg The graph to fill, allocated in optArena.
+ * @param function Index of the function in ir->functions.
+ */
+void buildCfg(Cfg *cfg, int function);
+
+// Whether block a dominates block b, in constant time
+bool dominates(const Cfg *cfg, int a, int b);
+
+static inline int32_t predecessorOf(const Cfg *cfg, int block, int i) {
+  return cfg->predecessors[cfg->blocks[block].firstPredecessor + i];
+}
+
+/**
+ * Number of an operand among the values of the function.
+ *
+ * @return The value, or -1 for constants, labels, other functions and
+ *         temporaries added since the graph was built.
+ */
+int valueOf(const Cfg *cfg, Operand operand);
+
+// Operand of a value
+Operand valueOperand(const Cfg *cfg, int value);
+
+// Whether a value is a scalar: arrays are memory the analyses leave alone
+bool isScalarValue(const Cfg *cfg, int value);
+
+/**
+ * The values an instruction reads and the scalar value it writes. A store
+ * writes memory, not a value, and a load reads its array from memory.
+ *
+ * @param uses Filled with up to two values, -1 where there is none.
+ * @return The value the instruction defines, or -1.
+ */
+int instructionValues(const Cfg *cfg, const Instruction *instruction,
+                      int uses[2]);
+
+#endif
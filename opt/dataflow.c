@@ -0,0 +1,371 @@
+#include "dataflow.h"
+
+#include <string.h>
+
+#include "../common/arena.h"
+#include "passes.h"
+
+static BitWord *newSets(int blockCount, int words) {
+  size_t size = ((size_t)blockCount * words + 1) * sizeof(BitWord);
+  BitWord *sets = arenaAlloc(optArena, size);
+  memset(sets, 0, size);
+  return sets;
+}
+
+static int32_t *newTable(int count) {
+  return arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(int32_t));
+}
+
+void initDataflow(Dataflow *dataflow, const Cfg *cfg, int bitCount,
+                  bool isForward, bool isIntersection) {
+  dataflow->isForward = isForward;
+  dataflow->isIntersection = isIntersection;
+  dataflow->bitCount = bitCount;
+  dataflow->words = bitWords(bitCount);
+  dataflow->gen = newSets(cfg->blockCount, dataflow->words);
+  dataflow->kill = newSets(cfg->blockCount, dataflow->words);
+  dataflow->in = newSets(cfg->blockCount, dataflow->words);
+  dataflow->out = newSets(cfg->blockCount, dataflow->words);
+  dataflow->items = NULL;
+}
+
+//> Solver
+// Meet of the sets flowing into a block; unreachable neighbours have none
+static void meet(Dataflow *dataflow, const Cfg *cfg, int b, BitWord *target) {
+  const BasicBlock *block = &cfg->blocks[b];
+  BitWord *sources = dataflow->isForward ? dataflow->out : dataflow->in;
+  int count =
+      dataflow->isForward ? block->predecessorCount : block->successorCount;
+  bool isFirst = true;
+
+  for (int i = 0; i < count; i++) {
+    int neighbour = dataflow->isForward ? predecessorOf(cfg, b, i)
+                                        : block->successors[i];
+    if (cfg->blocks[neighbour].order == -1) {
+      continue;
+    }
+
+    BitWord *source = blockSet(sources, dataflow->words, neighbour);
+    if (isFirst) {
+      copyBits(target, source, dataflow->words);
+      isFirst = false;
+    } else if (dataflow->isIntersection) {
+      intersectBits(target, source, dataflow->words);
+    } else {
+      unionBits(target, source, dataflow->words);
+    }
+  }
+
+  // The boundary: nothing holds on entry to the function or after it
+  if (isFirst) {
+    clearBits(target, dataflow->words);
+  }
+}
+
+void solveDataflow(Dataflow *dataflow, const Cfg *cfg) {
+  int words = dataflow->words;
+  BitWord *meets = dataflow->isForward ? dataflow->in : dataflow->out;
+  BitWord *results = dataflow->isForward ? dataflow->out : dataflow->in;
+
+  // Optimistic start for intersections, so loops do not lose every fact
+  for (int i = 0; i < cfg->orderCount; i++) {
+    BitWord *result = blockSet(results, words, cfg->order[i]);
+    if (dataflow->isIntersection) {
+      fillBits(result, dataflow->bitCount);
+    } else {
+      clearBits(result, words);
+    }
+  }
+
+  // The worklist is a set of positions in reverse postorder (postorder
+  // when backward), and always gives back the earliest, so an inner loop
+  // settles before the blocks after it run again
+  int orderWords = bitWords(cfg->orderCount);
+  BitWord *pending = arenaAlloc(optArena, (orderWords + 1) * sizeof(BitWord));
+  int next = 0;
+
+  fillBits(pending, cfg->orderCount);
+  while ((next = nextBit(pending, orderWords, next)) != -1) {
+    int b = cfg->order[dataflow->isForward ? next
+                                           : cfg->orderCount - 1 - next];
+    clearBit(pending, next);
+
+    BitWord *input = blockSet(meets, words, b);
+    meet(dataflow, cfg, b, input);
+    if (!transferBits(blockSet(results, words, b),
+                      blockSet(dataflow->gen, words, b), input,
+                      blockSet(dataflow->kill, words, b), words)) {
+      continue;
+    }
+
+    const BasicBlock *block = &cfg->blocks[b];
+    int count =
+        dataflow->isForward ? block->successorCount : block->predecessorCount;
+    for (int i = 0; i < count; i++) {
+      int neighbour = dataflow->isForward ? block->successors[i]
+                                          : predecessorOf(cfg, b, i);
+      int position = cfg->blocks[neighbour].order;
+      if (position == -1) {
+        continue;
+      }
+
+      if (!dataflow->isForward) {
+        position = cfg->orderCount - 1 - position;
+      }
+      setBit(pending, position);
+      if (position < next) {
+        next = position;
+      }
+    }
+  }
+
+  // Unreachable blocks keep empty sets, whatever the start was
+  for (int b = 0; b < cfg->blockCount; b++) {
+    if (cfg->blocks[b].order == -1) {
+      clearBits(blockSet(dataflow->in, words, b), words);
+      clearBits(blockSet(dataflow->out, words, b), words);
+    }
+  }
+}
+//< Solver
+
+//> Liveness
+void computeLiveness(Dataflow *liveness, const Cfg *cfg) {
+  initDataflow(liveness, cfg, cfg->valueCount, false, false);
+
+  for (int b = 0; b < cfg->blockCount; b++) {
+    const BasicBlock *block = &cfg->blocks[b];
+    BitWord *gen = blockSet(liveness->gen, liveness->words, b);
+    BitWord *kill = blockSet(liveness->kill, liveness->words, b);
+
+    // Uses not preceded by a definition in the block are live on entry
+    for (int i = 0; i < block->count; i++) {
+      int uses[2];
+      int definition =
+          instructionValues(cfg, &ir->instructions[block->first + i], uses);
+
+      for (int u = 0; u < 2; u++) {
+        if (uses[u] != -1 && !hasBit(kill, uses[u])) {
+          setBit(gen, uses[u]);
+        }
+      }
+      if (definition != -1) {
+        setBit(kill, definition);
+      }
+    }
+  }
+
+  solveDataflow(liveness, cfg);
+}
+//< Liveness
+
+//> Reaching Definitions
+void computeReachingDefinitions(Dataflow *definitions, const Cfg *cfg) {
+  IrFunction *function = &ir->functions[cfg->function];
+  int instructionCount = function->instructionCount;
+  int32_t *bitOf = newTable(instructionCount);
+  int32_t *firstDefinition = newTable(cfg->valueCount + 1);
+  int32_t *next = newTable(cfg->valueCount);
+  int32_t *stamp = newTable(cfg->valueCount);
+  int count = 0;
+
+  // Number the definitions grouped by value, so each value's are a range
+  for (int v = 0; v <= cfg->valueCount; v++) {
+    firstDefinition[v] = 0;
+  }
+  for (int i = 0; i < instructionCount; i++) {
+    int uses[2];
+    bitOf[i] = instructionValues(
+        cfg, &ir->instructions[function->firstInstruction + i], uses);
+    if (bitOf[i] != -1) {
+      firstDefinition[bitOf[i] + 1]++;
+      count++;
+    }
+  }
+  for (int v = 0; v < cfg->valueCount; v++) {
+    firstDefinition[v + 1] += firstDefinition[v];
+    next[v] = firstDefinition[v];
+    stamp[v] = -1;
+  }
+
+  initDataflow(definitions, cfg, count, true, false);
+  definitions->items = newTable(count);
+  int32_t *valueOfBit = newTable(count);
+
+  for (int i = 0; i < instructionCount; i++) {
+    int value = bitOf[i];
+    if (value != -1) {
+      bitOf[i] = next[value]++;
+      definitions->items[bitOf[i]] = function->firstInstruction + i;
+      valueOfBit[bitOf[i]] = value;
+    }
+  }
+
+  // A block kills every definition of the values it defines, and generates
+  // the last one of each
+  for (int b = 0; b < cfg->blockCount; b++) {
+    const BasicBlock *block = &cfg->blocks[b];
+    BitWord *gen = blockSet(definitions->gen, definitions->words, b);
+    BitWord *kill = blockSet(definitions->kill, definitions->words, b);
+    int offset = block->first - function->firstInstruction;
+
+    for (int i = block->count - 1; i >= 0; i--) {
+      int bit = bitOf[offset + i];
+      if (bit == -1 || stamp[valueOfBit[bit]] == b) {
+        continue;
+      }
+
+      int value = valueOfBit[bit];
+      stamp[value] = b;
+      setBit(gen, bit);
+      for (int d = firstDefinition[value]; d < firstDefinition[value + 1];
+           d++) {
+        setBit(kill, d);
+      }
+    }
+  }
+
+  solveDataflow(definitions, cfg);
+}
+//< Reaching Definitions
+
+//> Available Expressions
+typedef struct {
+  uint8_t opcode;
+  uint8_t type;
+  Operand arg1;
+  Operand arg2;
+} ExpressionKey;
+
+static ExpressionKey keyOf(const Instruction *instruction) {
+  ExpressionKey key = {instruction->opcode, instruction->type,
+                       instruction->arg1, instruction->arg2};
+
+  if ((key.opcode == IR_ADD || key.opcode == IR_MUL) &&
+      valueHash(key.arg1) > valueHash(key.arg2)) {
+    key.arg1 = instruction->arg2;
+    key.arg2 = instruction->arg1;
+  }
+  return key;
+}
+
+void computeAvailableExpressions(Dataflow *expressions, const Cfg *cfg) {
+  IrFunction *function = &ir->functions[cfg->function];
+  int32_t *expressionOf = newTable(function->instructionCount);
+  ExpressionKey *keys = arenaAlloc(
+      optArena, (function->instructionCount + 1) * sizeof(ExpressionKey));
+  int32_t *items = newTable(function->instructionCount);
+  int count = 0;
+
+  // Number the distinct expressions through an open-addressed table
+  uint32_t slots = 16;
+  while (slots < 2 * (uint32_t)function->instructionCount + 2) {
+    slots *= 2;
+  }
+  int32_t *table = newTable(slots);
+  for (uint32_t i = 0; i < slots; i++) {
+    table[i] = -1;
+  }
+
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+    expressionOf[i] = -1;
+    if (!isExpression(instruction->opcode)) {
+      continue;
+    }
+
+    ExpressionKey key = keyOf(instruction);
+    uint32_t hash = (valueHash(key.arg1) * 31 + valueHash(key.arg2)) * 31 +
+                    key.opcode;
+    hash ^= hash >> 15;
+
+    uint32_t slot = hash & (slots - 1);
+    while (table[slot] != -1) {
+      ExpressionKey *other = &keys[table[slot]];
+      if (other->opcode == key.opcode && other->type == key.type &&
+          sameValue(other->arg1, key.arg1) &&
+          sameValue(other->arg2, key.arg2)) {
+        break;
+      }
+      slot = (slot + 1) & (slots - 1);
+    }
+
+    if (table[slot] == -1) {
+      table[slot] = count;
+      keys[count] = key;
+      items[count++] = function->firstInstruction + i;
+    }
+    expressionOf[i] = table[slot];
+  }
+
+  // Expressions using each value, arrays included for the loads from them
+  int32_t *firstUser = newTable(cfg->valueCount + 1);
+  int32_t *users = newTable(2 * count);
+  for (int v = 0; v <= cfg->valueCount; v++) {
+    firstUser[v] = 0;
+  }
+  for (int e = 0; e < count; e++) {
+    int left = valueOf(cfg, keys[e].arg1);
+    int right = valueOf(cfg, keys[e].arg2);
+    if (left != -1) {
+      firstUser[left + 1]++;
+    }
+    if (right != -1 && right != left) {
+      firstUser[right + 1]++;
+    }
+  }
+  for (int v = 0; v < cfg->valueCount; v++) {
+    firstUser[v + 1] += firstUser[v];
+  }
+  int32_t *nextUser = newTable(cfg->valueCount);
+  for (int v = 0; v < cfg->valueCount; v++) {
+    nextUser[v] = firstUser[v];
+  }
+  for (int e = 0; e < count; e++) {
+    int left = valueOf(cfg, keys[e].arg1);
+    int right = valueOf(cfg, keys[e].arg2);
+    if (left != -1) {
+      users[nextUser[left]++] = e;
+    }
+    if (right != -1 && right != left) {
+      users[nextUser[right]++] = e;
+    }
+  }
+
+  initDataflow(expressions, cfg, count, true, true);
+  expressions->items = items;
+
+  for (int b = 0; b < cfg->blockCount; b++) {
+    const BasicBlock *block = &cfg->blocks[b];
+    BitWord *gen = blockSet(expressions->gen, expressions->words, b);
+    BitWord *kill = blockSet(expressions->kill, expressions->words, b);
+    int offset = block->first - function->firstInstruction;
+
+    for (int i = 0; i < block->count; i++) {
+      Instruction *instruction = &ir->instructions[block->first + i];
+      int uses[2];
+      int written = instructionValues(cfg, instruction, uses);
+
+      if (expressionOf[offset + i] != -1) {
+        setBit(gen, expressionOf[offset + i]);
+      }
+
+      // A store overwrites its array, which kills the loads from it
+      if (instruction->opcode == IR_STORE) {
+        written = valueOf(cfg, instruction->result);
+      }
+      if (written == -1) {
+        continue;
+      }
+
+      for (int u = firstUser[written]; u < firstUser[written + 1]; u++) {
+        clearBit(gen, users[u]);
+        setBit(kill, users[u]);
+      }
+    }
+  }
+
+  solveDataflow(expressions, cfg);
+}
+//< Available Expressions
@@ -0,0 +1,66 @@
+// Iterative bit-vector dataflow over a control-flow graph, and the classic
+// problems built on it: liveness, reaching definitions and available
+// expressions
+
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include "bitset.h"
+#include "cfg.h"
+
+typedef struct {
+  bool isForward;
+  bool isIntersection; // Meet by intersection, "on every path"; else union
+  int bitCount;
+  int words; // Words in each set
+
+  // One set per block, blockCount * words words each; the problem fills
+  // gen and kill, solveDataflow fills in and out
+  BitWord *gen;
+  BitWord *kill;
+  BitWord *in;
+  BitWord *out;
+
+  // What every bit stands for: an instruction index for definitions and
+  // expressions, nothing for liveness, whose bits are values
+  int32_t *items;
+} Dataflow;
+
+static inline BitWord *blockSet(BitWord *sets, int words, int block) {
+  return &sets[(size_t)block * words];
+}
+
+/**
+ * Allocate the sets of a problem in optArena, gen and kill cleared.
+ *
+ * @param dataflow The problem to set up.
+ * @param cfg The graph it runs on.
+ * @param bitCount Number of facts.
+ * @param isForward Whether facts flow along the edges, or against them.
+ * @param isIntersection Whether a fact must hold on every incoming path.
+ */
+void initDataflow(Dataflow *dataflow, const Cfg *cfg, int bitCount,
+                  bool isForward, bool isIntersection);
+
+/**
+ * Solve a problem to its fixed point with a worklist seeded in reverse
+ * postorder, or postorder going backwards. The boundary set, in of the
+ * entry or out of the exits, is empty; every other set starts full for an
+ * intersection and empty for a union. Unreachable blocks keep empty sets.
+ *
+ * @param dataflow The problem, with gen and kill filled.
+ * @param cfg The graph it runs on.
+ */
+void solveDataflow(Dataflow *dataflow, const Cfg *cfg);
+
+// Values live on entry to and exit from every block; the bits are values
+void computeLiveness(Dataflow *liveness, const Cfg *cfg);
+
+// Definitions of scalar values that reach every block; a value with none
+// reaching still holds its value from the function's entry
+void computeReachingDefinitions(Dataflow *definitions, const Cfg *cfg);
+
+// Expressions computed on every path to a block, and not overwritten since
+void computeAvailableExpressions(Dataflow *expressions, const Cfg *cfg);
+
+#endif
@@ -0,0 +1,378 @@
+// Inlining: calls to small functions that are not recursive are replaced
+// with a copy of the callee's body, callees before their callers so a
+// caller takes in code that is already inlined
+
+#include <stdint.h>
+
+#include "../common/arena.h"
+#include "../semantic/semantic.h"
+#include "passes.h"
+
+// Largest callee a call is replaced with, labels not counted: its params,
+// the call and the return cost about as much as a few instructions, and
+// a bigger body gains little for the code it copies
+#define MAX_INLINED_SIZE 32
+// A caller stops taking in callees at this size
+#define MAX_CALLER_SIZE 4096
+
+// Per function, indexed like ir->functions
+static int32_t *visitOrder; // -1 until the call graph walk reaches it
+static int32_t *lowLink;
+static bool *isOnStack;
+static bool *isRecursive;
+static bool *hasArrays;
+static bool *mayFail; // A runtime error names the function it happens in
+static int32_t *variableCounts; // Parameters and locals
+static int32_t *sizes;          // Instructions, labels not counted
+
+static int32_t *stack;
+static int stackDepth;
+static int32_t *bottomUp; // Functions, callees before their callers
+static int bottomUpCount;
+static int visited;
+
+// New label of every label of the callee being copied
+static int32_t *labelCopies;
+static int labelCopyCapacity;
+
+static int32_t *newTable(int count) {
+  return arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(int32_t));
+}
+
+static bool *newFlags(int count) {
+  bool *flags = arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(bool));
+  for (int i = 0; i < count; i++) {
+    flags[i] = false;
+  }
+  return flags;
+}
+
+static int sizeOf(const IrFunction *function) {
+  int size = 0;
+  for (int i = 0; i < function->instructionCount; i++) {
+    uint8_t opcode = ir->instructions[function->firstInstruction + i].opcode;
+    size += opcode != IR_NOP && opcode != IR_LABEL;
+  }
+  return size;
+}
+
+//> Call Graph
+// Tarjan's strongly connected components: a component is complete once
+// every function it calls is, which orders the functions bottom-up, and
+// a function is recursive when it calls itself or shares its component
+static void visit(int f) {
+  const IrFunction *function = &ir->functions[f];
+
+  visitOrder[f] = lowLink[f] = visited++;
+  stack[stackDepth++] = f;
+  isOnStack[f] = true;
+
+  for (int i = 0; i < function->instructionCount; i++) {
+    const Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+    if (instruction->opcode != IR_CALL) {
+      continue;
+    }
+
+    int callee = (int)operandIndex(instruction->arg1);
+    if (callee == f) {
+      isRecursive[f] = true;
+    } else if (visitOrder[callee] == -1) {
+      visit(callee);
+      lowLink[f] = lowLink[callee] < lowLink[f] ? lowLink[callee] : lowLink[f];
+    } else if (isOnStack[callee] && visitOrder[callee] < lowLink[f]) {
+      lowLink[f] = visitOrder[callee];
+    }
+  }
+
+  if (lowLink[f] != visitOrder[f]) {
+    return;
+  }
+
+  int first = bottomUpCount;
+  int member;
+  do {
+    member = stack[--stackDepth];
+    isOnStack[member] = false;
+    bottomUp[bottomUpCount++] = member;
+  } while (member != f);
+
+  if (bottomUpCount - first > 1) {
+    for (int k = first; k < bottomUpCount; k++) {
+      isRecursive[bottomUp[k]] = true;
+    }
+  }
+}
+
+static void buildCallGraph() {
+  int count = ir->functionCount;
+
+  visitOrder = newTable(count);
+  lowLink = newTable(count);
+  stack = newTable(count);
+  bottomUp = newTable(count);
+  variableCounts = newTable(count);
+  sizes = newTable(count);
+  isOnStack = newFlags(count);
+  isRecursive = newFlags(count);
+  hasArrays = newFlags(count);
+  mayFail = newFlags(count);
+  stackDepth = 0;
+  bottomUpCount = 0;
+  visited = 0;
+
+  for (int f = 0; f < count; f++) {
+    const IrFunction *function = &ir->functions[f];
+    int v = function->firstParam;
+
+    // The program's variables are the globals, which it never passes on
+    while (f != ir->entry && v < ir->variableCount &&
+           ir->variables[v].function == f) {
+      hasArrays[f] |= ir->variables[v].arraySize > 0;
+      v++;
+    }
+    variableCounts[f] = v - function->firstParam;
+    visitOrder[f] = -1;
+
+    for (int i = 0; i < function->instructionCount; i++) {
+      const Instruction *instruction =
+          &ir->instructions[function->firstInstruction + i];
+      mayFail[f] |= (instruction->opcode == IR_DIV ||
+                     instruction->opcode == IR_MOD) &&
+                    !isRemovable(instruction);
+    }
+  }
+
+  for (int f = 0; f < count; f++) {
+    if (visitOrder[f] == -1) {
+      visit(f);
+    }
+  }
+}
+//< Call Graph
+
+// Functions cannot refer to globals, a local array has no temporary to
+// live in, and a division by zero has to be reported in its own function
+static bool isInlinable(int callee) {
+  return callee != ir->entry && !isRecursive[callee] && !hasArrays[callee] &&
+         !mayFail[callee] && sizes[callee] <= MAX_INLINED_SIZE;
+}
+
+static void mapLabels(const IrFunction *callee) {
+  if (ir->labelCount > labelCopyCapacity) {
+    labelCopyCapacity =
+        ir->labelCount > 2 * labelCopyCapacity ? ir->labelCount
+                                              : 2 * labelCopyCapacity;
+    labelCopies = newTable(labelCopyCapacity);
+  }
+
+  for (int i = 0; i < callee->instructionCount; i++) {
+    const Instruction *instruction =
+        &ir->instructions[callee->firstInstruction + i];
+    if (instruction->opcode == IR_LABEL) {
+      labelCopies[operandIndex(instruction->result)] =
+          (int32_t)operandIndex(newLabel());
+    }
+  }
+}
+
+// A callee's temporaries, then its parameters and locals, become the
+// caller's temporaries from first on
+static Operand mapOperand(Operand operand, const IrFunction *callee,
+                          int32_t first) {
+  uint32_t index = operandIndex(operand);
+
+  switch (operandKind(operand)) {
+  case OPERAND_TEMP:
+    return makeOperand(OPERAND_TEMP, first + index - callee->firstTemp);
+  case OPERAND_VARIABLE:
+    return makeOperand(OPERAND_TEMP, first + callee->tempCount + index -
+                                         callee->firstParam);
+  case OPERAND_LABEL:
+    return makeOperand(OPERAND_LABEL, (uint32_t)labelCopies[index]);
+  default:
+    return operand;
+  }
+}
+
+/**
+ * Copy a callee's body in place of a call.
+ *
+ * @param code The caller's new code, ending in the call's params.
+ * @param count Instructions in code.
+ * @param firstParam Index of the call's first param in code.
+ * @param call The call.
+ * @param first The first of the temporaries the callee's values become.
+ * @return Instructions in code now.
+ */
+static int expandCall(Instruction *code, int count, int firstParam,
+                      const Instruction *call, int32_t first) {
+  int f = (int)operandIndex(call->arg1);
+  const IrFunction *callee = &ir->functions[f];
+
+  // The params set the parameters, and the locals start at zero
+  for (int p = 0; p < callee->paramCount; p++) {
+    Instruction *param = &code[firstParam + p];
+    param->opcode = IR_COPY;
+    param->type = ir->variables[callee->firstParam + p].type;
+    param->result = mapOperand(
+        makeOperand(OPERAND_VARIABLE, callee->firstParam + p), callee, first);
+  }
+  for (int v = callee->paramCount; v < variableCounts[f]; v++) {
+    int type = ir->variables[callee->firstParam + v].type;
+    code[count++] = (Instruction){
+        .opcode = IR_COPY,
+        .type = (uint8_t)type,
+        .result = mapOperand(
+            makeOperand(OPERAND_VARIABLE, callee->firstParam + v), callee,
+            first),
+        .arg1 = type == INT ? intConstant(0) : doubleConstant(0),
+    };
+  }
+
+  mapLabels(callee);
+
+  // A return sets the call's result and leaves, and code no jump reaches
+  // after it, like the return every function ends with, is left out
+  Operand end = newLabel();
+  int exits = 0;
+  bool isReachable = true;
+  for (int i = 0; i < callee->instructionCount; i++) {
+    Instruction instruction = ir->instructions[callee->firstInstruction + i];
+
+    isReachable |= instruction.opcode == IR_LABEL;
+    if (instruction.opcode == IR_NOP || !isReachable) {
+      continue;
+    }
+    isReachable =
+        instruction.opcode != IR_JUMP && instruction.opcode != IR_RETURN;
+
+    if (instruction.opcode == IR_RETURN) {
+      code[count++] = (Instruction){
+          .opcode = IR_COPY,
+          .type = call->type,
+          .result = call->result,
+          .arg1 = mapOperand(instruction.arg1, callee, first),
+      };
+      code[count++] = (Instruction){.opcode = IR_JUMP, .result = end};
+      exits++;
+      continue;
+    }
+
+    instruction.result = mapOperand(instruction.result, callee, first);
+    instruction.arg1 = mapOperand(instruction.arg1, callee, first);
+    instruction.arg2 = mapOperand(instruction.arg2, callee, first);
+    code[count++] = instruction;
+  }
+
+  // The last return falls out instead
+  if (code[count - 1].opcode == IR_JUMP && code[count - 1].result == end) {
+    count--;
+    exits--;
+  }
+  if (exits > 0) {
+    code[count++] = (Instruction){.opcode = IR_LABEL, .result = end};
+  }
+  return count;
+}
+
+static bool inlineInto(int f) {
+  IrFunction *caller = &ir->functions[f];
+  int32_t *firstTemps = newTable(caller->instructionCount);
+  int size = sizeOf(caller);
+  int extra = 0;
+  int params = 0;
+  bool isChanged = false;
+
+  // Pick the calls to inline, while the caller has room for them
+  for (int i = 0; i < caller->instructionCount; i++) {
+    const Instruction *instruction =
+        &ir->instructions[caller->firstInstruction + i];
+    firstTemps[i] = -1;
+    params += instruction->opcode == IR_PARAM;
+    if (instruction->opcode != IR_CALL) {
+      continue;
+    }
+
+    int callee = (int)operandIndex(instruction->arg1);
+    if (isInlinable(callee) && params == ir->functions[callee].paramCount &&
+        size + sizes[callee] <= MAX_CALLER_SIZE) {
+      firstTemps[i] = 0;
+      size += sizes[callee];
+      extra += ir->functions[callee].instructionCount + variableCounts[callee] +
+               2;
+      isChanged = true;
+    }
+    params = 0;
+  }
+
+  if (!isChanged) {
+    return false;
+  }
+
+  // Every temporary first, adding them may renumber the caller's own
+  for (int i = 0; i < caller->instructionCount; i++) {
+    if (firstTemps[i] == -1) {
+      continue;
+    }
+
+    int callee =
+        (int)operandIndex(ir->instructions[caller->firstInstruction + i].arg1);
+    const IrFunction *function = &ir->functions[callee];
+    int temps = function->tempCount + variableCounts[callee];
+    for (int t = 0; t < temps; t++) {
+      int type = t < function->tempCount
+                     ? ir->tempTypes[function->firstTemp + t]
+                     : ir->variables[function->firstParam + t -
+                                    function->tempCount]
+                           .type;
+      int32_t temp = (int32_t)operandIndex(addTemp(f, type));
+      firstTemps[i] = t == 0 ? temp : firstTemps[i];
+    }
+  }
+
+  Instruction *code = arenaAlloc(
+      optArena, (caller->instructionCount + extra + 1) * sizeof(Instruction));
+  int count = 0;
+  int firstParam = -1;
+
+  for (int i = 0; i < caller->instructionCount; i++) {
+    Instruction instruction = ir->instructions[caller->firstInstruction + i];
+
+    if (instruction.opcode == IR_NOP) {
+      continue;
+    }
+    if (instruction.opcode == IR_PARAM && firstParam == -1) {
+      firstParam = count;
+    }
+    if (instruction.opcode == IR_CALL) {
+      if (firstTemps[i] != -1) {
+        count = expandCall(code, count, firstParam, &instruction,
+                           firstTemps[i]);
+        firstParam = -1;
+        continue;
+      }
+      firstParam = -1;
+    }
+    code[count++] = instruction;
+  }
+
+  replaceCode(f, code, count);
+  return true;
+}
+
+bool inlineCalls() {
+  bool isChanged = false;
+
+  labelCopies = NULL;
+  labelCopyCapacity = 0;
+  buildCallGraph();
+
+  for (int k = 0; k < bottomUpCount; k++) {
+    int f = bottomUp[k];
+    isChanged |= inlineInto(f);
+    sizes[f] = sizeOf(&ir->functions[f]);
+  }
+
+  return isChanged;
+}
@@ -0,0 +1,763 @@
+// Local passes: each one looks at a single instruction, or at the straight
+// line of instructions of one basic block at a time
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../common/arena.h"
+#include "../semantic/semantic.h"
+#include "passes.h"
+
+//> Versions
+// Every definition gives its operand a new version. A fact the passes
+// remember about some operands holds as long as their versions are still
+// the ones it recorded, so nothing has to be invalidated by hand.
+static uint32_t clock;
+static uint32_t *variableVersions;
+static uint32_t *tempVersions;
+
+// Basic block being scanned; entries stamped with another one are stale
+static uint32_t block;
+
+static uint32_t *versionOf(Operand operand) {
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    return &variableVersions[operandIndex(operand)];
+  case OPERAND_TEMP:
+    return &tempVersions[operandIndex(operand)];
+  default:
+    return NULL;
+  }
+}
+
+static uint32_t version(Operand operand) {
+  uint32_t *version = versionOf(operand);
+  return version ? *version : 0;
+}
+
+static void define(Operand operand) {
+  uint32_t *version = versionOf(operand);
+  if (version) {
+    *version = ++clock;
+  }
+}
+
+// Operand an instruction writes: its result, or the array a store changes
+static Operand definedOperand(const Instruction *instruction) {
+  switch (instruction->opcode) {
+  case IR_COPY:
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_DIV:
+  case IR_MOD:
+  case IR_SHL:
+  case IR_MOD_POW2:
+  case IR_LOAD:
+  case IR_STORE:
+  case IR_CALL:
+    return instruction->result;
+  default:
+    return NO_OPERAND;
+  }
+}
+
+// Labels start a basic block, jumps and returns end one
+static bool startsBlock(const Instruction *instruction) {
+  return instruction->opcode == IR_LABEL;
+}
+
+static bool endsBlock(const Instruction *instruction) {
+  return (instruction->opcode >= IR_JUMP &&
+          instruction->opcode <= IR_JUMP_NE) ||
+         instruction->opcode == IR_RETURN;
+}
+//< Versions
+
+//> Operands
+static IrConstant *constantOf(Operand operand) {
+  return operandKind(operand) == OPERAND_CONSTANT
+             ? &ir->constants[operandIndex(operand)]
+             : NULL;
+}
+
+static bool isIntConstant(Operand operand, int64_t value) {
+  IrConstant *constant = constantOf(operand);
+  return constant && constant->type == INT && constant->intValue == value;
+}
+
+// Compared bit for bit, so 0.0 and -0.0 differ
+static bool isDoubleConstant(Operand operand, double value) {
+  IrConstant *constant = constantOf(operand);
+  return constant && constant->type == DOUBLE &&
+         memcmp(&constant->doubleValue, &value, sizeof(double)) == 0;
+}
+
+static bool isValue(Operand operand) {
+  return operandKind(operand) == OPERAND_VARIABLE ||
+         operandKind(operand) == OPERAND_TEMP;
+}
+
+bool sameValue(Operand a, Operand b) {
+  if (a == b) {
+    return true;
+  }
+
+  IrConstant *x = constantOf(a);
+  IrConstant *y = constantOf(b);
+  return x && y && x->type == y->type && x->intValue == y->intValue;
+}
+
+uint32_t valueHash(Operand operand) {
+  IrConstant *constant = constantOf(operand);
+  if (!constant) {
+    return operand;
+  }
+
+  uint64_t bits = (uint64_t)constant->intValue;
+  return (uint32_t)(bits ^ (bits >> 32)) * 0x9e3779b1u + constant->type;
+}
+
+// k for a constant 2^k, -1 for anything else
+static int powerOfTwo(Operand operand) {
+  IrConstant *constant = constantOf(operand);
+  if (!constant || constant->type != INT || constant->intValue < 2 ||
+      (constant->intValue & (constant->intValue - 1)) != 0) {
+    return -1;
+  }
+
+  int shift = 0;
+  while (((int64_t)1 << shift) != constant->intValue) {
+    shift++;
+  }
+  return shift;
+}
+
+static void rewrite(Instruction *instruction, IrOpcode opcode, Operand arg1,
+                    Operand arg2) {
+  // Copying a value onto itself is no instruction at all
+  if (opcode == IR_COPY && instruction->result == arg1) {
+    opcode = IR_NOP;
+  }
+
+  instruction->opcode = (uint8_t)opcode;
+  instruction->arg1 = arg1;
+  instruction->arg2 = arg2;
+}
+
+static void copyValue(Instruction *instruction, Operand value) {
+  rewrite(instruction, IR_COPY, value, NO_OPERAND);
+}
+
+// Turn a conditional jump whose outcome is known into a jump or nothing
+static void settleJump(Instruction *instruction, bool isTaken) {
+  rewrite(instruction, isTaken ? IR_JUMP : IR_NOP, NO_OPERAND, NO_OPERAND);
+}
+//< Operands
+
+//> Copy Propagation
+// Operand a value was last copied from, while neither changes
+typedef struct {
+  uint32_t block;
+  Operand source;
+  uint32_t version;
+  uint32_t sourceVersion;
+} Copy;
+
+static Copy *variableCopies;
+static Copy *tempCopies;
+
+static Copy *copyOf(Operand operand) {
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    return &variableCopies[operandIndex(operand)];
+  case OPERAND_TEMP:
+    return &tempCopies[operandIndex(operand)];
+  default:
+    return NULL;
+  }
+}
+
+static Operand propagate(Operand operand) {
+  Copy *copy = copyOf(operand);
+  if (!copy || copy->block != block || copy->version != version(operand) ||
+      copy->sourceVersion != version(copy->source)) {
+    return operand;
+  }
+  return copy->source;
+}
+
+// Replace the operands of an instruction by the values they were copied
+// from. A load's first operand is the array itself, a call's the function.
+static bool propagateOperands(Instruction *instruction) {
+  Operand arg1 = instruction->arg1;
+  Operand arg2 = propagate(instruction->arg2);
+  if (instruction->opcode != IR_LOAD && instruction->opcode != IR_CALL) {
+    arg1 = propagate(arg1);
+  }
+
+  if (arg1 == instruction->arg1 && arg2 == instruction->arg2) {
+    return false;
+  }
+
+  instruction->arg1 = arg1;
+  instruction->arg2 = arg2;
+  return true;
+}
+
+// Give the operand an instruction writes a new version, and remember the
+// copy if the instruction is one worth propagating
+static void trackDefinition(const Instruction *instruction, bool isCopy) {
+  define(definedOperand(instruction));
+
+  if (isCopy) {
+    *copyOf(instruction->result) = (Copy){
+        .block = block,
+        .source = instruction->arg1,
+        .version = version(instruction->result),
+        .sourceVersion = version(instruction->arg1),
+    };
+  }
+}
+
+bool propagateCopies(IrFunction *function) {
+  bool isChanged = false;
+
+  block++;
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+
+    if (startsBlock(instruction)) {
+      block++;
+    }
+
+    isChanged |= propagateOperands(instruction);
+
+    if (instruction->opcode == IR_COPY &&
+        instruction->result == instruction->arg1) {
+      instruction->opcode = IR_NOP;
+      isChanged = true;
+      continue;
+    }
+
+    trackDefinition(instruction, instruction->opcode == IR_COPY);
+
+    if (endsBlock(instruction)) {
+      block++;
+    }
+  }
+
+  return isChanged;
+}
+//< Copy Propagation
+
+//> Constant Folding
+// Integer arithmetic wraps, as it does at run time; a division by zero
+// stays in the code to fail there
+static bool foldInt(uint8_t opcode, int64_t a, int64_t b, int64_t *result) {
+  switch (opcode) {
+  case IR_ADD:
+    *result = (int64_t)((uint64_t)a + (uint64_t)b);
+    return true;
+  case IR_SUB:
+    *result = (int64_t)((uint64_t)a - (uint64_t)b);
+    return true;
+  case IR_MUL:
+    *result = (int64_t)((uint64_t)a * (uint64_t)b);
+    return true;
+  case IR_SHL:
+    *result = (int64_t)((uint64_t)a << b);
+    return true;
+  case IR_DIV:
+    if (b == 0) {
+      return false;
+    }
+    *result = b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;
+    return true;
+  case IR_MOD:
+  case IR_MOD_POW2:
+    if (b == 0) {
+      return false;
+    }
+    *result = b == -1 ? 0 : a % b;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool foldDouble(uint8_t opcode, double a, double b, double *result) {
+  switch (opcode) {
+  case IR_ADD:
+    *result = a + b;
+    return true;
+  case IR_SUB:
+    *result = a - b;
+    return true;
+  case IR_MUL:
+    *result = a * b;
+    return true;
+  case IR_DIV:
+    *result = a / b;
+    return true;
+  case IR_MOD:
+    *result = fmod(a, b);
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool compareInts(uint8_t opcode, int64_t a, int64_t b) {
+  switch (opcode) {
+  case IR_JUMP_LT:
+    return a < b;
+  case IR_JUMP_LE:
+    return a <= b;
+  case IR_JUMP_GT:
+    return a > b;
+  case IR_JUMP_GE:
+    return a >= b;
+  case IR_JUMP_EQ:
+    return a == b;
+  default:
+    return a != b;
+  }
+}
+
+// No comparison holds for NaN but <>, as at run time
+static bool compareDoubles(uint8_t opcode, double a, double b) {
+  switch (opcode) {
+  case IR_JUMP_LT:
+    return a < b;
+  case IR_JUMP_LE:
+    return a <= b;
+  case IR_JUMP_GT:
+    return a > b;
+  case IR_JUMP_GE:
+    return a >= b;
+  case IR_JUMP_EQ:
+    return a == b;
+  default:
+    return a != b;
+  }
+}
+
+static void foldInstruction(Instruction *instruction) {
+  IrConstant *left = constantOf(instruction->arg1);
+  IrConstant *right = constantOf(instruction->arg2);
+  bool isDouble = instruction->type == DOUBLE;
+
+  if (instruction->opcode >= IR_JUMP_LT && instruction->opcode <= IR_JUMP_NE) {
+    settleJump(instruction,
+               isDouble ? compareDoubles(instruction->opcode,
+                                         left->doubleValue,
+                                         right->doubleValue)
+                        : compareInts(instruction->opcode, left->intValue,
+                                      right->intValue));
+    return;
+  }
+
+  // The constant table may move as constants are added, read it first
+  if (isDouble) {
+    double value;
+    if (foldDouble(instruction->opcode, left->doubleValue,
+                   right->doubleValue, &value)) {
+      copyValue(instruction, doubleConstant(value));
+    }
+  } else {
+    int64_t value;
+    if (foldInt(instruction->opcode, left->intValue, right->intValue,
+                &value)) {
+      copyValue(instruction, intConstant(value));
+    }
+  }
+}
+
+// Constants assigned earlier in the block are propagated as the block is
+// folded, so a chain of them collapses in one sweep
+bool foldConstants(IrFunction *function) {
+  bool isChanged = false;
+
+  block++;
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+    uint8_t opcode = instruction->opcode;
+
+    if (startsBlock(instruction)) {
+      block++;
+    }
+
+    // Only constants are tracked, so propagating gives constants only
+    isChanged |= propagateOperands(instruction);
+
+    if (constantOf(instruction->arg1) && constantOf(instruction->arg2)) {
+      foldInstruction(instruction);
+      isChanged |= instruction->opcode != opcode;
+    }
+
+    trackDefinition(instruction, instruction->opcode == IR_COPY &&
+                                     constantOf(instruction->arg1));
+
+    // A settled jump may have gone, the block ends where it was
+    if (endsBlock(instruction) ||
+        (opcode >= IR_JUMP_LT && opcode <= IR_JUMP_NE)) {
+      block++;
+    }
+  }
+
+  return isChanged;
+}
+//< Constant Folding
+
+//> Algebraic Simplification
+static bool simplifyInt(Instruction *instruction) {
+  Operand x = instruction->arg1;
+  Operand y = instruction->arg2;
+  int shift;
+
+  switch (instruction->opcode) {
+  case IR_ADD:
+    if (isIntConstant(y, 0)) {
+      copyValue(instruction, x);
+    } else if (isIntConstant(x, 0)) {
+      copyValue(instruction, y);
+    } else {
+      return false;
+    }
+    return true;
+  case IR_SUB:
+    if (isIntConstant(y, 0)) {
+      copyValue(instruction, x);
+    } else if (x == y && isValue(x)) {
+      copyValue(instruction, intConstant(0));
+    } else {
+      return false;
+    }
+    return true;
+  case IR_MUL:
+    if (isIntConstant(x, 0) || isIntConstant(y, 0)) {
+      copyValue(instruction, intConstant(0));
+    } else if (isIntConstant(y, 1)) {
+      copyValue(instruction, x);
+    } else if (isIntConstant(x, 1)) {
+      copyValue(instruction, y);
+    } else if ((shift = powerOfTwo(y)) > 0 && shift < 63) {
+      rewrite(instruction, IR_SHL, x, intConstant(shift));
+    } else if ((shift = powerOfTwo(x)) > 0 && shift < 63) {
+      rewrite(instruction, IR_SHL, y, intConstant(shift));
+    } else {
+      return false;
+    }
+    return true;
+  case IR_DIV:
+    if (!isIntConstant(y, 1)) {
+      return false;
+    }
+    copyValue(instruction, x);
+    return true;
+  case IR_MOD:
+    // The remainder keeps the dividend's sign, so x % 2^k is not just a
+    // mask: IR_MOD_POW2 corrects negative dividends without a division
+    if (isIntConstant(y, 1) || isIntConstant(y, -1)) {
+      copyValue(instruction, intConstant(0));
+    } else if ((shift = powerOfTwo(y)) > 0 && shift < 63) {
+      rewrite(instruction, IR_MOD_POW2, x, y);
+    } else {
+      return false;
+    }
+    return true;
+  case IR_JUMP_LT:
+  case IR_JUMP_GT:
+  case IR_JUMP_NE:
+    if (x != y || !isValue(x)) {
+      return false;
+    }
+    settleJump(instruction, false);
+    return true;
+  case IR_JUMP_LE:
+  case IR_JUMP_GE:
+  case IR_JUMP_EQ:
+    if (x != y || !isValue(x)) {
+      return false;
+    }
+    settleJump(instruction, true);
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Only rewrites that give the same bits for every double, NaN and -0.0
+// included: x + 0.0 is -0.0 + 0.0 = 0.0, so it stays
+static bool simplifyDouble(Instruction *instruction) {
+  Operand x = instruction->arg1;
+  Operand y = instruction->arg2;
+
+  switch (instruction->opcode) {
+  case IR_ADD:
+    if (!isDoubleConstant(y, -0.0)) {
+      return false;
+    }
+    copyValue(instruction, x);
+    return true;
+  case IR_SUB:
+    if (!isDoubleConstant(y, 0.0)) {
+      return false;
+    }
+    copyValue(instruction, x);
+    return true;
+  case IR_MUL:
+    if (isDoubleConstant(y, 1.0)) {
+      copyValue(instruction, x);
+    } else if (isDoubleConstant(x, 1.0)) {
+      copyValue(instruction, y);
+    } else if (isDoubleConstant(y, 2.0)) {
+      rewrite(instruction, IR_ADD, x, x);
+    } else if (isDoubleConstant(x, 2.0)) {
+      rewrite(instruction, IR_ADD, y, y);
+    } else {
+      return false;
+    }
+    return true;
+  case IR_DIV:
+    if (!isDoubleConstant(y, 1.0)) {
+      return false;
+    }
+    copyValue(instruction, x);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool simplifyAlgebra(IrFunction *function) {
+  bool isChanged = false;
+
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+
+    isChanged |= instruction->type == DOUBLE ? simplifyDouble(instruction)
+                                             : simplifyInt(instruction);
+  }
+
+  return isChanged;
+}
+//< Algebraic Simplification
+
+//> Common Subexpressions
+// An expression computed earlier in the block, and the operand holding it
+typedef struct {
+  uint32_t block;
+  uint8_t opcode;
+  uint8_t type;
+  Operand arg1;
+  Operand arg2;
+  Operand holder;
+  uint32_t arg1Version;
+  uint32_t arg2Version;
+  uint32_t holderVersion;
+} Expression;
+
+// Open addressing, at least twice as many slots as a function has
+// instructions, so a block never fills it
+static Expression *expressions;
+static uint32_t expressionMask;
+
+bool isExpression(uint8_t opcode) {
+  return (opcode >= IR_ADD && opcode <= IR_LOAD) || opcode == IR_SHL ||
+         opcode == IR_MOD_POW2;
+}
+
+// Slot of the expression, or the free slot it would go in
+static Expression *findExpression(uint8_t opcode, uint8_t type, Operand arg1,
+                                  Operand arg2) {
+  uint32_t hash = (valueHash(arg1) * 31 + valueHash(arg2)) * 31 + opcode;
+  hash ^= hash >> 15;
+
+  for (uint32_t i = hash & expressionMask;; i = (i + 1) & expressionMask) {
+    Expression *expression = &expressions[i];
+    if (expression->block != block ||
+        (expression->opcode == opcode && expression->type == type &&
+         sameValue(expression->arg1, arg1) &&
+         sameValue(expression->arg2, arg2))) {
+      return expression;
+    }
+  }
+}
+
+static bool isAvailable(const Expression *expression) {
+  return expression->block == block &&
+         version(expression->arg1) == expression->arg1Version &&
+         version(expression->arg2) == expression->arg2Version &&
+         version(expression->holder) == expression->holderVersion;
+}
+
+bool eliminateCommonSubexpressions(IrFunction *function) {
+  bool isChanged = false;
+
+  block++;
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+
+    if (startsBlock(instruction)) {
+      block++;
+    }
+
+    if (isExpression(instruction->opcode)) {
+      Operand arg1 = instruction->arg1;
+      Operand arg2 = instruction->arg2;
+
+      // Commutative operations are keyed with their operands in order
+      if ((instruction->opcode == IR_ADD || instruction->opcode == IR_MUL) &&
+          valueHash(arg1) > valueHash(arg2)) {
+        Operand swap = arg1;
+        arg1 = arg2;
+        arg2 = swap;
+      }
+
+      Expression *expression =
+          findExpression(instruction->opcode, instruction->type, arg1, arg2);
+
+      if (isAvailable(expression)) {
+        copyValue(instruction, expression->holder);
+        isChanged = true;
+        if (instruction->opcode == IR_NOP) {
+          continue;
+        }
+      } else {
+        // Versions of the operands before the result overwrites one
+        *expression = (Expression){
+            .block = block,
+            .opcode = instruction->opcode,
+            .type = instruction->type,
+            .arg1 = arg1,
+            .arg2 = arg2,
+            .holder = instruction->result,
+            .arg1Version = version(arg1),
+            .arg2Version = version(arg2),
+        };
+        define(instruction->result);
+        expression->holderVersion = version(instruction->result);
+        continue;
+      }
+    }
+
+    define(definedOperand(instruction));
+
+    if (endsBlock(instruction)) {
+      block++;
+    }
+  }
+
+  return isChanged;
+}
+//< Common Subexpressions
+
+
+//> Dead Temporaries
+static int32_t *useCounts;
+
+static void countUse(Operand operand, int32_t delta) {
+  if (operandKind(operand) == OPERAND_TEMP) {
+    useCounts[operandIndex(operand)] += delta;
+  }
+}
+
+bool isRemovable(const Instruction *instruction) {
+  IrConstant *right = constantOf(instruction->arg2);
+
+  switch (instruction->opcode) {
+  case IR_COPY:
+  case IR_ADD:
+  case IR_SUB:
+  case IR_MUL:
+  case IR_SHL:
+  case IR_MOD_POW2:
+    return true;
+  case IR_DIV:
+  case IR_MOD:
+    return instruction->type == DOUBLE || (right && right->intValue != 0);
+  case IR_LOAD:
+    return right && right->intValue >= 0 &&
+           right->intValue <
+               ir->variables[operandIndex(instruction->arg1)].arraySize;
+  default:
+    return false;
+  }
+}
+
+bool eliminateDeadTemps(IrFunction *function) {
+  Instruction *instructions = &ir->instructions[function->firstInstruction];
+  bool isChanged = false;
+  bool isRemoving = true;
+
+  memset(&useCounts[function->firstTemp], 0,
+         function->tempCount * sizeof(int32_t));
+  for (int i = 0; i < function->instructionCount; i++) {
+    countUse(instructions[i].arg1, 1);
+    countUse(instructions[i].arg2, 1);
+  }
+
+  // Backwards, so a chain of dead temporaries goes in one sweep
+  while (isRemoving) {
+    isRemoving = false;
+
+    for (int i = function->instructionCount - 1; i >= 0; i--) {
+      Instruction *instruction = &instructions[i];
+
+      if (operandKind(instruction->result) != OPERAND_TEMP ||
+          useCounts[operandIndex(instruction->result)] > 0 ||
+          !isRemovable(instruction)) {
+        continue;
+      }
+
+      countUse(instruction->arg1, -1);
+      countUse(instruction->arg2, -1);
+      instruction->opcode = IR_NOP;
+      instruction->result = NO_OPERAND;
+      isRemoving = isChanged = true;
+    }
+  }
+
+  return isChanged;
+}
+//< Dead Temporaries
+
+void initLocalPasses() {
+  int largestFunction = 0;
+  for (int f = 0; f < ir->functionCount; f++) {
+    if (ir->functions[f].instructionCount > largestFunction) {
+      largestFunction = ir->functions[f].instructionCount;
+    }
+  }
+
+  uint32_t slots = 16;
+  while (slots < 2 * (uint32_t)largestFunction + 2) {
+    slots *= 2;
+  }
+  expressionMask = slots - 1;
+
+  // Stamps start at 1, so zeroed entries belong to no block
+  clock = 0;
+  block = 1;
+  expressions = arenaAlloc(optArena, slots * sizeof(Expression));
+  memset(expressions, 0, slots * sizeof(Expression));
+
+  size_t variables = (size_t)ir->variableCount + 1;
+  size_t temps = (size_t)ir->tempCount + 1;
+  variableVersions = arenaAlloc(optArena, variables * sizeof(uint32_t));
+  tempVersions = arenaAlloc(optArena, temps * sizeof(uint32_t));
+  variableCopies = arenaAlloc(optArena, variables * sizeof(Copy));
+  tempCopies = arenaAlloc(optArena, temps * sizeof(Copy));
+  useCounts = arenaAlloc(optArena, temps * sizeof(int32_t));
+  memset(variableVersions, 0, variables * sizeof(uint32_t));
+  memset(tempVersions, 0, temps * sizeof(uint32_t));
+  memset(variableCopies, 0, variables * sizeof(Copy));
+  memset(tempCopies, 0, temps * sizeof(Copy));
+}
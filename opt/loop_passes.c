@@ -0,0 +1,852 @@
+// Loop passes: invariant code motion, strength reduction of induction
+// variables and unrolling, over the natural loops of one function at a time
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../common/arena.h"
+#include "../semantic/semantic.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "loops.h"
+#include "opt.h"
+#include "passes.h"
+
+// Instructions unrolling may add to a loop
+#define MAX_UNROLLED_INSTRUCTIONS 256
+// Largest step of an induction variable unrolling handles, so the bound
+// it checks for the whole unrolled iteration never overflows
+#define MAX_UNROLLED_STEP (1 << 20)
+
+static int unrollFactor = 1;
+
+// Function being optimized, and its analyses
+static IrFunction *current;
+static int functionIndex;
+static Cfg cfg;
+static LoopForest forest;
+
+static int32_t *newTable(int count) {
+  return arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(int32_t));
+}
+
+static Instruction *at(int offset) {
+  return &ir->instructions[current->firstInstruction + offset];
+}
+
+static int offsetOf(int block) {
+  return cfg.blocks[block].first - current->firstInstruction;
+}
+
+// Last instruction of a block, NULL for an empty one
+static Instruction *lastOf(int block) {
+  const BasicBlock *basicBlock = &cfg.blocks[block];
+  return basicBlock->count == 0
+             ? NULL
+             : &ir->instructions[basicBlock->first + basicBlock->count - 1];
+}
+
+static Instruction makeInstruction(IrOpcode opcode, Operand result,
+                                   Operand arg1, Operand arg2) {
+  return (Instruction){
+      .opcode = (uint8_t)opcode,
+      .type = INT,
+      .result = result,
+      .arg1 = arg1,
+      .arg2 = arg2,
+  };
+}
+
+static bool isIntConstant(Operand operand, int64_t *value) {
+  if (operandKind(operand) != OPERAND_CONSTANT ||
+      ir->constants[operandIndex(operand)].type != INT) {
+    return false;
+  }
+  *value = ir->constants[operandIndex(operand)].intValue;
+  return true;
+}
+
+static bool isJump(uint8_t opcode) {
+  return opcode >= IR_JUMP && opcode <= IR_JUMP_NE;
+}
+
+//> Edits
+// Code the passes add goes in front of an instruction of the original
+// code, keyed twice its offset. Code that carries on from the instruction
+// before goes first, with the even key: a jump to the label in front of
+// which it lands did not run that instruction.
+typedef struct {
+  int32_t key;
+  Instruction instruction;
+} Insertion;
+
+static Insertion *insertions;
+static int insertionCount;
+static int insertionCapacity;
+
+// Offset of the code run once before each loop, see preheaderOf
+static int32_t *preheaders;
+
+static void insert(int32_t key, Instruction instruction) {
+  if (insertionCount == insertionCapacity) {
+    int capacity = insertionCapacity == 0 ? 16 : insertionCapacity * 2;
+    insertions = arenaGrow(optArena, insertions,
+                           insertionCapacity * sizeof(Insertion),
+                           capacity * sizeof(Insertion));
+    insertionCapacity = capacity;
+  }
+  insertions[insertionCount++] = (Insertion){key, instruction};
+}
+
+static void insertBefore(int offset, Instruction instruction) {
+  insert(2 * offset + 1, instruction);
+}
+
+static void insertAfter(int offset, Instruction instruction) {
+  insert(2 * (offset + 1), instruction);
+}
+
+static void renumberTemp(Operand *operand, int32_t from, int32_t to) {
+  if (operandKind(*operand) == OPERAND_TEMP) {
+    *operand = makeOperand(OPERAND_TEMP, operandIndex(*operand) - from + to);
+  }
+}
+
+// A new integer temporary of the function. Adding it may move the
+// function's temporaries to the end of the table, which renumbers its code
+// but not the code waiting to go in, so that is renumbered here.
+static Operand addIntTemp() {
+  int32_t first = current->firstTemp;
+  Operand temp = addTemp(functionIndex, INT);
+
+  if (current->firstTemp != first) {
+    for (int i = 0; i < insertionCount; i++) {
+      Instruction *instruction = &insertions[i].instruction;
+      renumberTemp(&instruction->result, first, current->firstTemp);
+      renumberTemp(&instruction->arg1, first, current->firstTemp);
+      renumberTemp(&instruction->arg2, first, current->firstTemp);
+    }
+  }
+  return temp;
+}
+
+// Rebuild the function with the insertions in place, in the order they
+// were made where keys are equal
+static bool applyEdits() {
+  if (insertionCount == 0) {
+    return false;
+  }
+
+  int count = current->instructionCount;
+  int keys = 2 * count + 2;
+  int32_t *firstOfKey = newTable(keys + 1);
+  Insertion *sorted =
+      arenaAlloc(optArena, (insertionCount + 1) * sizeof(Insertion));
+
+  memset(firstOfKey, 0, (keys + 1) * sizeof(int32_t));
+  for (int i = 0; i < insertionCount; i++) {
+    firstOfKey[insertions[i].key + 1]++;
+  }
+  for (int key = 0; key < keys; key++) {
+    firstOfKey[key + 1] += firstOfKey[key];
+  }
+  for (int i = 0; i < insertionCount; i++) {
+    sorted[firstOfKey[insertions[i].key]++] = insertions[i];
+  }
+
+  Instruction *code = arenaAlloc(
+      optArena, (count + insertionCount + 1) * sizeof(Instruction));
+  int length = 0;
+  int next = 0;
+  for (int offset = 0; offset <= count; offset++) {
+    while (next < insertionCount && sorted[next].key <= 2 * offset + 1) {
+      code[length++] = sorted[next++].instruction;
+    }
+    if (offset < count && at(offset)->opcode != IR_NOP) {
+      code[length++] = *at(offset);
+    }
+  }
+
+  replaceCode(functionIndex, code, length);
+  return true;
+}
+
+// Offset in front of which code that runs once before a loop goes: the
+// loop's header, which the block laid out before it falls into. Jumps from
+// outside the loop to the header move to a new label put there first.
+// -1 when a block of the loop itself falls into the header.
+static int preheaderOf(int loop) {
+  int header = forest.loops[loop].header;
+  const BasicBlock *block = &cfg.blocks[header];
+  Operand label = block->count > 0 ? ir->instructions[block->first].result
+                                   : NO_OPERAND;
+  bool isJumpedTo = false;
+
+  if (preheaders[loop] != -2) {
+    return preheaders[loop];
+  }
+
+  preheaders[loop] = -1;
+  if (block->count == 0 ||
+      ir->instructions[block->first].opcode != IR_LABEL) {
+    return -1;
+  }
+
+  for (int p = 0; p < block->predecessorCount; p++) {
+    int predecessor = predecessorOf(&cfg, header, p);
+    Instruction *last = lastOf(predecessor);
+    bool isJumping = last && isJump(last->opcode) && last->result == label;
+
+    if (isInLoop(&forest, loop, predecessor)) {
+      if (predecessor == header - 1 &&
+          (!last || last->opcode != IR_JUMP)) {
+        return -1;
+      }
+    } else if (isJumping) {
+      isJumpedTo = true;
+    }
+  }
+
+  if (isJumpedTo) {
+    Operand entry = newLabel();
+    for (int p = 0; p < block->predecessorCount; p++) {
+      int predecessor = predecessorOf(&cfg, header, p);
+      Instruction *last = lastOf(predecessor);
+      if (!isInLoop(&forest, loop, predecessor) && last &&
+          isJump(last->opcode) && last->result == label) {
+        last->result = entry;
+      }
+    }
+    insertBefore(offsetOf(header), makeInstruction(IR_LABEL, entry,
+                                                   NO_OPERAND, NO_OPERAND));
+  }
+
+  preheaders[loop] = offsetOf(header);
+  return preheaders[loop];
+}
+//< Edits
+
+//> Definitions
+// Definitions of every value in the function, and inside the loop last
+// counted, with the offset of the last one there
+static int32_t *functionDefinitions;
+static int32_t *loopDefinitions;
+static int32_t *definingOffset;
+static int32_t *countedLoop;
+// Loop whose code last stored to each array
+static int32_t *storingLoop;
+
+// Build the graph and the loops of a function, false if it has no loop
+static bool beginLoops(IrFunction *function) {
+  current = function;
+  functionIndex = (int)(function - ir->functions);
+  buildCfg(&cfg, functionIndex);
+  findLoops(&forest, &cfg);
+
+  insertions = NULL;
+  insertionCount = insertionCapacity = 0;
+  if (forest.loopCount == 0) {
+    return false;
+  }
+
+  preheaders = newTable(forest.loopCount);
+  for (int l = 0; l < forest.loopCount; l++) {
+    preheaders[l] = -2;
+  }
+
+  functionDefinitions = newTable(cfg.valueCount);
+  loopDefinitions = newTable(cfg.valueCount);
+  definingOffset = newTable(cfg.valueCount);
+  countedLoop = newTable(cfg.valueCount);
+  storingLoop = newTable(cfg.valueCount);
+  for (int v = 0; v < cfg.valueCount; v++) {
+    functionDefinitions[v] = 0;
+    countedLoop[v] = storingLoop[v] = -1;
+  }
+
+  for (int i = 0; i < current->instructionCount; i++) {
+    int uses[2];
+    int value = instructionValues(&cfg, at(i), uses);
+    if (value != -1) {
+      functionDefinitions[value]++;
+    }
+  }
+  return true;
+}
+
+static void countLoopDefinitions(int loop) {
+  const Loop *counted = &forest.loops[loop];
+
+  for (int k = 0; k < counted->blockCount; k++) {
+    const BasicBlock *block =
+        &cfg.blocks[forest.blocks[counted->firstBlock + k]];
+    int offset = block->first - current->firstInstruction;
+
+    for (int i = offset; i < offset + block->count; i++) {
+      int uses[2];
+      int value = instructionValues(&cfg, at(i), uses);
+
+      if (at(i)->opcode == IR_STORE) {
+        int array = valueOf(&cfg, at(i)->result);
+        if (array != -1) {
+          storingLoop[array] = loop;
+        }
+      }
+      if (value == -1) {
+        continue;
+      }
+      if (countedLoop[value] != loop) {
+        countedLoop[value] = loop;
+        loopDefinitions[value] = 0;
+      }
+      loopDefinitions[value]++;
+      definingOffset[value] = i;
+    }
+  }
+}
+
+static int definitionsInLoop(int loop, int value) {
+  return countedLoop[value] == loop ? loopDefinitions[value] : 0;
+}
+
+// Step of a basic induction variable of the loop, whose one definition in
+// the loop adds a constant to it; 0 if the value is not one
+static int64_t stepOf(int loop, int value) {
+  int64_t step;
+
+  if (value == -1 || !isScalarValue(&cfg, value) ||
+      definitionsInLoop(loop, value) != 1) {
+    return 0;
+  }
+
+  Operand self = valueOperand(&cfg, value);
+  const Instruction *definition = at(definingOffset[value]);
+  if (definition->type != INT || definition->result != self) {
+    return 0;
+  }
+
+  switch (definition->opcode) {
+  case IR_ADD:
+    if ((definition->arg1 == self && isIntConstant(definition->arg2, &step)) ||
+        (definition->arg2 == self && isIntConstant(definition->arg1, &step))) {
+      return step;
+    }
+    return 0;
+  case IR_SUB:
+    if (definition->arg1 == self && isIntConstant(definition->arg2, &step)) {
+      return (int64_t)(0 - (uint64_t)step);
+    }
+    return 0;
+  default:
+    return 0;
+  }
+}
+//< Definitions
+
+//> Invariant Code Motion
+static Dataflow liveness;
+// Loop whose preheader each value's definition moved to
+static int32_t *hoistedTo;
+// Values live on leaving the loop last asked about
+static BitWord *liveOnExit;
+static int liveOnExitLoop;
+
+static bool isLiveOnExit(int loop, int value) {
+  const Loop *exited = &forest.loops[loop];
+
+  if (liveOnExitLoop != loop) {
+    liveOnExitLoop = loop;
+    clearBits(liveOnExit, liveness.words);
+    for (int k = 0; k < exited->blockCount; k++) {
+      const BasicBlock *block =
+          &cfg.blocks[forest.blocks[exited->firstBlock + k]];
+      for (int s = 0; s < block->successorCount; s++) {
+        if (!isInLoop(&forest, loop, block->successors[s])) {
+          unionBits(liveOnExit,
+                    blockSet(liveness.in, liveness.words, block->successors[s]),
+                    liveness.words);
+        }
+      }
+    }
+  }
+  return hasBit(liveOnExit, value);
+}
+
+// An instruction computes the same value on every iteration when its
+// operands do, and it can run before the loop when it has no effect but
+// its result, that result is not read before it in the loop, and it is the
+// only definition anything after the loop may see
+static bool isInvariant(int loop, const Instruction *instruction) {
+  int uses[2];
+  int value = instructionValues(&cfg, instruction, uses);
+  const BitWord *liveIn =
+      blockSet(liveness.in, liveness.words, forest.loops[loop].header);
+
+  if (value == -1 ||
+      (!isExpression(instruction->opcode) && instruction->opcode != IR_COPY) ||
+      !isRemovable(instruction) || definitionsInLoop(loop, value) != 1 ||
+      hasBit(liveIn, value)) {
+    return false;
+  }
+
+  if (value >= cfg.variableCount ? functionDefinitions[value] != 1
+                                 : isLiveOnExit(loop, value)) {
+    return false;
+  }
+
+  if (instruction->opcode == IR_LOAD &&
+      storingLoop[valueOf(&cfg, instruction->arg1)] == loop) {
+    return false;
+  }
+
+  for (int u = 0; u < 2; u++) {
+    if (uses[u] != -1 && definitionsInLoop(loop, uses[u]) > 0 &&
+        hoistedTo[uses[u]] != loop) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool hoistInvariants(IrFunction *function) {
+  if (!beginLoops(function)) {
+    return false;
+  }
+
+  computeLiveness(&liveness, &cfg);
+  hoistedTo = newTable(cfg.valueCount);
+  liveOnExit = arenaAlloc(optArena, (liveness.words + 1) * sizeof(BitWord));
+  liveOnExitLoop = -1;
+  for (int v = 0; v < cfg.valueCount; v++) {
+    hoistedTo[v] = -1;
+  }
+
+  // Outer loops first, so code leaves every loop it does not depend on at
+  // once; the blocks in reverse postorder, so definitions move before
+  // their uses do
+  for (int l = 0; l < forest.loopCount; l++) {
+    const Loop *loop = &forest.loops[l];
+    countLoopDefinitions(l);
+
+    for (int k = 0; k < loop->blockCount; k++) {
+      const BasicBlock *block =
+          &cfg.blocks[forest.blocks[loop->firstBlock + k]];
+
+      for (int i = 0; i < block->count; i++) {
+        Instruction *instruction = &ir->instructions[block->first + i];
+        if (!isInvariant(l, instruction)) {
+          continue;
+        }
+
+        int preheader = preheaderOf(l);
+        if (preheader == -1) {
+          break;
+        }
+
+        int uses[2];
+        hoistedTo[instructionValues(&cfg, instruction, uses)] = l;
+        insertBefore(preheader, *instruction);
+        instruction->opcode = IR_NOP;
+        instruction->result = NO_OPERAND;
+      }
+    }
+  }
+
+  return applyEdits();
+}
+//< Invariant Code Motion
+
+//> Induction Variables
+// A derived induction variable: scale * base + offset, where base is a
+// basic induction variable, kept up to date by a temporary of its own
+typedef struct {
+  int32_t base;
+  int64_t scale;
+  int64_t offset;
+  Operand temp;
+} Induction;
+
+static int32_t *inductionLoop; // Loop in which a temporary is one, or -1
+static Induction *inductions;  // By value, valid where inductionLoop says
+static int32_t *chainUses;     // Uses by a longer induction expression
+static int32_t *useCounts;
+
+// The induction variable an instruction of the loop computes from another
+// one, by adding or multiplying a constant, into *induction
+static bool isInduction(int loop, const Instruction *instruction,
+                        Induction *induction) {
+  int result = valueOf(&cfg, instruction->result);
+  Operand source = instruction->arg1;
+  int64_t constant;
+
+  if (instruction->type != INT || result < cfg.variableCount ||
+      functionDefinitions[result] != 1) {
+    return false;
+  }
+
+  switch (instruction->opcode) {
+  case IR_ADD:
+  case IR_MUL:
+    if (!isIntConstant(instruction->arg2, &constant)) {
+      source = instruction->arg2;
+      if (!isIntConstant(instruction->arg1, &constant)) {
+        return false;
+      }
+    }
+    break;
+  case IR_SUB:
+  case IR_SHL:
+    if (!isIntConstant(instruction->arg2, &constant) ||
+        (instruction->opcode == IR_SHL && (constant < 0 || constant > 62))) {
+      return false;
+    }
+    break;
+  default:
+    return false;
+  }
+
+  int value = valueOf(&cfg, source);
+  if (value == -1) {
+    return false;
+  }
+  if (inductionLoop[value] == loop) {
+    *induction = inductions[value];
+  } else if (stepOf(loop, value) != 0) {
+    *induction = (Induction){.base = value, .scale = 1, .offset = 0};
+  } else {
+    return false;
+  }
+
+  // Integers wrap, so the arithmetic is done unsigned
+  uint64_t scale = (uint64_t)induction->scale;
+  uint64_t offset = (uint64_t)induction->offset;
+  switch (instruction->opcode) {
+  case IR_ADD:
+    offset += (uint64_t)constant;
+    break;
+  case IR_SUB:
+    offset -= (uint64_t)constant;
+    break;
+  case IR_MUL:
+    scale *= (uint64_t)constant;
+    offset *= (uint64_t)constant;
+    break;
+  default:
+    scale <<= constant;
+    offset <<= constant;
+    break;
+  }
+  induction->scale = (int64_t)scale;
+  induction->offset = (int64_t)offset;
+
+  if (inductionLoop[value] == loop) {
+    chainUses[value]++;
+  }
+  return true;
+}
+
+// Temporary holding an induction variable of the loop: set before the
+// loop, and stepped right after its base is
+static Operand inductionTemp(int loop, Induction *induction,
+                             Induction *made, int *madeCount) {
+  for (int i = 0; i < *madeCount; i++) {
+    if (made[i].base == induction->base && made[i].scale == induction->scale &&
+        made[i].offset == induction->offset) {
+      return made[i].temp;
+    }
+  }
+
+  int preheader = preheaderOf(loop);
+  if (preheader == -1) {
+    return NO_OPERAND;
+  }
+
+  // May renumber the function's temporaries, so operands come after it
+  Operand temp = addIntTemp();
+  Operand base = valueOperand(&cfg, induction->base);
+  uint64_t step =
+      (uint64_t)stepOf(loop, induction->base) * (uint64_t)induction->scale;
+
+  insertBefore(preheader,
+               makeInstruction(IR_MUL, temp, base,
+                               intConstant(induction->scale)));
+  if (induction->offset != 0) {
+    insertBefore(preheader, makeInstruction(IR_ADD, temp, temp,
+                                            intConstant(induction->offset)));
+  }
+  insertAfter(definingOffset[induction->base],
+              makeInstruction(IR_ADD, temp, temp,
+                              intConstant((int64_t)step)));
+
+  induction->temp = temp;
+  made[(*madeCount)++] = *induction;
+  return temp;
+}
+
+bool reduceInductionVariables(IrFunction *function) {
+  if (!beginLoops(function)) {
+    return false;
+  }
+
+  inductionLoop = newTable(cfg.valueCount);
+  chainUses = newTable(cfg.valueCount);
+  useCounts = newTable(cfg.valueCount);
+  inductions = arenaAlloc(optArena, (cfg.valueCount + 1) * sizeof(Induction));
+  for (int v = 0; v < cfg.valueCount; v++) {
+    inductionLoop[v] = -1;
+    useCounts[v] = 0;
+  }
+  for (int i = 0; i < current->instructionCount; i++) {
+    int uses[2];
+    instructionValues(&cfg, at(i), uses);
+    for (int u = 0; u < 2; u++) {
+      if (uses[u] != -1) {
+        useCounts[uses[u]]++;
+      }
+    }
+  }
+
+  int32_t *candidates = newTable(current->instructionCount);
+  Induction *made = arenaAlloc(
+      optArena, (current->instructionCount + 1) * sizeof(Induction));
+
+  // Inner loops first: their induction variables step most often
+  for (int l = forest.loopCount - 1; l >= 0; l--) {
+    const Loop *loop = &forest.loops[l];
+    int candidateCount = 0;
+    int madeCount = 0;
+
+    countLoopDefinitions(l);
+    for (int k = 0; k < loop->blockCount; k++) {
+      const BasicBlock *block =
+          &cfg.blocks[forest.blocks[loop->firstBlock + k]];
+      int offset = block->first - current->firstInstruction;
+
+      for (int i = offset; i < offset + block->count; i++) {
+        Induction induction;
+        if (!isInduction(l, at(i), &induction)) {
+          continue;
+        }
+
+        int result = valueOf(&cfg, at(i)->result);
+        inductionLoop[result] = l;
+        inductions[result] = induction;
+        chainUses[result] = 0;
+        candidates[candidateCount++] = i;
+      }
+    }
+
+    // Only the ends of chains are worth a temporary, and only those that
+    // multiply: an addition would just trade for another one
+    for (int c = 0; c < candidateCount; c++) {
+      Instruction *instruction = at(candidates[c]);
+      int result = valueOf(&cfg, instruction->result);
+      Induction *induction = &inductions[result];
+
+      if (induction->scale == 1 || useCounts[result] == chainUses[result]) {
+        continue;
+      }
+
+      Operand temp = inductionTemp(l, induction, made, &madeCount);
+      if (temp == NO_OPERAND) {
+        break;
+      }
+      instruction = at(candidates[c]);
+      instruction->opcode = IR_COPY;
+      instruction->arg1 = temp;
+      instruction->arg2 = NO_OPERAND;
+    }
+  }
+
+  return applyEdits();
+}
+//< Induction Variables
+
+//> Unrolling
+// A loop unrolls when it is the shape a while loop takes: a header that
+// tests a basic induction variable against an invariant bound and leaves,
+// then the body, laid out in one piece and ending in the only jump back
+static int32_t *labelCopies; // Label of the current copy, or -1
+static int labelCopyCount;    // Labels there were before the pass
+
+void setUnrollFactor(int factor) { unrollFactor = factor; }
+
+static IrOpcode mirrored(IrOpcode opcode) {
+  switch (opcode) {
+  case IR_JUMP_LT:
+    return IR_JUMP_GT;
+  case IR_JUMP_LE:
+    return IR_JUMP_GE;
+  case IR_JUMP_GT:
+    return IR_JUMP_LT;
+  case IR_JUMP_GE:
+    return IR_JUMP_LE;
+  default:
+    return opcode;
+  }
+}
+
+// Where a while loop's blocks are one run from header to latch, the
+// offset of the jump back, or -1
+static int latchJumpOf(int loop) {
+  const Loop *unrolled = &forest.loops[loop];
+  int header = unrolled->header;
+  int latch = header + unrolled->blockCount - 1;
+  int backEdges = 0;
+
+  for (int k = 0; k < unrolled->blockCount; k++) {
+    int block = forest.blocks[unrolled->firstBlock + k];
+    if (block < header || block > latch) {
+      return -1;
+    }
+  }
+  for (int p = 0; p < cfg.blocks[header].predecessorCount; p++) {
+    if (isInLoop(&forest, loop, predecessorOf(&cfg, header, p))) {
+      backEdges++;
+    }
+  }
+
+  Instruction *jump = lastOf(latch);
+  if (backEdges != 1 || latch == header || !jump ||
+      jump->opcode != IR_JUMP ||
+      jump->result != ir->instructions[cfg.blocks[header].first].result) {
+    return -1;
+  }
+  return offsetOf(latch) + cfg.blocks[latch].count - 1;
+}
+
+// Copy the loop's body, all but its header's label and test and the jump
+// back, with labels of its own
+static void copyBody(int first, int end, int test, int preheader) {
+  for (int i = first; i < end; i++) {
+    if (at(i)->opcode == IR_LABEL) {
+      labelCopies[operandIndex(at(i)->result)] = (int32_t)newLabel();
+    }
+  }
+
+  for (int i = first; i < end; i++) {
+    Instruction copy = *at(i);
+    if (i == test) {
+      continue;
+    }
+    if ((copy.opcode == IR_LABEL || isJump(copy.opcode)) &&
+        (int)operandIndex(copy.result) < labelCopyCount &&
+        labelCopies[operandIndex(copy.result)] != -1) {
+      copy.result = (Operand)labelCopies[operandIndex(copy.result)];
+    }
+    insertBefore(preheader, copy);
+  }
+}
+
+static bool unrollLoop(int loop) {
+  const Loop *unrolled = &forest.loops[loop];
+  int header = unrolled->header;
+  int latchJump = latchJumpOf(loop);
+  Instruction *test = lastOf(header);
+
+  if (!unrolled->isInnermost || latchJump == -1 || !test ||
+      test->opcode < IR_JUMP_LT || test->opcode > IR_JUMP_GE ||
+      test->type != INT || cfg.blocks[header].successorCount != 2 ||
+      isInLoop(&forest, loop, cfg.blocks[header].successors[1])) {
+    return false;
+  }
+
+  // The test, as: leave when the induction variable compares so to bound
+  countLoopDefinitions(loop);
+  IrOpcode comparison = test->opcode;
+  int variable = valueOf(&cfg, test->arg1);
+  Operand bound = test->arg2;
+  int64_t step = stepOf(loop, variable);
+  if (step == 0) {
+    comparison = mirrored(comparison);
+    variable = valueOf(&cfg, test->arg2);
+    bound = test->arg1;
+    step = stepOf(loop, variable);
+  }
+
+  int boundValue = valueOf(&cfg, bound);
+  int64_t constantBound = 0;
+  bool isConstant = isIntConstant(bound, &constantBound);
+  if (step == 0 || step > MAX_UNROLLED_STEP || step < -MAX_UNROLLED_STEP ||
+      (!isConstant &&
+       (boundValue == -1 || definitionsInLoop(loop, boundValue) != 0)) ||
+      (step > 0) != (comparison == IR_JUMP_GT || comparison == IR_JUMP_GE)) {
+    return false;
+  }
+
+  // It has to step once in every iteration
+  int latch = header + unrolled->blockCount - 1;
+  if (!dominates(&cfg, cfg.blockOf[definingOffset[variable]], latch)) {
+    return false;
+  }
+
+  int first = offsetOf(header) + 1;
+  int testOffset = offsetOf(header) + cfg.blocks[header].count - 1;
+  if ((latchJump - first - 1) * unrollFactor > MAX_UNROLLED_INSTRUCTIONS) {
+    return false;
+  }
+
+  // The copies run while the last of them would still pass the test: the
+  // variable compares to bound - (factor - 1) * step as the test does. A
+  // bound too close to the end of the integers to take that off runs the
+  // loop as it was.
+  int64_t reach = (int64_t)(unrollFactor - 1) * step;
+  if (isConstant && (step > 0 ? constantBound < INT64_MIN + reach
+                              : constantBound > INT64_MAX + reach)) {
+    return false;
+  }
+
+  int preheader = preheaderOf(loop);
+  if (preheader == -1) {
+    return false;
+  }
+
+  Operand limit = NO_OPERAND;
+  Operand remainder = ir->instructions[cfg.blocks[header].first].result;
+  if (isConstant) {
+    limit = intConstant(constantBound - reach);
+  } else {
+    // May renumber the function's temporaries, so operands come after it
+    limit = addIntTemp();
+    bound = valueOperand(&cfg, boundValue);
+    insertBefore(preheader,
+                 makeInstruction(step > 0 ? IR_JUMP_LT : IR_JUMP_GT,
+                                 remainder, bound,
+                                 intConstant(step > 0 ? INT64_MIN + reach
+                                                      : INT64_MAX + reach)));
+    insertBefore(preheader, makeInstruction(IR_SUB, limit, bound,
+                                            intConstant(reach)));
+  }
+
+  Operand top = newLabel();
+  insertBefore(preheader, makeInstruction(IR_LABEL, top, NO_OPERAND,
+                                          NO_OPERAND));
+  insertBefore(preheader,
+               makeInstruction(comparison, remainder,
+                               valueOperand(&cfg, variable), limit));
+  for (int copy = 0; copy < unrollFactor; copy++) {
+    copyBody(first, latchJump, testOffset, preheader);
+  }
+  insertBefore(preheader, makeInstruction(IR_JUMP, top, NO_OPERAND,
+                                          NO_OPERAND));
+  return true;
+}
+
+bool unrollLoops(IrFunction *function) {
+  if (unrollFactor < 2 || !beginLoops(function)) {
+    return false;
+  }
+
+  labelCopyCount = ir->labelCount;
+  labelCopies = newTable(labelCopyCount);
+  for (int label = 0; label < labelCopyCount; label++) {
+    labelCopies[label] = -1;
+  }
+
+  for (int l = 0; l < forest.loopCount; l++) {
+    unrollLoop(l);
+  }
+
+  return applyEdits();
+}
+//< Unrolling
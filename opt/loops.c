@@ -0,0 +1,141 @@
+#include "loops.h"
+
+#include "../common/arena.h"
+
+static int32_t *newTable(int count) {
+  return arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(int32_t));
+}
+
+static bool isBackEdge(const Cfg *cfg, int from, int to) {
+  return cfg->blocks[from].order != -1 && dominates(cfg, to, from);
+}
+
+// Outermost loop found so far that holds a loop
+static int32_t outermost(const LoopForest *forest, int32_t loop) {
+  while (forest->loops[loop].parent != -1) {
+    loop = forest->loops[loop].parent;
+  }
+  return loop;
+}
+
+// Walk back from the back edges of a loop to its header. A block already
+// in an inner loop stands for that whole loop, which is entered through
+// its header, so the walk goes on from the header's predecessors.
+static void collectLoop(LoopForest *forest, const Cfg *cfg, int32_t loop,
+                        int32_t *stack) {
+  int header = forest->loops[loop].header;
+  int depth = 0;
+
+  forest->loopOf[header] = loop;
+  for (int p = 0; p < cfg->blocks[header].predecessorCount; p++) {
+    int predecessor = predecessorOf(cfg, header, p);
+    if (isBackEdge(cfg, predecessor, header)) {
+      stack[depth++] = predecessor;
+    }
+  }
+
+  while (depth > 0) {
+    int b = stack[--depth];
+
+    if (forest->loopOf[b] != -1) {
+      int32_t inner = outermost(forest, forest->loopOf[b]);
+      if (inner == loop) {
+        continue;
+      }
+      forest->loops[inner].parent = loop;
+      b = forest->loops[inner].header;
+    } else {
+      forest->loopOf[b] = loop;
+    }
+
+    for (int p = 0; p < cfg->blocks[b].predecessorCount; p++) {
+      int predecessor = predecessorOf(cfg, b, p);
+      if (cfg->blocks[predecessor].order != -1) {
+        stack[depth++] = predecessor;
+      }
+    }
+  }
+}
+
+void findLoops(LoopForest *forest, const Cfg *cfg) {
+  // A block pushes its predecessors once, and has at most two successors
+  int32_t *stack = newTable(2 * cfg->blockCount + 1);
+  int32_t *filled = newTable(cfg->blockCount);
+
+  forest->loopCount = 0;
+  forest->loopOf = newTable(cfg->blockCount);
+  for (int b = 0; b < cfg->blockCount; b++) {
+    forest->loopOf[b] = -1;
+  }
+
+  // Headers in reverse postorder
+  for (int i = 0; i < cfg->orderCount; i++) {
+    int b = cfg->order[i];
+    for (int p = 0; p < cfg->blocks[b].predecessorCount; p++) {
+      if (isBackEdge(cfg, predecessorOf(cfg, b, p), b)) {
+        stack[forest->loopCount++] = b;
+        break;
+      }
+    }
+  }
+
+  forest->loops = arenaAlloc(optArena, (forest->loopCount + 1) * sizeof(Loop));
+  for (int l = 0; l < forest->loopCount; l++) {
+    forest->loops[l] = (Loop){
+        .header = stack[l],
+        .parent = -1,
+        .isInnermost = true,
+    };
+  }
+
+  // Inner loops first, so each outer one finds them complete
+  for (int l = forest->loopCount - 1; l >= 0; l--) {
+    collectLoop(forest, cfg, l, stack);
+  }
+
+  // A parent comes before its children
+  for (int l = 0; l < forest->loopCount; l++) {
+    Loop *loop = &forest->loops[l];
+    loop->depth = 1;
+    if (loop->parent != -1) {
+      loop->depth = forest->loops[loop->parent].depth + 1;
+      forest->loops[loop->parent].isInnermost = false;
+    }
+    loop->blockCount = 0;
+  }
+
+  // A block belongs to its innermost loop and to every loop around it
+  int total = 0;
+  for (int i = 0; i < cfg->orderCount; i++) {
+    for (int32_t l = forest->loopOf[cfg->order[i]]; l != -1;
+         l = forest->loops[l].parent) {
+      forest->loops[l].blockCount++;
+      total++;
+    }
+  }
+  for (int l = 0; l < forest->loopCount; l++) {
+    forest->loops[l].firstBlock = l == 0 ? 0
+                                         : forest->loops[l - 1].firstBlock +
+                                               forest->loops[l - 1].blockCount;
+    filled[l] = 0;
+  }
+
+  forest->blocks = newTable(total);
+  for (int i = 0; i < cfg->orderCount; i++) {
+    int b = cfg->order[i];
+    for (int32_t l = forest->loopOf[b]; l != -1;
+         l = forest->loops[l].parent) {
+      forest->blocks[forest->loops[l].firstBlock + filled[l]++] = b;
+    }
+  }
+}
+
+bool isInLoop(const LoopForest *forest, int loop, int block) {
+  int32_t l = forest->loopOf[block];
+
+  // Enclosing loops come first, so the walk can stop below the loop
+  while (l > loop) {
+    l = forest->loops[l].parent;
+  }
+  return l == loop;
+}
@@ -0,0 +1,40 @@
+// Natural loops of a function: a back edge goes to a block that dominates
+// its source, and the loop of that header is every block that reaches one
+// of its back edges without passing through the header
+
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include "cfg.h"
+
+typedef struct {
+  int32_t header;
+  int32_t parent;     // Innermost enclosing loop, -1 if there is none
+  int32_t depth;      // 1 for a loop no other loop contains
+  int32_t firstBlock; // Into LoopForest.blocks
+  int32_t blockCount;
+  bool isInnermost;
+} Loop;
+
+typedef struct {
+  // In reverse postorder of their headers, so a loop comes before the
+  // loops it contains
+  Loop *loops;
+  int loopCount;
+  int32_t *blocks;   // Blocks of every loop, each list in reverse postorder
+  int32_t *loopOf;   // Innermost loop of every block, -1 outside loops
+} LoopForest;
+
+/**
+ * Find the natural loops of a function and how they nest; back edges to
+ * the same header make one loop.
+ *
+ * @param forest The loops to fill, allocated in optArena.
+ * @param cfg The function's graph.
+ */
+void findLoops(LoopForest *forest, const Cfg *cfg);
+
+// Whether a block belongs to a loop, or to a loop nested in it
+bool isInLoop(const LoopForest *forest, int loop, int block);
+
+#endif
@@ -0,0 +1,95 @@
+#include "opt.h"
+
+#include "../codegen/ir.h"
+#include "../common/arena.h"
+#include "../common/string.h"
+#include "../common/trace.h"
+#include "cfg.h"
+#include "passes.h"
+
+// Later passes open up work for earlier ones, a few rounds reach the
+// fixed point on real programs
+#define MAX_ROUNDS 4
+
+typedef struct {
+  const char *name;
+  bool (*run)(IrFunction *function);
+  // Its analyses live in optArena for one function at a time
+  bool isLoopPass;
+  // Unrolling unrolled loops again would multiply them every round, and
+  // inlining again would only grow the callers
+  bool isFirstRoundOnly;
+  // Or a pass over the whole program at once, with optArena to itself
+  bool (*runProgram)();
+} Pass;
+
+static const Pass passes[PASS_COUNT] = {
+    [PASS_INLINE] = {"inline", NULL, false, true, inlineCalls},
+    [PASS_FOLD] = {"fold", foldConstants},
+    [PASS_SIMPLIFY] = {"simplify", simplifyAlgebra},
+    [PASS_CSE] = {"cse", eliminateCommonSubexpressions},
+    [PASS_COPY_PROPAGATION] = {"copy-propagation", propagateCopies},
+    [PASS_DEAD_TEMPS] = {"dead-temps", eliminateDeadTemps},
+    [PASS_LICM] = {"licm", hoistInvariants, true},
+    [PASS_INDUCTION] = {"induction", reduceInductionVariables, true},
+    [PASS_UNROLL] = {"unroll", unrollLoops, true, true},
+};
+
+PassKind findPass(const char *name, int length) {
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    if (_strlen(passes[pass].name) == length &&
+        _strncmp((char *)name, passes[pass].name, length) == 0) {
+      return pass;
+    }
+  }
+  return PASS_COUNT;
+}
+
+const char *passName(PassKind pass) { return passes[pass].name; }
+
+void optimizeIr(const bool enabled[PASS_COUNT]) {
+  trace(TRACE_OPT, TRACE_PHASE, "Optimizing intermediate code now\n");
+
+  initAnalysis();
+  initLocalPasses();
+
+  for (int round = 1; round <= MAX_ROUNDS; round++) {
+    bool isChanged = false;
+
+    for (int pass = 0; pass < PASS_COUNT; pass++) {
+      if (!enabled[pass] || (passes[pass].isFirstRoundOnly && round > 1)) {
+        continue;
+      }
+
+      int before = ir->instructionCount;
+      if (passes[pass].runProgram) {
+        isChanged |= passes[pass].runProgram();
+        releaseArena(optArena);
+        initAnalysis();
+      }
+      for (int f = 0; passes[pass].run && f < ir->functionCount; f++) {
+        isChanged |= passes[pass].run(&ir->functions[f]);
+        if (passes[pass].isLoopPass) {
+          releaseArena(optArena);
+          initAnalysis();
+        }
+      }
+      compactIr();
+
+      // The local passes' tables went with the arena, and the program may
+      // have more temporaries now
+      if (passes[pass].isLoopPass || passes[pass].runProgram) {
+        initLocalPasses();
+      }
+
+      trace(TRACE_OPT, TRACE_RULE, "Round %d %-16s %8d -> %8d instructions\n",
+            round, passes[pass].name, before, ir->instructionCount);
+    }
+
+    if (!isChanged) {
+      break;
+    }
+  }
+
+  releaseArena(optArena);
+}
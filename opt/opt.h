@@ -0,0 +1,60 @@
+// Optimization passes over the three-address code, run by a pass manager
+
+#ifndef OPT_H
+#define OPT_H
+
+#include <stdbool.h>
+
+typedef enum {
+  PASS_INLINE,           // Inlining of small functions that do not recurse
+  PASS_FOLD,             // Constant folding
+  PASS_SIMPLIFY,         // Algebraic simplification and strength reduction
+  PASS_CSE,              // Local common-subexpression elimination
+  PASS_COPY_PROPAGATION, // Local copy propagation
+  PASS_DEAD_TEMPS,       // Dead-temporary elimination
+  PASS_LICM,             // Loop-invariant code motion
+  PASS_INDUCTION,        // Strength reduction of induction variables
+  PASS_UNROLL,           // Loop unrolling, by the factor setUnrollFactor sets
+  PASS_COUNT,
+} PassKind;
+
+/**
+ * Find a pass by its command line name.
+ *
+ * @param name The name, not necessarily null terminated.
+ * @param length Number of characters in the name.
+ * @return The pass, or PASS_COUNT if no pass has that name.
+ */
+PassKind findPass(const char *name, int length);
+
+// Command line name of a pass
+const char *passName(PassKind pass);
+
+/**
+ * Set how many copies of its body an unrolled loop runs per test; below 2
+ * the unroll pass leaves loops alone, which is the default.
+ *
+ * @param factor Copies of the body.
+ */
+void setUnrollFactor(int factor);
+
+/**
+ * Run the enabled passes over every function of ir, in the order of
+ * PassKind, and repeat the sequence while it still changes the program.
+ * The instruction count before and after every pass goes to stdout.
+ *
+ * @param enabled Whether each pass runs, indexed by PassKind.
+ */
+void optimizeIr(const bool enabled[PASS_COUNT]);
+
+/**
+ * Write what the analyses find in every function: its basic blocks with
+ * their edges, dominators and dominance frontiers, liveness, reaching
+ * definitions and available expressions, and the instructions in pruned
+ * SSA form.
+ *
+ * @param fileName The file to write.
+ */
+void writeAnalysis(const char *fileName);
+
+#endif
@@ -0,0 +1,61 @@
+// The passes the pass manager runs, each over one function at a time but
+// the inliner
+
+#ifndef PASSES_H
+#define PASSES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../codegen/ir.h"
+
+/**
+ * Every pass below rewrites the instructions of one function in place,
+ * turning the ones it removes into IR_NOP for the pass manager to compact.
+ *
+ * @param function The function to rewrite.
+ * @return Whether the pass changed any instruction.
+ */
+bool foldConstants(IrFunction *function);
+bool simplifyAlgebra(IrFunction *function);
+bool eliminateCommonSubexpressions(IrFunction *function);
+bool propagateCopies(IrFunction *function);
+bool eliminateDeadTemps(IrFunction *function);
+
+/**
+ * The loop passes build the control-flow graph and loops of the function
+ * in optArena, and may add temporaries and instructions: they replace the
+ * function's code when they change it.
+ *
+ * @param function The function to rewrite.
+ * @return Whether the pass changed the function.
+ */
+bool hoistInvariants(IrFunction *function);
+bool reduceInductionVariables(IrFunction *function);
+bool unrollLoops(IrFunction *function);
+
+/**
+ * Replace calls to small functions that do not recurse, directly or
+ * through others, with a copy of their body: parameters and locals become
+ * temporaries of the caller. Callees are inlined into before their
+ * callers. Tables live in optArena.
+ *
+ * @return Whether any call was inlined.
+ */
+bool inlineCalls();
+
+// Scratch tables the local passes share, sized for the whole of ir
+void initLocalPasses();
+
+// Constants are created per use, so equal ones are compared by value
+bool sameValue(Operand a, Operand b);
+// Hash consistent with sameValue
+uint32_t valueHash(Operand operand);
+// Whether an opcode computes a value from its operands alone, loads
+// included: the expressions CSE and available expressions track
+bool isExpression(uint8_t opcode);
+// Instructions whose only effect is their result: a division or a load
+// that may fail at run time has to stay where it is
+bool isRemovable(const Instruction *instruction);
+
+#endif
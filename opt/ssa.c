@@ -0,0 +1,282 @@
+#include "ssa.h"
+
+#include <string.h>
+
+#include "../common/arena.h"
+
+static int32_t *newTable(int count) {
+  return arenaAlloc(optArena, (count > 0 ? count : 1) * sizeof(int32_t));
+}
+
+//> Phi Placement
+// Blocks defining each value, each block listed once per value
+static int32_t *definitionBlocks(const Cfg *cfg, int32_t *firstBlock) {
+  IrFunction *function = &ir->functions[cfg->function];
+  int32_t *lastBlock = newTable(cfg->valueCount);
+  int32_t *definedIn = newTable(function->instructionCount);
+  int count = 0;
+
+  for (int v = 0; v <= cfg->valueCount; v++) {
+    firstBlock[v] = 0;
+  }
+  for (int v = 0; v < cfg->valueCount; v++) {
+    lastBlock[v] = -1;
+  }
+
+  // Instructions run in block order, so a repeat is always the last one
+  for (int i = 0; i < function->instructionCount; i++) {
+    int uses[2];
+    int value = instructionValues(
+        cfg, &ir->instructions[function->firstInstruction + i], uses);
+    int block = cfg->blockOf[i];
+
+    definedIn[i] = -1;
+    if (value != -1 && lastBlock[value] != block) {
+      lastBlock[value] = block;
+      definedIn[i] = value;
+      firstBlock[value + 1]++;
+      count++;
+    }
+  }
+  for (int v = 0; v < cfg->valueCount; v++) {
+    firstBlock[v + 1] += firstBlock[v];
+    lastBlock[v] = firstBlock[v];
+  }
+
+  int32_t *blocks = newTable(count);
+  for (int i = 0; i < function->instructionCount; i++) {
+    if (definedIn[i] != -1) {
+      blocks[lastBlock[definedIn[i]]++] = cfg->blockOf[i];
+    }
+  }
+  return blocks;
+}
+
+static void placePhis(SsaForm *ssa, const Cfg *cfg, const Dataflow *liveness) {
+  int32_t *firstBlock = newTable(cfg->valueCount + 1);
+  int32_t *blocks = definitionBlocks(cfg, firstBlock);
+  int32_t *hasPhi = newTable(cfg->blockCount);
+  int32_t *isQueued = newTable(cfg->blockCount);
+  int32_t *worklist = newTable(cfg->blockCount);
+  int capacity = 16;
+
+  ssa->phis = arenaAlloc(optArena, capacity * sizeof(Phi));
+  ssa->phiCount = 0;
+  for (int b = 0; b < cfg->blockCount; b++) {
+    hasPhi[b] = isQueued[b] = -1;
+  }
+
+  for (int v = 0; v < cfg->valueCount; v++) {
+    if (!isScalarValue(cfg, v)) {
+      continue;
+    }
+
+    int count = 0;
+    for (int i = firstBlock[v]; i < firstBlock[v + 1]; i++) {
+      worklist[count++] = blocks[i];
+      isQueued[blocks[i]] = v;
+    }
+
+    while (count > 0) {
+      const BasicBlock *block = &cfg->blocks[worklist[--count]];
+
+      for (int f = 0; f < block->frontierCount; f++) {
+        int join = cfg->frontiers[block->firstFrontier + f];
+        if (hasPhi[join] == v ||
+            !hasBit(blockSet(liveness->in, liveness->words, join), v)) {
+          continue;
+        }
+
+        hasPhi[join] = v;
+        if (ssa->phiCount == capacity) {
+          ssa->phis = arenaGrow(optArena, ssa->phis, capacity * sizeof(Phi),
+                                capacity * 2 * sizeof(Phi));
+          capacity *= 2;
+        }
+        ssa->phis[ssa->phiCount++] = (Phi){.block = join, .value = v};
+
+        // The phi is a definition too
+        if (isQueued[join] != v) {
+          isQueued[join] = v;
+          worklist[count++] = join;
+        }
+      }
+    }
+  }
+}
+
+// Group the phis by block, and give each its argument slots
+static void groupPhis(SsaForm *ssa, const Cfg *cfg) {
+  Phi *phis = ssa->phis;
+  int32_t *next = newTable(cfg->blockCount);
+
+  ssa->firstPhi = newTable(cfg->blockCount + 1);
+  for (int b = 0; b <= cfg->blockCount; b++) {
+    ssa->firstPhi[b] = 0;
+  }
+  for (int p = 0; p < ssa->phiCount; p++) {
+    ssa->firstPhi[phis[p].block + 1]++;
+  }
+  for (int b = 0; b < cfg->blockCount; b++) {
+    ssa->firstPhi[b + 1] += ssa->firstPhi[b];
+    next[b] = ssa->firstPhi[b];
+  }
+
+  ssa->phis = arenaAlloc(optArena, (ssa->phiCount + 1) * sizeof(Phi));
+  for (int p = 0; p < ssa->phiCount; p++) {
+    ssa->phis[next[phis[p].block]++] = phis[p];
+  }
+
+  int argumentCount = 0;
+  for (int p = 0; p < ssa->phiCount; p++) {
+    ssa->phis[p].firstArgument = argumentCount;
+    argumentCount += cfg->blocks[ssa->phis[p].block].predecessorCount;
+  }
+
+  ssa->arguments = newTable(argumentCount);
+  for (int a = 0; a < argumentCount; a++) {
+    ssa->arguments[a] = -1;
+  }
+}
+//< Phi Placement
+
+//> Renaming
+typedef struct {
+  int32_t value;
+  int32_t name;
+} Renamed;
+
+static int32_t newName(SsaForm *ssa, int32_t *versions, int value,
+                       int instruction, int phi) {
+  ssa->names[ssa->nameCount] = (SsaName){
+      .value = value,
+      .version = ++versions[value],
+      .instruction = instruction,
+      .phi = phi,
+  };
+  return ssa->nameCount++;
+}
+
+// Name the phis, definitions and uses of a block, and fill the arguments
+// its successors' phis take from it
+static void renameBlock(SsaForm *ssa, const Cfg *cfg, int b, int32_t *current,
+                        int32_t *versions, Renamed *log, int *logCount) {
+  const BasicBlock *block = &cfg->blocks[b];
+  int firstInstruction = ir->functions[cfg->function].firstInstruction;
+
+  for (int p = ssa->firstPhi[b]; p < ssa->firstPhi[b + 1]; p++) {
+    Phi *phi = &ssa->phis[p];
+    log[(*logCount)++] = (Renamed){phi->value, current[phi->value]};
+    phi->name = newName(ssa, versions, phi->value, -1, p);
+    current[phi->value] = phi->name;
+  }
+
+  for (int i = 0; i < block->count; i++) {
+    int offset = block->first - firstInstruction + i;
+    int uses[2];
+    int value = instructionValues(cfg, &ir->instructions[block->first + i],
+                                  uses);
+
+    for (int u = 0; u < 2; u++) {
+      ssa->uses[2 * offset + u] = uses[u] == -1 ? -1 : current[uses[u]];
+    }
+    if (value != -1) {
+      log[(*logCount)++] = (Renamed){value, current[value]};
+      current[value] = newName(ssa, versions, value, block->first + i, -1);
+      ssa->definitions[offset] = current[value];
+    }
+  }
+
+  for (int s = 0; s < block->successorCount; s++) {
+    int successor = block->successors[s];
+    int edge = 0;
+    while (predecessorOf(cfg, successor, edge) != b) {
+      edge++;
+    }
+
+    for (int p = ssa->firstPhi[successor]; p < ssa->firstPhi[successor + 1];
+         p++) {
+      Phi *phi = &ssa->phis[p];
+      ssa->arguments[phi->firstArgument + edge] = current[phi->value];
+    }
+  }
+}
+
+// Walk the dominator tree with an explicit stack; leaving a block undoes
+// the names it pushed, so every block sees its dominators' names
+static void renameValues(SsaForm *ssa, const Cfg *cfg, int definitionCount) {
+  IrFunction *function = &ir->functions[cfg->function];
+  int32_t *current = newTable(cfg->valueCount);
+  int32_t *versions = newTable(cfg->valueCount);
+  int32_t *stack = newTable(cfg->blockCount);
+  int32_t *nextChild = newTable(cfg->blockCount);
+  int32_t *logStart = newTable(cfg->blockCount);
+  Renamed *log = arenaAlloc(optArena, (definitionCount + ssa->phiCount + 1) *
+                                           sizeof(Renamed));
+  int logCount = 0;
+  int depth = 0;
+
+  ssa->nameCount = 0;
+  for (int v = 0; v < cfg->valueCount; v++) {
+    ssa->names[ssa->nameCount++] =
+        (SsaName){.value = v, .version = 0, .instruction = -1, .phi = -1};
+    current[v] = v;
+    versions[v] = 0;
+  }
+  for (int i = 0; i < 2 * function->instructionCount; i++) {
+    ssa->uses[i] = -1;
+  }
+  for (int i = 0; i < function->instructionCount; i++) {
+    ssa->definitions[i] = -1;
+  }
+
+  stack[depth++] = 0;
+  logStart[0] = logCount;
+  renameBlock(ssa, cfg, 0, current, versions, log, &logCount);
+  nextChild[0] = cfg->blocks[0].firstChild;
+
+  while (depth > 0) {
+    int b = stack[depth - 1];
+    int child = nextChild[b];
+
+    if (child != -1) {
+      nextChild[b] = cfg->blocks[child].nextSibling;
+      nextChild[child] = cfg->blocks[child].firstChild;
+      logStart[child] = logCount;
+      renameBlock(ssa, cfg, child, current, versions, log, &logCount);
+      stack[depth++] = child;
+      continue;
+    }
+
+    while (logCount > logStart[b]) {
+      logCount--;
+      current[log[logCount].value] = log[logCount].name;
+    }
+    depth--;
+  }
+}
+//< Renaming
+
+void buildSsa(SsaForm *ssa, const Cfg *cfg, const Dataflow *liveness) {
+  IrFunction *function = &ir->functions[cfg->function];
+
+  placePhis(ssa, cfg, liveness);
+  groupPhis(ssa, cfg);
+
+  int definitionCount = 0;
+  for (int i = 0; i < function->instructionCount; i++) {
+    int uses[2];
+    if (instructionValues(cfg,
+                          &ir->instructions[function->firstInstruction + i],
+                          uses) != -1) {
+      definitionCount++;
+    }
+  }
+
+  ssa->names = arenaAlloc(optArena, (cfg->valueCount + ssa->phiCount +
+                                     definitionCount + 1) *
+                                         sizeof(SsaName));
+  ssa->uses = newTable(2 * function->instructionCount);
+  ssa->definitions = newTable(function->instructionCount);
+  renameValues(ssa, cfg, definitionCount);
+}
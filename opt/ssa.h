@@ -0,0 +1,54 @@
+// Static single assignment view of a function: the instructions stay as
+// they are, and every use and definition of a scalar value is mapped to
+// the SSA name it reads or creates
+
+#ifndef SSA_H
+#define SSA_H
+
+#include "cfg.h"
+#include "dataflow.h"
+
+typedef struct {
+  int32_t block;
+  int32_t value;         // Value the phi merges
+  int32_t name;          // SSA name it defines
+  int32_t firstArgument; // Into SsaForm.arguments, one per predecessor
+} Phi;
+
+typedef struct {
+  int32_t value;
+  int32_t version;     // Counts the value's names, 0 for its value on entry
+  int32_t instruction; // Defining instruction in ir->instructions, or -1
+  int32_t phi;         // Defining phi, or -1; neither for the entry names
+} SsaName;
+
+typedef struct {
+  // Phis of block b are phis[firstPhi[b]] up to phis[firstPhi[b + 1]]
+  Phi *phis;
+  int phiCount;
+  int32_t *firstPhi;
+  int32_t *arguments;
+
+  // Names 0 to valueCount - 1 are the values on entry to the function
+  SsaName *names;
+  int nameCount;
+
+  // By instruction offset in the function: the names its two value
+  // operands read, and the name it defines; -1 where there is none, and
+  // everywhere in unreachable blocks
+  int32_t *uses;
+  int32_t *definitions;
+} SsaForm;
+
+/**
+ * Build pruned SSA: a phi goes on the iterated dominance frontier of a
+ * value's definitions, and only where the value is live, then a walk of
+ * the dominator tree names every definition and use.
+ *
+ * @param ssa The form to fill, allocated in optArena.
+ * @param cfg The function's graph.
+ * @param liveness Its liveness, from computeLiveness.
+ */
+void buildSsa(SsaForm *ssa, const Cfg *cfg, const Dataflow *liveness);
+
+#endif
@@ -0,0 +1,74 @@
+#include "ast.h"
+#include "../common/arena.h"
+#include "../semantic/semantic.h"
+
+#define AST_INITIAL_CAPACITY 256
+
+_Thread_local AstPool *ast = NULL;
+
+// The first nodes, once the pool is empty
+static void startAst() {
+  ast->nodes = arenaAlloc(parserArena, AST_INITIAL_CAPACITY * sizeof(AstNode));
+  ast->capacity = AST_INITIAL_CAPACITY;
+
+  // Reserve index 0, so AST_NONE reads as an empty node of error type
+  newAstNode(AST_EMPTY, 0, AST_NONE, AST_NONE, AST_NONE);
+  ast->nodes[AST_NONE].dataType = ERROR;
+}
+
+void initAst() {
+  freeAst();
+  startAst();
+}
+
+void clearAst() {
+  rewindArena(parserArena);
+  ast->count = 0;
+  ast->capacity = 0;
+  startAst();
+}
+
+void freeAst() {
+  releaseArena(parserArena);
+  ast->nodes = NULL;
+  ast->count = 0;
+  ast->capacity = 0;
+}
+
+AstIndex newAstNode(AstKind kind, uint32_t offset, AstIndex a, AstIndex b,
+                    AstIndex c) {
+  if (ast->count == ast->capacity) {
+    ast->nodes = arenaGrow(parserArena, ast->nodes,
+                           ast->capacity * sizeof(AstNode),
+                           ast->capacity * 2 * sizeof(AstNode));
+    ast->capacity *= 2;
+  }
+
+  AstIndex index = ast->count++;
+  AstNode *node = &ast->nodes[index];
+  node->kind = (uint8_t)kind;
+  node->op = 0;
+  node->dataType = ERROR;
+  node->offset = offset;
+  node->a = a;
+  node->b = b;
+  node->c = c;
+  node->next = AST_NONE;
+  node->name = NULL;
+
+  return index;
+}
+
+AstIndex appendAstList(AstIndex first, AstIndex rest) {
+  if (first == AST_NONE) {
+    return rest;
+  }
+
+  AstIndex tail = first;
+  while (ast->nodes[tail].next != AST_NONE) {
+    tail = ast->nodes[tail].next;
+  }
+  ast->nodes[tail].next = rest;
+
+  return first;
+}
@@ -0,0 +1,84 @@
+// Abstract syntax tree built once by the parser and walked by later passes
+
+#ifndef AST_H
+#define AST_H
+
+#include <stdint.h>
+
+// Nodes refer to each other by index into the node pool, so the pool can
+// grow without invalidating links. Index 0 is the empty node.
+typedef int32_t AstIndex;
+
+#define AST_NONE 0
+
+typedef enum {
+  AST_EMPTY,       // Placeholder for missing or invalid parts
+  AST_PROGRAM,     // a: functions, b: declarations, c: statements
+  AST_FUNCTION,    // name, dataType: return type, a: params, b: decls, c: body
+  AST_DECLARATION, // name, dataType, a: array size (optional)
+  AST_ASSIGN,      // a: variable, b: value
+  AST_IF,          // a: condition, b: then statements, c: else statements
+  AST_WHILE,       // a: condition, b: body
+  AST_PRINT,       // a: value
+  AST_RETURN,      // a: value
+  AST_BINARY,      // op: +, -, *, /, %, a: left, b: right
+  AST_COMPARE,     // op: <, <=, >, >=, ==, <>, a: left, b: right
+  AST_AND,         // a: left, b: right
+  AST_OR,          // a: left, b: right
+  AST_NOT,         // a: operand
+  AST_NUMBER,      // name: lexeme, dataType
+  AST_VARIABLE,    // name, dataType, a: array index (optional)
+  AST_CALL,        // name, dataType: return type, a: arguments
+} AstKind;
+
+typedef struct {
+  uint8_t kind;     // AstKind
+  uint8_t op;       // TokenType of the operator
+  uint8_t dataType; // DataType computed by the parser
+  uint32_t offset; // Of its first token in the input
+  AstIndex a, b, c; // Children, see AstKind
+  AstIndex next;    // Next sibling in a list
+  const char *name; // Interned identifier or number lexeme
+} AstNode;
+
+typedef struct {
+  AstNode *nodes;
+  int count;
+  int capacity;
+} AstPool;
+
+// Tree of the context bound to this thread
+extern _Thread_local AstPool *ast;
+
+void initAst();
+void freeAst();
+// Start an empty tree in the memory of the last one, as a worker does per
+// function
+void clearAst();
+
+/**
+ * Allocate a node in the pool. Pointers into the pool are invalidated by
+ * later allocations, so hold on to indices instead.
+ *
+ * @param kind The kind of node.
+ * @param offset Offset in the input of the token the node starts at.
+ * @param a First child, or AST_NONE.
+ * @param b Second child, or AST_NONE.
+ * @param c Third child, or AST_NONE.
+ * @return Index of the new node.
+ */
+AstIndex newAstNode(AstKind kind, uint32_t offset, AstIndex a, AstIndex b,
+                    AstIndex c);
+
+/**
+ * Join two sibling lists.
+ *
+ * @param first Head of the first list, or AST_NONE.
+ * @param rest Head of the list to append, or AST_NONE.
+ * @return Head of the joined list.
+ */
+AstIndex appendAstList(AstIndex first, AstIndex rest);
+
+static inline AstNode *astNode(AstIndex index) { return &ast->nodes[index]; }
+
+#endif
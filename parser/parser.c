@@ -3,49 +3,30 @@
 #include <fcntl.h>  // For open() flags
 #include <stdarg.h> // For variable argument lists
 #include <stdio.h>
-#include <stdlib.h> // For free()
 #include <unistd.h> // For write() and close()
 
 #include "../common/error_state.h"
 #include "../common/file_utils.h"
+#include "../common/line_index.h"
 #include "../common/string.h"
 #include "../common/token_utils.h"
+#include "../common/trace.h"
 #include "parser.h"
 
 #define BUFFER_SIZE 1024
 
-// Global variables
-Token identifiers[1024];
-int identifierCount = 0;
-
-// Variable for this module
-char parseErrorBuffer[BUFFER_SIZE + 1];
-size_t parseErrorBufferIndex = 0;
-
-char symbolTableBuffer[BUFFER_SIZE + 1];
-size_t symbolTableBufferIndex = 0;
+_Thread_local ParserState *parsing = NULL;
 
 //> Helper Functions
 void preParse(const char *message) {
-  printf("Currently parsing: %s\n", message);
+  trace(TRACE_PARSER, TRACE_RULE, "Currently parsing: %s\n", message);
 }
 
 void parseError(const char *expectedMessage) {
-  setErrorOccurred();
-
-  char *lexeme = getTokenLexeme(look_ahead);
-  char parseErrorMessage[BUFFER_SIZE + 1];
-
-  // Print and create syntax error file
-  sprintf(parseErrorMessage, "Syntax Error: %s, but found '%s' at line %d\n",
-          expectedMessage, lexeme, look_ahead->line);
-
-  appendToBuffer(parseErrorBuffer, &parseErrorBufferIndex, parseErrorMessage,
-                 "syntax_analysis_errors.txt");
-  flushBufferToFile("syntax_analysis_errors.txt", parseErrorBuffer,
-                    &parseErrorBufferIndex);
-
-  free(lexeme);
+  int line = lineOf(look_ahead->offset);
+  reportError(PHASE_SYNTAX, DIAG_EXPECTED, line, 0,
+              "Syntax Error: %s, but found '%s' at line %d", expectedMessage,
+              getTokenLexeme(look_ahead), line);
 }
 
 void handleParseError(const char *message, bool (*isInFollowSet)()) {
@@ -61,26 +42,27 @@ void handleParseError(const char *message, bool (*isInFollowSet)()) {
 }
 
 // Push scope operation
-void A(char *scopeName) { pushScope(scopeName); }
+void A(const char *scopeName) { pushScope(scopeName); }
 
 // Pop scope operation
 void B() { popScope(); }
 
 // Insert symbol operation
-void C(SymbolType symbolType, DataType returnType, int lineNumber,
-       int parameterCount, char *symbolName) {
+void C(SymbolType symbolType, DataType returnType, uint32_t offset,
+       int parameterCount, const char *symbolName) {
   SymbolTableEntry entry;
   entry.symbolType = symbolType;
   entry.returnType = returnType;
-  entry.lineNumber = lineNumber;
+  entry.offset = offset;
   entry.parameterCount = parameterCount;
 
-  // Update entry name
-  _strncpy(entry.lexeme, symbolName, _strlen(symbolName) + 1);
+  // Interned name, compared by pointer in the symbol table
+  entry.lexeme = symbolName;
 
   // Update argument type list
+  entry.parameters = newParameters(parameterCount);
   for (int i = 0; i < parameterCount; i++) {
-    entry.parameters[i] = tempArgTypeList[i];
+    entry.parameters[i] = semantic->tempArgList[i].returnType;
   }
 
   insertSymbol(entry);
@@ -91,14 +73,16 @@ SymbolTableEntry *D(const char *lexeme) {
   SymbolTableEntry *variable = lookupSymbol(lexeme);
 
   if (!variable) {
-    handleSemanticError("Undeclared variable %s at line number %d", lexeme,
-                        look_ahead->line);
+    int line = lineOf(look_ahead->offset);
+    handleSemanticError(DIAG_UNDECLARED, line,
+                        "Undeclared variable %s at line number %d", lexeme,
+                        line);
   }
 
   return variable;
 }
 
-void handleSemanticError(const char *format, ...) {
+void handleSemanticError(DiagnosticId id, int line, const char *format, ...) {
   char semanticErrorMessage[BUFFER_SIZE + 1];
   va_list args;
 
@@ -106,10 +90,17 @@ void handleSemanticError(const char *format, ...) {
   vsnprintf(semanticErrorMessage, BUFFER_SIZE, format, args);
   va_end(args);
 
-  semanticError(semanticErrorMessage);
+  reportError(PHASE_SEMANTIC, id, line, 0, "Semantic Error: %s",
+              semanticErrorMessage);
+}
+
+// An ERROR operand was reported where its error is, so it matches anything
+// rather than reporting that error again
+static bool isTypeMismatch(DataType left, DataType right) {
+  return left != right && left != ERROR && right != ERROR;
 }
 
-void resetArgCount() { argCount = 0; }
+void resetArgCount() { semantic->argCount = 0; }
 
 void handleFunctionCall(SymbolTableEntry *symbol) {
   SymbolTableEntry *functionEntry = lookupSymbol(symbol->lexeme);
@@ -117,25 +108,34 @@ void handleFunctionCall(SymbolTableEntry *symbol) {
 
   if (frame->argCount != functionEntry->parameterCount) {
     if (frame->argCount > functionEntry->parameterCount) {
-      handleSemanticError("%s arguments for function '%s' (line %d). Expected "
+      int line = lineOf(look_ahead->offset);
+      handleSemanticError(DIAG_ARGUMENT_COUNT, line,
+                          "%s arguments for function '%s' (line %d). Expected "
                           "%d, but got %d.",
-                          "Too many", functionEntry->lexeme, look_ahead->line,
+                          "Too many", functionEntry->lexeme, line,
                           functionEntry->parameterCount, frame->argCount);
     } else {
-      handleSemanticError("%s arguments for function '%s' (line %d). Expected "
+      int line = lineOf(look_ahead->offset);
+      handleSemanticError(DIAG_ARGUMENT_COUNT, line,
+                          "%s arguments for function '%s' (line %d). Expected "
                           "%d, but got %d.",
-                          "Too few", functionEntry->lexeme, look_ahead->line,
+                          "Too few", functionEntry->lexeme, line,
                           functionEntry->parameterCount, frame->argCount);
     }
   }
 
+  // A missing argument has no type, and so never matches
   for (int i = 0; i < functionEntry->parameterCount; i++) {
-    if (frame->argTypes[i] != functionEntry->parameters[i]) {
-      handleSemanticError("Argument %d of function '%s' (line %d) has "
+    bool isMissing = i >= frame->argCount;
+    DataType argType = isMissing ? ERROR : frame->argTypes[i];
+    if (isMissing || isTypeMismatch(argType, functionEntry->parameters[i])) {
+      int line = lineOf(look_ahead->offset);
+      handleSemanticError(DIAG_ARGUMENT_TYPE, line,
+                          "Argument %d of function '%s' (line %d) has "
                           "incorrect type. Expected '%s', but got '%s'.",
-                          i + 1, functionEntry->lexeme, look_ahead->line,
+                          i + 1, functionEntry->lexeme, line,
                           dataTypeToString(functionEntry->parameters[i]),
-                          dataTypeToString(frame->argTypes[i]));
+                          dataTypeToString(argType));
     }
   }
 
@@ -146,59 +146,76 @@ void handleFunctionCall(SymbolTableEntry *symbol) {
 //< Helper functions
 
 //> Parse Functions
-void Parse(Token **tokens) {
-  puts("===============");
-  puts("Start parsing!");
-  puts("===============");
+void beginParse() {
+  trace(TRACE_PARSER, TRACE_PHASE,
+        "===============\nStart parsing!\n===============\n");
 
   // Remove the created files first
-  remove("syntax_analysis_errors.txt");
-  remove("symbol_table.txt");
-  remove("semantic_errors.txt");
+  removeOutputFile("syntax_analysis_errors.txt");
+  removeOutputFile("symbol_table.txt");
+  removeOutputFile("semantic_errors.txt");
 
   // Initialization
-  parseErrorBuffer[BUFFER_SIZE] = '\0';
-  symbolTableBuffer[BUFFER_SIZE] = '\0';
-
-  // Initialize the look ahead variable
-  look_ahead = *tokens;
-
-  // Start Parsing, with parseProg as the starting function
-  parseProg();
+  parsing->symbolTableBuffer[PARSER_BUFFER_SIZE] = '\0';
+  initAst();
+}
 
+void endParse() {
   if (look_ahead->type == TOKEN_DOLLAR) {
-    puts("=====================");
-    puts("Parsing Reach To End!");
-    puts("=====================");
+    trace(TRACE_PARSER, TRACE_PHASE,
+          "=====================\nParsing Reach To End!\n"
+          "=====================\n");
   } else {
-    puts("=========================");
-    puts("Parsing Not Reach To End!");
-    puts("=========================");
+    trace(TRACE_PARSER, TRACE_PHASE,
+          "=========================\nParsing Not Reach To End!\n"
+          "=========================\n");
   }
 }
 
+AstIndex Parse(CompilerContext *context) {
+  useContext(context);
+  beginParse();
+
+  // Start Parsing, with parseProg as the starting function
+  AstIndex program = parseProg();
+
+  endParse();
+  return program;
+}
+
 void syncProg() {
   while (!isAtEnd()) {
     advanceToken();
   }
 }
 
-void parseProg() {
+AstIndex parseProg() {
   // PROG → A FNS DECLS STMTS B .
   preParse("prog");
 
+  uint32_t offset = look_ahead->offset;
+
   A("global");
-  parseFns();
-  parseDecls();
-  parseStmts();
+  AstIndex functions = parseFns();
+
+  return parseProgc(offset, functions);
+}
+
+AstIndex parseProgc(uint32_t offset, AstIndex functions) {
+  // The rest of PROG once the functions are parsed: DECLS STMTS B .
+  AstIndex declarations = parseDecls();
+  AstIndex statements = parseStmts();
   B();
 
+  AstIndex program =
+      newAstNode(AST_PROGRAM, offset, functions, declarations, statements);
+
   if (!matchType(TOKEN_DOT)) {
     parseError("Expected '.' to indicate end of the program");
     syncProg();
-
-    return;
   }
+
+  return program;
 }
 
 bool isInFollowSetForFns() {
@@ -210,108 +227,114 @@ bool isInFollowSetForFns() {
   case TOKEN_DOUBLE:
     return true;
   case TOKEN_KEYWORD:
-    return isKeyword("if", 2) || isKeyword("while", 5) ||
-           isKeyword("print", 5) || isKeyword("return", 6);
+    return isKeyword(KEYWORD_IF) || isKeyword(KEYWORD_WHILE) ||
+           isKeyword(KEYWORD_PRINT) || isKeyword(KEYWORD_RETURN);
   default:
     return false;
   }
 }
 
-void parseFns() {
+AstIndex parseFns() {
   // FNS → FN ; FNSC
   // FNS → ε
   preParse("fns");
 
-  if (isKeyword("def", 3)) {
-    parseFn();
+  if (isKeyword(KEYWORD_DEF)) {
+    AstIndex function = parseFn();
 
     if (!matchType(TOKEN_SEMICOLON)) {
       handleParseError("Expected ';' after function definition",
                        isInFollowSetForFns);
-      return;
+      return function;
     }
 
-    parseFnsc();
-
-    return;
+    return appendAstList(function, parseFnsc());
   }
 
-  return;
+  return AST_NONE;
 }
 
-void parseFnsc() {
+AstIndex parseFnsc() {
   // FNSC → FN; FNSC
   // FNSC → ε
   preParse("fnsc");
-  parseFns();
+  return parseFns();
 }
 
 bool isInFollowSetForFn() { return look_ahead->type == TOKEN_SEMICOLON; }
 
-void parseFn() {
+AstIndex parseFn() {
   // FN → def TYPE FNAME ( PARAMS ) C A C DECLS STMTS fed B
   preParse("fn");
 
-  if (!matchKeyword("def")) {
+  uint32_t offset = look_ahead->offset;
+
+  if (!matchKeyword(KEYWORD_DEF)) {
     handleParseError("Expected 'def' at the start of function definition",
                      isInFollowSetForFn);
-    return;
+    return AST_NONE;
   }
 
   DataType type = parseType();
-  char *funcName = parseFname();
+  const char *funcName = parseFname();
 
   if (!matchType(TOKEN_LEFT_PAREN)) {
     handleParseError("Expected '(' after function name", isInFollowSetForFn);
-    return;
+    return AST_NONE;
   }
 
   // Update argument counts
-  parseParams();
+  AstIndex params = parseParams();
 
   if (!matchType(TOKEN_RIGHT_PAREN)) {
     handleParseError("Expected ')' after function parameters",
                      isInFollowSetForFn);
-    return;
+    return AST_NONE;
   }
 
   // Insert function symbol at global scope
-  C(FUNCTION, type, look_ahead->line, argCount, funcName);
+  C(FUNCTION, type, look_ahead->offset, semantic->argCount, funcName);
 
   // Insert function scope
   A(funcName);
 
   // Insert argument symbol at function scope
-  for (int i = 0; i < argCount; i++) {
-    C(tempArgList[i].symbolType, tempArgList[i].returnType,
-      tempArgList[i].lineNumber, 0, (tempArgList[i].lexeme));
+  for (int i = 0; i < semantic->argCount; i++) {
+    SymbolTableEntry *argument = &semantic->tempArgList[i];
+    C(argument->symbolType, argument->returnType, argument->offset, 0,
+      (argument->lexeme));
   }
   resetArgCount();
 
-  parseDecls();
-  parseStmts();
+  AstIndex declarations = parseDecls();
+  AstIndex body = parseStmts();
 
-  if (!matchKeyword("fed")) {
+  if (!matchKeyword(KEYWORD_FED)) {
     handleParseError("Expected 'fed' at the end of function definition",
                      isInFollowSetForFn);
-    return;
+    return AST_NONE;
   }
 
   // Pop function scope
   B();
 
-  free(funcName);
+  AstIndex function =
+      newAstNode(AST_FUNCTION, offset, params, declarations, body);
+  astNode(function)->name = funcName;
+  astNode(function)->dataType = type;
+
+  return function;
 }
 
-char *parseFname() {
+const char *parseFname() {
   // FNAME → ID
   preParse("fname");
 
   if (look_ahead->type == TOKEN_ID) {
-    char *lexemeCopy = getTokenLexeme(look_ahead);
+    const char *lexeme = getTokenLexeme(look_ahead);
     matchType(TOKEN_ID);
 
-    return lexemeCopy;
+    return lexeme;
   }
 
   handleParseError("Expected function name (identifier)",
@@ -319,81 +342,67 @@ char *parseFname() {
   return NULL;
 }
 
-void parseParams() {
+// Record a parameter for the function symbol and its scope
+AstIndex addParam(DataType type, AstIndex variable) {
+  const char *paramName = astNode(variable)->name;
+
+  SymbolTableEntry entry;
+  entry.parameterCount = 0;
+  entry.parameters = NULL;
+  entry.symbolType = VARIABLE;
+  entry.offset = look_ahead->offset;
+  entry.returnType = type;
+  entry.lexeme = paramName;
+
+  // Update temporarily argument list
+  addTempArg(entry);
+
+  AstIndex param = newAstNode(AST_DECLARATION, entry.offset, AST_NONE,
+                              AST_NONE, AST_NONE);
+  astNode(param)->name = paramName;
+  astNode(param)->dataType = type;
+
+  return param;
+}
+
+AstIndex parseParams() {
   // PARAMS → TYPE VAR PARAMSC
   // PARAMS → ε
   preParse("params");
 
-  if (isKeyword("int", 3) || isKeyword("double", 6)) {
+  if (isKeyword(KEYWORD_INT) || isKeyword(KEYWORD_DOUBLE)) {
     DataType type = parseType();
+    AstIndex param = addParam(type, parseVar());
 
-    char *paramName = parseVar();
-
-    SymbolTableEntry entry;
-    entry.parameterCount = 0;
-    entry.symbolType = VARIABLE;
-    entry.lineNumber = look_ahead->line;
-    entry.returnType = type;
-
-    if (paramName) {
-      _strncpy(entry.lexeme, paramName, _strlen(paramName) + 1);
-      free(paramName);
-    }
-
-    // Update temporarily argument list and argument type list
-    tempArgList[argCount] = entry;
-    tempArgTypeList[argCount] = type;
-    argCount++;
-
-    parseParamsc();
-
-    return;
+    return appendAstList(param, parseParamsc());
   }
 
-  return;
+  return AST_NONE;
 }
 
 bool isInFollowSetForParamsc() { return look_ahead->type == TOKEN_RIGHT_PAREN; }
 
-void parseParamsc() {
+AstIndex parseParamsc() {
   // PARAMSC → , TYPE VAR PARAMSC | ε
   preParse("paramsc");
 
   if (look_ahead->type == TOKEN_COMMA) {
     matchType(TOKEN_COMMA);
 
-    if (!(isKeyword("int", 3) || isKeyword("double", 6))) {
+    if (!(isKeyword(KEYWORD_INT) || isKeyword(KEYWORD_DOUBLE))) {
       handleParseError(
           "Expected a type ('int' or 'double') after ',' in parameter list",
           isInFollowSetForParamsc);
-      return;
+      return AST_NONE;
     }
 
     DataType type = parseType();
-    char *paramName = parseVar();
-
-    SymbolTableEntry entry;
-    entry.parameterCount = 0;
-    entry.symbolType = VARIABLE;
-    entry.lineNumber = look_ahead->line;
-    entry.returnType = type;
+    AstIndex param = addParam(type, parseVar());
 
-    if (paramName) {
-      _strncpy(entry.lexeme, paramName, _strlen(paramName) + 1);
-      free(paramName);
-    }
-
-    // Update temporarily argument list and argument type list
-    tempArgList[argCount] = entry;
-    tempArgTypeList[argCount] = type;
-    argCount++;
-
-    parseParamsc();
-
-    return;
+    return appendAstList(param, parseParamsc());
   }
 
-  return;
+  return AST_NONE;
 }
 
 bool isInFollowSetForFname() { return look_ahead->type == TOKEN_LEFT_PAREN; }
@@ -405,61 +414,77 @@ bool isInFollowSetForDecls() {
   case TOKEN_ID:
     return true;
   case TOKEN_KEYWORD:
-    return isKeyword("fed", 3) || isKeyword("if", 2) || isKeyword("while", 5) ||
-           isKeyword("print", 5) || isKeyword("return", 6);
+    return isKeyword(KEYWORD_FED) || isKeyword(KEYWORD_IF) ||
+           isKeyword(KEYWORD_WHILE) || isKeyword(KEYWORD_PRINT) ||
+           isKeyword(KEYWORD_RETURN);
   default:
     return false;
   }
 }
 
-void parseDecls() {
+// Link items (a list) after *last, and move *last to the new tail
+void appendToList(AstIndex *first, AstIndex *last, AstIndex items) {
+  if (items == AST_NONE) {
+    return;
+  }
+
+  if (*last == AST_NONE) {
+    *first = items;
+  } else {
+    astNode(*last)->next = items;
+  }
+
+  *last = items;
+  while (astNode(*last)->next != AST_NONE) {
+    *last = astNode(*last)->next;
+  }
+}
+
+AstIndex parseDecls() {
   // DECLS → DECL; DECLSC
   // DECLS → ε
+  // DECLSC → DECL; DECLSC
+  // DECLSC → ε
+  // DECLSC is taken by looping instead of recursing, so long declaration
+  // lists do not grow the stack
+  AstIndex first = AST_NONE;
+  AstIndex last = AST_NONE;
+
   preParse("decls");
 
-  if (isKeyword("int", 3) || isKeyword("double", 6)) {
-    parseDecl();
+  while (isKeyword(KEYWORD_INT) || isKeyword(KEYWORD_DOUBLE)) {
+    appendToList(&first, &last, parseDecl());
 
     if (!matchType(TOKEN_SEMICOLON)) {
       handleParseError("Expected semicolon", isInFollowSetForDecls);
-      return;
+      return first;
     }
 
-    parseDeclsc();
-
-    return;
+    preParse("declsc");
+    preParse("decls");
   }
 
-  return;
-}
-
-void parseDeclsc() {
-  // DECLSC → DECL; DECLSC
-  // DECLSC → ε
-  preParse("declsc");
-  parseDecls();
+  return first;
 }
 
 bool isInFollowSetForDecl() { return look_ahead->type == TOKEN_SEMICOLON; }
 
 // DECL -> TYPE VARS
 
-void parseDecl() {
+AstIndex parseDecl() {
   // DECL → TYPE VARS
   preParse("decl");
 
-  if (isKeyword("int", 3) || isKeyword("double", 6)) {
+  if (isKeyword(KEYWORD_INT) || isKeyword(KEYWORD_DOUBLE)) {
     // Will be use for defining the type of variable list
-    tempDeclarationReturnType = parseType();
-    parseVars();
-
-    return;
+    semantic->tempDeclarationReturnType = parseType();
+    return parseVars();
   }
 
   handleParseError("Expected 'int' or 'double' for declaration",
                    isInFollowSetForDecl);
 
-  return;
+  return AST_NONE;
 }
 
 bool isInFollowSetForType() { return look_ahead->type == TOKEN_ID; }
@@ -469,9 +494,9 @@ int parseType() {
   // TYPE → double
   preParse("type");
 
-  if (matchKeyword("int")) {
+  if (matchKeyword(KEYWORD_INT)) {
     return INT;
-  } else if (matchKeyword("double")) {
+  } else if (matchKeyword(KEYWORD_DOUBLE)) {
     return DOUBLE;
   } else {
     handleParseError("Expected 'int' or 'double' as type",
@@ -481,41 +506,54 @@ int parseType() {
   }
 }
 
-void parseVars() {
+AstIndex parseVars() {
   // VARS → VAR C VARSC
   preParse("vars");
 
-  char *variableName = parseVar();
+  AstIndex variable = parseVar();
+  const char *variableName = astNode(variable)->name;
 
-  C(VARIABLE, tempDeclarationReturnType, look_ahead->line, 0, variableName);
+  C(VARIABLE, semantic->tempDeclarationReturnType, look_ahead->offset, 0,
+    variableName);
 
-  parseVarsc();
+  // A declaration reuses the variable's index as the array size
+  AstIndex declaration = newAstNode(AST_DECLARATION, astNode(variable)->offset,
+                                    astNode(variable)->a, AST_NONE, AST_NONE);
+  astNode(declaration)->name = variableName;
+  astNode(declaration)->dataType = semantic->tempDeclarationReturnType;
 
-  free(variableName);
+  return appendAstList(declaration, parseVarsc());
 }
 
-void parseVarsc() {
+AstIndex parseVarsc() {
   // VARSC → , VARS
   // VARSC → ε
   preParse("varsc");
 
   if (matchType(TOKEN_COMMA)) {
-    parseVars();
-    return;
+    return parseVars();
   }
 
-  return;
+  return AST_NONE;
 }
 
-void parseStmts() {
+AstIndex parseStmts() {
   // STMTS → STMT STMTSC
-  preParse("stmts");
+  // STMTSC is taken by looping instead of recursing, so long statement
+  // lists do not grow the stack
+  AstIndex first = AST_NONE;
+  AstIndex last = AST_NONE;
 
-  parseStmt();
-  parseStmtsc();
+  do {
+    preParse("stmts");
+
+    appendToList(&first, &last, parseStmt());
+  } while (parseStmtsc());
+
+  return first;
 }
 
-void parseStmtsc() {
+bool parseStmtsc() {
   // STMTSC → ; STMTS
   // STMTSC → ε
   preParse("stmtsc");
@@ -523,12 +561,10 @@ void parseStmtsc() {
   if (look_ahead->type == TOKEN_SEMICOLON) {
     matchType(TOKEN_SEMICOLON);
 
-    parseStmts();
-
-    return;
+    return true;
   }
 
-  return;
+  return false;
 }
 
 bool isInFollowSetForStmt() {
@@ -537,14 +573,14 @@ bool isInFollowSetForStmt() {
   case TOKEN_SEMICOLON:
     return true;
   case TOKEN_KEYWORD:
-    return isKeyword("fed", 3) || isKeyword("fi", 2) || isKeyword("od", 2) ||
-           isKeyword("else", 4);
+    return isKeyword(KEYWORD_FED) || isKeyword(KEYWORD_FI) ||
+           isKeyword(KEYWORD_OD) || isKeyword(KEYWORD_ELSE);
   default:
     return false;
   }
 }
 
-void parseStmt() {
+AstIndex parseStmt() {
   // STMT → VAR D = EXPR
   // STMT → if BEXPR then STMTS STMTC
   // STMT → while BEXPR do STMTS od
@@ -553,159 +589,188 @@ void parseStmt() {
   // STMT →  ε
   preParse("stmt");
 
+  uint32_t offset = look_ahead->offset;
+
   if (look_ahead->type == TOKEN_ID) {
-    char *variableName = parseVar();
+    AstIndex target = parseVar();
 
-    SymbolTableEntry *variable = D(variableName);
+    SymbolTableEntry *variable = D(astNode(target)->name);
+    if (variable) {
+      astNode(target)->dataType = variable->returnType;
+    }
 
     if (!matchType(TOKEN_ASSIGN_OP)) {
       handleParseError("Expected '=' for assignment", isInFollowSetForStmt);
-      return;
+      return AST_NONE;
     }
 
     // Get the return type of expression
-    DataType rightType = parseExpr();
+    AstIndex value = parseExpr();
+    DataType rightType = astNode(value)->dataType;
 
     // Type checking: Ensure LHS (variable) type matches RHS (expression) type
-    if (variable && variable->returnType != rightType) {
-      handleSemanticError("Type mismatch during assignment at line %d. "
+    if (variable && isTypeMismatch(variable->returnType, rightType)) {
+      int line = lineOf(look_ahead->offset);
+      handleSemanticError(DIAG_ASSIGNMENT_TYPE, line,
+                          "Type mismatch during assignment at line %d. "
                           "Left operand is '%s', but right operand is '%s'.",
-                          look_ahead->line,
+                          line,
                           dataTypeToString(variable->returnType),
                           dataTypeToString(rightType));
     }
-  } else if (isKeyword("if", 2)) {
-    matchKeyword("if");
 
-    parseBexpr();
+    return newAstNode(AST_ASSIGN, offset, target, value, AST_NONE);
+  } else if (isKeyword(KEYWORD_IF)) {
+    matchKeyword(KEYWORD_IF);
 
-    if (!matchKeyword("then")) {
+    AstIndex condition = parseBexpr();
+
+    if (!matchKeyword(KEYWORD_THEN)) {
       handleParseError("Missing 'then' after 'if' statement",
                        isInFollowSetForStmt);
-      return;
+      return AST_NONE;
     }
 
-    parseStmts();
+    AstIndex thenBranch = parseStmts();
+    AstIndex elseBranch = parseStmtc();
 
-    parseStmtc();
-  } else if (isKeyword("while", 5)) {
-    matchKeyword("while");
+    return newAstNode(AST_IF, offset, condition, thenBranch, elseBranch);
+  } else if (isKeyword(KEYWORD_WHILE)) {
+    matchKeyword(KEYWORD_WHILE);
 
-    parseBexpr();
+    AstIndex condition = parseBexpr();
 
-    if (!matchKeyword("do")) {
+    if (!matchKeyword(KEYWORD_DO)) {
       handleParseError("Missing 'do' after 'while' statement",
                        isInFollowSetForStmt);
-      return;
+      return AST_NONE;
     }
 
-    parseStmts();
+    AstIndex body = parseStmts();
 
-    if (!matchKeyword("od")) {
+    if (!matchKeyword(KEYWORD_OD)) {
       handleParseError("Expected 'od' at the end of while loop",
                        isInFollowSetForStmt);
-      return;
+      return AST_NONE;
     }
-  } else if (isKeyword("print", 5)) {
-    matchKeyword("print");
 
-    parseExpr();
+    return newAstNode(AST_WHILE, offset, condition, body, AST_NONE);
+  } else if (isKeyword(KEYWORD_PRINT)) {
+    matchKeyword(KEYWORD_PRINT);
 
-  } else if (isKeyword("return", 6)) {
-    matchKeyword("return");
+    AstIndex value = parseExpr();
 
-    DataType returnType = parseExpr();
+    return newAstNode(AST_PRINT, offset, value, AST_NONE, AST_NONE);
+  } else if (isKeyword(KEYWORD_RETURN)) {
+    matchKeyword(KEYWORD_RETURN);
+
+    AstIndex value = parseExpr();
+    DataType returnType = astNode(value)->dataType;
 
     // Compare the return value with function return type
     SymbolTableEntry *functionEntry = getFunctionEntry();
 
-    if (returnType != functionEntry->returnType) {
-      handleSemanticError("Function declared as %s but returning %s",
+    if (!functionEntry) {
+      int line = lineOf(offset);
+      handleSemanticError(DIAG_RETURN_OUTSIDE_FUNCTION, line,
+                          "Return statement outside of a function at line %d",
+                          line);
+    } else if (isTypeMismatch(returnType, functionEntry->returnType)) {
+      int line = lineOf(offset);
+      handleSemanticError(DIAG_RETURN_TYPE, line,
+                          "Function declared as %s but returning %s",
                           dataTypeToString(functionEntry->returnType),
                           dataTypeToString(returnType));
     }
+
+    return newAstNode(AST_RETURN, offset, value, AST_NONE, AST_NONE);
   } else {
-    return;
+    return AST_NONE;
   }
 }
 
-void parseStmtc() {
+AstIndex parseStmtc() {
   // STMTC → fi
   // STMTC → else STMTS fi
   preParse("stmtc");
 
-  if (isKeyword("fi", 2)) {
-    matchKeyword("fi");
-    return;
+  if (isKeyword(KEYWORD_FI)) {
+    matchKeyword(KEYWORD_FI);
+    return AST_NONE;
   }
 
-   if (isKeyword("else", 4)) {
-    matchKeyword("else");
-    
-    parseStmts();
+  if (isKeyword(KEYWORD_ELSE)) {
+    matchKeyword(KEYWORD_ELSE);
 
-    if (!matchKeyword("fi")) {
+    AstIndex elseBranch = parseStmts();
+
+    if (!matchKeyword(KEYWORD_FI)) {
       handleParseError("Statement does not end with 'fi'",
                        isInFollowSetForStmt);
-      return;
     }
 
-    return;
+    return elseBranch;
   }
 
   handleParseError("Expected 'fi' or 'else' for the end of statement",
                    isInFollowSetForStmt);
-  return;
+  return AST_NONE;
 }
 
-DataType parseExpr() {
+AstIndex parseExpr() {
   // EXPR → TERM EXPRC
   preParse("expr");
 
-  DataType leftType = parseTerm();
-  return parseExprc(leftType);
+  AstIndex left = parseTerm();
+  return parseExprc(left);
 }
 
-DataType parseExprc(DataType leftType) {
+AstIndex parseExprc(AstIndex left) {
   // EXPRC → + TERM EXPRC
   // EXPRC → - TERM EXPRC
   // EXPRC → ε
   preParse("exprc");
 
   if (look_ahead->type == TOKEN_ADD || look_ahead->type == TOKEN_SUB) {
-    int line = look_ahead->line;
-
-    char *lexemeCopy = getTokenLexeme(look_ahead);
+    uint32_t offset = look_ahead->offset;
+    TokenType op = look_ahead->type;
 
     matchType(look_ahead->type);
 
-    DataType rightType = parseTerm();
+    AstIndex right = parseTerm();
+    DataType leftType = astNode(left)->dataType;
+    DataType rightType = astNode(right)->dataType;
 
-    if (leftType != rightType) {
-      handleSemanticError("Type mismatch in arithmetic operation at line %d. "
+    if (isTypeMismatch(leftType, rightType)) {
+      int line = lineOf(offset);
+      handleSemanticError(DIAG_ARITHMETIC_TYPE, line,
+                          "Type mismatch in arithmetic operation at line %d. "
                           "Left operand is '%s', but right operand is '%s'.",
                           line, dataTypeToString(leftType),
                           dataTypeToString(rightType));
     }
 
-    free(lexemeCopy);
+    // Left associative: the new node becomes the left operand
+    AstIndex binary = newAstNode(AST_BINARY, offset, left, right, AST_NONE);
+    astNode(binary)->op = (uint8_t)op;
+    astNode(binary)->dataType = leftType;
 
-    return parseExprc(leftType);
+    return parseExprc(binary);
   }
 
-  return leftType;
+  return left;
 }
 
-DataType parseTerm() {
+AstIndex parseTerm() {
   // TERM → FACTOR TERMC
   preParse("term");
 
-  DataType leftType = parseFactor();
+  AstIndex left = parseFactor();
 
-  return parseTermc(leftType);
+  return parseTermc(left);
 }
 
-DataType parseTermc(DataType leftType) {
+AstIndex parseTermc(AstIndex left) {
   // TERMC → * FACTOR TERMC
   // TERMC → / FACTOR TERMC
   // TERMC → % FACTOR TERMC
@@ -715,29 +780,35 @@ DataType parseTermc(DataType leftType) {
 
   if (look_ahead->type == TOKEN_MUL || look_ahead->type == TOKEN_DIV ||
       look_ahead->type == TOKEN_MOD) {
-    int line = look_ahead->line;
-
-    char *lexemeCopy = getTokenLexeme(look_ahead);
+    uint32_t offset = look_ahead->offset;
+    TokenType op = look_ahead->type;
 
     matchType(look_ahead->type);
 
-    DataType rightType = parseFactor();
+    AstIndex right = parseFactor();
+    DataType leftType = astNode(left)->dataType;
+    DataType rightType = astNode(right)->dataType;
 
-    if (leftType != rightType) {
-      handleSemanticError("Type mismatch in arithmetic operation at line %d. "
+    AstIndex binary = newAstNode(AST_BINARY, offset, left, right, AST_NONE);
+    astNode(binary)->op = (uint8_t)op;
+    astNode(binary)->dataType = leftType;
+
+    if (isTypeMismatch(leftType, rightType)) {
+      int line = lineOf(offset);
+      handleSemanticError(DIAG_ARITHMETIC_TYPE, line,
+                          "Type mismatch in arithmetic operation at line %d. "
                           "Left operand is '%s', but right operand is '%s'.",
                           line, dataTypeToString(leftType),
                           dataTypeToString(rightType));
 
-      return ERROR;
+      astNode(binary)->dataType = ERROR;
+      return binary;
     }
 
-    free(lexemeCopy);
-
-    return parseTermc(leftType);
+    return parseTermc(binary);
   }
 
-  return leftType;
+  return left;
 }
 
 bool isInFollowSetForFactor() {
@@ -761,94 +832,109 @@ bool isInFollowSetForFactor() {
     return true;
 
   case TOKEN_KEYWORD:
-    return isKeyword("fed", 3) || isKeyword("fi", 2) || isKeyword("od", 2) ||
-           isKeyword("else", 4);
+    return isKeyword(KEYWORD_FED) || isKeyword(KEYWORD_FI) ||
+           isKeyword(KEYWORD_OD) || isKeyword(KEYWORD_ELSE);
 
   default:
     return false;
   }
 }
 
-DataType parseFactor() {
+AstIndex parseFactor() {
   // FACTOR → ID D FACTORC
   // FACTOR → NUMBER
   // FACTOR → (EXPR)
   preParse("factor");
 
+  uint32_t offset = look_ahead->offset;
+
   if (look_ahead->type == TOKEN_ID) {
     // Look up the identifier in symbol table
     // If found, return the symbol's return type
-    char *factorId = getTokenLexeme(look_ahead);
+    const char *factorId = getTokenLexeme(look_ahead);
 
     matchType(TOKEN_ID);
 
     SymbolTableEntry *symbol = D(factorId);
-    parseFactorc(symbol);
+    AstIndex factor = parseFactorc(symbol, offset);
 
-    free(factorId);
+    astNode(factor)->name = factorId;
+    astNode(factor)->dataType = symbol ? symbol->returnType : ERROR;
 
-    return symbol->returnType;
+    return factor;
   }
 
   if (isNumber(look_ahead->type)) {
-    DataType numberType = look_ahead->type == TOKEN_INT ? INT : DOUBLE;
+    AstIndex number =
+        newAstNode(AST_NUMBER, offset, AST_NONE, AST_NONE, AST_NONE);
+    astNode(number)->name = getTokenLexeme(look_ahead);
+    astNode(number)->dataType = look_ahead->type == TOKEN_INT ? INT : DOUBLE;
 
     matchType(look_ahead->type);
 
-    return numberType;
+    return number;
   }
 
   if (look_ahead->type == TOKEN_LEFT_PAREN) {
     matchType(TOKEN_LEFT_PAREN);
 
-    DataType exprType = parseExpr();
+    AstIndex expr = parseExpr();
 
     if (!matchType(TOKEN_RIGHT_PAREN)) {
       handleParseError("Expected ')'", isInFollowSetForFactor);
-      return ERROR;
+      return AST_NONE;
     }
 
-    return exprType;
+    return expr;
   }
 
   handleParseError(
       "Expected an identifier, number, or '(' to start an expression",
       isInFollowSetForFactor);
-  return ERROR;
+  return AST_NONE;
 }
 
-void parseFactorc(SymbolTableEntry *symbol) {
+AstIndex parseFactorc(SymbolTableEntry *symbol, uint32_t offset) {
   // FACTORC → VARC
   // FACTORC → ( EXPRS )
   preParse("factorc");
 
   if (look_ahead->type == TOKEN_LEFT_PAREN) {
-    if (symbol->symbolType != FUNCTION) {
-      handleSemanticError("'%s' is not a function but is used as one (line "
+    if (symbol && symbol->symbolType != FUNCTION) {
+      int line = lineOf(look_ahead->offset);
+      handleSemanticError(DIAG_NOT_A_FUNCTION, line,
+                          "'%s' is not a function but is used as one (line "
                           "%d).",
-                          symbol->lexeme, look_ahead->line);
+                          symbol->lexeme, line);
     }
 
     // Manage call stack
     pushCallFrame();
 
     matchType(TOKEN_LEFT_PAREN);
-    parseExprs();
+    AstIndex arguments = parseExprs();
+    AstIndex call = newAstNode(AST_CALL, offset, arguments, AST_NONE, AST_NONE);
 
     if (!matchType(TOKEN_RIGHT_PAREN)) {
       handleParseError("Expected closing parenthesis ')'",
                        isInFollowSetForFactor);
-      return;
+      return call;
     }
-    handleFunctionCall(symbol);
 
-    return;
+    if (symbol) {
+      handleFunctionCall(symbol);
+    } else {
+      popCallFrame();
+    }
+
+    return call;
   }
 
-  parseVarc();
+  AstIndex index = parseVarc();
+  return newAstNode(AST_VARIABLE, offset, index, AST_NONE, AST_NONE);
 }
 
-void parseExprs() {
+AstIndex parseExprs() {
   // EXPRS → EXPR EXPRSC
   // EXPRS → ε
   preParse("exprs");
@@ -856,129 +942,137 @@ void parseExprs() {
   if (look_ahead->type == TOKEN_ID || look_ahead->type == TOKEN_INT ||
       look_ahead->type == TOKEN_DOUBLE ||
       look_ahead->type == TOKEN_LEFT_PAREN) {
-    FunctionCallFrame *frame = currentCallFrame();
+    AstIndex argument = parseExpr();
 
-    frame->argTypes[frame->argCount++] = parseExpr();
-    parseExprsc();
+    // Nested calls may have moved the frames, so record it afterwards
+    addArgType(astNode(argument)->dataType);
 
-    return;
+    return appendAstList(argument, parseExprsc());
   }
 
-  return;
+  return AST_NONE;
 }
 
-void parseExprsc() {
+AstIndex parseExprsc() {
   // EXPRSC → , EXPRS
   // EXPRSC → ε
   preParse("exprsc");
 
   if (look_ahead->type == TOKEN_COMMA) {
     matchType(TOKEN_COMMA);
-    parseExprs();
-    return;
+    return parseExprs();
   }
 
-  return;
+  return AST_NONE;
 }
 
-void parseBexpr() {
+AstIndex parseBexpr() {
   // BEXPR → BTERM BEXPRC
   preParse("bexpr");
 
-  parseBterm();
-  parseBexprc();
+  AstIndex left = parseBterm();
+  return parseBexprc(left);
 }
 
-void parseBexprc() {
+AstIndex parseBexprc(AstIndex left) {
   // BEXPRC → or BTERM BEXPRC
   // BEXPRC → ε
   preParse("bexprc");
 
-  if (isKeyword("or", 2)) {
-    matchKeyword("or");
+  if (isKeyword(KEYWORD_OR)) {
+    uint32_t offset = look_ahead->offset;
 
-    parseBterm();
+    matchKeyword(KEYWORD_OR);
 
-    parseBexprc();
+    AstIndex right = parseBterm();
 
-    return;
+    return parseBexprc(newAstNode(AST_OR, offset, left, right, AST_NONE));
   }
 
-  return;
+  return left;
 }
 
-void parseBterm() {
+AstIndex parseBterm() {
   // BTERM → BFACTOR BTERMC
   preParse("bterm");
 
-  parseBfactor();
-  parseBtermc();
+  AstIndex left = parseBfactor();
+  return parseBtermc(left);
 }
 
-void parseBtermc() {
+AstIndex parseBtermc(AstIndex left) {
   // BTERMC → and BFACTOR BTERMC
   // BTERMC → ε
   preParse("btermc");
 
-  if (isKeyword("and", 3)) {
-    matchKeyword("and");
+  if (isKeyword(KEYWORD_AND)) {
+    uint32_t offset = look_ahead->offset;
 
-    parseBfactor();
+    matchKeyword(KEYWORD_AND);
 
-    parseBtermc();
+    AstIndex right = parseBfactor();
 
-    return;
+    return parseBtermc(newAstNode(AST_AND, offset, left, right, AST_NONE));
   }
 
-  return;
+  return left;
 }
 
 bool isInFollowSetForBfactor() {
-  return isKeyword("then", 4) || isKeyword("do", 2) || isKeyword("or", 2) ||
-         isKeyword("and", 3);
+  return isKeyword(KEYWORD_THEN) || isKeyword(KEYWORD_DO) ||
+         isKeyword(KEYWORD_OR) || isKeyword(KEYWORD_AND);
 }
 
-void parseBfactor() {
+AstIndex parseBfactor() {
   // BFACTOR → not bfactor
   // BFACTOR → (expr comp expr)
   preParse("bfactor");
 
-  if (isKeyword("not", 3)) {
-    matchKeyword("not");
+  uint32_t offset = look_ahead->offset;
 
-    parseBfactor();
+  if (isKeyword(KEYWORD_NOT)) {
+    matchKeyword(KEYWORD_NOT);
 
-    return;
+    AstIndex operand = parseBfactor();
+
+    return newAstNode(AST_NOT, offset, operand, AST_NONE, AST_NONE);
   }
 
   if (look_ahead->type == TOKEN_LEFT_PAREN) {
     matchType(TOKEN_LEFT_PAREN);
 
-    DataType leftType = parseExpr();
+    AstIndex left = parseExpr();
 
-    parseComp();
+    TokenType op = parseComp();
 
-    DataType rightType = parseExpr();
+    AstIndex right = parseExpr();
+    DataType leftType = astNode(left)->dataType;
+    DataType rightType = astNode(right)->dataType;
 
-    if (leftType != rightType) {
-      handleSemanticError("Type mismatched in comparison at line %d. Left "
+    if (isTypeMismatch(leftType, rightType)) {
+      int line = lineOf(look_ahead->offset);
+      handleSemanticError(DIAG_COMPARISON_TYPE, line,
+                          "Type mismatched in comparison at line %d. Left "
                           "operand is '%s' but right operand is '%s'",
-                          look_ahead->line, dataTypeToString(leftType),
+                          line, dataTypeToString(leftType),
                           dataTypeToString(rightType));
     }
 
+    AstIndex compare = newAstNode(AST_COMPARE, offset, left, right, AST_NONE);
+    astNode(compare)->op = (uint8_t)op;
+    astNode(compare)->dataType = leftType;
+
     if (!matchType(TOKEN_RIGHT_PAREN)) {
       handleParseError("Expected closing parenthesis ')'",
                        isInFollowSetForBfactor);
-      return;
     }
 
-    return;
+    return compare;
   }
 
   handleParseError("Expected 'not' or '(' for boolean factor",
                    isInFollowSetForBfactor);
-  return;
+  return AST_NONE;
 }
 
 bool isInFollowSetForComp() {
@@ -986,7 +1080,7 @@ bool isInFollowSetForComp() {
          look_ahead->type == TOKEN_INT || look_ahead->type == TOKEN_DOUBLE;
 }
 
-void parseComp() {
+TokenType parseComp() {
   // COMP → <
   // COMP → >
   // COMP → ==
@@ -995,13 +1089,15 @@ void parseComp() {
   // COMP → <>
   preParse("comp");
 
-  if (isComparison(look_ahead->type)) {
-    matchType(look_ahead->type);
-    return;
+  TokenType op = look_ahead->type;
+
+  if (isComparison(op)) {
+    matchType(op);
+    return op;
   }
 
   handleParseError("Expected a comparison operator", isInFollowSetForComp);
-  return;
+  return TOKEN_EQ;
 }
 
 bool isInFollowSetForVar() {
@@ -1010,25 +1106,35 @@ bool isInFollowSetForVar() {
          look_ahead->type == TOKEN_COMMA || look_ahead->type == TOKEN_ASSIGN_OP;
 }
 
-char *parseVar() {
+AstIndex parseVar() {
   // VAR → ID VARC
   preParse("var");
 
+  uint32_t offset = look_ahead->offset;
+
   if (look_ahead->type == TOKEN_ID) {
-    char *lexemeCopy = getTokenLexeme(look_ahead);
+    const char *lexeme = getTokenLexeme(look_ahead);
 
     matchType(TOKEN_ID);
 
-    parseVarc();
+    AstIndex index = parseVarc();
 
-    return lexemeCopy;
+    AstIndex variable =
+        newAstNode(AST_VARIABLE, offset, index, AST_NONE, AST_NONE);
+    astNode(variable)->name = lexeme;
+
+    return variable;
   }
 
   handleParseError("Expected an identifier", isInFollowSetForVar);
-  return NULL;
+  return AST_NONE;
+}
+
+bool isInFollowSetForVarc() {
+  return isInFollowSetForFactor() || look_ahead->type == TOKEN_ASSIGN_OP;
 }
 
-void parseVarc() {
+AstIndex parseVarc() {
   // VARC → [ EXPR ]
   // VARC → ε
 
@@ -1037,14 +1143,17 @@ void parseVarc() {
   if (look_ahead->type == TOKEN_LEFT_SQUARE_PAREN) {
     matchType(TOKEN_LEFT_SQUARE_PAREN);
 
-    parseExpr();
+    AstIndex index = parseExpr();
 
-    matchType(TOKEN_LEFT_SQUARE_PAREN);
+    if (!matchType(TOKEN_RIGHT_SQUARE_PAREN)) {
+      handleParseError("Expected ']' after array index",
+                       isInFollowSetForVarc);
+    }
 
-    return;
+    return index;
   }
 
-  return;
+  return AST_NONE;
 }
 
-//< Parse Functions
\ No newline at end of file
+//< Parse Functions
@@ -1,14 +1,23 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "../common/context.h"
+#include "../common/diagnostics.h"
 #include "../common/token.h"
 #include "../semantic/semantic.h"
+#include "ast.h"
 #include <stdbool.h>
 
-// Exported variables
-// extern Token *look_ahead;
-extern Token identifiers[];
-extern int identifierCount;
+#define PARSER_BUFFER_SIZE 1024
+
+// Output buffers of a parse, one per compiler context
+typedef struct {
+  char symbolTableBuffer[PARSER_BUFFER_SIZE + 1];
+  size_t symbolTableBufferIndex;
+} ParserState;
+
+// Parser of the context bound to this thread
+extern _Thread_local ParserState *parsing;
 
 // Helper functions
 // void addEndToken(Token *tokens, int *tokenCount);
@@ -17,7 +26,13 @@ void parseError(const char *expectedMessage);
 void handleParseError(const char *message, bool (*isInFollowSet)());
 
 // Parsing functions
-void Parse(Token **tokens);
+// Parse the tokens behind the context's cursor, set up with
+// initTokenCursor*, and return the root of the syntax tree
+AstIndex Parse(CompilerContext *context);
+// The two ends of Parse: remove the files a parse writes and clear the
+// syntax tree, then tell whether the parse reached the end of the input
+void beginParse();
+void endParse();
 
 // Follow Set functions
 void syncProg();
@@ -33,43 +48,49 @@ bool isInFollowSetForFactor();
 bool isInFollowSetForBfactor();
 bool isInFollowSetForComp();
 bool isInFollowSetForVar();
+bool isInFollowSetForVarc();
 
-// Non-terminal parsing functions
-void parseProg();
-void parseFns();
-void parseFnsc();
-void parseFn();
-void parseParams();
-void parseParamsc();
-char *parseFname();
-void parseDecls();
-void parseDeclsc();
-void parseDecl();
+// Non-terminal parsing functions, each returns the node it built
+void appendToList(AstIndex *first, AstIndex *last, AstIndex items);
+AstIndex parseProg();
+// Declarations and statements after the functions, then the end of the
+// program, whose node starts at offset and holds the functions
+AstIndex parseProgc(uint32_t offset, AstIndex functions);
+AstIndex parseFns();
+AstIndex parseFnsc();
+AstIndex parseFn();
+AstIndex addParam(DataType type, AstIndex variable);
+AstIndex parseParams();
+AstIndex parseParamsc();
+const char *parseFname();
+AstIndex parseDecls();
+AstIndex parseDecl();
 int parseType();
-void parseVars();
-void parseVarsc();
-void parseStmts();
-void parseStmtsc();
-void parseStmt();
-void parseStmtc();
-DataType parseExpr();
-DataType parseExprc(DataType leftType);
-DataType parseTerm();
-DataType parseTermc(DataType leftType);
-DataType parseFactor();
-void parseFactorc(SymbolTableEntry *symbol);
-void parseExprs();
-void parseExprsc();
-char *parseVar();
-void parseVarc();
+AstIndex parseVars();
+AstIndex parseVarsc();
+AstIndex parseStmts();
+// Matches the ; between statements, parseStmts loops while it does
+bool parseStmtsc();
+AstIndex parseStmt();
+AstIndex parseStmtc();
+AstIndex parseExpr();
+AstIndex parseExprc(AstIndex left);
+AstIndex parseTerm();
+AstIndex parseTermc(AstIndex left);
+AstIndex parseFactor();
+AstIndex parseFactorc(SymbolTableEntry *symbol, uint32_t offset);
+AstIndex parseExprs();
+AstIndex parseExprsc();
+AstIndex parseVar();
+AstIndex parseVarc();
 
 // Boolean expression parsing functions
-void parseBexpr();
-void parseBexprc();
-void parseBterm();
-void parseBtermc();
-void parseBfactor();
-void parseComp();
+AstIndex parseBexpr();
+AstIndex parseBexprc(AstIndex left);
+AstIndex parseBterm();
+AstIndex parseBtermc(AstIndex left);
+AstIndex parseBfactor();
+TokenType parseComp();
 bool isComparison(TokenType type);
 
 // Semantic Analysis Handlers (Markers)
@@ -77,11 +98,11 @@ bool isComparison(TokenType type);
 // B: Pop Scope
 // C: Insert Symbol
 // D: Lookup Symbol
-void A(char *scopeName);
+void A(const char *scopeName);
 void B();
-void C(SymbolType symbolType, DataType returnType, int lineNumber,
-       int parameterCount, char *symbolName);
+void C(SymbolType symbolType, DataType returnType, uint32_t offset,
+       int parameterCount, const char *symbolName);
 SymbolTableEntry *D(const char *lexeme);
-void handleSemanticError(const char *format, ...);
+void handleSemanticError(DiagnosticId id, int line, const char *format, ...);
 
 #endif // PARSER_H
\ No newline at end of file
@@ -1,29 +1,99 @@
 #include "semantic.h"
+#include "../common/arena.h"
+#include "../common/diagnostics.h"
 #include "../common/error_state.h"
-#include "../common/file_utils.h"
+#include "../common/line_index.h"
+#include "../common/trace.h"
+#include <stdint.h>
 #include <stdio.h>
 
-#define BUFFER_SIZE 1024
+#define INITIAL_SCOPES 4
+#define INITIAL_ENTRIES 16
+#define INITIAL_SLOTS 32
+#define INITIAL_CALL_FRAMES 8
+#define INITIAL_ARGS 8
 
-// Global variables
-// Scopes size of 2: global scope, function scope
-int scopeCount = 0;
-SymbolTable scopes[MAX_SCOPES];
+_Thread_local SemanticState *semantic = NULL;
 
-char semanticErrorBuffer[BUFFER_SIZE + 1];
-size_t semanticErrorBufferIndex = 0;
+//> Hash index
+// Names are interned, so the pointer itself is the key
+static unsigned int hashName(const char *lexeme) {
+  uintptr_t key = (uintptr_t)lexeme;
+  return (unsigned int)((key >> 4) ^ (key >> 20)) * 2654435761u;
+}
+
+// Slot holding the name, or the empty slot where it would go
+static SymbolTableEntry **findSlot(SymbolTable *table, const char *lexeme) {
+  unsigned int mask = table->slotCount - 1;
+  unsigned int index = hashName(lexeme) & mask;
+
+  while (table->slots[index] && table->slots[index]->lexeme != lexeme) {
+    index = (index + 1) & mask;
+  }
+
+  return &table->slots[index];
+}
+
+static VisibleSlot *findVisibleSlot(const char *lexeme) {
+  unsigned int mask = semantic->visibleSlotCount - 1;
+  unsigned int index = hashName(lexeme) & mask;
+
+  VisibleSlot *slots = semantic->visible;
+
+  while (slots[index].lexeme && slots[index].lexeme != lexeme) {
+    index = (index + 1) & mask;
+  }
+
+  return &slots[index];
+}
+
+static void growVisibleSlots() {
+  VisibleSlot *oldSlots = semantic->visible;
+  int oldCount = semantic->visibleSlotCount;
+
+  semantic->visibleSlotCount = oldCount == 0 ? INITIAL_SLOTS : oldCount * 2;
+  semantic->visible = arenaAlloc(
+      semanticArena, semantic->visibleSlotCount * sizeof(VisibleSlot));
+
+  for (int i = 0; i < semantic->visibleSlotCount; i++) {
+    semantic->visible[i].lexeme = NULL;
+    semantic->visible[i].entry = NULL;
+  }
+
+  for (int i = 0; i < oldCount; i++) {
+    if (oldSlots[i].lexeme) {
+      *findVisibleSlot(oldSlots[i].lexeme) = oldSlots[i];
+    }
+  }
+}
+
+static void growSlots(SymbolTable *table) {
+  int slotCount = table->slotCount == 0 ? INITIAL_SLOTS : table->slotCount * 2;
 
-DataType tempDeclarationReturnType = INT;
-DataType tempArgTypeList[MAX_ARGS];
-SymbolTableEntry tempArgList[MAX_ARGS];
-int argCount = 0;
+  table->slots =
+      arenaAlloc(semanticArena, slotCount * sizeof(SymbolTableEntry *));
+  table->slotCount = slotCount;
 
-FunctionCallStack callStack = {.top = -1}; // top property is 0 based
+  for (int i = 0; i < slotCount; i++) {
+    table->slots[i] = NULL;
+  }
+
+  // Rehash every entry into the bigger index
+  for (int i = 0; i < table->entryCount; i++) {
+    *findSlot(table, table->entries[i]->lexeme) = table->entries[i];
+  }
+}
+//< Hash index
 
 // Create default symbol table
 SymbolTable defaultSymbolTable(const char *scopeName) {
   SymbolTable table;
   table.entryCount = 0;
+  table.entryCapacity = 0;
+  table.entries = NULL;
+  table.slots = NULL;
+  table.slotCount = 0;
+  table.function = NULL;
   // Update the name of the symbol table
   _strncpy(table.name, scopeName, sizeof(table.name) - 1);
   table.name[sizeof(table.name) - 1] = '\0';
@@ -32,44 +102,60 @@ SymbolTable defaultSymbolTable(const char *scopeName) {
 }
 
 void pushScope(const char *scopeName) {
-  printf("scope count before push scope: %d\n", scopeCount);
+  trace(TRACE_SEMANTIC, TRACE_RULE, "scope count before push scope: %d\n",
+        semantic->scopeCount);
 
-  if (scopeCount >= MAX_SCOPES) {
-    char errorMsg[100];
-    snprintf(errorMsg, sizeof(errorMsg), "Maximum scope limit of %d reached.",
-             MAX_SCOPES);
-    scopeError(errorMsg);
+  if (semantic->scopeCount == semantic->scopeCapacity) {
+    int capacity = semantic->scopeCapacity == 0 ? INITIAL_SCOPES
+                                                : semantic->scopeCapacity * 2;
 
-    return;
+    semantic->scopes = arenaGrow(semanticArena, semantic->scopes,
+                                 semantic->scopeCapacity * sizeof(SymbolTable),
+                                 capacity * sizeof(SymbolTable));
+    semantic->scopeCapacity = capacity;
   }
 
   SymbolTable table = defaultSymbolTable(scopeName);
-  scopes[scopeCount++] = table;
+
+  // Function scopes are named after their function, which the enclosing
+  // scope already holds
+  SymbolTableEntry *owner = lookupSymbol(scopeName);
+  if (owner && owner->symbolType == FUNCTION) {
+    table.function = owner;
+  }
+
+  semantic->scopes[semantic->scopeCount++] = table;
   printScope(&table);
 }
 
 SymbolTable *popScope() {
-  if (scopeCount <= 0) {
-    scopeError("No scopes left to pop");
+  if (semantic->scopeCount <= 0) {
+    scopeError(DIAG_NO_SCOPE, 0, "No scopes left to pop");
     return NULL;
   }
 
-  SymbolTable *popTable = &(scopes[scopeCount - 1]);
-  scopeCount--;
+  SymbolTable *popTable = &(semantic->scopes[semantic->scopeCount - 1]);
+  semantic->scopeCount--;
 
-  puts("Pop the table");
+  // Names of the popped scope reveal what they shadowed
+  for (int i = popTable->entryCount - 1; i >= 0; i--) {
+    SymbolTableEntry *entry = popTable->entries[i];
+    findVisibleSlot(entry->lexeme)->entry = entry->shadowed;
+  }
+
+  trace(TRACE_SEMANTIC, TRACE_RULE, "Pop the table\n");
   printScope(popTable);
 
   return popTable;
 }
 
 SymbolTable *getSymbolTable() {
-  if (scopeCount == 0) {
-    scopeError("No scope available to retrieve");
+  if (semantic->scopeCount == 0) {
+    scopeError(DIAG_NO_SCOPE, 0, "No scope available to retrieve");
     return NULL;
   }
 
-  return &(scopes[scopeCount - 1]);
+  return &(semantic->scopes[semantic->scopeCount - 1]);
 }
 
 void insertSymbol(SymbolTableEntry entry) {
@@ -78,158 +164,231 @@ void insertSymbol(SymbolTableEntry entry) {
   if (table == NULL)
     return; // Handling error in getSymbolTable
 
-  // Error handling if reach max entries
-  if (table->entryCount >= MAX_ENTRIES) {
-    scopeError("Maximum symbol table entries reached.");
+  // A declaration whose name was missing, already reported as a syntax
+  // error; a NULL key would read as an empty slot holding an entry
+  if (entry.lexeme == NULL) {
     return;
   }
 
+  // Keep the load factor under one half
+  if ((table->entryCount + 1) * 2 > table->slotCount) {
+    growSlots(table);
+  }
+
   // Check for redeclaration at current scope
-  for (int i = 0; i < table->entryCount; i++) {
-    if (_strcmp(table->entries[i].lexeme, entry.lexeme) == 0) {
-      char errorMsg[100];
-      snprintf(errorMsg, sizeof(errorMsg), "Redeclaration of '%s' at line %d",
-               entry.lexeme, entry.lineNumber);
-      scopeError(errorMsg);
-      return;
-    }
+  SymbolTableEntry **slot = findSlot(table, entry.lexeme);
+  if (*slot) {
+    char errorMsg[100];
+    int line = lineOf(entry.offset);
+    snprintf(errorMsg, sizeof(errorMsg), "Redeclaration of '%s' at line %d",
+             entry.lexeme, line);
+    scopeError(DIAG_REDECLARATION, line, errorMsg);
+    return;
+  }
+
+  // Insert if no redeclaration, growing the entries when full
+  if (table->entryCount == table->entryCapacity) {
+    int capacity =
+        table->entryCapacity == 0 ? INITIAL_ENTRIES : table->entryCapacity * 2;
+
+    table->entries =
+        arenaGrow(semanticArena, table->entries,
+                  table->entryCapacity * sizeof(SymbolTableEntry *),
+                  capacity * sizeof(SymbolTableEntry *));
+    table->entryCapacity = capacity;
   }
 
-  // Insert if no redeclaration
-  table->entries[table->entryCount++] = entry;
+  SymbolTableEntry *stored = arenaAlloc(semanticArena, sizeof(entry));
+  *stored = entry;
+
+  *slot = stored;
+  table->entries[table->entryCount++] = stored;
+
+  // The new entry hides the same name in enclosing scopes until popped
+  if ((semantic->visibleNameCount + 1) * 2 > semantic->visibleSlotCount) {
+    growVisibleSlots();
+  }
+
+  VisibleSlot *name = findVisibleSlot(entry.lexeme);
+  if (!name->lexeme) {
+    name->lexeme = entry.lexeme;
+    semantic->visibleNameCount++;
+  }
+
+  stored->shadowed = name->entry;
+  name->entry = stored;
 }
 
-// Perform lookup from current scope and proceed to parent scopes
+// The innermost declaration wins, as if scanning from the current scope out
 SymbolTableEntry *lookupSymbol(const char *lexeme) {
-  for (int i = scopeCount - 1; i >= 0; i--) {
-    SymbolTable *table = &scopes[i];
-
-    for (int j = 0; j < table->entryCount; j++) {
-      if (_strcmp(table->entries[j].lexeme, lexeme) == 0) {
-        return &(table->entries[j]);
-      }
-    }
+  if (semantic->visibleSlotCount == 0) {
+    return NULL;
   }
 
-  return NULL; // Symbol not found
+  return findVisibleSlot(lexeme)->entry; // NULL if not found
 }
 
 SymbolTableEntry *getFunctionEntry() {
-  for (int i = scopeCount - 1; i >= 0; i--) {
-    SymbolTable *table = &scopes[i];
-
-    for (int j = 0; j < table->entryCount; j++) {
-      if (table->entries[j].symbolType == FUNCTION) {
-        return &(table->entries[j]);
-      }
+  for (int i = semantic->scopeCount - 1; i >= 0; i--) {
+    if (semantic->scopes[i].function) {
+      return semantic->scopes[i].function;
     }
   }
 
-  return NULL; // Symbol not found
+  return NULL; // Not inside a function
 }
 
 void pushCallFrame() {
-  if (callStack.top >= MAX_CALL_STACKS) {
-    fprintf(stderr, "Call stack overflow\n");
-    return;
+  FunctionCallStack *callStack = &semantic->callStack;
+
+  if (callStack->top + 1 == callStack->capacity) {
+    int capacity = callStack->capacity == 0 ? INITIAL_CALL_FRAMES
+                                            : callStack->capacity * 2;
+
+    callStack->stack =
+        arenaGrow(semanticArena, callStack->stack,
+                  callStack->capacity * sizeof(FunctionCallFrame),
+                  capacity * sizeof(FunctionCallFrame));
+    for (int i = callStack->capacity; i < capacity; i++) {
+      callStack->stack[i].argTypes = NULL;
+      callStack->stack[i].argCapacity = 0;
+    }
+    callStack->capacity = capacity;
   }
 
-  callStack.top++;
-
-  FunctionCallFrame *frame = &callStack.stack[callStack.top];
-  frame->argCount = 0;
-
-  for (int i = 0; i < MAX_ARGS; i++) {
-    frame->argTypes[i] = ERROR;
-  }
+  callStack->top++;
+  callStack->stack[callStack->top].argCount = 0;
 }
 
 void popCallFrame() {
-  if (callStack.top < 0) {
+  if (semantic->callStack.top < 0) {
     fprintf(stderr, "Call stack is already empty\n");
     return;
   }
 
-  callStack.top--;
+  semantic->callStack.top--;
 }
 
 FunctionCallFrame *currentCallFrame() {
-  if (callStack.top < 0) {
+  if (semantic->callStack.top < 0) {
     return NULL;
   }
 
-  return &callStack.stack[callStack.top];
+  return &semantic->callStack.stack[semantic->callStack.top];
 }
 
-void scopeError(const char *message) {
-  char fullMessage[BUFFER_SIZE + 1];
-  snprintf(fullMessage, BUFFER_SIZE, "Scope Error: %s\n", message);
+void addArgType(DataType type) {
+  FunctionCallFrame *frame = currentCallFrame();
+
+  if (frame->argCount == frame->argCapacity) {
+    int capacity =
+        frame->argCapacity == 0 ? INITIAL_ARGS : frame->argCapacity * 2;
 
-  semanticErrorBuffer[BUFFER_SIZE] = '\0';
-  appendToBuffer(semanticErrorBuffer, &semanticErrorBufferIndex, fullMessage,
-                 "semantic_errors.txt");
-  flushBufferToFile("semantic_errors.txt", semanticErrorBuffer,
-                    &semanticErrorBufferIndex);
+    frame->argTypes = arenaGrow(semanticArena, frame->argTypes,
+                                frame->argCapacity * sizeof(DataType),
+                                capacity * sizeof(DataType));
+    frame->argCapacity = capacity;
+  }
+
+  frame->argTypes[frame->argCount++] = type;
 }
 
-void semanticError(const char *message) {
-  setErrorOccurred();
+void addTempArg(SymbolTableEntry entry) {
+  if (semantic->argCount == semantic->argCapacity) {
+    int capacity =
+        semantic->argCapacity == 0 ? INITIAL_ARGS : semantic->argCapacity * 2;
 
-  char fullMessage[BUFFER_SIZE + 1];
-  snprintf(fullMessage, BUFFER_SIZE, "Semantic Error: %s\n", message);
+    semantic->tempArgList =
+        arenaGrow(semanticArena, semantic->tempArgList,
+                  semantic->argCapacity * sizeof(SymbolTableEntry),
+                  capacity * sizeof(SymbolTableEntry));
+    semantic->argCapacity = capacity;
+  }
 
-  semanticErrorBuffer[BUFFER_SIZE] = '\0';
-  appendToBuffer(semanticErrorBuffer, &semanticErrorBufferIndex, fullMessage,
-                 "semantic_errors.txt");
-  flushBufferToFile("semantic_errors.txt", semanticErrorBuffer,
-                    &semanticErrorBufferIndex);
-  return;
+  semantic->tempArgList[semantic->argCount++] = entry;
 }
 
-void printScope(SymbolTable *table) {
-  puts("===============");
-  puts("Print Scope");
-  puts("===============");
-  printf("table name: %s\n", table->name);
-  printf("entry count: %d\n", table->entryCount);
-  puts("");
-  for (int i = 0; i < table->entryCount; i++) {
-    printEntry(table->entries[i]);
+DataType *newParameters(int count) {
+  return count > 0 ? arenaAlloc(semanticArena, count * sizeof(DataType))
+                   : NULL;
+}
+
+void initSemanticState(SemanticState *state) {
+  *state = (SemanticState){0};
+  state->tempDeclarationReturnType = INT;
+  state->callStack.top = -1; // 0 based top
+}
+
+// Forget every scope and frame, their memory is gone
+static void forgetSymbolTables() {
+  semantic->scopes = NULL;
+  semantic->scopeCount = 0;
+  semantic->scopeCapacity = 0;
+  semantic->visible = NULL;
+  semantic->visibleSlotCount = 0;
+  semantic->visibleNameCount = 0;
+  semantic->callStack.stack = NULL;
+  semantic->callStack.top = -1;
+  semantic->callStack.capacity = 0;
+  semantic->tempArgList = NULL;
+  semantic->argCount = 0;
+  semantic->argCapacity = 0;
+}
+
+void freeSymbolTables() {
+  releaseArena(semanticArena);
+  forgetSymbolTables();
+}
+
+void clearSymbolTables() {
+  rewindArena(semanticArena);
+  forgetSymbolTables();
+}
+
+void scopeError(DiagnosticId id, int line, const char *message) {
+  // Not an error of the program, but the sequential compile reports it
+  if (errorState->isQuiet) {
+    setErrorOccurred();
+    return;
   }
-  puts("");
-  puts("");
+
+  reportWarning(PHASE_SEMANTIC, id, line, 0, "Scope Error: %s", message);
 }
 
-void printCurrentScope() {
-  SymbolTable *table = &scopes[scopeCount - 1];
-
-  puts("===============");
-  puts("Print Scope");
-  puts("===============");
-  printf("table name: %s\n", table->name);
-  printf("entry count: %d\n", table->entryCount);
-  puts("");
+// Every entry of a scope, in the order declared
+static void traceScope(SymbolTable *table) {
+  traceFormat("===============\nPrint Scope\n===============\n"
+              "table name: %s\nentry count: %d\n\n",
+              table->name, table->entryCount);
   for (int i = 0; i < table->entryCount; i++) {
-    printEntry(table->entries[i]);
+    printEntry(*table->entries[i]);
+  }
+  traceFormat("\n\n");
+}
+
+void printScope(SymbolTable *table) {
+  if (isTraced(TRACE_SEMANTIC, TRACE_RULE)) {
+    traceScope(table);
   }
-  puts("");
-  puts("");
+}
+
+void printCurrentScope() {
+  traceScope(&semantic->scopes[semantic->scopeCount - 1]);
 }
 
 void printEntry(SymbolTableEntry entry) {
-  printf("lexeme: %s\n", entry.lexeme);
-  printf("line: %d\n", entry.lineNumber);
-  printf("arg count: %d\n", entry.parameterCount);
-  printf("return type: %s\n", entry.returnType == INT ? "integer" : "double");
-  printf("symbol type: %s\n",
-         entry.symbolType == VARIABLE ? "variable" : "function");
+  traceFormat("lexeme: %s\nline: %d\narg count: %d\nreturn type: %s\n"
+              "symbol type: %s\n",
+              entry.lexeme, lineOf(entry.offset), entry.parameterCount,
+              entry.returnType == INT ? "integer" : "double",
+              entry.symbolType == VARIABLE ? "variable" : "function");
 
   for (int i = 0; i < entry.parameterCount; i++) {
-    printf("arg %d type: %s\n", i + 1,
-           entry.parameters[i] == INT ? "integer" : "double");
+    traceFormat("arg %d type: %s\n", i + 1,
+                entry.parameters[i] == INT ? "integer" : "double");
   }
 
-  puts("");
+  traceFormat("\n");
 }
 
 const char *dataTypeToString(DataType type) {
@@ -1,14 +1,11 @@
 #ifndef SEMANTIC_ANALYZER_H
 #define SEMANTIC_ANALYZER_H
 
-// Adjust as needed
-#define MAX_ENTRIES 100
-#define MAX_SCOPES 2
-#define MAX_ARGS 10
-#define MAX_CALL_STACKS 100
-
+#include "../common/diagnostics.h"
 #include "../common/string.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Handling scope and type
 
@@ -16,47 +13,77 @@ typedef enum { INT, DOUBLE, ERROR } DataType;
 
 typedef enum { VARIABLE, FUNCTION } SymbolType;
 
-typedef struct {
-  int lineNumber;
-  char lexeme[50];
+typedef struct SymbolTableEntry {
+  uint32_t offset; // Of the token after the name, in the input
+  const char *lexeme; // Interned name
   DataType returnType;
   SymbolType symbolType;
   int parameterCount;
-  DataType parameters[10];
+  DataType *parameters; // In the semantic arena, NULL without parameters
+  struct SymbolTableEntry *shadowed; // Same name in an enclosing scope
 } SymbolTableEntry;
 
+// One scope: an open-addressing hash table keyed by interned name. Entries
+// are allocated one by one in the semantic arena, so pointers to them stay
+// valid while the table grows.
 typedef struct {
   char name[50];
   int entryCount;
-  SymbolTableEntry entries[MAX_ENTRIES];
+  int entryCapacity;
+  SymbolTableEntry **entries; // In insertion order, for printing
+  SymbolTableEntry **slots;   // Hash index over entries, NULL if empty
+  int slotCount;              // Power of two, at most half full
+  SymbolTableEntry *function; // Function owning this scope, NULL for global
 } SymbolTable;
 
 typedef struct {
   int argCount;
-  DataType argTypes[MAX_ARGS];
+  int argCapacity;
+  DataType *argTypes; // Grows in the semantic arena, kept when reused
 } FunctionCallFrame;
 
 typedef struct {
-  FunctionCallFrame stack[MAX_CALL_STACKS];
+  FunctionCallFrame *stack; // Grows in the semantic arena
   int top;
+  int capacity;
 } FunctionCallStack;
 
-// Exported variables
-extern int scopeCount;
-extern SymbolTable scopes[];
+// Innermost entry for every name seen, across the whole scope chain. A slot
+// keeps its name once used; its entry is NULL when no scope declares it.
+typedef struct {
+  const char *lexeme;
+  SymbolTableEntry *entry;
+} VisibleSlot;
+
+// Everything the semantic analysis works on, one per compiler context
+typedef struct {
+  // Scope chain: global scope, then one scope per function being analysed;
+  // grows in the semantic arena
+  int scopeCount;
+  SymbolTable *scopes;
+  int scopeCapacity;
+
+  VisibleSlot *visible;
+  int visibleSlotCount;
+  int visibleNameCount;
+
+  DataType tempDeclarationReturnType; // For varlist only
+  SymbolTableEntry *tempArgList;        // Grows in the semantic arena
+  int argCount;
+  int argCapacity;
 
-extern char semanticErrorBuffer[];
-extern size_t semanticErrorBufferIndex;
+  FunctionCallStack callStack;
+} SemanticState;
 
-extern DataType tempDeclarationReturnType; // For varlist only
-extern DataType tempArgTypeList[];
-extern SymbolTableEntry tempArgList[];
-extern int argCount;
+// Semantic analysis of the context bound to this thread
+extern _Thread_local SemanticState *semantic;
 
-extern FunctionCallStack callStack;
+// Set a state up for its first analysis
+void initSemanticState(SemanticState *state);
 
 // Define the operations for symbol table stack
-// Add a new scope
+// Add a new scope. If the name is a function visible from the current scope
+// the new scope belongs to that function.
 void pushScope(const char *scopeName);
 // Remove the scope at the very top
 SymbolTable *popScope();
@@ -65,20 +92,35 @@ SymbolTable *getSymbolTable();
 // Insert the symbol at the current scope
 void insertSymbol(SymbolTableEntry entry);
 // Look for the symbol, starting from the very top, then bottom
+// The lexeme must be interned, names are compared by pointer. A single
+// probe whatever the depth: every name maps to its innermost entry.
 SymbolTableEntry *lookupSymbol(const char *lexeme);
-// Look for the function symbol, starting from the very top, then bottom
+// The function whose body is being analysed, NULL at global scope
 SymbolTableEntry *getFunctionEntry();
 
 // Nested Function calls
+// Pushing may move the frames, so fetch the current frame again after it
 void pushCallFrame();
 void popCallFrame();
 FunctionCallFrame *currentCallFrame();
+// Record the type of the next argument of the innermost call
+void addArgType(DataType type);
+
+// Record a parameter of the function being declared
+void addTempArg(SymbolTableEntry entry);
+// Room for the types of a function's parameters, NULL for none
+DataType *newParameters(int count);
+
+// Release the symbol tables and call frames at once
+void freeSymbolTables();
+// The same, keeping memory for the next ones, as a worker does per function
+void clearSymbolTables();
 
 // Scope error handling
-void scopeError(const char *message);
-void semanticError(const char *message);
+// Scope errors do not stop the compile, though quiet ones do
+void scopeError(DiagnosticId id, int line, const char *message);
 
-// Debugging
+// Debugging, written to the trace
 void printScope(SymbolTable *table);
 void printCurrentScope();
 void printEntry(SymbolTableEntry entry);
@@ -0,0 +1,11 @@
+def int add(int a, int b)
+	return (a + c)
+fed;
+def double half(double d)
+	return e
+fed;
+int x;
+x = add(x, y) * z;
+x = w;
+if (x < v) then print(x) fi;
+.
\ No newline at end of file
@@ -0,0 +1,15 @@
+def int f(int q)
+	int u, s;
+	u=0; s=0;
+	while(u<q) do
+		s = s+u*3; u=u+1
+	od;
+	return (s)
+fed;
+int a[20], i;
+i=0;
+while(i<20) do
+	a[i] = i*7%13; i=i+1
+od;
+print f(10);
+print a[11]; print a[18]; print a[19].
\ No newline at end of file
@@ -0,0 +1,67 @@
+// To compile: gcc tools/gen_transition_table.c lexer/transition_table.c -o
+// gen_transition_table
+// To regenerate (from the repository root), whenever lexer_transition.txt
+// changes: ./gen_transition_table lexer_transition.txt >
+// lexer/transition_table_data.h
+
+//> Build step: turn the transition table text file into the compact DFA the
+// lexer links in, so the compiler never parses the text file at startup
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "../lexer/transition_table.h"
+
+int main(int argc, const char *argv[]) {
+  const char *tablePath = argc > 1 ? argv[1] : "lexer_transition.txt";
+
+  int fd = open(tablePath, O_RDONLY);
+  if (fd == -1) {
+    perror("Failed to open transition table file");
+    return 1;
+  }
+
+  static TransitionState table[TT_ROWS][TT_COLS];
+  static CompactDfa dfa;
+  int isRead = initTransitionTable(table, &fd) == 0;
+  close(fd);
+
+  if (!isRead || compressTransitionTable(table, &dfa) != 0) {
+    return 1;
+  }
+
+  printf("// Generated by tools/gen_transition_table.c from %s.\n", tablePath);
+  printf("// Do not edit by hand, regenerate it instead.\n\n");
+  printf("#ifndef TRANSITION_TABLE_DATA_H\n");
+  printf("#define TRANSITION_TABLE_DATA_H\n\n");
+  printf("#include \"transition_table.h\"\n\n");
+  printf("static const CompactDfa builtinDfa = {\n");
+
+  printf("    .byteClass =\n        {");
+  for (int byte = 0; byte < TT_BYTES; byte++) {
+    if (byte > 0) {
+      printf(byte % 16 == 0 ? ",\n         " : ", ");
+    }
+    printf("%2d", dfa.byteClass[byte]);
+  }
+  printf("},\n");
+
+  printf("    .next =\n        {");
+  for (int row = 0; row < TT_ROWS; row++) {
+    printf("%s{", row > 0 ? "         " : "");
+    for (int class = 0; class < TT_MAX_CLASSES; class++) {
+      if (class > 0) {
+        printf(class % 16 == 0 ? ",\n          " : ", ");
+      }
+      printf("%2d", dfa.next[row][class]);
+    }
+    printf("}%s\n", row < TT_ROWS - 1 ? "," : "},");
+  }
+
+  printf("    .classCount = %d,\n", dfa.classCount);
+  printf("};\n\n");
+  printf("#endif\n");
+
+  return 0;
+}
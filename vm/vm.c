@@ -0,0 +1,639 @@
+#include "vm.h"
+#include "../codegen/ir.h"
+#include "../common/arena.h"
+#include "../semantic/semantic.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Values of the register stack; deep recursion beyond it is an error
+#define MAX_STACK_VALUES (1 << 24)
+#define INITIAL_STACK_VALUES 4096
+#define INITIAL_IMAGE_VALUES 256
+
+// Jump through a table of label addresses where the compiler supports it,
+// so every handler dispatches the next instruction itself
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+//> Lowering
+// Register of every IR variable in its owner's frame
+static int32_t *variableRegister;
+
+// Register of a constant in the function being lowered, valid when
+// constantOwner matches it
+static int32_t *constantRegister;
+static int32_t *constantOwner;
+
+// Bytecode index of every label
+static int32_t *labelTarget;
+
+// First register of the temporaries of the function being lowered
+static int32_t tempBase;
+static int32_t tempFirst;
+
+static int32_t registerOf(Operand operand) {
+  uint32_t index = operandIndex(operand);
+
+  switch (operandKind(operand)) {
+  case OPERAND_VARIABLE:
+    return variableRegister[index];
+  case OPERAND_TEMP:
+    return tempBase + (int32_t)index - tempFirst;
+  case OPERAND_CONSTANT:
+    return constantRegister[index];
+  default:
+    return 0;
+  }
+}
+
+static int32_t *newTable(int count) {
+  int32_t *table = arenaAlloc(vmArena, (count + 1) * sizeof(int32_t));
+  for (int i = 0; i <= count; i++) {
+    table[i] = -1;
+  }
+
+  return table;
+}
+
+static int ownerOf(const IrVariable *variable) {
+  return variable->function == -1 ? ir->entry : variable->function;
+}
+
+// Give every variable its registers: parameters first, as the IR lists
+// them, and one extra register before each array for its size
+static int32_t *layoutVariables() {
+  int32_t *nextRegister = newTable(ir->functionCount);
+  for (int f = 0; f < ir->functionCount; f++) {
+    nextRegister[f] = 0;
+  }
+
+  variableRegister = newTable(ir->variableCount);
+  for (int v = 0; v < ir->variableCount; v++) {
+    IrVariable *variable = &ir->variables[v];
+    int owner = ownerOf(variable);
+
+    if (variable->arraySize > 0) {
+      nextRegister[owner]++;
+      variableRegister[v] = nextRegister[owner];
+      nextRegister[owner] += variable->arraySize;
+    } else {
+      variableRegister[v] = nextRegister[owner]++;
+    }
+  }
+
+  return nextRegister;
+}
+
+static void bindConstant(int f, Operand operand, int32_t *registerCount) {
+  if (operandKind(operand) != OPERAND_CONSTANT) {
+    return;
+  }
+
+  uint32_t index = operandIndex(operand);
+  if (constantOwner[index] == f) {
+    return;
+  }
+
+  constantOwner[index] = f;
+  constantRegister[index] = (*registerCount)++;
+}
+
+// First pass over a function: place its labels, and give its temporaries
+// and constants registers after the variables
+static void layoutFunction(VmProgram *program, int f, int32_t registerCount) {
+  IrFunction *function = &ir->functions[f];
+  VmFunction *target = &program->functions[f];
+  int32_t codeCount = program->codeCount;
+
+  tempBase = registerCount;
+  tempFirst = function->firstTemp;
+  registerCount += function->tempCount;
+
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+
+    if (instruction->opcode == IR_LABEL) {
+      labelTarget[operandIndex(instruction->result)] = codeCount;
+      continue;
+    }
+
+    if (instruction->opcode != IR_NOP) {
+      codeCount++;
+    }
+    bindConstant(f, instruction->arg1, &registerCount);
+    bindConstant(f, instruction->arg2, &registerCount);
+  }
+
+  target->name = function->name;
+  target->paramCount = function->paramCount;
+  // Returned values need a register even in an empty function
+  target->registerCount = registerCount > 0 ? registerCount : 1;
+  target->stackCount = target->registerCount;
+}
+
+static void emit(VmProgram *program, VmOpcode opcode, int32_t a, int32_t b,
+                 int32_t c) {
+  Bytecode *code = &program->code[program->codeCount++];
+  code->opcode = (uint8_t)opcode;
+  code->unused[0] = code->unused[1] = code->unused[2] = 0;
+  code->a = a;
+  code->b = b;
+  code->c = c;
+}
+
+static VmOpcode arithmeticOpcode(uint8_t opcode, uint8_t type) {
+  static const VmOpcode ints[] = {OP_ADD_INT, OP_SUB_INT, OP_MUL_INT,
+                                  OP_DIV_INT, OP_MOD_INT};
+  static const VmOpcode doubles[] = {OP_ADD_DOUBLE, OP_SUB_DOUBLE,
+                                     OP_MUL_DOUBLE, OP_DIV_DOUBLE,
+                                     OP_MOD_DOUBLE};
+
+  return type == DOUBLE ? doubles[opcode - IR_ADD] : ints[opcode - IR_ADD];
+}
+
+static VmOpcode jumpOpcode(uint8_t opcode, uint8_t type) {
+  static const VmOpcode ints[] = {OP_JUMP_LT_INT, OP_JUMP_LE_INT,
+                                  OP_JUMP_GT_INT, OP_JUMP_GE_INT,
+                                  OP_JUMP_EQ_INT, OP_JUMP_NE_INT};
+  static const VmOpcode doubles[] = {OP_JUMP_LT_DOUBLE, OP_JUMP_LE_DOUBLE,
+                                     OP_JUMP_GT_DOUBLE, OP_JUMP_GE_DOUBLE,
+                                     OP_JUMP_EQ_DOUBLE, OP_JUMP_NE_DOUBLE};
+
+  return type == DOUBLE ? doubles[opcode - IR_JUMP_LT]
+                        : ints[opcode - IR_JUMP_LT];
+}
+
+// Second pass over a function: one bytecode per IR instruction
+static void lowerFunction(VmProgram *program, int f) {
+  IrFunction *function = &ir->functions[f];
+  int32_t frameSize = program->functions[f].registerCount;
+  int32_t argument = 0;
+
+  program->functions[f].firstCode = program->codeCount;
+
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+    int32_t result = registerOf(instruction->result);
+    int32_t arg1 = registerOf(instruction->arg1);
+    int32_t arg2 = registerOf(instruction->arg2);
+
+    switch (instruction->opcode) {
+    case IR_COPY:
+      emit(program, OP_MOVE, result, arg1, 0);
+      break;
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_MOD:
+      emit(program,
+           arithmeticOpcode(instruction->opcode, instruction->type), result,
+           arg1, arg2);
+      break;
+    case IR_SHL:
+      emit(program, OP_SHL_INT, result, arg1, arg2);
+      break;
+    case IR_MOD_POW2:
+      emit(program, OP_MOD_POW2_INT, result, arg1, arg2);
+      break;
+    case IR_LOAD:
+      emit(program, OP_LOAD, result, arg1, arg2);
+      break;
+    case IR_STORE:
+      emit(program, OP_STORE, result, arg1, arg2);
+      break;
+    case IR_JUMP:
+      emit(program, OP_JUMP,
+           labelTarget[operandIndex(instruction->result)], 0, 0);
+      break;
+    case IR_JUMP_LT:
+    case IR_JUMP_LE:
+    case IR_JUMP_GT:
+    case IR_JUMP_GE:
+    case IR_JUMP_EQ:
+    case IR_JUMP_NE:
+      emit(program, jumpOpcode(instruction->opcode, instruction->type),
+           labelTarget[operandIndex(instruction->result)], arg1, arg2);
+      break;
+    case IR_PARAM:
+      // Arguments go straight to the registers the callee's frame starts at,
+      // which the frame reserves before any call grows the stack
+      emit(program, OP_PARAM, frameSize + argument++, arg1, 0);
+      if (frameSize + argument > program->functions[f].stackCount) {
+        program->functions[f].stackCount = frameSize + argument;
+      }
+      break;
+    case IR_CALL:
+      emit(program, OP_CALL, result, (int32_t)operandIndex(instruction->arg1),
+           frameSize);
+      argument = 0;
+      break;
+    case IR_RETURN:
+      if (instruction->arg1 == NO_OPERAND) {
+        emit(program, OP_HALT, 0, 0, 0);
+      } else {
+        emit(program, OP_RETURN, arg1, 0, 0);
+      }
+      break;
+    case IR_PRINT:
+      emit(program,
+           instruction->type == DOUBLE ? OP_PRINT_DOUBLE : OP_PRINT_INT, arg1,
+           0, 0);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+// Initial registers of a function: the constants it uses
+static void fillConstants(VmProgram *program, int f) {
+  IrFunction *function = &ir->functions[f];
+  Value *image = &program->images[program->functions[f].image];
+
+  for (int i = 0; i < function->instructionCount; i++) {
+    Instruction *instruction =
+        &ir->instructions[function->firstInstruction + i];
+    Operand operands[] = {instruction->arg1, instruction->arg2};
+
+    for (int j = 0; j < 2; j++) {
+      if (operandKind(operands[j]) != OPERAND_CONSTANT) {
+        continue;
+      }
+
+      IrConstant *constant = &ir->constants[operandIndex(operands[j])];
+      Value *value = &image[constantRegister[operandIndex(operands[j])]];
+      if (constant->type == DOUBLE) {
+        value->doubleValue = constant->doubleValue;
+      } else {
+        value->intValue = constant->intValue;
+      }
+    }
+  }
+}
+
+void lowerIr(VmProgram *program) {
+  int32_t *nextRegister = layoutVariables();
+  int imageCapacity = 0;
+
+  constantRegister = newTable(ir->constantCount);
+  constantOwner = newTable(ir->constantCount);
+  labelTarget = newTable(ir->labelCount);
+
+  program->entry = ir->entry;
+  program->functionCount = ir->functionCount;
+  program->functions =
+      arenaAlloc(vmArena, (ir->functionCount + 1) * sizeof(VmFunction));
+  program->codeCount = 0;
+  program->code =
+      arenaAlloc(vmArena, (ir->instructionCount + 1) * sizeof(Bytecode));
+  program->images = NULL;
+  program->imageCount = 0;
+
+  for (int f = 0; f < ir->functionCount; f++) {
+    VmFunction *function = &program->functions[f];
+
+    layoutFunction(program, f, nextRegister[f]);
+
+    int newCount = program->imageCount + function->registerCount;
+    if (newCount > imageCapacity) {
+      int newCapacity = imageCapacity == 0 ? INITIAL_IMAGE_VALUES
+                                           : imageCapacity * 2;
+      while (newCapacity < newCount) {
+        newCapacity *= 2;
+      }
+
+      program->images =
+          arenaGrow(vmArena, program->images, imageCapacity * sizeof(Value),
+                    newCapacity * sizeof(Value));
+      imageCapacity = newCapacity;
+    }
+
+    function->image = program->imageCount;
+    memset(&program->images[function->image], 0,
+           function->registerCount * sizeof(Value));
+    program->imageCount = newCount;
+
+    lowerFunction(program, f);
+    fillConstants(program, f);
+  }
+
+  // Every array starts with its size in the register before it
+  for (int v = 0; v < ir->variableCount; v++) {
+    IrVariable *variable = &ir->variables[v];
+
+    if (variable->arraySize > 0) {
+      VmFunction *owner = &program->functions[ownerOf(variable)];
+      program->images[owner->image + variableRegister[v] - 1].intValue =
+          variable->arraySize;
+    }
+  }
+}
+
+void freeVm() { releaseArena(vmArena); }
+//< Lowering
+
+//> Interpreter
+typedef struct {
+  const Bytecode *returnTo;
+  size_t base;    // Offset of the caller's frame in the stack
+  int32_t result; // Caller's register for the returned value
+  int32_t function;
+} CallFrame;
+
+static Value *stack;
+static size_t stackCapacity;
+static CallFrame *frames;
+static size_t frameCapacity;
+
+static void *growStack(void *memory, size_t *capacity, size_t elementSize) {
+  size_t newCapacity = *capacity == 0 ? INITIAL_STACK_VALUES : *capacity * 2;
+
+  memory = realloc(memory, newCapacity * elementSize);
+  if (!memory) {
+    perror("Failed to allocate the VM stack");
+    exit(1);
+  }
+  *capacity = newCapacity;
+
+  return memory;
+}
+
+static int runtimeError(const VmProgram *program, int32_t function,
+                        const char *message) {
+  const char *name = program->functions[function].name;
+
+  // Keep the program's own output ahead of the error
+  fflush(stdout);
+  fprintf(stderr, "Runtime Error: %s in %s%s\n", message,
+          name ? "function " : "the program", name ? name : "");
+
+  return 1;
+}
+
+int runVm(const VmProgram *program, long long *executed) {
+#ifdef VM_THREADED
+#define VM_LABEL_ADDRESS(name) &&do_##name,
+  static const void *dispatchTable[] = {VM_OPCODES(VM_LABEL_ADDRESS)};
+#undef VM_LABEL_ADDRESS
+#define CASE(name) do_##name:
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    count++;                                                                   \
+    goto *dispatchTable[pc->opcode];                                           \
+  } while (0)
+#else
+#define CASE(name) case OP_##name:
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    count++;                                                                   \
+    goto dispatch;                                                             \
+  } while (0)
+#endif
+
+  const VmFunction *entry = &program->functions[program->entry];
+  const Value *images = program->images;
+  const Bytecode *code = program->code;
+  size_t frameCount = 0;
+  int32_t function = program->entry;
+  long long count = 0;
+  int status = 0;
+
+  while (stackCapacity < (size_t)entry->stackCount) {
+    stack = growStack(stack, &stackCapacity, sizeof(Value));
+  }
+  memcpy(stack, &images[entry->image], entry->registerCount * sizeof(Value));
+
+  Value *r = stack;
+  const Bytecode *pc = &code[entry->firstCode];
+
+  DISPATCH();
+
+#ifndef VM_THREADED
+dispatch:
+  switch (pc->opcode) {
+#endif
+
+  CASE(MOVE) {
+    r[pc->a] = r[pc->b];
+    pc++;
+    DISPATCH();
+  }
+
+  // Integers wrap around instead of overflowing
+  CASE(ADD_INT) {
+    r[pc->a].intValue =
+        (int64_t)((uint64_t)r[pc->b].intValue + (uint64_t)r[pc->c].intValue);
+    pc++;
+    DISPATCH();
+  }
+  CASE(SUB_INT) {
+    r[pc->a].intValue =
+        (int64_t)((uint64_t)r[pc->b].intValue - (uint64_t)r[pc->c].intValue);
+    pc++;
+    DISPATCH();
+  }
+  CASE(MUL_INT) {
+    r[pc->a].intValue =
+        (int64_t)((uint64_t)r[pc->b].intValue * (uint64_t)r[pc->c].intValue);
+    pc++;
+    DISPATCH();
+  }
+  CASE(DIV_INT) {
+    int64_t divisor = r[pc->c].intValue;
+    if (divisor == 0) {
+      status = runtimeError(program, function, "Division by zero");
+      goto halt;
+    }
+    r[pc->a].intValue = divisor == -1
+                            ? (int64_t)(0 - (uint64_t)r[pc->b].intValue)
+                            : r[pc->b].intValue / divisor;
+    pc++;
+    DISPATCH();
+  }
+  CASE(MOD_INT) {
+    int64_t divisor = r[pc->c].intValue;
+    if (divisor == 0) {
+      status = runtimeError(program, function, "Division by zero");
+      goto halt;
+    }
+    r[pc->a].intValue = divisor == -1 ? 0 : r[pc->b].intValue % divisor;
+    pc++;
+    DISPATCH();
+  }
+  CASE(SHL_INT) {
+    r[pc->a].intValue = (int64_t)((uint64_t)r[pc->b].intValue
+                                  << r[pc->c].intValue);
+    pc++;
+    DISPATCH();
+  }
+  CASE(MOD_POW2_INT) {
+    // The remainder takes the dividend's sign, as % does
+    int64_t dividend = r[pc->b].intValue;
+    int64_t remainder = dividend & (r[pc->c].intValue - 1);
+    if (dividend < 0 && remainder != 0) {
+      remainder -= r[pc->c].intValue;
+    }
+    r[pc->a].intValue = remainder;
+    pc++;
+    DISPATCH();
+  }
+
+  CASE(ADD_DOUBLE) {
+    r[pc->a].doubleValue = r[pc->b].doubleValue + r[pc->c].doubleValue;
+    pc++;
+    DISPATCH();
+  }
+  CASE(SUB_DOUBLE) {
+    r[pc->a].doubleValue = r[pc->b].doubleValue - r[pc->c].doubleValue;
+    pc++;
+    DISPATCH();
+  }
+  CASE(MUL_DOUBLE) {
+    r[pc->a].doubleValue = r[pc->b].doubleValue * r[pc->c].doubleValue;
+    pc++;
+    DISPATCH();
+  }
+  CASE(DIV_DOUBLE) {
+    r[pc->a].doubleValue = r[pc->b].doubleValue / r[pc->c].doubleValue;
+    pc++;
+    DISPATCH();
+  }
+  CASE(MOD_DOUBLE) {
+    r[pc->a].doubleValue = fmod(r[pc->b].doubleValue, r[pc->c].doubleValue);
+    pc++;
+    DISPATCH();
+  }
+
+  CASE(LOAD) {
+    int64_t index = r[pc->c].intValue;
+    if ((uint64_t)index >= (uint64_t)r[pc->b - 1].intValue) {
+      status = runtimeError(program, function, "Array index out of bounds");
+      goto halt;
+    }
+    r[pc->a] = r[pc->b + index];
+    pc++;
+    DISPATCH();
+  }
+  CASE(STORE) {
+    int64_t index = r[pc->b].intValue;
+    if ((uint64_t)index >= (uint64_t)r[pc->a - 1].intValue) {
+      status = runtimeError(program, function, "Array index out of bounds");
+      goto halt;
+    }
+    r[pc->a + index] = r[pc->c];
+    pc++;
+    DISPATCH();
+  }
+
+  CASE(JUMP) {
+    pc = &code[pc->a];
+    DISPATCH();
+  }
+
+#define VM_JUMP_IF(name, field, op)                                            \
+  CASE(name) {                                                                 \
+    pc = r[pc->b].field op r[pc->c].field ? &code[pc->a] : pc + 1;             \
+    DISPATCH();                                                                \
+  }
+  VM_JUMP_IF(JUMP_LT_INT, intValue, <)
+  VM_JUMP_IF(JUMP_LE_INT, intValue, <=)
+  VM_JUMP_IF(JUMP_GT_INT, intValue, >)
+  VM_JUMP_IF(JUMP_GE_INT, intValue, >=)
+  VM_JUMP_IF(JUMP_EQ_INT, intValue, ==)
+  VM_JUMP_IF(JUMP_NE_INT, intValue, !=)
+  VM_JUMP_IF(JUMP_LT_DOUBLE, doubleValue, <)
+  VM_JUMP_IF(JUMP_LE_DOUBLE, doubleValue, <=)
+  VM_JUMP_IF(JUMP_GT_DOUBLE, doubleValue, >)
+  VM_JUMP_IF(JUMP_GE_DOUBLE, doubleValue, >=)
+  VM_JUMP_IF(JUMP_EQ_DOUBLE, doubleValue, ==)
+  VM_JUMP_IF(JUMP_NE_DOUBLE, doubleValue, !=)
+#undef VM_JUMP_IF
+
+  CASE(PARAM) {
+    r[pc->a] = r[pc->b];
+    pc++;
+    DISPATCH();
+  }
+
+  CASE(CALL) {
+    const VmFunction *callee = &program->functions[pc->b];
+    size_t base = (size_t)(r - stack);
+    size_t top = base + pc->c + callee->stackCount;
+
+    // Registers and frames grow together, so both are bounded by the stack
+    if (top > MAX_STACK_VALUES) {
+      status = runtimeError(program, function, "Stack overflow");
+      goto halt;
+    }
+    while (top > stackCapacity) {
+      stack = growStack(stack, &stackCapacity, sizeof(Value));
+      r = stack + base;
+    }
+    if (frameCount == frameCapacity) {
+      frames = growStack(frames, &frameCapacity, sizeof(CallFrame));
+    }
+
+    CallFrame *frame = &frames[frameCount++];
+    frame->returnTo = pc + 1;
+    frame->base = base;
+    frame->result = pc->a;
+    frame->function = function;
+
+    // The arguments are in place, the rest of the frame starts from the
+    // callee's image
+    r += pc->c;
+    memcpy(r + callee->paramCount, &images[callee->image + callee->paramCount],
+           (callee->registerCount - callee->paramCount) * sizeof(Value));
+
+    function = pc->b;
+    pc = &code[callee->firstCode];
+    DISPATCH();
+  }
+
+  CASE(RETURN) {
+    Value value = r[pc->a];
+    CallFrame *frame = &frames[--frameCount];
+
+    r = stack + frame->base;
+    r[frame->result] = value;
+    function = frame->function;
+    pc = frame->returnTo;
+    DISPATCH();
+  }
+
+  CASE(PRINT_INT) {
+    printf("%lld\n", (long long)r[pc->a].intValue);
+    pc++;
+    DISPATCH();
+  }
+  CASE(PRINT_DOUBLE) {
+    printf("%g\n", r[pc->a].doubleValue);
+    pc++;
+    DISPATCH();
+  }
+
+  CASE(HALT) { goto halt; }
+
+#ifndef VM_THREADED
+  default:
+    goto halt;
+  }
+#endif
+
+halt:
+  if (executed) {
+    *executed = count;
+  }
+
+  return status;
+
+#undef CASE
+#undef DISPATCH
+}
+//< Interpreter
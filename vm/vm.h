@@ -0,0 +1,109 @@
+// Register bytecode lowered from the IR, and the interpreter that runs it
+
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+
+// A register holds either kind of value; the bytecode knows which
+typedef union {
+  int64_t intValue;
+  double doubleValue;
+} Value;
+
+// Every opcode comes in the typed variants the IR instruction asks for.
+// Operands a, b and c are registers of the current frame unless noted.
+#define VM_OPCODES(X)                                                          \
+  X(MOVE)         /* r[a] = r[b] */                                            \
+  X(ADD_INT)      /* r[a] = r[b] + r[c] */                                     \
+  X(SUB_INT)                                                                   \
+  X(MUL_INT)                                                                   \
+  X(DIV_INT)                                                                   \
+  X(MOD_INT)                                                                   \
+  X(SHL_INT)      /* r[a] = r[b] << r[c] */                                    \
+  X(MOD_POW2_INT) /* r[a] = r[b] % r[c], r[c] a power of two */                \
+  X(ADD_DOUBLE)                                                                \
+  X(SUB_DOUBLE)                                                                \
+  X(MUL_DOUBLE)                                                                \
+  X(DIV_DOUBLE)                                                                \
+  X(MOD_DOUBLE)                                                                \
+  X(LOAD)         /* r[a] = r[b + r[c]], r[b - 1] holds the array size */      \
+  X(STORE)        /* r[a + r[b]] = r[c] */                                     \
+  X(JUMP)         /* goto a */                                                 \
+  X(JUMP_LT_INT)  /* if r[b] < r[c] goto a */                                  \
+  X(JUMP_LE_INT)                                                               \
+  X(JUMP_GT_INT)                                                               \
+  X(JUMP_GE_INT)                                                               \
+  X(JUMP_EQ_INT)                                                               \
+  X(JUMP_NE_INT)                                                               \
+  X(JUMP_LT_DOUBLE)                                                            \
+  X(JUMP_LE_DOUBLE)                                                            \
+  X(JUMP_GT_DOUBLE)                                                            \
+  X(JUMP_GE_DOUBLE)                                                            \
+  X(JUMP_EQ_DOUBLE)                                                            \
+  X(JUMP_NE_DOUBLE)                                                            \
+  X(PARAM)        /* r[a] = r[b], a past the frame: the callee's argument */   \
+  X(CALL)         /* r[a] = call function b, c is the caller's frame size */   \
+  X(RETURN)       /* return r[a] to the caller */                              \
+  X(PRINT_INT)    /* print r[a] */                                             \
+  X(PRINT_DOUBLE)                                                              \
+  X(HALT)         /* end of the program */
+
+#define VM_OPCODE_ENUM(name) OP_##name,
+typedef enum { VM_OPCODES(VM_OPCODE_ENUM) OP_COUNT } VmOpcode;
+#undef VM_OPCODE_ENUM
+
+// 16 bytes, like the IR instruction it comes from
+typedef struct {
+  uint8_t opcode; // VmOpcode
+  uint8_t unused[3];
+  int32_t a;
+  int32_t b;
+  int32_t c;
+} Bytecode;
+
+typedef struct {
+  const char *name; // Interned, NULL for the top-level statements
+  int32_t firstCode;
+  int32_t paramCount;    // Parameters are the first registers of a frame
+  int32_t registerCount; // Registers of one frame
+  int32_t stackCount;    // Those and the arguments it passes past them
+  int32_t image; // Offset in images of the frame's initial registers:
+                 // zeros, constants and array sizes
+} VmFunction;
+
+// Every table lives in the VM arena
+typedef struct {
+  Bytecode *code;
+  int codeCount;
+
+  VmFunction *functions;
+  int functionCount;
+
+  Value *images;
+  int imageCount;
+
+  int32_t entry; // Function holding the top-level statements
+} VmProgram;
+
+/**
+ * Lower the IR program to register bytecode.
+ *
+ * @param program Filled with the bytecode, valid until freeVm.
+ */
+void lowerIr(VmProgram *program);
+
+/**
+ * Run a program from its entry function until it halts. Output of print
+ * goes to stdout.
+ *
+ * @param program The lowered program.
+ * @param executed Set to the number of instructions executed, may be NULL.
+ * @return 0 on success, 1 after a runtime error reported on stderr.
+ */
+int runVm(const VmProgram *program, long long *executed);
+
+// Release every lowered program at once
+void freeVm();
+
+#endif